@@ -0,0 +1,41 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) out vec4 out_color;
+layout(location = 1) in vec2 texcoord;
+
+layout (push_constant) uniform draw_indices {
+    uint camera_index;
+    uint model_index;
+    uint tint_index;
+    uint texture_index;
+    uint sampler_index;
+    uint cube_index;
+};
+
+layout(set = 0, binding = 0) uniform texture2D textures[];
+layout(set = 0, binding = 1) readonly buffer tint_data {
+    vec4 tint[4];
+} tints[];
+layout(set = 0, binding = 2) uniform sampler samplers[];
+
+void main() {
+    vec4 color = texture(sampler2D(textures[texture_index],
+                                   samplers[sampler_index]), texcoord);
+    out_color = vec4(color.xyz * tints[tint_index].tint[cube_index].xyz, 1.0);
+}
@@ -0,0 +1,44 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+#include "models/model_setup.glsl"
+
+layout (location = 1) out vec2 texcoord;
+
+layout (push_constant) uniform draw_indices {
+    uint camera_index;
+    uint model_index;
+    uint tint_index;
+    uint texture_index;
+    uint sampler_index;
+    uint cube_index;
+};
+
+// Both of these alias the storage buffer array of the bindless heap.
+layout (binding = 1, set = 0) readonly buffer camera_data {
+    layout(column_major) mat4x4 projection[4];
+} cameras[];
+
+layout (binding = 1, set = 0) readonly buffer model_data {
+    layout(column_major) mat4x4 transform;
+} models[];
+
+void main() {
+    gl_Position = cameras[camera_index].projection[cube_index] *
+                  models[model_index].transform * get_position();
+    texcoord = get_texcoord();
+}
@@ -0,0 +1,399 @@
+// Copyright 2022 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "application_sandbox/sample_application_framework/sample_application.h"
+#include "support/entry/entry.h"
+#include "vulkan_helpers/bindless_heap.h"
+#include "vulkan_helpers/buffer_frame_data.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+#include "vulkan_helpers/vulkan_model.h"
+#include "vulkan_helpers/vulkan_texture.h"
+
+#include <chrono>
+#include "mathfu/matrix.h"
+#include "mathfu/vector.h"
+
+using Mat44 = mathfu::Matrix<float, 4, 4>;
+using Vector4 = mathfu::Vector<float, 4>;
+
+namespace cube_model {
+#include "cube.obj.h"
+}
+const auto& cube_data = cube_model::model;
+
+uint32_t bindless_heap_vertex_shader[] =
+#include "bindless_heap.vert.spv"
+    ;
+
+uint32_t bindless_heap_fragment_shader[] =
+#include "bindless_heap.frag.spv"
+    ;
+
+namespace simple_texture {
+#include "star.png.h"
+}
+
+const auto& texture_data = simple_texture::texture;
+
+// The indices of everything that a single draw uses. This matches the push
+// constant block in the shaders.
+struct DrawIndices {
+  uint32_t camera_index;
+  uint32_t model_index;
+  uint32_t tint_index;
+  uint32_t texture_index;
+  uint32_t sampler_index;
+  uint32_t cube_index;
+};
+
+struct BindlessFrameData {
+  containers::unique_ptr<vulkan::VkCommandBuffer> command_buffer_;
+  containers::unique_ptr<vulkan::VkFramebuffer> framebuffer_;
+  // This frame's ranges of the camera and model buffers.
+  vulkan::BindlessIndex camera_index_;
+  vulkan::BindlessIndex model_index_;
+};
+
+// This renders four cubes, each with a different view of the same texture,
+// without any per-draw descriptor sets. Every resource lives in the
+// application's BindlessHeap, which is bound once per command buffer, and
+// each draw gets the indices of its resources through push constants.
+class BindlessSample : public sample_application::Sample<BindlessFrameData> {
+ public:
+  BindlessSample(const entry::EntryData* data, void* device_next)
+      : data_(data),
+        Sample<BindlessFrameData>(
+            data->allocator(), data, 32, 512, 32, 32,
+            sample_application::SampleOptions()
+                .EnableBindlessHeap()
+                .AddDeviceExtensionStructure(device_next),
+            {0}, {VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME},
+            {VK_KHR_MAINTENANCE3_EXTENSION_NAME,
+             VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME}),
+        cube_(data->allocator(), data->logger(), cube_data),
+        texture_(data->allocator(), data->logger(), texture_data),
+        sampler_index_(0) {}
+
+  virtual void InitializeApplicationData(
+      vulkan::VkCommandBuffer* initialization_buffer,
+      size_t num_swapchain_images) override {
+    vulkan::BindlessHeap* heap = app()->bindless_heap();
+    cube_.InitializeData(app(), initialization_buffer);
+    texture_.InitializeData(app(), initialization_buffer);
+
+    // The first cube uses the texture's own view, the others get views
+    // that each keep only one of the color channels.
+    texture_indices_[0] = texture_.GetBindlessIndex(app());
+    const VkComponentMapping swizzles[3] = {
+        {VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_ZERO,
+         VK_COMPONENT_SWIZZLE_ZERO, VK_COMPONENT_SWIZZLE_A},
+        {VK_COMPONENT_SWIZZLE_ZERO, VK_COMPONENT_SWIZZLE_G,
+         VK_COMPONENT_SWIZZLE_ZERO, VK_COMPONENT_SWIZZLE_A},
+        {VK_COMPONENT_SWIZZLE_ZERO, VK_COMPONENT_SWIZZLE_ZERO,
+         VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A}};
+    for (size_t i = 0; i < 3; ++i) {
+      VkImageViewCreateInfo view_create_info = {
+          VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,  // sType
+          nullptr,                                   // pNext
+          0,                                         // flags
+          texture_.image(),                          // image
+          VK_IMAGE_VIEW_TYPE_2D,                     // viewType
+          texture_data.format,                       // format
+          swizzles[i],                               // components
+          {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
+
+      ::VkImageView raw_view;
+      LOG_ASSERT(==, data_->logger(), VK_SUCCESS,
+                 app()->device()->vkCreateImageView(
+                     app()->device(), &view_create_info, nullptr, &raw_view));
+      image_views_[i] = containers::make_unique<vulkan::VkImageView>(
+          data_->allocator(),
+          vulkan::VkImageView(raw_view, nullptr, &app()->device()));
+      texture_indices_[i + 1] = heap->AddSampledImage(raw_view);
+    }
+
+    sampler_ = containers::make_unique<vulkan::VkSampler>(
+        data_->allocator(),
+        vulkan::CreateSampler(&app()->device(), VK_FILTER_LINEAR,
+                              VK_FILTER_LINEAR));
+    sampler_index_ = heap->AddSampler(*sampler_);
+
+    // A tint per cube, in a plain storage buffer that is added through
+    // VulkanApplication::GetBindlessIndex().
+    const float tints[4][4] = {{1.0f, 1.0f, 1.0f, 1.0f},
+                               {1.0f, 0.5f, 0.5f, 1.0f},
+                               {0.5f, 1.0f, 0.5f, 1.0f},
+                               {0.5f, 0.5f, 1.0f, 1.0f}};
+    tint_buffer_ = app()->CreateAndBindDefaultExclusiveCoherentBuffer(
+        sizeof(tints), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    memcpy(tint_buffer_->base_address(), tints, sizeof(tints));
+    tint_buffer_->flush();
+
+    VkPushConstantRange push_constant_range{
+        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,  // stages
+        0,                                                          // offset
+        sizeof(DrawIndices)                                         // size
+    };
+    pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data_->allocator(),
+        app()->CreatePipelineLayout({heap->layout()}, {push_constant_range}));
+
+    VkAttachmentReference color_attachment = {
+        0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+
+    render_pass_ = containers::make_unique<vulkan::VkRenderPass>(
+        data_->allocator(),
+        app()->CreateRenderPass(
+            {{
+                0,                                         // flags
+                render_format(),                           // format
+                num_samples(),                             // samples
+                VK_ATTACHMENT_LOAD_OP_CLEAR,               // loadOp
+                VK_ATTACHMENT_STORE_OP_STORE,              // storeOp
+                VK_ATTACHMENT_LOAD_OP_DONT_CARE,           // stencilLoadOp
+                VK_ATTACHMENT_STORE_OP_DONT_CARE,          // stencilStoreOp
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // initialLayout
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL   // finalLayout
+            }},  // AttachmentDescriptions
+            {{
+                0,                                // flags
+                VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
+                0,                                // inputAttachmentCount
+                nullptr,                          // pInputAttachments
+                1,                                // colorAttachmentCount
+                &color_attachment,                // colorAttachment
+                nullptr,                          // pResolveAttachments
+                nullptr,                          // pDepthStencilAttachment
+                0,                                // preserveAttachmentCount
+                nullptr                           // pPreserveAttachments
+            }},                                   // SubpassDescriptions
+            {}                                    // SubpassDependencies
+            ));
+
+    cube_pipeline_ = containers::make_unique<vulkan::VulkanGraphicsPipeline>(
+        data_->allocator(), app()->CreateGraphicsPipeline(
+                                pipeline_layout_.get(), render_pass_.get(), 0));
+    cube_pipeline_->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main",
+                              bindless_heap_vertex_shader);
+    cube_pipeline_->AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, "main",
+                              bindless_heap_fragment_shader);
+    cube_pipeline_->SetTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    cube_pipeline_->SetInputStreams(&cube_);
+    cube_pipeline_->SetViewport(viewport());
+    cube_pipeline_->SetScissor(scissor());
+    cube_pipeline_->SetSamples(num_samples());
+    cube_pipeline_->AddAttachment();
+    cube_pipeline_->Commit();
+
+    camera_data_ = containers::make_unique<vulkan::BufferFrameData<CameraData>>(
+        data_->allocator(), app(), num_swapchain_images,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+    model_data_ = containers::make_unique<vulkan::BufferFrameData<ModelData>>(
+        data_->allocator(), app(), num_swapchain_images,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+    float aspect =
+        (float)app()->swapchain().width() / (float)app()->swapchain().height();
+    const float offsets[4][2] = {
+        {-0.5f, -0.5f}, {-0.5f, 0.5f}, {0.5f, -0.5f}, {0.5f, 0.5f}};
+    for (size_t i = 0; i < 4; ++i) {
+      camera_data_->data().projection_matrix[i] =
+          Mat44::FromTranslationVector(
+              mathfu::Vector<float, 3>{offsets[i][0], offsets[i][1], 0.0f}) *
+          Mat44::FromScaleVector(mathfu::Vector<float, 3>{1.0f, -1.0f, 1.0f}) *
+          Mat44::Perspective(1.5708f, aspect, 0.1f, 100.0f);
+    }
+
+    model_data_->data().transform = Mat44::FromTranslationVector(
+        mathfu::Vector<float, 3>{0.0f, 0.0f, -3.0f});
+  }
+
+  virtual void InitializationComplete() override {
+    texture_.InitializationComplete();
+  }
+
+  virtual void InitializeFrameData(
+      BindlessFrameData* frame_data,
+      vulkan::VkCommandBuffer* initialization_buffer,
+      size_t frame_index) override {
+    vulkan::BindlessHeap* heap = app()->bindless_heap();
+    frame_data->command_buffer_ =
+        containers::make_unique<vulkan::VkCommandBuffer>(
+            data_->allocator(), app()->GetCommandBuffer());
+
+    frame_data->camera_index_ = vulkan::BindlessIndex(
+        heap, vulkan::BindlessHeap::kStorageBufferBinding,
+        heap->AddStorageBuffer(camera_data_->get_buffer(),
+                               camera_data_->get_offset_for_frame(frame_index),
+                               camera_data_->size()));
+    frame_data->model_index_ = vulkan::BindlessIndex(
+        heap, vulkan::BindlessHeap::kStorageBufferBinding,
+        heap->AddStorageBuffer(model_data_->get_buffer(),
+                               model_data_->get_offset_for_frame(frame_index),
+                               model_data_->size()));
+
+    ::VkImageView raw_view = color_view(frame_data);
+
+    // Create a framebuffer with depth and image attachments
+    VkFramebufferCreateInfo framebuffer_create_info{
+        VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        *render_pass_,                              // renderPass
+        1,                                          // attachmentCount
+        &raw_view,                                  // attachments
+        app()->swapchain().width(),                 // width
+        app()->swapchain().height(),                // height
+        1                                           // layers
+    };
+
+    ::VkFramebuffer raw_framebuffer;
+    app()->device()->vkCreateFramebuffer(
+        app()->device(), &framebuffer_create_info, nullptr, &raw_framebuffer);
+    frame_data->framebuffer_ = containers::make_unique<vulkan::VkFramebuffer>(
+        data_->allocator(),
+        vulkan::VkFramebuffer(raw_framebuffer, nullptr, &app()->device()));
+
+    (*frame_data->command_buffer_)
+        ->vkBeginCommandBuffer((*frame_data->command_buffer_),
+                               &sample_application::kBeginCommandBuffer);
+    vulkan::VkCommandBuffer& cmdBuffer = (*frame_data->command_buffer_);
+
+    VkClearValue clear;
+    vulkan::MemoryClear(&clear);
+
+    VkRenderPassBeginInfo pass_begin = {
+        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
+        nullptr,                                   // pNext
+        *render_pass_,                             // renderPass
+        *frame_data->framebuffer_,                 // framebuffer
+        {{0, 0},
+         {app()->swapchain().width(),
+          app()->swapchain().height()}},  // renderArea
+        1,                                // clearValueCount
+        &clear                            // clears
+    };
+
+    cmdBuffer->vkCmdBeginRenderPass(cmdBuffer, &pass_begin,
+                                    VK_SUBPASS_CONTENTS_INLINE);
+
+    cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                 *cube_pipeline_);
+    // The only descriptor set bind in this command buffer.
+    heap->Bind(&cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, *pipeline_layout_,
+               0);
+    for (uint32_t i = 0; i < 4; ++i) {
+      DrawIndices indices = {
+          frame_data->camera_index_.index(),         // camera_index
+          frame_data->model_index_.index(),          // model_index
+          app()->GetBindlessIndex(tint_buffer_.get()),  // tint_index
+          texture_indices_[i],                       // texture_index
+          sampler_index_,                            // sampler_index
+          i,                                         // cube_index
+      };
+      cmdBuffer->vkCmdPushConstants(
+          cmdBuffer, *pipeline_layout_,
+          VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+          sizeof(indices), &indices);
+      cube_.Draw(&cmdBuffer);
+    }
+    cmdBuffer->vkCmdEndRenderPass(cmdBuffer);
+
+    (*frame_data->command_buffer_)
+        ->vkEndCommandBuffer(*frame_data->command_buffer_);
+  }
+
+  virtual void Update(float time_since_last_render) override {
+    model_data_->data().transform =
+        model_data_->data().transform *
+        Mat44::FromRotationMatrix(
+            Mat44::RotationX(3.14f * time_since_last_render) *
+            Mat44::RotationY(3.14f * time_since_last_render * 0.5f));
+  }
+
+  virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
+                      BindlessFrameData* frame_data) override {
+    // Update our uniform buffers.
+    camera_data_->UpdateBuffer(queue, frame_index);
+    model_data_->UpdateBuffer(queue, frame_index);
+
+    VkSubmitInfo init_submit_info{
+        VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+        nullptr,                        // pNext
+        0,                              // waitSemaphoreCount
+        nullptr,                        // pWaitSemaphores
+        nullptr,                        // pWaitDstStageMask,
+        1,                              // commandBufferCount
+        &(frame_data->command_buffer_->get_command_buffer()),
+        0,       // signalSemaphoreCount
+        nullptr  // pSignalSemaphores
+    };
+
+    app()->render_queue()->vkQueueSubmit(app()->render_queue(), 1,
+                                         &init_submit_info,
+                                         static_cast<VkFence>(VK_NULL_HANDLE));
+  }
+
+ private:
+  struct CameraData {
+    Mat44 projection_matrix[4];
+  };
+
+  struct ModelData {
+    Mat44 transform;
+  };
+
+  const entry::EntryData* data_;
+  containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
+  containers::unique_ptr<vulkan::VulkanGraphicsPipeline> cube_pipeline_;
+  containers::unique_ptr<vulkan::VkRenderPass> render_pass_;
+  vulkan::VulkanModel cube_;
+  vulkan::VulkanTexture texture_;
+  containers::unique_ptr<vulkan::VkImageView> image_views_[3];
+  containers::unique_ptr<vulkan::VkSampler> sampler_;
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> tint_buffer_;
+
+  // The heap indices of the four texture views and of the sampler. These
+  // stay in the heap for the lifetime of the application.
+  uint32_t texture_indices_[4];
+  uint32_t sampler_index_;
+
+  containers::unique_ptr<vulkan::BufferFrameData<CameraData>> camera_data_;
+  containers::unique_ptr<vulkan::BufferFrameData<ModelData>> model_data_;
+};
+
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptor_index_features{};
+  descriptor_index_features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+  descriptor_index_features.runtimeDescriptorArray = true;
+  descriptor_index_features.descriptorBindingPartiallyBound = true;
+  descriptor_index_features.descriptorBindingUpdateUnusedWhilePending = true;
+  descriptor_index_features.descriptorBindingSampledImageUpdateAfterBind = true;
+  descriptor_index_features.descriptorBindingStorageBufferUpdateAfterBind =
+      true;
+  BindlessSample sample(data, &descriptor_index_features);
+  sample.Initialize();
+
+  while (!sample.should_exit() && !data->WindowClosing()) {
+    sample.ProcessFrame();
+  }
+  sample.WaitIdle();
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
@@ -0,0 +1,460 @@
+// Copyright 2022 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+
+#include "application_sandbox/sample_application_framework/sample_application.h"
+#include "mathfu/matrix.h"
+#include "mathfu/vector.h"
+#include "support/entry/entry.h"
+#include "vulkan_helpers/buffer_frame_data.h"
+#include "vulkan_helpers/descriptor_allocator.h"
+#include "vulkan_helpers/descriptor_writer.h"
+#include "vulkan_helpers/gpu_profiler.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+#include "vulkan_helpers/vulkan_model.h"
+
+using Mat44 = mathfu::Matrix<float, 4, 4>;
+using Vector4 = mathfu::Vector<float, 4>;
+
+namespace cube_model {
+#include "cube.obj.h"
+}
+const auto& cube_data = cube_model::model;
+
+uint32_t cube_vertex_shader[] =
+#include "cube.vert.spv"
+    ;
+
+uint32_t cube_fragment_shader[] =
+#include "cube.frag.spv"
+    ;
+
+// The number of descriptor sets that are allocated and updated every frame.
+const size_t kNumSets = 10000;
+// The number of frames each update mode runs for before switching.
+const size_t kFramesPerMode = 100;
+
+struct CubeFrameData {
+  containers::unique_ptr<vulkan::VkCommandBuffer> command_buffer_;
+  containers::unique_ptr<vulkan::VkFramebuffer> framebuffer_;
+  containers::unique_ptr<vulkan::DescriptorAllocator> descriptor_allocator_;
+  ::VkDescriptorSetLayout descriptor_set_layout_;
+};
+
+using Clock = std::chrono::high_resolution_clock;
+
+// This renders a rotating cube, but every frame it allocates kNumSets
+// descriptor sets and writes both uniform buffers to all of them. The sets
+// are written in one of three ways, which are switched every kFramesPerMode
+// frames:
+//   individually: one vkUpdateDescriptorSets call per set.
+//   batched:      a DescriptorWriter that makes one vkUpdateDescriptorSets
+//                 call for all of the sets.
+//   templated:    a DescriptorWriter that uses a VkDescriptorUpdateTemplate
+//                 per layout.
+// The average CPU time spent writing the sets is printed for each mode.
+// With -gpu-trace, the writes and the render pass of every frame are timed
+// with a GpuProfiler, and written to a Chrome trace on exit.
+class CubeSample : public sample_application::Sample<CubeFrameData> {
+ public:
+  CubeSample(const entry::EntryData* data)
+      : data_(data),
+        Sample<CubeFrameData>(
+            data->allocator(), data, 1, 512, 1, 1,
+            sample_application::SampleOptions().EnableMultisampling(), {0},
+            {}, {VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME}),
+        cube_(data->allocator(), data->logger(), cube_data),
+        descriptor_sets_(data->allocator()),
+        mode_(UpdateMode::kIndividual),
+        frames_in_mode_(0),
+        time_in_mode_(0.0f) {}
+
+  virtual void InitializeApplicationData(
+      vulkan::VkCommandBuffer* initialization_buffer,
+      size_t num_swapchain_images) override {
+    cube_.InitializeData(app(), initialization_buffer);
+
+    cube_descriptor_set_layouts_[0] = {
+        0,                                  // binding
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,  // descriptorType
+        1,                                  // descriptorCount
+        VK_SHADER_STAGE_VERTEX_BIT,         // stageFlags
+        nullptr                             // pImmutableSamplers
+    };
+    cube_descriptor_set_layouts_[1] = {
+        1,                                  // binding
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,  // descriptorType
+        1,                                  // descriptorCount
+        VK_SHADER_STAGE_VERTEX_BIT,         // stageFlags
+        nullptr                             // pImmutableSamplers
+    };
+
+    pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data_->allocator(),
+        app()->CreatePipelineLayout({{cube_descriptor_set_layouts_[0],
+                                      cube_descriptor_set_layouts_[1]}}));
+
+    VkAttachmentReference color_attachment = {
+        0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+
+    render_pass_ = containers::make_unique<vulkan::VkRenderPass>(
+        data_->allocator(),
+        app()->CreateRenderPass(
+            {{
+                0,                                         // flags
+                render_format(),                           // format
+                num_samples(),                             // samples
+                VK_ATTACHMENT_LOAD_OP_CLEAR,               // loadOp
+                VK_ATTACHMENT_STORE_OP_STORE,              // storeOp
+                VK_ATTACHMENT_LOAD_OP_DONT_CARE,           // stencilLoadOp
+                VK_ATTACHMENT_STORE_OP_DONT_CARE,          // stencilStoreOp
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // initialLayout
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL   // finalLayout
+            }},  // AttachmentDescriptions
+            {{
+                0,                                // flags
+                VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
+                0,                                // inputAttachmentCount
+                nullptr,                          // pInputAttachments
+                1,                                // colorAttachmentCount
+                &color_attachment,                // colorAttachment
+                nullptr,                          // pResolveAttachments
+                nullptr,                          // pDepthStencilAttachment
+                0,                                // preserveAttachmentCount
+                nullptr                           // pPreserveAttachments
+            }},                                   // SubpassDescriptions
+            {}                                    // SubpassDependencies
+            ));
+
+    cube_pipeline_ = containers::make_unique<vulkan::VulkanGraphicsPipeline>(
+        data_->allocator(), app()->CreateGraphicsPipeline(
+                                pipeline_layout_.get(), render_pass_.get(), 0));
+    cube_pipeline_->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main",
+                              cube_vertex_shader);
+    cube_pipeline_->AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, "main",
+                              cube_fragment_shader);
+    cube_pipeline_->SetTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    cube_pipeline_->SetInputStreams(&cube_);
+    cube_pipeline_->SetViewport(viewport());
+    cube_pipeline_->SetScissor(scissor());
+    cube_pipeline_->SetSamples(num_samples());
+    cube_pipeline_->AddAttachment();
+    cube_pipeline_->Commit();
+
+    camera_data_ = containers::make_unique<vulkan::BufferFrameData<CameraData>>(
+        data_->allocator(), app(), num_swapchain_images,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+
+    model_data_ = containers::make_unique<vulkan::BufferFrameData<ModelData>>(
+        data_->allocator(), app(), num_swapchain_images,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+
+    descriptor_sets_.reserve(kNumSets);
+    batched_writer_ = containers::make_unique<vulkan::DescriptorWriter>(
+        data_->allocator(), data_->allocator(), &app()->device());
+    templated_writer_ = containers::make_unique<vulkan::DescriptorWriter>(
+        data_->allocator(), data_->allocator(), &app()->device(), 1);
+
+    float aspect =
+        (float)app()->swapchain().width() / (float)app()->swapchain().height();
+    camera_data_->data().projection_matrix =
+        Mat44::FromScaleVector(mathfu::Vector<float, 3>{1.0f, -1.0f, 1.0f}) *
+        Mat44::Perspective(1.5708f, aspect, 0.1f, 100.0f);
+
+    model_data_->data().transform = Mat44::FromTranslationVector(
+        mathfu::Vector<float, 3>{0.0f, 0.0f, -3.0f});
+
+    if (data_->gpu_trace_file()) {
+      profiler_ = containers::make_unique<vulkan::GpuProfiler>(
+          data_->allocator(), data_->allocator(), &app()->instance(),
+          &app()->device(), app()->render_queue().index(),
+          static_cast<uint32_t>(num_swapchain_images), false);
+      profiler_->SetQueueName(0, "render");
+    }
+  }
+
+  virtual void InitializeFrameData(
+      CubeFrameData* frame_data, vulkan::VkCommandBuffer* initialization_buffer,
+      size_t frame_index) override {
+    frame_data->command_buffer_ =
+        containers::make_unique<vulkan::VkCommandBuffer>(
+            data_->allocator(), app()->GetCommandBuffer());
+
+    // Each frame gets its own allocator, so that all of its sets can be
+    // returned with a single reset once the frame's fence has signaled.
+    frame_data->descriptor_allocator_ =
+        containers::make_unique<vulkan::DescriptorAllocator>(
+            data_->allocator(), data_->allocator(), &app()->device(), 1024, 0,
+            16384);
+    frame_data->descriptor_set_layout_ =
+        frame_data->descriptor_allocator_->GetLayout(
+            {cube_descriptor_set_layouts_[0], cube_descriptor_set_layouts_[1]});
+
+    ::VkImageView raw_view = color_view(frame_data);
+
+    // Create a framebuffer with depth and image attachments
+    VkFramebufferCreateInfo framebuffer_create_info{
+        VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        *render_pass_,                              // renderPass
+        1,                                          // attachmentCount
+        &raw_view,                                  // attachments
+        app()->swapchain().width(),                 // width
+        app()->swapchain().height(),                // height
+        1                                           // layers
+    };
+
+    ::VkFramebuffer raw_framebuffer;
+    app()->device()->vkCreateFramebuffer(
+        app()->device(), &framebuffer_create_info, nullptr, &raw_framebuffer);
+    frame_data->framebuffer_ = containers::make_unique<vulkan::VkFramebuffer>(
+        data_->allocator(),
+        vulkan::VkFramebuffer(raw_framebuffer, nullptr, &app()->device()));
+  }
+
+  virtual void Update(float time_since_last_render) override {
+    model_data_->data().transform =
+        model_data_->data().transform *
+        Mat44::FromRotationMatrix(
+            Mat44::RotationX(3.14f * time_since_last_render) *
+            Mat44::RotationY(3.14f * time_since_last_render * 0.5f));
+  }
+
+  virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
+                      CubeFrameData* frame_data) override {
+    // Update our uniform buffers.
+    camera_data_->UpdateBuffer(queue, frame_index);
+    model_data_->UpdateBuffer(queue, frame_index);
+
+    // The previous submission of this frame has completed, so all of its
+    // sets can be thrown away.
+    frame_data->descriptor_allocator_->Reset();
+    descriptor_sets_.clear();
+    for (size_t i = 0; i < kNumSets; ++i) {
+      descriptor_sets_.push_back(
+          frame_data->descriptor_allocator_->Allocate(
+              frame_data->descriptor_set_layout_));
+    }
+
+    VkDescriptorBufferInfo buffer_infos[2] = {
+        {
+            camera_data_->get_buffer(),                       // buffer
+            camera_data_->get_offset_for_frame(frame_index),  // offset
+            camera_data_->size(),                             // range
+        },
+        {
+            model_data_->get_buffer(),                       // buffer
+            model_data_->get_offset_for_frame(frame_index),  // offset
+            model_data_->size(),                             // range
+        }};
+
+    auto update_start = Clock::now();
+    {
+      vulkan::GpuProfiler::CpuScope scope(profiler_.get(),
+                                          UpdateModeName(mode_));
+      WriteDescriptorSets(frame_data, buffer_infos);
+    }
+    std::chrono::duration<float, std::milli> update_time =
+        Clock::now() - update_start;
+    RecordUpdateTime(update_time.count());
+
+    vulkan::VkCommandBuffer& cmdBuffer = (*frame_data->command_buffer_);
+    cmdBuffer->vkBeginCommandBuffer(cmdBuffer,
+                                    &sample_application::kBeginCommandBuffer);
+    if (profiler_) {
+      profiler_->BeginFrame(&cmdBuffer);
+    }
+
+    VkClearValue clear;
+    vulkan::MemoryClear(&clear);
+
+    VkRenderPassBeginInfo pass_begin = {
+        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
+        nullptr,                                   // pNext
+        *render_pass_,                             // renderPass
+        *frame_data->framebuffer_,                 // framebuffer
+        {{0, 0},
+         {app()->swapchain().width(),
+          app()->swapchain().height()}},  // renderArea
+        1,                                // clearValueCount
+        &clear                            // clears
+    };
+
+    {
+      vulkan::GpuProfiler::Scope scope(profiler_.get(), &cmdBuffer, "cube");
+      cmdBuffer->vkCmdBeginRenderPass(cmdBuffer, &pass_begin,
+                                      VK_SUBPASS_CONTENTS_INLINE);
+
+      cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                   *cube_pipeline_);
+      cmdBuffer->vkCmdBindDescriptorSets(
+          cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+          ::VkPipelineLayout(*pipeline_layout_), 0, 1,
+          &descriptor_sets_[0], 0, nullptr);
+      cube_.Draw(&cmdBuffer);
+      cmdBuffer->vkCmdEndRenderPass(cmdBuffer);
+    }
+    cmdBuffer->vkEndCommandBuffer(cmdBuffer);
+
+    VkSubmitInfo init_submit_info{
+        VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+        nullptr,                        // pNext
+        0,                              // waitSemaphoreCount
+        nullptr,                        // pWaitSemaphores
+        nullptr,                        // pWaitDstStageMask,
+        1,                              // commandBufferCount
+        &(frame_data->command_buffer_->get_command_buffer()),
+        0,       // signalSemaphoreCount
+        nullptr  // pSignalSemaphores
+    };
+
+    app()->render_queue()->vkQueueSubmit(app()->render_queue(), 1,
+                                         &init_submit_info,
+                                         static_cast<VkFence>(VK_NULL_HANDLE));
+  }
+
+  // Writes the trace for -gpu-trace, if it was given. The device has to be
+  // idle.
+  void WriteGpuTrace() {
+    if (profiler_) {
+      profiler_->WriteChromeTrace(data_->gpu_trace_file());
+    }
+  }
+
+ private:
+  struct CameraData {
+    Mat44 projection_matrix;
+  };
+
+  struct ModelData {
+    Mat44 transform;
+  };
+
+  enum class UpdateMode { kIndividual, kBatched, kTemplated };
+
+  static const char* UpdateModeName(UpdateMode mode) {
+    switch (mode) {
+      case UpdateMode::kIndividual:
+        return "individual";
+      case UpdateMode::kBatched:
+        return "batched";
+      case UpdateMode::kTemplated:
+        return "templated";
+    }
+    return "";
+  }
+
+  void WriteDescriptorSets(CubeFrameData* frame_data,
+                           const VkDescriptorBufferInfo* buffer_infos) {
+    if (mode_ == UpdateMode::kIndividual) {
+      for (::VkDescriptorSet set : descriptor_sets_) {
+        VkWriteDescriptorSet writes[2];
+        for (uint32_t i = 0; i < 2; ++i) {
+          writes[i] = {
+              VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+              nullptr,                                 // pNext
+              set,                                     // dstSet
+              i,                                       // dstbinding
+              0,                                       // dstArrayElement
+              1,                                       // descriptorCount
+              VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,       // descriptorType
+              nullptr,                                 // pImageInfo
+              &buffer_infos[i],                        // pBufferInfo
+              nullptr,                                 // pTexelBufferView
+          };
+        }
+        app()->device()->vkUpdateDescriptorSets(app()->device(), 2, writes, 0,
+                                                nullptr);
+      }
+      return;
+    }
+
+    vulkan::DescriptorWriter* writer = mode_ == UpdateMode::kBatched
+                                           ? batched_writer_.get()
+                                           : templated_writer_.get();
+    for (::VkDescriptorSet set : descriptor_sets_) {
+      writer
+          ->Begin(set, frame_data->descriptor_set_layout_,
+                  {cube_descriptor_set_layouts_[0],
+                   cube_descriptor_set_layouts_[1]})
+          .WriteBuffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, buffer_infos[0])
+          .WriteBuffer(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, buffer_infos[1]);
+    }
+    writer->Flush();
+  }
+
+  void RecordUpdateTime(float ms) {
+    time_in_mode_ += ms;
+    if (++frames_in_mode_ < kFramesPerMode) {
+      return;
+    }
+
+    const char* name = UpdateModeName(mode_);
+    switch (mode_) {
+      case UpdateMode::kIndividual:
+        mode_ = UpdateMode::kBatched;
+        break;
+      case UpdateMode::kBatched:
+        mode_ = UpdateMode::kTemplated;
+        break;
+      case UpdateMode::kTemplated:
+        mode_ = UpdateMode::kIndividual;
+        break;
+    }
+    app()->GetLogger()->LogInfo("Updating ", kNumSets, " sets (", name,
+                                "): ", time_in_mode_ / frames_in_mode_,
+                                "ms per frame");
+    frames_in_mode_ = 0;
+    time_in_mode_ = 0.0f;
+  }
+
+  const entry::EntryData* data_;
+  containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
+  containers::unique_ptr<vulkan::VulkanGraphicsPipeline> cube_pipeline_;
+  containers::unique_ptr<vulkan::VkRenderPass> render_pass_;
+  VkDescriptorSetLayoutBinding cube_descriptor_set_layouts_[2];
+  vulkan::VulkanModel cube_;
+
+  containers::unique_ptr<vulkan::BufferFrameData<CameraData>> camera_data_;
+  containers::unique_ptr<vulkan::BufferFrameData<ModelData>> model_data_;
+
+  // The sets allocated for the frame that is being rendered.
+  containers::vector<::VkDescriptorSet> descriptor_sets_;
+  containers::unique_ptr<vulkan::DescriptorWriter> batched_writer_;
+  containers::unique_ptr<vulkan::DescriptorWriter> templated_writer_;
+  // Only created with -gpu-trace.
+  containers::unique_ptr<vulkan::GpuProfiler> profiler_;
+
+  UpdateMode mode_;
+  size_t frames_in_mode_;
+  float time_in_mode_;
+};
+
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+  CubeSample sample(data);
+  sample.Initialize();
+
+  while (!sample.should_exit() && !data->WindowClosing()) {
+    sample.ProcessFrame();
+  }
+  sample.WaitIdle();
+  sample.WriteGpuTrace();
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
@@ -0,0 +1,118 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <chrono>
+
+#include "support/entry/entry.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+#include "vulkan_wrapper/lazy_function.h"
+
+uint32_t compute_shader[] =
+#include "empty.comp.spv"
+    ;
+
+namespace {
+const uint32_t kCallsPerRound = 1000000;
+const uint32_t kRounds = 5;
+
+// Records kCallsPerRound dispatches with |dispatch| into a new command
+// buffer, kRounds times, and logs the nanoseconds per call.
+template <typename Dispatch>
+void RunBenchmark(vulkan::VulkanApplication* app,
+                  vulkan::VulkanComputePipeline* pipeline, const char* name,
+                  Dispatch dispatch) {
+  double best = 0.0;
+  double total = 0.0;
+  for (uint32_t round = 0; round < kRounds; ++round) {
+    vulkan::VkCommandBuffer cmd_buf = app->GetCommandBuffer();
+    app->BeginCommandBuffer(&cmd_buf);
+    cmd_buf->vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE,
+                               *pipeline);
+    const ::VkCommandBuffer raw_cmd_buf = cmd_buf;
+
+    auto begin = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < kCallsPerRound; ++i) {
+      dispatch(&cmd_buf, raw_cmd_buf);
+    }
+    auto end = std::chrono::steady_clock::now();
+    cmd_buf->vkEndCommandBuffer(cmd_buf);
+
+    const double nanoseconds_per_call =
+        static_cast<double>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin)
+                .count()) /
+        kCallsPerRound;
+    best = round == 0 ? nanoseconds_per_call
+                      : std::min(best, nanoseconds_per_call);
+    total += nanoseconds_per_call;
+  }
+  app->GetLogger()->LogInfoF("%-8s %8.2f ns per call best, %8.2f on average",
+                             name, best, total / kRounds);
+}
+}  // anonymous namespace
+
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+
+  vulkan::VulkanApplication app(data->allocator(), data->logger(), data,
+                                vulkan::VulkanApplicationOptions());
+  vulkan::VkDevice& device = app.device();
+
+  auto pipeline_layout = containers::make_unique<vulkan::PipelineLayout>(
+      data->allocator(), app.CreatePipelineLayout({}));
+  auto pipeline = containers::make_unique<vulkan::VulkanComputePipeline>(
+      data->allocator(),
+      app.CreateComputePipeline(
+          pipeline_layout.get(),
+          VkShaderModuleCreateInfo{VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+                                   nullptr, 0, sizeof(compute_shader),
+                                   compute_shader},
+          "main"));
+
+  // Both are resolved from the same device, so they end up at the same
+  // driver entry point, and only the way they are called differs.
+  LazyFunction<PFN_vkCmdDispatch, ::VkDevice, vulkan::DeviceFunctions> lazy(
+      device, "vkCmdDispatch", device.functions());
+  PFN_vkCmdDispatch eager = ResolveFunction<PFN_vkCmdDispatch>(
+      static_cast<::VkDevice>(device), "vkCmdDispatch", device.functions());
+  LOG_ASSERT(!=, data->logger(), static_cast<PFN_vkCmdDispatch>(nullptr),
+             eager);
+
+#if defined VULKAN_EAGER_DISPATCH
+  data->logger()->LogInfo("The function tables are resolved eagerly");
+#else
+  data->logger()->LogInfo("The function tables are resolved lazily");
+#endif
+  data->logger()->LogInfo("Recording ", kCallsPerRound,
+                          " vkCmdDispatch calls, ", kRounds, " times");
+
+  RunBenchmark(&app, pipeline.get(), "lazy",
+               [&lazy](vulkan::VkCommandBuffer*, ::VkCommandBuffer cmd_buf) {
+                 lazy(cmd_buf, 1u, 1u, 1u);
+               });
+  RunBenchmark(&app, pipeline.get(), "eager",
+               [eager](vulkan::VkCommandBuffer*, ::VkCommandBuffer cmd_buf) {
+                 eager(cmd_buf, 1, 1, 1);
+               });
+  RunBenchmark(&app, pipeline.get(), "table",
+               [](vulkan::VkCommandBuffer* wrapper, ::VkCommandBuffer cmd_buf) {
+                 (*wrapper)->vkCmdDispatch(cmd_buf, 1, 1, 1);
+               });
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
@@ -0,0 +1,435 @@
+// Copyright 2022 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+
+#include "application_sandbox/sample_application_framework/sample_application.h"
+#include "mathfu/matrix.h"
+#include "mathfu/vector.h"
+#include "support/entry/entry.h"
+#include "vulkan_helpers/buffer_frame_data.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+#include "vulkan_helpers/vulkan_model.h"
+
+using Mat44 = mathfu::Matrix<float, 4, 4>;
+using Vector4 = mathfu::Vector<float, 4>;
+
+namespace cube_model {
+#include "cube.obj.h"
+}
+const auto& cube_data = cube_model::model;
+
+uint32_t cube_vertex_shader[] =
+#include "cube.vert.spv"
+    ;
+
+uint32_t cube_fragment_shader[] =
+#include "cube.frag.spv"
+    ;
+
+struct CubeFrameData {
+  containers::unique_ptr<vulkan::VkCommandBuffer> command_buffer_;
+  containers::unique_ptr<vulkan::VkFramebuffer> framebuffer_;
+  containers::unique_ptr<vulkan::DescriptorSet> cube_descriptor_set_;
+};
+
+VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT kGraphicsPipelineLibrary{
+    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT,
+    nullptr,  // pNext
+    VK_TRUE,  // graphicsPipelineLibrary
+};
+
+using Clock = std::chrono::high_resolution_clock;
+
+// The pipelines only differ in their cull mode, which is pre-rasterization
+// state, and their blending, which is fragment output state. Their vertex
+// input and fragment shader parts are the same.
+struct Permutation {
+  VkCullModeFlagBits cull_mode;
+  bool additive_blending;
+};
+const Permutation kPermutations[] = {
+    {VK_CULL_MODE_BACK_BIT, false},
+    {VK_CULL_MODE_NONE, false},
+    {VK_CULL_MODE_BACK_BIT, true},
+    {VK_CULL_MODE_NONE, true},
+};
+const size_t kNumPermutations =
+    sizeof(kPermutations) / sizeof(kPermutations[0]);
+
+// This renders a rotating cube with pipelines that are created from
+// graphics pipeline libraries, switching between a few permutations every
+// second. The permutations share their library parts through a
+// PipelineLibraryCache. The time it takes to create all of them is printed
+// for both the fast-linked library path and the monolithic path, as well as
+// the time at which the optimized pipelines replace the fast-linked ones.
+class CubeSample : public sample_application::Sample<CubeFrameData> {
+ public:
+  CubeSample(const entry::EntryData* data)
+      : data_(data),
+        Sample<CubeFrameData>(
+            data->allocator(), data, 1, 512, 1, 1,
+            sample_application::SampleOptions()
+                .EnableMultisampling()
+                .SetVulkanApiVersion(VK_API_VERSION_1_1)
+                .AddDeviceExtensionStructure(&kGraphicsPipelineLibrary),
+            {0}, {},
+            {VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME,
+             VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME}),
+        library_cache_(data->allocator()),
+        cube_pipelines_(data->allocator()),
+        cube_(data->allocator(), data->logger(), cube_data),
+        total_time_(0.0f),
+        drawn_first_frame_(false),
+        drawn_optimized_frame_(false) {}
+
+  virtual void InitializeApplicationData(
+      vulkan::VkCommandBuffer* initialization_buffer,
+      size_t num_swapchain_images) override {
+    cube_.InitializeData(app(), initialization_buffer);
+
+    cube_descriptor_set_layouts_[0] = {
+        0,                                  // binding
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,  // descriptorType
+        1,                                  // descriptorCount
+        VK_SHADER_STAGE_VERTEX_BIT,         // stageFlags
+        nullptr                             // pImmutableSamplers
+    };
+    cube_descriptor_set_layouts_[1] = {
+        1,                                  // binding
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,  // descriptorType
+        1,                                  // descriptorCount
+        VK_SHADER_STAGE_VERTEX_BIT,         // stageFlags
+        nullptr                             // pImmutableSamplers
+    };
+
+    pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data_->allocator(),
+        app()->CreatePipelineLayout({{cube_descriptor_set_layouts_[0],
+                                      cube_descriptor_set_layouts_[1]}}));
+
+    VkAttachmentReference color_attachment = {
+        0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+
+    render_pass_ = containers::make_unique<vulkan::VkRenderPass>(
+        data_->allocator(),
+        app()->CreateRenderPass(
+            {{
+                0,                                         // flags
+                render_format(),                           // format
+                num_samples(),                             // samples
+                VK_ATTACHMENT_LOAD_OP_CLEAR,               // loadOp
+                VK_ATTACHMENT_STORE_OP_STORE,              // storeOp
+                VK_ATTACHMENT_LOAD_OP_DONT_CARE,           // stencilLoadOp
+                VK_ATTACHMENT_STORE_OP_DONT_CARE,          // stencilStoreOp
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // initialLayout
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL   // finalLayout
+            }},  // AttachmentDescriptions
+            {{
+                0,                                // flags
+                VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
+                0,                                // inputAttachmentCount
+                nullptr,                          // pInputAttachments
+                1,                                // colorAttachmentCount
+                &color_attachment,                // colorAttachment
+                nullptr,                          // pResolveAttachments
+                nullptr,                          // pDepthStencilAttachment
+                0,                                // preserveAttachmentCount
+                nullptr                           // pPreserveAttachments
+            }},                                   // SubpassDescriptions
+            {}                                    // SubpassDependencies
+            ));
+
+    // Every permutation is also created as a monolithic pipeline, purely to
+    // have something to compare against. Both paths compile the same
+    // shaders, and whichever goes first may warm caches inside the driver
+    // for the other, so the order alternates between permutations.
+    std::chrono::duration<float, std::milli> monolithic_time(0.0f);
+    std::chrono::duration<float, std::milli> fast_link_time(0.0f);
+    for (size_t i = 0; i < kNumPermutations; ++i) {
+      for (size_t j = 0; j < 2; ++j) {
+        const bool use_pipeline_library = (i + j) % 2 == 0;
+        auto start = Clock::now();
+        auto pipeline =
+            CreateCubePipeline(kPermutations[i], use_pipeline_library);
+        auto end = Clock::now();
+        if (use_pipeline_library) {
+          fast_link_time += end - start;
+          cube_pipelines_.push_back(std::move(pipeline));
+        } else {
+          monolithic_time += end - start;
+        }
+      }
+    }
+    pipeline_start_ = Clock::now();
+    app()->GetLogger()->LogInfo(kNumPermutations,
+                                " monolithic pipelines created in ",
+                                monolithic_time.count(), "ms");
+    app()->GetLogger()->LogInfo(kNumPermutations,
+                                " fast-linked library pipelines created in ",
+                                fast_link_time.count(), "ms, from ",
+                                library_cache_.num_parts(), " parts (",
+                                library_cache_.num_reused(), " reused)");
+
+    camera_data_ = containers::make_unique<vulkan::BufferFrameData<CameraData>>(
+        data_->allocator(), app(), num_swapchain_images,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+
+    model_data_ = containers::make_unique<vulkan::BufferFrameData<ModelData>>(
+        data_->allocator(), app(), num_swapchain_images,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+
+    float aspect =
+        (float)app()->swapchain().width() / (float)app()->swapchain().height();
+    camera_data_->data().projection_matrix =
+        Mat44::FromScaleVector(mathfu::Vector<float, 3>{1.0f, -1.0f, 1.0f}) *
+        Mat44::Perspective(1.5708f, aspect, 0.1f, 100.0f);
+
+    model_data_->data().transform = Mat44::FromTranslationVector(
+        mathfu::Vector<float, 3>{0.0f, 0.0f, -3.0f});
+  }
+
+  virtual void InitializeFrameData(
+      CubeFrameData* frame_data, vulkan::VkCommandBuffer* initialization_buffer,
+      size_t frame_index) override {
+    frame_data->command_buffer_ =
+        containers::make_unique<vulkan::VkCommandBuffer>(
+            data_->allocator(), app()->GetCommandBuffer());
+
+    frame_data->cube_descriptor_set_ =
+        containers::make_unique<vulkan::DescriptorSet>(
+            data_->allocator(),
+            app()->AllocateDescriptorSet({cube_descriptor_set_layouts_[0],
+                                          cube_descriptor_set_layouts_[1]}));
+
+    VkDescriptorBufferInfo buffer_infos[2] = {
+        {
+            camera_data_->get_buffer(),                       // buffer
+            camera_data_->get_offset_for_frame(frame_index),  // offset
+            camera_data_->size(),                             // range
+        },
+        {
+            model_data_->get_buffer(),                       // buffer
+            model_data_->get_offset_for_frame(frame_index),  // offset
+            model_data_->size(),                             // range
+        }};
+
+    VkWriteDescriptorSet write{
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+        nullptr,                                 // pNext
+        *frame_data->cube_descriptor_set_,       // dstSet
+        0,                                       // dstbinding
+        0,                                       // dstArrayElement
+        2,                                       // descriptorCount
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,       // descriptorType
+        nullptr,                                 // pImageInfo
+        buffer_infos,                            // pBufferInfo
+        nullptr,                                 // pTexelBufferView
+    };
+
+    app()->device()->vkUpdateDescriptorSets(app()->device(), 1, &write, 0,
+                                            nullptr);
+
+    ::VkImageView raw_view = color_view(frame_data);
+
+    // Create a framebuffer with depth and image attachments
+    VkFramebufferCreateInfo framebuffer_create_info{
+        VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        *render_pass_,                              // renderPass
+        1,                                          // attachmentCount
+        &raw_view,                                  // attachments
+        app()->swapchain().width(),                 // width
+        app()->swapchain().height(),                // height
+        1                                           // layers
+    };
+
+    ::VkFramebuffer raw_framebuffer;
+    app()->device()->vkCreateFramebuffer(
+        app()->device(), &framebuffer_create_info, nullptr, &raw_framebuffer);
+    frame_data->framebuffer_ = containers::make_unique<vulkan::VkFramebuffer>(
+        data_->allocator(),
+        vulkan::VkFramebuffer(raw_framebuffer, nullptr, &app()->device()));
+  }
+
+  virtual void Update(float time_since_last_render) override {
+    total_time_ += time_since_last_render;
+    model_data_->data().transform =
+        model_data_->data().transform *
+        Mat44::FromRotationMatrix(
+            Mat44::RotationX(3.14f * time_since_last_render) *
+            Mat44::RotationY(3.14f * time_since_last_render * 0.5f));
+  }
+
+  virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
+                      CubeFrameData* frame_data) override {
+    // Update our uniform buffers.
+    camera_data_->UpdateBuffer(queue, frame_index);
+    model_data_->UpdateBuffer(queue, frame_index);
+
+    // The command buffer is re-recorded every frame so that the optimized
+    // pipelines are picked up as soon as they are ready.
+    bool optimized = true;
+    for (const auto& pipeline : cube_pipelines_) {
+      optimized = optimized && pipeline->IsOptimized();
+    }
+    const vulkan::VulkanGraphicsPipeline& cube_pipeline =
+        *cube_pipelines_[static_cast<size_t>(total_time_) % kNumPermutations];
+    vulkan::VkCommandBuffer& cmdBuffer = (*frame_data->command_buffer_);
+    cmdBuffer->vkBeginCommandBuffer(cmdBuffer,
+                                    &sample_application::kBeginCommandBuffer);
+
+    VkClearValue clear;
+    vulkan::MemoryClear(&clear);
+
+    VkRenderPassBeginInfo pass_begin = {
+        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
+        nullptr,                                   // pNext
+        *render_pass_,                             // renderPass
+        *frame_data->framebuffer_,                 // framebuffer
+        {{0, 0},
+         {app()->swapchain().width(),
+          app()->swapchain().height()}},  // renderArea
+        1,                                // clearValueCount
+        &clear                            // clears
+    };
+
+    cmdBuffer->vkCmdBeginRenderPass(cmdBuffer, &pass_begin,
+                                    VK_SUBPASS_CONTENTS_INLINE);
+
+    cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                 cube_pipeline);
+    cmdBuffer->vkCmdBindDescriptorSets(
+        cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+        ::VkPipelineLayout(*pipeline_layout_), 0, 1,
+        &frame_data->cube_descriptor_set_->raw_set(), 0, nullptr);
+    cube_.Draw(&cmdBuffer);
+    cmdBuffer->vkCmdEndRenderPass(cmdBuffer);
+    cmdBuffer->vkEndCommandBuffer(cmdBuffer);
+
+    VkSubmitInfo init_submit_info{
+        VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+        nullptr,                        // pNext
+        0,                              // waitSemaphoreCount
+        nullptr,                        // pWaitSemaphores
+        nullptr,                        // pWaitDstStageMask,
+        1,                              // commandBufferCount
+        &(frame_data->command_buffer_->get_command_buffer()),
+        0,       // signalSemaphoreCount
+        nullptr  // pSignalSemaphores
+    };
+
+    app()->render_queue()->vkQueueSubmit(app()->render_queue(), 1,
+                                         &init_submit_info,
+                                         static_cast<VkFence>(VK_NULL_HANDLE));
+
+    std::chrono::duration<float, std::milli> since_creation =
+        Clock::now() - pipeline_start_;
+    if (!drawn_first_frame_) {
+      drawn_first_frame_ = true;
+      app()->GetLogger()->LogInfo("Time to first draw: ",
+                                  since_creation.count(), "ms (",
+                                  optimized ? "optimized" : "fast-linked",
+                                  " pipelines)");
+    }
+    if (optimized && !drawn_optimized_frame_) {
+      drawn_optimized_frame_ = true;
+      app()->GetLogger()->LogInfo(
+          "Time to first draw with all pipelines optimized: ",
+          since_creation.count(), "ms");
+    }
+  }
+
+ private:
+  struct CameraData {
+    Mat44 projection_matrix;
+  };
+
+  struct ModelData {
+    Mat44 transform;
+  };
+
+  containers::unique_ptr<vulkan::VulkanGraphicsPipeline> CreateCubePipeline(
+      const Permutation& permutation, bool use_pipeline_library) {
+    auto pipeline = containers::make_unique<vulkan::VulkanGraphicsPipeline>(
+        data_->allocator(), app()->CreateGraphicsPipeline(
+                                pipeline_layout_.get(), render_pass_.get(), 0));
+    if (use_pipeline_library) {
+      pipeline->EnablePipelineLibrary(&library_cache_);
+    }
+    pipeline->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main", cube_vertex_shader);
+    pipeline->AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, "main",
+                        cube_fragment_shader);
+    pipeline->SetTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    pipeline->SetInputStreams(&cube_);
+    pipeline->SetViewport(viewport());
+    pipeline->SetScissor(scissor());
+    pipeline->SetSamples(num_samples());
+    pipeline->SetCullMode(permutation.cull_mode);
+    if (permutation.additive_blending) {
+      pipeline->AddAttachment({
+          VK_TRUE,                  // blendEnable
+          VK_BLEND_FACTOR_ONE,      // srcColorBlendFactor
+          VK_BLEND_FACTOR_ONE,      // dstColorBlendFactor
+          VK_BLEND_OP_ADD,          // colorBlendOp
+          VK_BLEND_FACTOR_ONE,      // srcAlphaBlendFactor
+          VK_BLEND_FACTOR_ONE,      // dstAlphaBlendFactor
+          VK_BLEND_OP_ADD,          // alphaBlendOp
+          VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+              VK_COLOR_COMPONENT_B_BIT |
+              VK_COLOR_COMPONENT_A_BIT  // colorWriteMask
+      });
+    } else {
+      pipeline->AddAttachment();
+    }
+    pipeline->Commit();
+    return pipeline;
+  }
+
+  const entry::EntryData* data_;
+  containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
+  containers::unique_ptr<vulkan::VkRenderPass> render_pass_;
+  // This is destroyed after the pipelines that use its parts, and before the
+  // layout and render pass that its parts are looked up by.
+  vulkan::PipelineLibraryCache library_cache_;
+  containers::vector<containers::unique_ptr<vulkan::VulkanGraphicsPipeline>>
+      cube_pipelines_;
+  VkDescriptorSetLayoutBinding cube_descriptor_set_layouts_[2];
+  vulkan::VulkanModel cube_;
+
+  containers::unique_ptr<vulkan::BufferFrameData<CameraData>> camera_data_;
+  containers::unique_ptr<vulkan::BufferFrameData<ModelData>> model_data_;
+
+  // When creation of the pipelines finished.
+  std::chrono::time_point<Clock> pipeline_start_;
+  float total_time_;
+  bool drawn_first_frame_;
+  bool drawn_optimized_frame_;
+};
+
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+  CubeSample sample(data);
+  sample.Initialize();
+
+  while (!sample.should_exit() && !data->WindowClosing()) {
+    sample.ProcessFrame();
+  }
+  sample.WaitIdle();
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
@@ -0,0 +1,30 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#version 450
+
+layout (location = 0) out vec4 out_color;
+layout (location = 2) in vec4 normal;
+layout (location = 3) flat in uint lod;
+
+const vec3 lod_tints[4] = vec3[](
+    vec3(1.0, 1.0, 1.0),
+    vec3(0.5, 1.0, 0.5),
+    vec3(0.5, 0.5, 1.0),
+    vec3(1.0, 0.5, 0.5));
+
+void main() {
+    out_color = vec4(normal.xyz * lod_tints[min(lod, 3u)], 1.0);
+}
@@ -0,0 +1,42 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#version 450
+#define MODEL_OCTAHEDRAL_NORMALS
+#include "models/model_setup.glsl"
+
+layout (location = 2) out vec4 normal;
+layout (location = 3) flat out uint lod;
+
+layout (binding = 0, set = 0) uniform camera_data {
+    layout(column_major) mat4x4 projection;
+};
+
+// The instances of every level of detail, in separate ranges.
+layout (binding = 1, set = 0) readonly buffer instance_data {
+    layout(column_major) mat4x4 transforms[];
+};
+
+layout (push_constant) uniform lod_data {
+    uint first_instance;
+    uint lod_index;
+};
+
+void main() {
+    gl_Position = projection * transforms[first_instance + gl_InstanceIndex] *
+        get_position();
+    normal = abs(get_normal());
+    lod = lod_index;
+}
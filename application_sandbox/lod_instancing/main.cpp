@@ -0,0 +1,451 @@
+// Copyright 2022 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <algorithm>
+#include <cmath>
+
+#include "application_sandbox/sample_application_framework/sample_application.h"
+#include "support/entry/entry.h"
+#include "vulkan_helpers/buffer_frame_data.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/vulkan_application.h"
+#include "vulkan_helpers/vulkan_model.h"
+
+#include "mathfu/matrix.h"
+#include "mathfu/vector.h"
+
+using Mat44 = mathfu::Matrix<float, 4, 4>;
+using Vector3 = mathfu::Vector<float, 3>;
+
+namespace torus_model {
+#include "torus_knot.obj.h"
+}
+const auto& torus_data = torus_model::model;
+
+uint32_t lod_vertex_shader[] =
+#include "lod.vert.spv"
+    ;
+
+uint32_t lod_fragment_shader[] =
+#include "lod.frag.spv"
+    ;
+
+// The torus knots are laid out in a kGridSize x kGridSize grid, receding
+// away from the camera.
+const size_t kGridSize = 16;
+const size_t kNumInstances = kGridSize * kGridSize;
+const float kGridSpacing = 6.0f;
+// The levels of detail beyond this are not drawn, their instances use the
+// coarsest one that is.
+const size_t kMaxLods = 4;
+const float kFieldOfView = 1.5708f;
+
+// Pushed before the draw of every level of detail.
+struct LodPushConstants {
+  // Where the instances of the level start in InstanceData::transforms.
+  uint32_t first_instance;
+  uint32_t lod;
+};
+
+struct LodInstancingFrameData {
+  containers::unique_ptr<vulkan::VkCommandBuffer> command_buffer_;
+  containers::unique_ptr<vulkan::VkFramebuffer> framebuffer_;
+  containers::unique_ptr<vulkan::DescriptorSet> torus_descriptor_set_;
+};
+
+class LodInstancingSample
+    : public sample_application::Sample<LodInstancingFrameData> {
+ public:
+  LodInstancingSample(const entry::EntryData* data)
+      : data_(data),
+        Sample<LodInstancingFrameData>(
+            data->allocator(), data, 1, 512, 1, 1,
+            sample_application::SampleOptions().EnableDepthBuffer()),
+        torus_(data->allocator(), data->logger(), torus_data,
+               vulkan::VulkanModelLayout().EnableCompact()),
+        rotations_(data->allocator()) {}
+  virtual void InitializeApplicationData(
+      vulkan::VkCommandBuffer* initialization_buffer,
+      size_t num_swapchain_images) override {
+    torus_.InitializeData(app(), initialization_buffer);
+    num_lods_ = std::min(torus_.NumLods(), kMaxLods);
+    // The positions are quantized to the bounding box of the model, which
+    // this maps them back from.
+    dequantize_ =
+        Mat44::FromTranslationVector(Vector3{torus_.PositionOffset()[0],
+                                             torus_.PositionOffset()[1],
+                                             torus_.PositionOffset()[2]}) *
+        Mat44::FromScaleVector(Vector3{torus_.PositionScale()[0],
+                                       torus_.PositionScale()[1],
+                                       torus_.PositionScale()[2]});
+
+    torus_descriptor_set_layouts_[0] = {
+        0,                                  // binding
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,  // descriptorType
+        1,                                  // descriptorCount
+        VK_SHADER_STAGE_VERTEX_BIT,         // stageFlags
+        nullptr                             // pImmutableSamplers
+    };
+    torus_descriptor_set_layouts_[1] = {
+        1,                                  // binding
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+        1,                                  // descriptorCount
+        VK_SHADER_STAGE_VERTEX_BIT,         // stageFlags
+        nullptr                             // pImmutableSamplers
+    };
+
+    pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data_->allocator(),
+        app()->CreatePipelineLayout(
+            {{torus_descriptor_set_layouts_[0],
+              torus_descriptor_set_layouts_[1]}},
+            {{VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(LodPushConstants)}}));
+
+    VkAttachmentReference depth_attachment = {
+        0, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+    VkAttachmentReference color_attachment = {
+        1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+
+    render_pass_ = containers::make_unique<vulkan::VkRenderPass>(
+        data_->allocator(),
+        app()->CreateRenderPass(
+            {{
+                 0,                                 // flags
+                 depth_format(),                    // format
+                 num_samples(),                     // samples
+                 VK_ATTACHMENT_LOAD_OP_CLEAR,       // loadOp
+                 VK_ATTACHMENT_STORE_OP_STORE,      // storeOp
+                 VK_ATTACHMENT_LOAD_OP_DONT_CARE,   // stencilLoadOp
+                 VK_ATTACHMENT_STORE_OP_DONT_CARE,  // stencilStoreOp
+                 VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,  // initialLayout
+                 VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL  // finalLayout
+             },
+             {
+                 0,                                         // flags
+                 render_format(),                           // format
+                 num_samples(),                             // samples
+                 VK_ATTACHMENT_LOAD_OP_CLEAR,               // loadOp
+                 VK_ATTACHMENT_STORE_OP_STORE,              // storeOp
+                 VK_ATTACHMENT_LOAD_OP_DONT_CARE,           // stencilLoadOp
+                 VK_ATTACHMENT_STORE_OP_DONT_CARE,          // stencilStoreOp
+                 VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // initialLayout
+                 VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL   // finalLayout
+             }},  // AttachmentDescriptions
+            {{
+                0,                                // flags
+                VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
+                0,                                // inputAttachmentCount
+                nullptr,                          // pInputAttachments
+                1,                                // colorAttachmentCount
+                &color_attachment,                // colorAttachment
+                nullptr,                          // pResolveAttachments
+                &depth_attachment,                // pDepthStencilAttachment
+                0,                                // preserveAttachmentCount
+                nullptr                           // pPreserveAttachments
+            }},                                   // SubpassDescriptions
+            {}                                    // SubpassDependencies
+            ));
+
+    torus_pipeline_ = containers::make_unique<vulkan::VulkanGraphicsPipeline>(
+        data_->allocator(),
+        app()->CreateGraphicsPipeline(pipeline_layout_.get(),
+                                      render_pass_.get(), 0));
+    torus_pipeline_->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main",
+                               lod_vertex_shader);
+    torus_pipeline_->AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, "main",
+                               lod_fragment_shader);
+    torus_pipeline_->SetTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    torus_pipeline_->SetInputStreams(&torus_);
+    torus_pipeline_->SetViewport(viewport());
+    torus_pipeline_->SetScissor(scissor());
+    torus_pipeline_->SetSamples(num_samples());
+    torus_pipeline_->AddAttachment();
+    torus_pipeline_->Commit();
+
+    camera_data_ = containers::make_unique<vulkan::BufferFrameData<CameraData>>(
+        data_->allocator(), app(), num_swapchain_images,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+
+    instance_data_ =
+        containers::make_unique<vulkan::BufferFrameData<InstanceData>>(
+            data_->allocator(), app(), num_swapchain_images,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+    draw_data_ = containers::make_unique<vulkan::BufferFrameData<DrawData>>(
+        data_->allocator(), app(), num_swapchain_images,
+        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+
+    float aspect =
+        (float)app()->swapchain().width() / (float)app()->swapchain().height();
+    camera_data_->data().projection_matrix =
+        Mat44::FromScaleVector(Vector3{1.0f, -1.0f, 1.0f}) *
+        Mat44::Perspective(kFieldOfView, aspect, 0.1f, 200.0f);
+    // The size in pixels of one unit at a distance of one.
+    pixels_per_unit_ = (float)app()->swapchain().height() /
+                       (2.0f * std::tan(kFieldOfView * 0.5f));
+
+    for (size_t i = 0; i < kNumInstances; ++i) {
+      const float x = (float(i % kGridSize) - float(kGridSize - 1) * 0.5f) *
+                      kGridSpacing;
+      const float z = -float(i / kGridSize + 1) * kGridSpacing;
+      positions_[i] = Vector3{x, -3.0f, z};
+      rotations_.push_back(
+          Mat44::FromRotationMatrix(Mat44::RotationY(float(i))));
+    }
+    UpdateInstances();
+  }
+
+  virtual void InitializeFrameData(
+      LodInstancingFrameData* frame_data,
+      vulkan::VkCommandBuffer* initialization_buffer,
+      size_t frame_index) override {
+    frame_data->command_buffer_ =
+        containers::make_unique<vulkan::VkCommandBuffer>(
+            data_->allocator(), app()->GetCommandBuffer());
+
+    frame_data->torus_descriptor_set_ =
+        containers::make_unique<vulkan::DescriptorSet>(
+            data_->allocator(),
+            app()->AllocateDescriptorSet({torus_descriptor_set_layouts_[0],
+                                          torus_descriptor_set_layouts_[1]}));
+
+    VkDescriptorBufferInfo buffer_infos[2] = {
+        {
+            camera_data_->get_buffer(),                       // buffer
+            camera_data_->get_offset_for_frame(frame_index),  // offset
+            camera_data_->size(),                             // range
+        },
+        {
+            instance_data_->get_buffer(),                       // buffer
+            instance_data_->get_offset_for_frame(frame_index),  // offset
+            instance_data_->size(),                             // range
+        }};
+
+    VkWriteDescriptorSet writes[2] = {
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+            nullptr,                                 // pNext
+            *frame_data->torus_descriptor_set_,      // dstSet
+            0,                                       // dstbinding
+            0,                                       // dstArrayElement
+            1,                                       // descriptorCount
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,       // descriptorType
+            nullptr,                                 // pImageInfo
+            &buffer_infos[0],                        // pBufferInfo
+            nullptr,                                 // pTexelBufferView
+        },
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+            nullptr,                                 // pNext
+            *frame_data->torus_descriptor_set_,      // dstSet
+            1,                                       // dstbinding
+            0,                                       // dstArrayElement
+            1,                                       // descriptorCount
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
+            nullptr,                                 // pImageInfo
+            &buffer_infos[1],                        // pBufferInfo
+            nullptr,                                 // pTexelBufferView
+        }};
+
+    app()->device()->vkUpdateDescriptorSets(app()->device(), 2, writes, 0,
+                                            nullptr);
+
+    ::VkImageView raw_views[2] = {depth_view(frame_data),
+                                  color_view(frame_data)};
+
+    // Create a framebuffer with depth and image attachments
+    VkFramebufferCreateInfo framebuffer_create_info{
+        VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        *render_pass_,                              // renderPass
+        2,                                          // attachmentCount
+        raw_views,                                  // attachments
+        app()->swapchain().width(),                 // width
+        app()->swapchain().height(),                // height
+        1                                           // layers
+    };
+
+    ::VkFramebuffer raw_framebuffer;
+    app()->device()->vkCreateFramebuffer(
+        app()->device(), &framebuffer_create_info, nullptr, &raw_framebuffer);
+    frame_data->framebuffer_ = containers::make_unique<vulkan::VkFramebuffer>(
+        data_->allocator(),
+        vulkan::VkFramebuffer(raw_framebuffer, nullptr, &app()->device()));
+
+    (*frame_data->command_buffer_)
+        ->vkBeginCommandBuffer((*frame_data->command_buffer_),
+                               &sample_application::kBeginCommandBuffer);
+    vulkan::VkCommandBuffer& cmdBuffer = (*frame_data->command_buffer_);
+
+    VkClearValue clears[2];
+    vulkan::MemoryClear(&clears[0]);
+    clears[0].depthStencil.depth = 1.0f;
+    vulkan::MemoryClear(&clears[1]);
+
+    VkRenderPassBeginInfo pass_begin = {
+        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
+        nullptr,                                   // pNext
+        *render_pass_,                             // renderPass
+        *frame_data->framebuffer_,                 // framebuffer
+        {{0, 0},
+         {app()->swapchain().width(),
+          app()->swapchain().height()}},  // renderArea
+        2,                                // clearValueCount
+        clears                            // clears
+    };
+
+    cmdBuffer->vkCmdBeginRenderPass(cmdBuffer, &pass_begin,
+                                    VK_SUBPASS_CONTENTS_INLINE);
+
+    cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                 *torus_pipeline_);
+    cmdBuffer->vkCmdBindDescriptorSets(
+        cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+        ::VkPipelineLayout(*pipeline_layout_), 0, 1,
+        &frame_data->torus_descriptor_set_->raw_set(), 0, nullptr);
+    torus_.BindVertexAndIndexBuffers(&cmdBuffer);
+
+    // One draw per level of detail, with the instance counts filled in by
+    // Update(). The instances of each level live in their own range of the
+    // transforms, which the vertex shader offsets into, so that neither
+    // multiDrawIndirect nor drawIndirectFirstInstance is needed.
+    for (size_t lod = 0; lod < num_lods_; ++lod) {
+      LodPushConstants push_constants = {
+          static_cast<uint32_t>(lod * kNumInstances),
+          static_cast<uint32_t>(lod)};
+      cmdBuffer->vkCmdPushConstants(
+          cmdBuffer, ::VkPipelineLayout(*pipeline_layout_),
+          VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push_constants),
+          &push_constants);
+      cmdBuffer->vkCmdDrawIndexedIndirect(
+          cmdBuffer, draw_data_->get_buffer(),
+          draw_data_->get_offset_for_frame(frame_index) +
+              lod * sizeof(VkDrawIndexedIndirectCommand),
+          1, sizeof(VkDrawIndexedIndirectCommand));
+    }
+
+    cmdBuffer->vkCmdEndRenderPass(cmdBuffer);
+
+    (*frame_data->command_buffer_)
+        ->vkEndCommandBuffer(*frame_data->command_buffer_);
+  }
+
+  virtual void Update(float time_since_last_render) override {
+    const Mat44 rotation = Mat44::FromRotationMatrix(
+        Mat44::RotationX(3.14f * time_since_last_render * 0.25f) *
+        Mat44::RotationY(3.14f * time_since_last_render * 0.125f));
+    for (auto& r : rotations_) {
+      r = r * rotation;
+    }
+    UpdateInstances();
+  }
+
+  virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
+                      LodInstancingFrameData* frame_data) override {
+    // Update our uniform buffers.
+    camera_data_->UpdateBuffer(queue, frame_index);
+    instance_data_->UpdateBuffer(queue, frame_index);
+    draw_data_->UpdateBuffer(queue, frame_index);
+
+    VkSubmitInfo init_submit_info{
+        VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+        nullptr,                        // pNext
+        0,                              // waitSemaphoreCount
+        nullptr,                        // pWaitSemaphores
+        nullptr,                        // pWaitDstStageMask,
+        1,                              // commandBufferCount
+        &(frame_data->command_buffer_->get_command_buffer()),
+        0,       // signalSemaphoreCount
+        nullptr  // pSignalSemaphores
+    };
+
+    app()->render_queue()->vkQueueSubmit(app()->render_queue(), 1,
+                                         &init_submit_info,
+                                         static_cast<VkFence>(VK_NULL_HANDLE));
+  }
+
+ private:
+  // Picks the level of detail of every instance from its distance to the
+  // camera, which sits at the origin, and groups the instances by level.
+  void UpdateInstances() {
+    uint32_t counts[kMaxLods] = {};
+    InstanceData& instances = instance_data_->data();
+    for (size_t i = 0; i < kNumInstances; ++i) {
+      const size_t lod = std::min(
+          torus_.SelectLod(positions_[i].Length(), pixels_per_unit_),
+          num_lods_ - 1);
+      instances.transforms[lod * kNumInstances + counts[lod]++] =
+          Mat44::FromTranslationVector(positions_[i]) * rotations_[i] *
+          dequantize_;
+    }
+
+    DrawData& draws = draw_data_->data();
+    for (size_t lod = 0; lod < num_lods_; ++lod) {
+      draws.commands[lod] = {
+          torus_.Lod(lod).index_count,  // indexCount
+          counts[lod],                  // instanceCount
+          torus_.Lod(lod).first_index,  // firstIndex
+          0,                            // vertexOffset
+          0                             // firstInstance
+      };
+    }
+  }
+
+  struct CameraData {
+    Mat44 projection_matrix;
+  };
+
+  // The transforms of the instances of level |lod| start at
+  // lod * kNumInstances.
+  struct InstanceData {
+    Mat44 transforms[kMaxLods * kNumInstances];
+  };
+
+  struct DrawData {
+    VkDrawIndexedIndirectCommand commands[kMaxLods];
+  };
+
+  const entry::EntryData* data_;
+  containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
+  containers::unique_ptr<vulkan::VulkanGraphicsPipeline> torus_pipeline_;
+  containers::unique_ptr<vulkan::VkRenderPass> render_pass_;
+  VkDescriptorSetLayoutBinding torus_descriptor_set_layouts_[2];
+  vulkan::VulkanModel torus_;
+  size_t num_lods_ = 1;
+  float pixels_per_unit_ = 1.0f;
+
+  Vector3 positions_[kNumInstances];
+  containers::vector<Mat44> rotations_;
+  Mat44 dequantize_;
+
+  containers::unique_ptr<vulkan::BufferFrameData<CameraData>> camera_data_;
+  containers::unique_ptr<vulkan::BufferFrameData<InstanceData>> instance_data_;
+  containers::unique_ptr<vulkan::BufferFrameData<DrawData>> draw_data_;
+};
+
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+  LodInstancingSample sample(data);
+  sample.Initialize();
+
+  while (!sample.should_exit() && !data->WindowClosing()) {
+    sample.ProcessFrame();
+  }
+  sample.WaitIdle();
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
@@ -0,0 +1,29 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#version 450
+
+// Scales the texture coordinates that make up the color. The built-in
+// SPIR-V uses the default, runtime compiled shaders define it.
+#ifndef COLOR_SCALE
+#define COLOR_SCALE 1.0
+#endif
+
+layout(location = 0) out vec4 out_color;
+layout (location = 1) in vec2 texcoord;
+
+void main() {
+    out_color = vec4(texcoord * COLOR_SCALE, 0.0, 1.0);
+}
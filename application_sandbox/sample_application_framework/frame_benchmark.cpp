@@ -0,0 +1,129 @@
+// Copyright 2022 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "application_sandbox/sample_application_framework/frame_benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+namespace sample_application {
+namespace {
+const char* kPhaseNames[] = {"update", "acquire", "record", "submit",
+                             "present"};
+
+// Returns the |percentile|th percentile of |sorted|, by nearest rank.
+float Percentile(const containers::vector<float>& sorted, float percentile) {
+  size_t rank = static_cast<size_t>(
+      std::ceil(percentile / 100.0f * static_cast<float>(sorted.size())));
+  return sorted[rank == 0 ? 0 : rank - 1];
+}
+
+// Writes the distribution of |times| as a JSON object.
+void WriteDistribution(std::ostream& out, containers::vector<float> times) {
+  if (times.empty()) {
+    out << "null";
+    return;
+  }
+  std::sort(times.begin(), times.end());
+  float sum = 0.0f;
+  for (float time : times) {
+    sum += time;
+  }
+  out << "{\"mean\": " << sum / static_cast<float>(times.size())
+      << ", \"min\": " << times.front() << ", \"p50\": "
+      << Percentile(times, 50.0f) << ", \"p95\": " << Percentile(times, 95.0f)
+      << ", \"p99\": " << Percentile(times, 99.0f)
+      << ", \"max\": " << times.back() << ", \"count\": " << times.size()
+      << "}";
+}
+}  // anonymous namespace
+
+FrameBenchmark::FrameBenchmark(containers::Allocator* allocator,
+                               logging::Logger* log, uint32_t warmup_frames,
+                               uint32_t frames)
+    : log_(log),
+      warmup_frames_(warmup_frames),
+      frames_(frames),
+      current_frame_(0),
+      current_times_{},
+      phase_times_{containers::vector<float>(allocator),
+                   containers::vector<float>(allocator),
+                   containers::vector<float>(allocator),
+                   containers::vector<float>(allocator),
+                   containers::vector<float>(allocator)},
+      frame_times_(allocator),
+      gpu_times_(allocator) {
+  for (auto& times : phase_times_) {
+    times.reserve(frames_);
+  }
+  frame_times_.reserve(frames_);
+  gpu_times_.reserve(frames_);
+}
+
+void FrameBenchmark::AddCpuTime(FramePhase phase, float milliseconds) {
+  current_times_[static_cast<size_t>(phase)] += milliseconds;
+}
+
+void FrameBenchmark::AddGpuTime(uint64_t frame, float milliseconds) {
+  if (frame >= warmup_frames_ && frame < warmup_frames_ + frames_) {
+    gpu_times_.push_back(milliseconds);
+  }
+}
+
+void FrameBenchmark::EndFrame(float milliseconds) {
+  if (measuring()) {
+    for (size_t i = 0; i < static_cast<size_t>(FramePhase::kNumPhases); ++i) {
+      phase_times_[i].push_back(current_times_[i]);
+    }
+    frame_times_.push_back(milliseconds);
+  }
+  std::fill(std::begin(current_times_), std::end(current_times_), 0.0f);
+  ++current_frame_;
+}
+
+void FrameBenchmark::WriteResults(const char* file, const char* device_name,
+                                  uint32_t width, uint32_t height) {
+  std::ostringstream json;
+  json << "{\n";
+  json << "  \"device\": \"" << device_name << "\",\n";
+  json << "  \"width\": " << width << ",\n";
+  json << "  \"height\": " << height << ",\n";
+  json << "  \"warmup_frames\": " << warmup_frames_ << ",\n";
+  json << "  \"frames\": " << frames_ << ",\n";
+  json << "  \"milliseconds\": {\n";
+  json << "    \"frame\": ";
+  WriteDistribution(json, frame_times_);
+  for (size_t i = 0; i < static_cast<size_t>(FramePhase::kNumPhases); ++i) {
+    json << ",\n    \"" << kPhaseNames[i] << "\": ";
+    WriteDistribution(json, phase_times_[i]);
+  }
+  json << ",\n    \"gpu\": ";
+  WriteDistribution(json, gpu_times_);
+  json << "\n  }\n}\n";
+
+  if (!file) {
+    log_->LogInfo("Benchmark results:\n", json.str());
+    return;
+  }
+  std::ofstream out(file, std::ofstream::out);
+  if (!out) {
+    log_->LogError("Could not write the benchmark results to ", file);
+    return;
+  }
+  out << json.str();
+}
+
+}  // namespace sample_application
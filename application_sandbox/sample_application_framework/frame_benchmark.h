@@ -0,0 +1,106 @@
+// Copyright 2022 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SAMPLE_APPLICATION_FRAMEWORK_FRAME_BENCHMARK_H_
+#define SAMPLE_APPLICATION_FRAMEWORK_FRAME_BENCHMARK_H_
+
+#include <chrono>
+#include <cstdint>
+
+#include "support/containers/allocator.h"
+#include "support/containers/vector.h"
+#include "support/log/log.h"
+
+namespace sample_application {
+
+// The parts of a frame that FrameBenchmark times on the CPU.
+enum class FramePhase {
+  kUpdate,
+  kAcquire,
+  kRecord,
+  kSubmit,
+  kPresent,
+  kNumPhases,
+};
+
+// FrameBenchmark collects the CPU and GPU times of a fixed number of frames,
+// after a number of warmup frames, and writes their distribution as JSON.
+class FrameBenchmark {
+ public:
+  // Adds the time between its construction and destruction to |phase| of
+  // the current frame. Does nothing if |benchmark| is nullptr.
+  class Scope {
+   public:
+    Scope(FrameBenchmark* benchmark, FramePhase phase)
+        : benchmark_(benchmark),
+          phase_(phase),
+          start_(std::chrono::high_resolution_clock::now()) {}
+    ~Scope() { End(); }
+
+    // Stops timing before the end of the scope.
+    void End() {
+      if (benchmark_) {
+        std::chrono::duration<float, std::milli> elapsed =
+            std::chrono::high_resolution_clock::now() - start_;
+        benchmark_->AddCpuTime(phase_, elapsed.count());
+        benchmark_ = nullptr;
+      }
+    }
+
+   private:
+    FrameBenchmark* benchmark_;
+    FramePhase phase_;
+    std::chrono::high_resolution_clock::time_point start_;
+  };
+
+  FrameBenchmark(containers::Allocator* allocator, logging::Logger* log,
+                 uint32_t warmup_frames, uint32_t frames);
+
+  // Adds |milliseconds| to |phase| of the current frame.
+  void AddCpuTime(FramePhase phase, float milliseconds);
+  // Records the GPU time of frame number |frame|, which is the value that
+  // current_frame() had while that frame was being processed.
+  void AddGpuTime(uint64_t frame, float milliseconds);
+  // Finishes the current frame, which took |milliseconds| in total.
+  void EndFrame(float milliseconds);
+
+  uint64_t current_frame() const { return current_frame_; }
+  // Returns true once every frame has been timed on the CPU.
+  bool done() const { return current_frame_ >= warmup_frames_ + frames_; }
+
+  // Writes the results as JSON to |file|, or logs them if it is nullptr.
+  // |device_name|, |width| and |height| are included to tell apart runs.
+  void WriteResults(const char* file, const char* device_name, uint32_t width,
+                    uint32_t height);
+
+ private:
+  bool measuring() const {
+    return current_frame_ >= warmup_frames_ && !done();
+  }
+
+  logging::Logger* log_;
+  const uint32_t warmup_frames_;
+  const uint32_t frames_;
+  uint64_t current_frame_;
+  // The CPU time of each phase in the current frame.
+  float current_times_[static_cast<size_t>(FramePhase::kNumPhases)];
+  containers::vector<float> phase_times_[static_cast<size_t>(
+      FramePhase::kNumPhases)];
+  containers::vector<float> frame_times_;
+  containers::vector<float> gpu_times_;
+};
+
+}  // namespace sample_application
+
+#endif  // SAMPLE_APPLICATION_FRAMEWORK_FRAME_BENCHMARK_H_
@@ -19,9 +19,11 @@
 #include <cstddef>
 #include <cstdint>
 
+#include "application_sandbox/sample_application_framework/frame_benchmark.h"
 #include "support/entry/entry.h"
 #include "vulkan_helpers/helper_functions.h"
 #include "vulkan_helpers/vulkan_application.h"
+#include "vulkan_wrapper/call_tracer.h"
 
 namespace sample_application {
 
@@ -51,6 +53,7 @@ struct SampleOptions {
   bool enable_display_timing = false;
   bool enable_10bit_hdr = false;
   bool use_high_precision_depth = false;
+  bool enable_bindless_heap = false;
   void* device_extension_structures = nullptr;
   // The default value of zero means there is no application
   // enforced minimum and the number of swapchains images
@@ -119,6 +122,12 @@ struct SampleOptions {
     use_high_precision_depth = true;
     return *this;
   }
+  // The sample has to enable descriptor indexing itself, see
+  // vulkan::BindlessHeap.
+  SampleOptions& EnableBindlessHeap() {
+    enable_bindless_heap = true;
+    return *this;
+  }
   SampleOptions& AddDeviceExtensionStructure(void* device_extension_structure) {
     device_extension_structures = device_extension_structure;
     return *this;
@@ -180,6 +189,7 @@ vulkan::VulkanApplicationOptions buildVulkanApplicationOptions(
   if (options.shared_presentation) ret.EnableSharedPresentation();
   if (options.enable_10bit_hdr) ret.Enable10BitHDR();
   if (options.mutable_swapchain_format) ret.EnableMutableSwapchainFormat();
+  if (options.enable_bindless_heap) ret.EnableBindlessHeap();
 
   if (options.extended_swapchain_color_space)
     ret.SetSwapchainColorSpace(VK_COLOR_SPACE_EXTENDED_SRGB_NONLINEAR_EXT);
@@ -229,6 +239,15 @@ class Sample {
     containers::unique_ptr<vulkan::VkSemaphore> ready_semaphore_;
     // The fence that signals that the resources for this frame are free.
     containers::unique_ptr<vulkan::VkFence> ready_fence_;
+    // The BindlessHeap frame that was last rendered with this data.
+    uint64_t bindless_frame_;
+    // Two timestamps around the commands from Render(), only created when
+    // benchmarking.
+    containers::unique_ptr<vulkan::VkQueryPool> timestamp_pool_;
+    // The benchmark frame whose timestamps are in |timestamp_pool_|, if
+    // |timestamps_pending_| is set.
+    uint64_t benchmark_frame_;
+    bool timestamps_pending_;
     // The application-specific data for this frame.
     FrameData child_data_;
   };
@@ -255,10 +274,21 @@ class Sample {
         last_frame_time_(std::chrono::high_resolution_clock::now()),
         initialization_command_buffer_(application_.GetCommandBuffer()),
         average_frame_time_(0),
-        is_valid_(true) {
+        is_valid_(true),
+        timestamp_period_(0.0f),
+        timestamp_mask_(0) {
     if (data_->fixed_timestep()) {
       app()->GetLogger()->LogInfo("Running with a fixed timestep of 0.1s");
     }
+    if (data_->benchmark_frames() > 0) {
+      benchmark_ = containers::make_unique<FrameBenchmark>(
+          allocator, allocator, data_->logger(),
+          data_->benchmark_warmup_frames(), data_->benchmark_frames());
+      InitializeTimestamps();
+    }
+    if (data_->trace_api_calls()) {
+      vulkan::CallTracer::Enable(true);
+    }
 
     frame_data_.reserve(swapchain_images_.size());
     // TODO: The image format used by the swapchain image may not suppport
@@ -362,6 +392,13 @@ class Sample {
     data_->NotifyReady();
   }
 
+  virtual ~Sample() {
+    if (data_->trace_api_calls()) {
+      vulkan::CallTracer::Enable(false);
+      vulkan::CallTracer::LogReport(data_->logger());
+    }
+  }
+
   virtual void WaitIdle() {
     app()->device()->vkDeviceWaitIdle(app()->device());
   }
@@ -396,7 +433,22 @@ class Sample {
     auto current_time = std::chrono::high_resolution_clock::now();
     std::chrono::duration<float> elapsed_time = current_time - last_frame_time_;
     last_frame_time_ = current_time;
-    Update(data_->fixed_timestep() ? 0.1f : elapsed_time.count());
+    if (data_->trace_api_calls()) {
+      vulkan::CallTracer::EndFrame();
+    }
+    FrameBenchmark* benchmark = benchmark_.get();
+    if (benchmark && benchmark->current_frame() > 0) {
+      // The time since the last call is the length of the previous frame.
+      benchmark->EndFrame(elapsed_time.count() * 1000.0f);
+      if (benchmark->done()) {
+        FinishBenchmark();
+        return;
+      }
+    }
+    {
+      FrameBenchmark::Scope scope(benchmark, FramePhase::kUpdate);
+      Update(data_->fixed_timestep() ? 0.1f : elapsed_time.count());
+    }
 
     // Smooth this out, so that it is more sensible.
     average_frame_time_ =
@@ -472,6 +524,7 @@ class Sample {
     }
 
     uint32_t image_idx;
+    FrameBenchmark::Scope acquire_scope(benchmark, FramePhase::kAcquire);
 
     // This is a bit weird as we have to make new semaphores every frame, but
     // for now this will do. It will get cleaned up the next time
@@ -494,6 +547,16 @@ class Sample {
     LOG_ASSERT(
         ==, app()->GetLogger(), VK_SUCCESS,
         app()->device()->vkResetFences(app()->device(), 1, &ready_fence));
+    acquire_scope.End();
+    if (benchmark) {
+      ReadTimestamps(&frame_data_[image_idx], 0);
+    }
+    if (vulkan::BindlessHeap* heap = app()->bindless_heap()) {
+      // The last frame that used this image is done, so everything that was
+      // freed in it, or before it, can be reused.
+      heap->FrameCompleted(frame_data_[image_idx].bindless_frame_);
+      frame_data_[image_idx].bindless_frame_ = heap->BeginFrame();
+    }
     if (options_.verbose_output) {
       app()->GetLogger()->LogInfo("Rendering frame <", elapsed_time.count(),
                                   ">: <", image_idx, ">", " Average: <",
@@ -510,6 +573,12 @@ class Sample {
     VkPipelineStageFlags flags =
         VkPipelineStageFlags(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
 
+    FrameBenchmark::Scope submit_scope(benchmark, FramePhase::kSubmit);
+    if (frame_data_[image_idx].timestamp_pool_) {
+      frame_data_[image_idx].benchmark_frame_ = benchmark->current_frame();
+      frame_data_[image_idx].timestamps_pending_ = true;
+    }
+
     if (application_.HasSeparatePresentQueue()) {
       render_wait_semaphore = *frame_data_[image_idx].transfer_semaphore_;
       VkSubmitInfo transfer_submit_info{
@@ -550,9 +619,14 @@ class Sample {
     app()->render_queue()->vkQueueSubmit(
         app()->render_queue(), 1, &init_submit_info,
         static_cast<::VkFence>(VK_NULL_HANDLE));
+    submit_scope.End();
 
-    Render(&app()->render_queue(), image_idx,
-           &frame_data_[image_idx].child_data_);
+    {
+      FrameBenchmark::Scope record_scope(benchmark, FramePhase::kRecord);
+      Render(&app()->render_queue(), image_idx,
+             &frame_data_[image_idx].child_data_);
+    }
+    FrameBenchmark::Scope resolve_scope(benchmark, FramePhase::kSubmit);
     init_submit_info.pCommandBuffers =
         &(frame_data_[image_idx].resolve_command_buffer_->get_command_buffer());
 
@@ -565,9 +639,13 @@ class Sample {
     app()->render_queue()->vkQueueSubmit(
         app()->render_queue(), 1, &init_submit_info, ::VkFence(ready_fence));
 
+    if (data_->headless()) {
+      present_ready_semaphore =
+          app()->CaptureHeadlessFrame(image_idx, present_ready_semaphore);
+    }
+
     if (application_.HasSeparatePresentQueue()) {
-      ::VkSemaphore transfer_semaphore =
-          *frame_data_[image_idx].transfer_semaphore_;
+      ::VkSemaphore transfer_semaphore = present_ready_semaphore;
       present_ready_semaphore = render_wait_semaphore;
       VkSubmitInfo transfer_submit_info{
           VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
@@ -586,7 +664,9 @@ class Sample {
           app()->present_queue(), 1, &transfer_submit_info,
           static_cast<::VkFence>(VK_NULL_HANDLE));
     }
+    resolve_scope.End();
 
+    FrameBenchmark::Scope present_scope(benchmark, FramePhase::kPresent);
     VkPresentInfoKHR present_info{
         VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,    // sType
         nullptr,                               // pNext
@@ -623,7 +703,9 @@ class Sample {
   void set_invalid(bool invaid) { is_valid_ = false; }
   const bool is_valid() { return is_valid_; }
 
-  bool should_exit() const { return app()->should_exit(); }
+  bool should_exit() const {
+    return app()->should_exit() || (benchmark_ && benchmark_->done());
+  }
 
  private:
   const size_t sample_frame_data_offset =
@@ -697,6 +779,9 @@ class Sample {
 
     data->ready_fence_ = containers::make_unique<vulkan::VkFence>(
         allocator_, vulkan::CreateFence(&application_.device()));
+    data->bindless_frame_ = 0;
+    data->benchmark_frame_ = 0;
+    data->timestamps_pending_ = false;
 
     VkImageCreateInfo image_create_info{
         /* sType = */
@@ -910,6 +995,26 @@ class Sample {
                                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
                                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0,
                                0, nullptr, 0, nullptr, 1, &barrier);
+    if (timestamp_mask_) {
+      VkQueryPoolCreateInfo query_pool_info = {
+          VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,  // sType
+          nullptr,                                   // pNext
+          0,                                         // flags
+          VK_QUERY_TYPE_TIMESTAMP,                   // queryType
+          2,                                         // queryCount
+          0,                                         // pipelineStatistics
+      };
+      data->timestamp_pool_ = containers::make_unique<vulkan::VkQueryPool>(
+          allocator_,
+          vulkan::CreateQueryPool(&application_.device(), query_pool_info));
+      (*data->setup_command_buffer_)
+          ->vkCmdResetQueryPool((*data->setup_command_buffer_),
+                                *data->timestamp_pool_, 0, 2);
+      (*data->setup_command_buffer_)
+          ->vkCmdWriteTimestamp((*data->setup_command_buffer_),
+                                VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                *data->timestamp_pool_, 0);
+    }
     (*data->setup_command_buffer_)
         ->vkEndCommandBuffer(*data->setup_command_buffer_);
 
@@ -920,6 +1025,12 @@ class Sample {
     (*data->resolve_command_buffer_)
         ->vkBeginCommandBuffer((*data->resolve_command_buffer_),
                                &kBeginCommandBuffer);
+    if (data->timestamp_pool_) {
+      (*data->resolve_command_buffer_)
+          ->vkCmdWriteTimestamp((*data->resolve_command_buffer_),
+                                VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                *data->timestamp_pool_, 1);
+    }
     VkImageLayout old_layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
     VkAccessFlags old_access = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
     if (options_.enable_multisampling && !options_.enable_mixed_multisampling) {
@@ -1009,6 +1120,67 @@ class Sample {
     InitializeFrameData(&data->child_data_, initialization_buffer, frame_index);
   }
 
+  // Works out whether the render queue can write timestamps, and how long
+  // each tick is.
+  void InitializeTimestamps() {
+    ::VkPhysicalDevice physical_device =
+        application_.device().physical_device();
+    containers::vector<VkQueueFamilyProperties> properties =
+        vulkan::GetQueueFamilyProperties(allocator_, application_.instance(),
+                                         physical_device);
+    uint32_t valid_bits =
+        properties[application_.render_queue().index()].timestampValidBits;
+    if (valid_bits == 0) {
+      app()->GetLogger()->LogInfo(
+          "The render queue does not support timestamps, GPU times will not "
+          "be measured");
+      return;
+    }
+    timestamp_mask_ =
+        valid_bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << valid_bits) - 1;
+    VkPhysicalDeviceProperties device_properties;
+    application_.instance()->vkGetPhysicalDeviceProperties(physical_device,
+                                                          &device_properties);
+    timestamp_period_ = device_properties.limits.timestampPeriod;
+  }
+
+  // Passes the GPU time of the last frame rendered with |data| to the
+  // benchmark, if it is available. |flags| may contain
+  // VK_QUERY_RESULT_WAIT_BIT to wait for it.
+  void ReadTimestamps(SampleFrameData* data, VkQueryResultFlags flags) {
+    if (!data->timestamps_pending_) {
+      return;
+    }
+    uint64_t timestamps[2];
+    VkResult result = app()->device()->vkGetQueryPoolResults(
+        app()->device(), *data->timestamp_pool_, 0, 2, sizeof(timestamps),
+        timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | flags);
+    if (result != VK_SUCCESS) {
+      return;
+    }
+    data->timestamps_pending_ = false;
+    uint64_t ticks = (timestamps[1] - timestamps[0]) & timestamp_mask_;
+    benchmark_->AddGpuTime(data->benchmark_frame_,
+                           static_cast<float>(ticks) * timestamp_period_ /
+                               1000000.0f);
+  }
+
+  // Collects the GPU times of the frames that are still in flight, and
+  // writes the results.
+  void FinishBenchmark() {
+    app()->device()->vkDeviceWaitIdle(app()->device());
+    for (auto& frame_data : frame_data_) {
+      ReadTimestamps(&frame_data, VK_QUERY_RESULT_WAIT_BIT);
+    }
+    VkPhysicalDeviceProperties device_properties;
+    application_.instance()->vkGetPhysicalDeviceProperties(
+        application_.device().physical_device(), &device_properties);
+    benchmark_->WriteResults(data_->benchmark_file(),
+                             device_properties.deviceName,
+                             application_.swapchain().width(),
+                             application_.swapchain().height());
+  }
+
   SampleOptions options_;
   const entry::EntryData* data_;
   containers::Allocator* allocator_;
@@ -1046,6 +1218,12 @@ class Sample {
   bool is_valid_;
   // The format used for depth stencil attachment.
   VkFormat depth_stencil_format_;
+  // Only set when running with -benchmark.
+  containers::unique_ptr<FrameBenchmark> benchmark_;
+  // The length of a timestamp tick in nanoseconds.
+  float timestamp_period_;
+  // The valid bits of a timestamp, or 0 if GPU times are not measured.
+  uint64_t timestamp_mask_;
 };  // namespace sample_application
 }  // namespace sample_application
 
@@ -16,6 +16,7 @@
 #include "support/entry/entry.h"
 #include "vulkan_helpers/buffer_frame_data.h"
 #include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/image_loader.h"
 #include "vulkan_helpers/vulkan_application.h"
 #include "vulkan_helpers/vulkan_model.h"
 #include "vulkan_helpers/vulkan_texture.h"
@@ -46,6 +47,9 @@ namespace simple_texture {
 
 const auto& texture_data = simple_texture::texture;
 
+// The size of the staging ring that -image-dir images are loaded through.
+const size_t kImageStagingSize = 256 * 1024;
+
 struct TexturedCubeFrameData {
   containers::unique_ptr<vulkan::VkCommandBuffer> command_buffer_;
   containers::unique_ptr<vulkan::VkFramebuffer> framebuffer_;
@@ -53,7 +57,8 @@ struct TexturedCubeFrameData {
 };
 
 // This creates an application with 16MB of image memory, and defaults
-// for host, and device buffer sizes.
+// for host, and device buffer sizes. With -image-dir, the texture is loaded
+// from rgb8.png in that directory with an ImageLoader instead.
 class TexturedCubeSample
     : public sample_application::Sample<TexturedCubeFrameData> {
  public:
@@ -68,6 +73,9 @@ class TexturedCubeSample
       size_t num_swapchain_images) override {
     cube_.InitializeData(app(), initialization_buffer);
     texture_.InitializeData(app(), initialization_buffer);
+    if (data_->image_dir()) {
+      LoadRuntimeTexture();
+    }
 
     cube_descriptor_set_layouts_[0] = {
         0,                                  // binding
@@ -215,7 +223,7 @@ class TexturedCubeSample
     };
     VkDescriptorImageInfo texture_info = {
         VK_NULL_HANDLE,                            // sampler
-        texture_.view(),                           // imageView
+        texture_view(),                            // imageView
         VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,  // imageLayout
     };
 
@@ -358,6 +366,28 @@ class TexturedCubeSample
     Mat44 transform;
   };
 
+  // Loads the texture from -image-dir, and waits until it is uploaded, as
+  // the descriptor sets are only written once.
+  void LoadRuntimeTexture() {
+    containers::string path(data_->image_dir(), data_->allocator());
+    path.append("/rgb8.png");
+    // The staging ring has to fit into the 1MB of host buffer memory, next
+    // to the staging buffers of the embedded model and texture.
+    image_loader_ = containers::make_unique<vulkan::ImageLoader>(
+        data_->allocator(), app(), 1, kImageStagingSize);
+    runtime_texture_ = image_loader_->Load(path.c_str());
+    image_loader_->Flush(&app()->render_queue());
+    if (runtime_texture_->failed()) {
+      app()->GetLogger()->LogError("Could not load ", path.c_str(),
+                                   ", using the embedded texture");
+      runtime_texture_ = nullptr;
+    }
+  }
+
+  ::VkImageView texture_view() const {
+    return runtime_texture_ ? runtime_texture_->view() : texture_.view();
+  }
+
   const entry::EntryData* data_;
   containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
   containers::unique_ptr<vulkan::VulkanGraphicsPipeline> cube_pipeline_;
@@ -366,6 +396,9 @@ class TexturedCubeSample
   vulkan::VulkanModel cube_;
   vulkan::VulkanTexture texture_;
   containers::unique_ptr<vulkan::VkSampler> sampler_;
+  containers::unique_ptr<vulkan::ImageLoader> image_loader_;
+  // The texture from -image-dir, if it has been loaded.
+  vulkan::StreamedImage* runtime_texture_ = nullptr;
 
   containers::unique_ptr<vulkan::BufferFrameData<CameraData>> camera_data_;
   containers::unique_ptr<vulkan::BufferFrameData<ModelData>> model_data_;
@@ -0,0 +1,463 @@
+// Copyright 2022 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "application_sandbox/sample_application_framework/sample_application.h"
+#include "support/entry/entry.h"
+#include "vulkan_helpers/buffer_frame_data.h"
+#include "vulkan_helpers/helper_functions.h"
+#include "vulkan_helpers/virtual_texture.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+#include <cmath>
+#include "mathfu/matrix.h"
+#include "mathfu/vector.h"
+
+using Mat44 = mathfu::Matrix<float, 4, 4>;
+using Vector3 = mathfu::Vector<float, 3>;
+
+uint32_t virtual_texturing_vertex_shader[] =
+#include "virtual_texturing.vert.spv"
+    ;
+
+uint32_t virtual_texturing_fragment_shader[] =
+#include "virtual_texturing.frag.spv"
+    ;
+
+// 1 GiB at level 0, of which only kPageBudget pages are resident.
+const uint32_t kTextureSize = 16384;
+const uint32_t kPageBudget = 512;
+// The size of the squares of the checkerboard, in texels of level 0.
+const uint32_t kSquareSize = 512;
+
+struct VirtualTexturingFrameData {
+  containers::unique_ptr<vulkan::VkCommandBuffer> command_buffer_;
+  containers::unique_ptr<vulkan::VkFramebuffer> framebuffer_;
+  containers::unique_ptr<vulkan::DescriptorSet> plane_descriptor_set_;
+};
+
+namespace {
+VkPhysicalDeviceFeatures VirtualTexturingFeatures() {
+  VkPhysicalDeviceFeatures features = {0};
+  features.sparseBinding = VK_TRUE;
+  features.sparseResidencyImage2D = VK_TRUE;
+  // The feedback is written by the fragment shader.
+  features.fragmentStoresAndAtomics = VK_TRUE;
+  return features;
+}
+
+// Fills a page of a checkerboard with thin stripes, which are only visible
+// in the finer levels. Every level has its own tint, so that it is visible
+// which levels are resident.
+void FillPage(uint32_t level, uint32_t x, uint32_t y, uint32_t width,
+              uint32_t height, uint8_t* texels) {
+  static const uint8_t kLevelTints[8][3] = {
+      {255, 255, 255}, {255, 160, 160}, {160, 255, 160}, {160, 160, 255},
+      {255, 255, 160}, {255, 160, 255}, {160, 255, 255}, {200, 200, 200}};
+  const uint8_t* tint = kLevelTints[level % 8];
+  for (uint32_t row = 0; row < height; ++row) {
+    for (uint32_t column = 0; column < width; ++column) {
+      // The position of the texel in level 0.
+      const uint32_t u = (x + column) << level;
+      const uint32_t v = (y + row) << level;
+      uint32_t brightness =
+          ((u / kSquareSize + v / kSquareSize) & 1) != 0 ? 96 : 224;
+      if ((u + v) / 8 % 8 == 0) {
+        brightness -= 64;
+      }
+      uint8_t* texel = texels + (size_t(row) * width + column) * 4;
+      for (uint32_t channel = 0; channel < 3; ++channel) {
+        texel[channel] = uint8_t(brightness * tint[channel] / 255);
+      }
+      texel[3] = 255;
+    }
+  }
+}
+}  // anonymous namespace
+
+class VirtualTexturingSample
+    : public sample_application::Sample<VirtualTexturingFrameData> {
+ public:
+  VirtualTexturingSample(const entry::EntryData* data)
+      : data_(data),
+        Sample<VirtualTexturingFrameData>(
+            data->allocator(), data, 16, 128, 1, 4,
+            sample_application::SampleOptions().EnableSparseBinding(),
+            VirtualTexturingFeatures()) {}
+  virtual void InitializeApplicationData(
+      vulkan::VkCommandBuffer* initialization_buffer,
+      size_t num_swapchain_images) override {
+    texture_ = containers::make_unique<vulkan::VirtualTexture>(
+        data_->allocator(), app(), VK_FORMAT_R8G8B8A8_UNORM, kTextureSize,
+        kTextureSize, kPageBudget, uint32_t(num_swapchain_images), FillPage);
+    texture_->InitializeData(initialization_buffer);
+
+    plane_descriptor_set_layouts_[0] = {
+        0,                                  // binding
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,  // descriptorType
+        1,                                  // descriptorCount
+        VK_SHADER_STAGE_VERTEX_BIT,         // stageFlags
+        nullptr                             // pImmutableSamplers
+    };
+    plane_descriptor_set_layouts_[1] = {
+        1,                                  // binding
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,  // descriptorType
+        1,                                  // descriptorCount
+        VK_SHADER_STAGE_VERTEX_BIT,         // stageFlags
+        nullptr                             // pImmutableSamplers
+    };
+    plane_descriptor_set_layouts_[2] = {
+        2,                             // binding
+        VK_DESCRIPTOR_TYPE_SAMPLER,    // descriptorType
+        1,                             // descriptorCount
+        VK_SHADER_STAGE_FRAGMENT_BIT,  // stageFlags
+        nullptr                        // pImmutableSamplers
+    };
+    plane_descriptor_set_layouts_[3] = {
+        3,                                 // binding
+        VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,  // descriptorType
+        1,                                 // descriptorCount
+        VK_SHADER_STAGE_FRAGMENT_BIT,      // stageFlags
+        nullptr                            // pImmutableSamplers
+    };
+    // The page table and the feedback.
+    for (uint32_t i = 4; i < 6; ++i) {
+      plane_descriptor_set_layouts_[i] = {
+          i,                                  // binding
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+          1,                                  // descriptorCount
+          VK_SHADER_STAGE_FRAGMENT_BIT,       // stageFlags
+          nullptr                             // pImmutableSamplers
+      };
+    }
+
+    sampler_ = containers::make_unique<vulkan::VkSampler>(
+        data_->allocator(),
+        vulkan::CreateSampler(&app()->device(), VK_FILTER_LINEAR,
+                              VK_FILTER_LINEAR));
+
+    pipeline_layout_ = containers::make_unique<vulkan::PipelineLayout>(
+        data_->allocator(),
+        app()->CreatePipelineLayout({{plane_descriptor_set_layouts_[0],
+                                      plane_descriptor_set_layouts_[1],
+                                      plane_descriptor_set_layouts_[2],
+                                      plane_descriptor_set_layouts_[3],
+                                      plane_descriptor_set_layouts_[4],
+                                      plane_descriptor_set_layouts_[5]}}));
+
+    VkAttachmentReference color_attachment = {
+        0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+
+    render_pass_ = containers::make_unique<vulkan::VkRenderPass>(
+        data_->allocator(),
+        app()->CreateRenderPass(
+            {{
+                0,                                         // flags
+                render_format(),                           // format
+                num_samples(),                             // samples
+                VK_ATTACHMENT_LOAD_OP_CLEAR,               // loadOp
+                VK_ATTACHMENT_STORE_OP_STORE,              // storeOp
+                VK_ATTACHMENT_LOAD_OP_DONT_CARE,           // stencilLoadOp
+                VK_ATTACHMENT_STORE_OP_DONT_CARE,          // stencilStoreOp
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // initialLayout
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL   // finalLayout
+            }},  // AttachmentDescriptions
+            {{
+                0,                                // flags
+                VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint
+                0,                                // inputAttachmentCount
+                nullptr,                          // pInputAttachments
+                1,                                // colorAttachmentCount
+                &color_attachment,                // colorAttachment
+                nullptr,                          // pResolveAttachments
+                nullptr,                          // pDepthStencilAttachment
+                0,                                // preserveAttachmentCount
+                nullptr                           // pPreserveAttachments
+            }},                                   // SubpassDescriptions
+            {}                                    // SubpassDependencies
+            ));
+
+    plane_pipeline_ = containers::make_unique<vulkan::VulkanGraphicsPipeline>(
+        data_->allocator(),
+        app()->CreateGraphicsPipeline(pipeline_layout_.get(),
+                                      render_pass_.get(), 0));
+    plane_pipeline_->AddShader(VK_SHADER_STAGE_VERTEX_BIT, "main",
+                               virtual_texturing_vertex_shader);
+    plane_pipeline_->AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, "main",
+                               virtual_texturing_fragment_shader);
+    plane_pipeline_->SetTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    // The plane is generated in the vertex shader, and seen from above.
+    plane_pipeline_->SetCullMode(VK_CULL_MODE_NONE);
+    plane_pipeline_->SetViewport(viewport());
+    plane_pipeline_->SetScissor(scissor());
+    plane_pipeline_->SetSamples(num_samples());
+    plane_pipeline_->AddAttachment();
+    plane_pipeline_->Commit();
+
+    camera_data_ = containers::make_unique<vulkan::BufferFrameData<CameraData>>(
+        data_->allocator(), app(), num_swapchain_images,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+
+    model_data_ = containers::make_unique<vulkan::BufferFrameData<ModelData>>(
+        data_->allocator(), app(), num_swapchain_images,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+
+    float aspect =
+        (float)app()->swapchain().width() / (float)app()->swapchain().height();
+    // Looking down at the plane, so that both the finest and the coarsest
+    // levels are on screen.
+    camera_data_->data().projection_matrix =
+        Mat44::FromScaleVector(Vector3{1.0f, -1.0f, 1.0f}) *
+        Mat44::Perspective(1.5708f, aspect, 0.1f, 100.0f) *
+        Mat44::FromRotationMatrix(Mat44::RotationX(0.5f));
+
+    UpdateModelData();
+  }
+
+  virtual void InitializationComplete() override {
+    texture_->InitializationComplete();
+  }
+
+  virtual void InitializeFrameData(
+      VirtualTexturingFrameData* frame_data,
+      vulkan::VkCommandBuffer* initialization_buffer,
+      size_t frame_index) override {
+    frame_data->command_buffer_ =
+        containers::make_unique<vulkan::VkCommandBuffer>(
+            data_->allocator(), app()->GetCommandBuffer());
+
+    frame_data->plane_descriptor_set_ =
+        containers::make_unique<vulkan::DescriptorSet>(
+            data_->allocator(),
+            app()->AllocateDescriptorSet({plane_descriptor_set_layouts_[0],
+                                          plane_descriptor_set_layouts_[1],
+                                          plane_descriptor_set_layouts_[2],
+                                          plane_descriptor_set_layouts_[3],
+                                          plane_descriptor_set_layouts_[4],
+                                          plane_descriptor_set_layouts_[5]}));
+
+    VkDescriptorBufferInfo buffer_infos[2] = {
+        {
+            camera_data_->get_buffer(),                       // buffer
+            camera_data_->get_offset_for_frame(frame_index),  // offset
+            camera_data_->size(),                             // range
+        },
+        {
+            model_data_->get_buffer(),                       // buffer
+            model_data_->get_offset_for_frame(frame_index),  // offset
+            model_data_->size(),                             // range
+        }};
+
+    VkDescriptorImageInfo sampler_info = {
+        *sampler_,                 // sampler
+        VK_NULL_HANDLE,            // imageView
+        VK_IMAGE_LAYOUT_UNDEFINED  //  imageLayout
+    };
+    VkDescriptorImageInfo texture_info = {
+        VK_NULL_HANDLE,           // sampler
+        texture_->view(),         // imageView
+        VK_IMAGE_LAYOUT_GENERAL,  // imageLayout
+    };
+
+    // Every frame index has its own page table and feedback.
+    VkDescriptorBufferInfo storage_buffer_infos[2] = {
+        texture_->page_table_info(frame_index),
+        texture_->feedback_info(frame_index)};
+
+    VkWriteDescriptorSet writes[4] = {
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+            nullptr,                                 // pNext
+            *frame_data->plane_descriptor_set_,      // dstSet
+            0,                                       // dstbinding
+            0,                                       // dstArrayElement
+            2,                                       // descriptorCount
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,       // descriptorType
+            nullptr,                                 // pImageInfo
+            &buffer_infos[0],                        // pBufferInfo
+            nullptr,                                 // pTexelBufferView
+        },
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+            nullptr,                                 // pNext
+            *frame_data->plane_descriptor_set_,      // dstSet
+            2,                                       // dstbinding
+            0,                                       // dstArrayElement
+            1,                                       // descriptorCount
+            VK_DESCRIPTOR_TYPE_SAMPLER,              // descriptorType
+            &sampler_info,                           // pImageInfo
+            nullptr,                                 // pBufferInfo
+            nullptr,                                 // pTexelBufferView
+        },
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+            nullptr,                                 // pNext
+            *frame_data->plane_descriptor_set_,      // dstSet
+            3,                                       // dstbinding
+            0,                                       // dstArrayElement
+            1,                                       // descriptorCount
+            VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,        // descriptorType
+            &texture_info,                           // pImageInfo
+            nullptr,                                 // pBufferInfo
+            nullptr,                                 // pTexelBufferView
+        },
+        {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+            nullptr,                                 // pNext
+            *frame_data->plane_descriptor_set_,      // dstSet
+            4,                                       // dstbinding
+            0,                                       // dstArrayElement
+            2,                                       // descriptorCount
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,       // descriptorType
+            nullptr,                                 // pImageInfo
+            storage_buffer_infos,                    // pBufferInfo
+            nullptr,                                 // pTexelBufferView
+        },
+    };
+
+    app()->device()->vkUpdateDescriptorSets(app()->device(), 4, writes, 0,
+                                            nullptr);
+
+    ::VkImageView raw_view = color_view(frame_data);
+
+    // Create a framebuffer with depth and image attachments
+    VkFramebufferCreateInfo framebuffer_create_info{
+        VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
+        nullptr,                                    // pNext
+        0,                                          // flags
+        *render_pass_,                              // renderPass
+        1,                                          // attachmentCount
+        &raw_view,                                  // attachments
+        app()->swapchain().width(),                 // width
+        app()->swapchain().height(),                // height
+        1                                           // layers
+    };
+
+    ::VkFramebuffer raw_framebuffer;
+    app()->device()->vkCreateFramebuffer(
+        app()->device(), &framebuffer_create_info, nullptr, &raw_framebuffer);
+    frame_data->framebuffer_ = containers::make_unique<vulkan::VkFramebuffer>(
+        data_->allocator(),
+        vulkan::VkFramebuffer(raw_framebuffer, nullptr, &app()->device()));
+
+    (*frame_data->command_buffer_)
+        ->vkBeginCommandBuffer((*frame_data->command_buffer_),
+                               &sample_application::kBeginCommandBuffer);
+    vulkan::VkCommandBuffer& cmdBuffer = (*frame_data->command_buffer_);
+
+    VkClearValue clear;
+    vulkan::MemoryClear(&clear);
+
+    VkRenderPassBeginInfo pass_begin = {
+        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
+        nullptr,                                   // pNext
+        *render_pass_,                             // renderPass
+        *frame_data->framebuffer_,                 // framebuffer
+        {{0, 0},
+         {app()->swapchain().width(),
+          app()->swapchain().height()}},  // renderArea
+        1,                                // clearValueCount
+        &clear                            // clears
+    };
+
+    cmdBuffer->vkCmdBeginRenderPass(cmdBuffer, &pass_begin,
+                                    VK_SUBPASS_CONTENTS_INLINE);
+
+    cmdBuffer->vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                 *plane_pipeline_);
+    cmdBuffer->vkCmdBindDescriptorSets(
+        cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+        ::VkPipelineLayout(*pipeline_layout_), 0, 1,
+        &frame_data->plane_descriptor_set_->raw_set(), 0, nullptr);
+    cmdBuffer->vkCmdDraw(cmdBuffer, 6, 1, 0, 0);
+    cmdBuffer->vkCmdEndRenderPass(cmdBuffer);
+    texture_->RecordFeedbackBarrier(&cmdBuffer);
+
+    (*frame_data->command_buffer_)
+        ->vkEndCommandBuffer(*frame_data->command_buffer_);
+  }
+
+  virtual void Update(float time_since_last_render) override {
+    time_ += time_since_last_render;
+    UpdateModelData();
+  }
+  virtual void Render(vulkan::VkQueue* queue, size_t frame_index,
+                      VirtualTexturingFrameData* frame_data) override {
+    // Update our uniform buffers.
+    camera_data_->UpdateBuffer(queue, frame_index);
+    model_data_->UpdateBuffer(queue, frame_index);
+    // Page in what the last frame with this index requested.
+    texture_->BeginFrame(queue, frame_index);
+
+    VkSubmitInfo init_submit_info{
+        VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+        nullptr,                        // pNext
+        0,                              // waitSemaphoreCount
+        nullptr,                        // pWaitSemaphores
+        nullptr,                        // pWaitDstStageMask,
+        1,                              // commandBufferCount
+        &(frame_data->command_buffer_->get_command_buffer()),
+        0,       // signalSemaphoreCount
+        nullptr  // pSignalSemaphores
+    };
+
+    app()->render_queue()->vkQueueSubmit(app()->render_queue(), 1,
+                                         &init_submit_info,
+                                         static_cast<VkFence>(VK_NULL_HANDLE));
+  }
+
+ private:
+  // The plane slowly turns and drifts below the camera, so that new pages
+  // keep coming into view and old ones are evicted.
+  void UpdateModelData() {
+    model_data_->data().transform =
+        Mat44::FromTranslationVector(
+            Vector3{8.0f * sinf(time_ * 0.1f), -1.5f,
+                    -4.0f + 8.0f * cosf(time_ * 0.07f)}) *
+        Mat44::FromRotationMatrix(Mat44::RotationY(time_ * 0.05f));
+  }
+
+  struct CameraData {
+    Mat44 projection_matrix;
+  };
+
+  struct ModelData {
+    Mat44 transform;
+  };
+
+  const entry::EntryData* data_;
+  containers::unique_ptr<vulkan::PipelineLayout> pipeline_layout_;
+  containers::unique_ptr<vulkan::VulkanGraphicsPipeline> plane_pipeline_;
+  containers::unique_ptr<vulkan::VkRenderPass> render_pass_;
+  VkDescriptorSetLayoutBinding plane_descriptor_set_layouts_[6];
+  containers::unique_ptr<vulkan::VirtualTexture> texture_;
+  containers::unique_ptr<vulkan::VkSampler> sampler_;
+  float time_ = 0.0f;
+
+  containers::unique_ptr<vulkan::BufferFrameData<CameraData>> camera_data_;
+  containers::unique_ptr<vulkan::BufferFrameData<ModelData>> model_data_;
+};
+
+int main_entry(const entry::EntryData* data) {
+  data->logger()->LogInfo("Application Startup");
+  VirtualTexturingSample sample(data);
+  sample.Initialize();
+
+  while (!sample.should_exit() && !data->WindowClosing()) {
+    sample.ProcessFrame();
+  }
+  sample.WaitIdle();
+
+  data->logger()->LogInfo("Application Shutdown");
+  return 0;
+}
@@ -0,0 +1,64 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#version 450
+
+layout(location = 0) out vec4 out_color;
+layout (location = 0) in vec2 texcoord;
+
+layout(set = 0, binding = 2) uniform sampler default_sampler;
+layout(set = 0, binding = 3) uniform texture2D virtual_texture;
+
+// The layouts of the page table and the feedback of VirtualTexture.
+layout(std430, set = 0, binding = 4) readonly buffer page_table {
+    // The width and height of a page, the number of pages in a row of
+    // level 0, and the first level of the mip tail.
+    uvec4 info;
+    uint min_level[];
+};
+
+layout(std430, set = 0, binding = 5) buffer feedback {
+    uint requested[];
+};
+
+void main() {
+    // The texture is not repeated, so the texture coordinates stay inside
+    // the first and last pages.
+    vec2 uv = clamp(texcoord, vec2(0.0), vec2(0.99999));
+    vec2 lod = textureQueryLod(sampler2D(virtual_texture, default_sampler),
+                               uv);
+    uvec2 size = uvec2(
+        textureSize(sampler2D(virtual_texture, default_sampler), 0));
+
+    // Request the page of the finer level that is sampled. The coarser
+    // levels are requested along with it.
+    uint level = uint(lod.y);
+    if (level < info.w) {
+        uint first_page = 0;
+        for (uint i = 0; i < level; ++i) {
+            uvec2 level_pages = (size >> i) / info.xy;
+            first_page += level_pages.x * level_pages.y;
+        }
+        uvec2 level_pages = (size >> level) / info.xy;
+        uvec2 page = uvec2(uv * vec2(size >> level)) / info.xy;
+        requested[first_page + page.y * level_pages.x + page.x] = 1;
+    }
+
+    // Only sample the levels that are resident here.
+    uvec2 page = uvec2(uv * vec2(size)) / info.xy;
+    float min_lod = float(min_level[page.y * info.z + page.x]);
+    out_color = textureLod(sampler2D(virtual_texture, default_sampler), uv,
+                           max(lod.y, min_lod));
+}
@@ -435,8 +435,12 @@ function(add_vulkan_shared_library target)
   _add_vulkan_library(${target} TYPE SHARED ${ARGN})
 endfunction(add_vulkan_shared_library)
 
+# Converts the given .obj models to c headers. With OPTIMIZE, the native
+# converter reorders the triangles and vertices of every model for the GPU,
+# and with LODS N it adds up to N levels of detail, see
+# cmake/convert_obj_to_c.cpp. The python converter ignores both.
 function(add_model_library target)
-  cmake_parse_arguments(LIB "" "TYPE" "SOURCES" ${ARGN})
+  cmake_parse_arguments(LIB "OPTIMIZE" "TYPE;LODS" "SOURCES" ${ARGN})
 
   if(BUILD_APKS)
     add_custom_target(${target})
@@ -451,24 +455,48 @@ function(add_model_library target)
     set_target_properties(${target} PROPERTIES LIB_DEPS "")
   else()
     set(output_files)
+    set(converter_flags)
+    if(LIB_OPTIMIZE)
+      list(APPEND converter_flags --optimize)
+    endif()
+    if(LIB_LODS)
+      list(APPEND converter_flags --lods ${LIB_LODS})
+    endif()
 
     foreach(model ${LIB_SOURCES})
       get_filename_component(model ${model} ABSOLUTE)
       file(RELATIVE_PATH rel_pos ${CMAKE_CURRENT_SOURCE_DIR} ${model})
+      # Models from other directories, such as standard_models, are
+      # converted next to this library's own.
+      if(rel_pos MATCHES "^\\.\\./")
+        get_filename_component(rel_pos ${model} NAME)
+      endif()
       set(output_file ${CMAKE_CURRENT_BINARY_DIR}/${rel_pos}.h)
       get_filename_component(output_file ${output_file} ABSOLUTE)
       list(APPEND output_files ${output_file})
 
-      add_custom_command(
-        OUTPUT ${CMAKE_CURRENT_BINARY_DIR}/${rel_pos}.h
-        WORKING_DIRECTORY ${CMAKE_CURRENT_SOURCE_DIR}
-        COMMENT "Compiling Model ${model}"
-        DEPENDS ${model}
-        ${VulkanTestApplications_SOURCE_DIR}/cmake/convert_obj_to_c.py
-        COMMAND ${Python3_EXECUTABLE}
-        ${VulkanTestApplications_SOURCE_DIR}/cmake/convert_obj_to_c.py
-        ${model} -o ${output_file}
-      )
+      # The native converter cannot run when cross-compiling, so fall back
+      # to the python one there.
+      if(TARGET convert_obj_to_c)
+        add_custom_command(
+          OUTPUT ${CMAKE_CURRENT_BINARY_DIR}/${rel_pos}.h
+          WORKING_DIRECTORY ${CMAKE_CURRENT_SOURCE_DIR}
+          COMMENT "Compiling Model ${model}"
+          DEPENDS ${model} convert_obj_to_c
+          COMMAND convert_obj_to_c ${model} -o ${output_file} ${converter_flags}
+        )
+      else()
+        add_custom_command(
+          OUTPUT ${CMAKE_CURRENT_BINARY_DIR}/${rel_pos}.h
+          WORKING_DIRECTORY ${CMAKE_CURRENT_SOURCE_DIR}
+          COMMENT "Compiling Model ${model}"
+          DEPENDS ${model}
+          ${VulkanTestApplications_SOURCE_DIR}/cmake/convert_obj_to_c.py
+          COMMAND ${Python3_EXECUTABLE}
+          ${VulkanTestApplications_SOURCE_DIR}/cmake/convert_obj_to_c.py
+          ${model} -o ${output_file}
+        )
+      endif()
     endforeach()
 
     add_custom_target(${target}
@@ -572,8 +600,12 @@ function(add_shader_library target)
   endif()
 endfunction()
 
+# Converts the given images to c headers. With MIPMAPS, the headers also hold
+# every smaller mip level of each image. With COMPRESS, the images are block
+# compressed, to ETC2 on Android and to BC elsewhere. With SRGB, color images
+# are sRGB encoded, filtered in linear space and use _SRGB formats.
 function(add_texture_library target)
-  cmake_parse_arguments(LIB "" "TYPE" "SOURCES" ${ARGN})
+  cmake_parse_arguments(LIB "MIPMAPS;COMPRESS;SRGB" "TYPE" "SOURCES" ${ARGN})
 
   if(BUILD_APKS)
     add_custom_target(${target})
@@ -588,6 +620,20 @@ function(add_texture_library target)
     set_target_properties(${target} PROPERTIES LIB_DEPS "")
   else()
     set(output_files)
+    set(converter_flags)
+    if(LIB_MIPMAPS)
+      list(APPEND converter_flags --mipmaps)
+    endif()
+    if(LIB_COMPRESS)
+      if(ANDROID)
+        list(APPEND converter_flags --compress etc2)
+      else()
+        list(APPEND converter_flags --compress bc)
+      endif()
+    endif()
+    if(LIB_SRGB)
+      list(APPEND converter_flags --srgb)
+    endif()
 
     foreach(texture ${LIB_SOURCES})
       get_filename_component(texture ${texture} ABSOLUTE)
@@ -604,7 +650,7 @@ function(add_texture_library target)
         ${VulkanTestApplications_SOURCE_DIR}/cmake/convert_img_to_c.py
         COMMAND ${Python3_EXECUTABLE}
         ${VulkanTestApplications_SOURCE_DIR}/cmake/convert_img_to_c.py
-        ${texture} -o ${output_file}
+        ${texture} -o ${output_file} ${converter_flags}
       )
     endforeach()
 
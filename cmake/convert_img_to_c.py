@@ -26,14 +26,403 @@ struct {
  {{data_0}, {data_1}, {data_2} ...}
 };
 
+With --mipmaps a "size_t mip_levels;" member follows the height, and data
+holds the full mip chain, from the largest level to the 1x1 one.
+
+With --compress bc or --compress etc2, 8 bit images are block compressed, and
+data holds the bytes of the blocks of every level. BC1, BC3 and BC4 are meant
+for desktop GPUs, ETC2 and EAC for mobile ones.
+
+With --srgb, the color channels of RGB and RGBA images are taken to be sRGB
+encoded. Their mip levels are then filtered in linear space, and the format
+is an _SRGB one, so that the GPU samples them in linear space too. Single
+channel images, and every image without --srgb, are filtered as stored and
+use _UNORM formats.
 """
 
 import argparse
+import bisect
 import sys
 import re
 from PIL import Image
 
 
+def srgb_to_linear(value):
+    c = value / 255.0
+    if c <= 0.04045:
+        return c / 12.92
+    return ((c + 0.055) / 1.055) ** 2.4
+
+
+def linear_to_srgb(value):
+    if value <= 0.0031308:
+        c = value * 12.92
+    else:
+        c = 1.055 * (value ** (1.0 / 2.4)) - 0.055
+    return int(round(min(max(c, 0.0), 1.0) * 255.0))
+
+
+def downsample(pixels, width, height, mode, srgb):
+    """Halves a level, given as a list of rows of pixels, with a box filter.
+
+    If |srgb| is set, the color channels are sRGB encoded, so they are
+    averaged in linear space. Odd sizes repeat their last row or column.
+    """
+    is_srgb = srgb and mode in srgb_modes
+    new_width = max(width // 2, 1)
+    new_height = max(height // 2, 1)
+    level = []
+    for y in range(0, new_height):
+        row = []
+        for x in range(0, new_width):
+            samples = [
+                pixels[min(2 * y + j, height - 1)][min(2 * x + i, width - 1)]
+                for j in range(0, 2) for i in range(0, 2)]
+            if not isinstance(samples[0], tuple):
+                samples = [(s,) for s in samples]
+            pixel = []
+            for c in range(0, len(samples[0])):
+                # Alpha is never sRGB encoded.
+                if is_srgb and c != 3:
+                    pixel.append(linear_to_srgb(
+                        sum(srgb_to_linear(s[c]) for s in samples) / 4.0))
+                elif mode == "F":
+                    pixel.append(sum(s[c] for s in samples) / 4.0)
+                else:
+                    pixel.append(int(round(sum(s[c] for s in samples) / 4.0)))
+            row.append(tuple(pixel) if len(pixel) > 1 else pixel[0])
+        level.append(row)
+    return level, new_width, new_height
+
+
+# The image modes whose color channels --srgb applies to.
+srgb_modes = ("RGB", "RGBA")
+
+# The formats of the images of those modes with --srgb.
+srgb_types = {
+    "VK_FORMAT_R8G8B8A8_UNORM": "VK_FORMAT_R8G8B8A8_SRGB",
+    "VK_FORMAT_BC1_RGB_UNORM_BLOCK": "VK_FORMAT_BC1_RGB_SRGB_BLOCK",
+    "VK_FORMAT_BC3_UNORM_BLOCK": "VK_FORMAT_BC3_SRGB_BLOCK",
+    "VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK": "VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK",
+    "VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK":
+        "VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK",
+}
+
+
+# The block compressed format of every image mode, for each --compress target.
+compressed_types = {
+    "bc": {
+        "1": "VK_FORMAT_BC4_UNORM_BLOCK",
+        "L": "VK_FORMAT_BC4_UNORM_BLOCK",
+        "RGB": "VK_FORMAT_BC1_RGB_UNORM_BLOCK",
+        "RGBA": "VK_FORMAT_BC3_UNORM_BLOCK",
+    },
+    "etc2": {
+        "1": "VK_FORMAT_EAC_R11_UNORM_BLOCK",
+        "L": "VK_FORMAT_EAC_R11_UNORM_BLOCK",
+        "RGB": "VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK",
+        "RGBA": "VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK",
+    },
+}
+
+
+def color_distance(a, b):
+    return sum((a[c] - b[c]) * (a[c] - b[c]) for c in range(0, 3))
+
+
+def encode_bc1(colors):
+    """Encodes 16 RGB colors as a BC1 block in four color mode.
+
+    The end points are the extremes of the colors along their principal axis.
+    """
+    mean = [sum(p[c] for p in colors) / 16.0 for c in range(0, 3)]
+    covariance = [[sum((p[i] - mean[i]) * (p[j] - mean[j]) for p in colors)
+                   for j in range(0, 3)] for i in range(0, 3)]
+    axis = [1.0, 1.0, 1.0]
+    for _ in range(0, 8):
+        axis = [sum(covariance[i][j] * axis[j] for j in range(0, 3))
+                for i in range(0, 3)]
+        length = max(abs(a) for a in axis)
+        if length == 0.0:
+            axis = [1.0, 1.0, 1.0]
+            break
+        axis = [a / length for a in axis]
+    projections = [sum((p[c] - mean[c]) * axis[c] for c in range(0, 3))
+                   for p in colors]
+    end_points = [colors[projections.index(max(projections))],
+                  colors[projections.index(min(projections))]]
+
+    def to_565(p):
+        return (int(round(p[0] * 31 / 255.0)) << 11 |
+                int(round(p[1] * 63 / 255.0)) << 5 |
+                int(round(p[2] * 31 / 255.0)))
+
+    def from_565(c):
+        r, g, b = (c >> 11) & 0x1f, (c >> 5) & 0x3f, c & 0x1f
+        return ((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2))
+
+    c0, c1 = to_565(end_points[0]), to_565(end_points[1])
+    if c0 < c1:
+        c0, c1 = c1, c0
+    p0, p1 = from_565(c0), from_565(c1)
+    palette = [p0, p1,
+               tuple((2 * p0[c] + p1[c]) // 3 for c in range(0, 3)),
+               tuple((p0[c] + 2 * p1[c]) // 3 for c in range(0, 3))]
+    indices = 0
+    if c0 != c1:
+        for i, p in enumerate(colors):
+            distances = [color_distance(p, q) for q in palette]
+            indices |= distances.index(min(distances)) << (2 * i)
+    return bytes([c0 & 0xff, c0 >> 8, c1 & 0xff, c1 >> 8,
+                  indices & 0xff, (indices >> 8) & 0xff,
+                  (indices >> 16) & 0xff, indices >> 24])
+
+
+def encode_bc4(values):
+    """Encodes 16 values as a BC4 block, or as the alpha block of BC3."""
+    r0, r1 = max(values), min(values)
+    palette = [r0, r1] + [((7 - i) * r0 + i * r1 + 3) // 7
+                          for i in range(1, 7)]
+    indices = 0
+    if r0 != r1:
+        for i, v in enumerate(values):
+            distances = [abs(v - q) for q in palette]
+            indices |= distances.index(min(distances)) << (3 * i)
+    return bytes([r0, r1] + [(indices >> (8 * i)) & 0xff
+                             for i in range(0, 6)])
+
+
+etc1_modifiers = [(2, 8), (5, 17), (9, 29), (13, 42), (18, 60), (24, 80),
+                  (33, 106), (47, 183)]
+
+
+def encode_etc1(colors):
+    """Encodes 16 RGB colors, in rows, as an ETC2 block.
+
+    Only the individual and differential modes that ETC2 shares with ETC1
+    are used, with the average colors of the sub-blocks as their base colors.
+    """
+    best = None
+    for flip in range(0, 2):
+        subblocks = [[], []]
+        for i, p in enumerate(colors):
+            x, y = i % 4, i // 4
+            subblocks[(y if flip else x) // 2].append((x, y, p))
+        averages = [[sum(p[c] for (_, _, p) in subblock) / 8.0
+                     for c in range(0, 3)] for subblock in subblocks]
+
+        candidates = []
+        quantized = [[int(round(a[c] * 31 / 255.0)) for c in range(0, 3)]
+                     for a in averages]
+        deltas = [quantized[1][c] - quantized[0][c] for c in range(0, 3)]
+        if all(-4 <= d <= 3 for d in deltas):
+            bases = [[(q[c] << 3) | (q[c] >> 2) for c in range(0, 3)]
+                     for q in quantized]
+            high = 0x2
+            for c in range(0, 3):
+                high |= (quantized[0][c] << (27 - 8 * c) |
+                         (deltas[c] & 0x7) << (24 - 8 * c))
+            candidates.append((bases, high))
+        quantized = [[int(round(a[c] * 15 / 255.0)) for c in range(0, 3)]
+                     for a in averages]
+        bases = [[(q[c] << 4) | q[c] for c in range(0, 3)] for q in quantized]
+        high = 0
+        for c in range(0, 3):
+            high |= (quantized[0][c] << (28 - 8 * c) |
+                     quantized[1][c] << (24 - 8 * c))
+        candidates.append((bases, high))
+
+        for bases, high in candidates:
+            error = 0
+            low = 0
+            for s in range(0, 2):
+                # The modifier is added to every channel, so the error of a
+                # texel splits into its error along the gray axis, which is
+                # that of its average offset from the base, and its error
+                # across it, which is the same for every modifier. The table
+                # is picked by the former alone, which is exact unless the
+                # decoded colors are clamped.
+                base_sum = sum(bases[s])
+                offsets = [(sum(p) - base_sum) / 3.0
+                           for (_, _, p) in subblocks[s]]
+                magnitudes = [abs(offset) for offset in offsets]
+                best_table = None
+                for table in range(0, 8):
+                    a, b = etc1_modifiers[table]
+                    threshold = (a + b) / 2.0
+                    table_error = sum(
+                        (d - a) * (d - a) if d < threshold else
+                        (d - b) * (d - b) for d in magnitudes)
+                    if best_table is None or table_error < best_table[0]:
+                        best_table = (table_error, table)
+                table = best_table[1]
+                a, b = etc1_modifiers[table]
+                threshold = (a + b) / 2.0
+                modifiers = [a, b, -a, -b]
+                for (x, y, p), offset in zip(subblocks[s], offsets):
+                    index = ((0 if abs(offset) < threshold else 1) |
+                             (0 if offset >= 0 else 2))
+                    error += color_distance(
+                        p, [min(max(bases[s][c] + modifiers[index], 0), 255)
+                            for c in range(0, 3)])
+                    # The indices are stored by column.
+                    i = x * 4 + y
+                    low |= (index >> 1) << (16 + i) | (index & 0x1) << i
+                high |= table << (5 - 3 * s)
+            high |= flip
+            if best is None or error < best[0]:
+                best = (error, high, low)
+    return best[1].to_bytes(4, "big") + best[2].to_bytes(4, "big")
+
+
+eac_modifiers = [
+    [-3, -6, -9, -15, 2, 5, 8, 14], [-3, -7, -10, -13, 2, 6, 9, 12],
+    [-2, -5, -8, -13, 1, 4, 7, 12], [-2, -4, -6, -13, 1, 3, 5, 12],
+    [-3, -6, -8, -12, 2, 5, 7, 11], [-3, -7, -9, -11, 2, 6, 8, 10],
+    [-4, -7, -8, -11, 3, 6, 7, 10], [-3, -5, -8, -11, 2, 4, 7, 10],
+    [-2, -6, -8, -10, 1, 5, 7, 9], [-2, -5, -8, -10, 1, 4, 7, 9],
+    [-2, -4, -8, -10, 1, 3, 7, 9], [-2, -5, -7, -10, 1, 4, 6, 9],
+    [-3, -4, -7, -10, 2, 3, 6, 9], [-1, -2, -3, -10, 0, 1, 2, 9],
+    [-4, -6, -8, -9, 3, 5, 7, 8], [-3, -5, -7, -9, 2, 4, 6, 8]]
+
+
+def encode_eac(values, eleven_bits):
+    """Encodes 16 values, in rows, as an EAC block.
+
+    The block is either the 8 bit alpha of ETC2 RGBA8, or an 11 bit red
+    channel, for which the values are scaled from 8 to 11 bits.
+    """
+    if eleven_bits:
+        targets = [v * 2047 / 255.0 for v in values]
+
+        def decode(base, multiplier, modifier):
+            return min(max(base * 8 + 4 + modifier * multiplier * 8, 0), 2047)
+        scale = 8.0
+    else:
+        targets = values
+
+        def decode(base, multiplier, modifier):
+            return min(max(base + modifier * multiplier, 0), 255)
+        scale = 1.0
+    low, high = min(targets) / scale, max(targets) / scale
+
+    if min(values) == max(values):
+        # Table 13 has a zero modifier, for blocks of a single value.
+        base = int(round(low - 0.5)) if eleven_bits else values[0]
+        return (bytes([min(max(base, 0), 255), 1 << 4 | 13]) +
+                (0x924924924924).to_bytes(6, "big"))
+
+    best = None
+    for table, modifiers in enumerate(eac_modifiers):
+        # The multiplier that stretches the modifiers over the range of the
+        # values, and the base that centers them on it, are close to the
+        # best ones, so only the integers around them are tried.
+        spread = max(modifiers) - min(modifiers)
+        multiplier = int((high - low) / spread)
+        for m in set([min(max(multiplier, 1), 15),
+                      min(max(multiplier + 1, 1), 15)]):
+            center = ((high + low) -
+                      (max(modifiers) + min(modifiers)) * m) / 2.0
+            if eleven_bits:
+                center -= 0.5
+            for base in (int(center), int(center) + 1):
+                if base < 0 or base > 255:
+                    continue
+                # The closest palette entry to a value is found by bisecting
+                # the midpoints between the sorted entries.
+                palette = sorted((decode(base, m, modifier), index)
+                                 for index, modifier in enumerate(modifiers))
+                midpoints = [(palette[i][0] + palette[i + 1][0]) / 2.0
+                             for i in range(0, 7)]
+                error = 0
+                indices = []
+                for t in targets:
+                    q, index = palette[bisect.bisect_left(midpoints, t)]
+                    error += (t - q) * (t - q)
+                    indices.append(index)
+                    if best is not None and error >= best[0]:
+                        break
+                else:
+                    best = (error, base, m, table, indices)
+    _, base, multiplier, table, indices = best
+    bits = 0
+    for x in range(0, 4):
+        for y in range(0, 4):
+            # The indices are stored by column, starting from the top bits.
+            bits = (bits << 3) | indices[y * 4 + x]
+    return bytes([base, multiplier << 4 | table]) + bits.to_bytes(6, "big")
+
+
+def compress_level(texels, width, height, mode, target):
+    """Block compresses a level, given as rows of texels, into bytes.
+
+    Partial blocks at the edges repeat their last row or column.
+    """
+    data = bytearray()
+    # Images often repeat blocks, such as empty areas, which only need to be
+    # compressed once.
+    cache = {}
+    for block_y in range(0, height, 4):
+        for block_x in range(0, width, 4):
+            block = tuple(texels[min(block_y + y, height - 1)]
+                          [min(block_x + x, width - 1)]
+                          for y in range(0, 4) for x in range(0, 4))
+            if block in cache:
+                data += cache[block]
+                continue
+            start = len(data)
+            if mode in ("1", "L"):
+                if target == "bc":
+                    data += encode_bc4(block)
+                else:
+                    data += encode_eac(block, True)
+                cache[block] = bytes(data[start:])
+                continue
+            colors = [p[0:3] for p in block]
+            if mode == "RGBA":
+                alphas = [p[3] for p in block]
+                if target == "bc":
+                    data += encode_bc4(alphas)
+                else:
+                    data += encode_eac(alphas, False)
+            if target == "bc":
+                data += encode_bc1(colors)
+            else:
+                data += encode_etc1(colors)
+            cache[block] = bytes(data[start:])
+    return bytes(data)
+
+
+def write_bytes(f, data):
+    """Writes a level of compressed data, one 8 byte block per line."""
+    for i in range(0, len(data), 8):
+        if i != 0:
+            f.write(",\n")
+        f.write("       ")
+        f.write(", ".join(str(b) for b in data[i:i + 8]))
+
+
+def write_level(f, pixels, width, height):
+    """Writes one level, given as a list of rows of pixels."""
+    for i in range(0, width):
+        if i != 0:
+            f.write(",\n")
+        f.write("       ")
+        for j in range(0, height):
+            if j != 0:
+                f.write(", ")
+            pixel = pixels[j][i]
+            if isinstance(pixel, tuple):
+                f.write("{")
+                for j in range(0, len(pixel)):
+                    if j != 0:
+                        f.write(", ")
+                    f.write(str(pixel[j]))
+                f.write("}")
+            else:
+                f.write(str(pixel))
+
+
 def main():
     parser = argparse.ArgumentParser(
         description='Convert an image file to a c file:' +
@@ -43,6 +432,16 @@ def main():
         '-o', default="", help='output filename (Defaults to input.<ext>.h)')
     parser.add_argument(
         '--verbose', action='store_true', help='enable verbose output')
+    parser.add_argument(
+        '--mipmaps', action='store_true',
+        help='also write every smaller mip level of the image')
+    parser.add_argument(
+        '--compress', choices=['bc', 'etc2'],
+        help='block compress 8 bit images, for desktop (bc) or mobile (etc2)')
+    parser.add_argument(
+        '--srgb', action='store_true',
+        help='treat color images as sRGB: filter mip levels in linear space, '
+             'and write an _SRGB format')
     args = parser.parse_args()
     if not args.o:
         args.o = args.img + ".h"
@@ -81,19 +480,68 @@ def main():
             f.write(" VkFormat format;\n")
             f.write(" size_t width;")
             f.write(" size_t height;")
+
+            # Multiplanar images cannot have mip levels.
+            mipmaps = args.mipmaps and image.mode != "YCbCr"
+            compressed = (args.compress and
+                          image.mode in compressed_types[args.compress])
+            if args.compress and not compressed:
+                print("Cannot compress images of mode " + image.mode)
+            levels = []
+            if image.mode != "YCbCr":
+                width, height = image.size
+                pixels = [[image.getpixel((x, y)) for x in range(0, width)]
+                          for y in range(0, height)]
+                levels.append((pixels, width, height))
+                while mipmaps and (width > 1 or height > 1):
+                    pixels, width, height = downsample(
+                        pixels, width, height, image.mode, args.srgb)
+                    levels.append((pixels, width, height))
+            if mipmaps:
+                f.write(" size_t mip_levels;")
+
+            compressed_levels = []
+            if compressed:
+                for (pixels, width, height) in levels:
+                    # The texels are written by column, and the GPU reads
+                    # them as rows, so that is how they are compressed too.
+                    texels = [pixels[j][i] for i in range(0, width)
+                              for j in range(0, height)]
+                    compressed_levels.append(compress_level(
+                        [texels[y * width:(y + 1) * width]
+                         for y in range(0, height)],
+                        width, height, image.mode, args.compress))
             
             if (image.mode == "YCbCr"):
                 f.write(
                     " " + data_types[image.mode] +
                     " data[" + str(image.size[0] * image.size[1] * 2) + "];\n} texture = { \n")
+            elif compressed:
+                f.write(
+                    " uint8_t data[" +
+                    str(sum(len(level) for level in compressed_levels)) +
+                    "];\n} texture = { \n")
+            elif mipmaps:
+                f.write(
+                    " " + data_types[image.mode] +
+                    " data[" + str(sum(w * h for (_, w, h) in levels)) +
+                    "];\n} texture = { \n")
             else:
                 f.write(
                     " " + data_types[image.mode] +
                     " data[" + str(image.size[0] * image.size[1]) + "];\n} texture = { \n")
             
-            f.write("   " + vulkan_types[image.mode] + ",\n")
+            if compressed:
+                vulkan_type = compressed_types[args.compress][image.mode]
+            else:
+                vulkan_type = vulkan_types[image.mode]
+            if args.srgb and image.mode in srgb_modes:
+                vulkan_type = srgb_types[vulkan_type]
+            f.write("   " + vulkan_type + ",\n")
             f.write("   " + str(image.size[0]) + ",\n")
             f.write("   " + str(image.size[1]) + ",\n")
+            if mipmaps:
+                f.write("   " + str(len(levels)) + ",\n")
             f.write("   {\n")
 
             if (image.mode == "YCbCr"):
@@ -115,23 +563,15 @@ def main():
                     if i != (image_plane_count - 1):
                         f.write(",\n")
             else:
-                for i in range(0, image.size[0]):
-                    if i != 0:
+                for level, (pixels, width, height) in enumerate(levels):
+                    if level != 0:
                         f.write(",\n")
-                    f.write("       ")
-                    for j in range(0, image.size[1]):
-                        if j != 0:
-                            f.write(", ")
-                        pixel = image.getpixel((i, j))
-                        if isinstance(pixel, tuple):
-                            f.write("{")
-                            for j in range(0, len(pixel)):
-                                if j != 0:
-                                    f.write(", ")
-                                f.write(str(pixel[j]))
-                            f.write("}")
-                        else:
-                            f.write(str(pixel))
+                    if compressed:
+                        write_bytes(f, compressed_levels[level])
+                    else:
+                        write_level(f, pixels, width, height)
+                if args.verbose and mipmaps:
+                    print("Wrote {} mip levels".format(len(levels)))
             f.write("\n   }\n")
             f.write("};\n")
     except IOError as err:
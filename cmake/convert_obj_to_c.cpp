@@ -0,0 +1,683 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This turns a .obj file into a c header, in the same layout as
+// convert_obj_to_c.py:
+//
+// const struct {
+//   size_t num_vertices;
+//   float positions[num_vertices * 3];
+//   float uv[num_vertices * 2];
+//   float normals[num_vertices * 3];
+//   size_t num_indices;
+//   uint32_t indices[num_indices];
+// } model = { ... };
+//
+// Unlike the python script it accepts any polygon, which is triangulated as a
+// fan, and faces without texture coordinates or normals. Missing texture
+// coordinates are 0, and missing normals are the normal of the face.
+// Identical vertices are welded through a hash table, so that this stays
+// linear in the size of the model. Otherwise the output is the same as that of
+// the python script, down to how the numbers are written.
+//
+// With --binary it writes the binary model format described in
+// vulkan_helpers/model_file.h instead, which VulkanModel can load at runtime.
+//
+// With --optimize the triangles are reordered for the vertex cache and for
+// less overdraw, and the vertices for sequential fetches, see
+// mesh_optimizer.h. --verbose then prints the ACMR and ATVR before and after.
+//
+// With --lods N up to N levels of detail are written, each with about half
+// the triangles of the one before, see mesh_optimizer::Simplify. They all use
+// the same vertices, and their indices follow those of the full model. In c
+// headers num_indices then counts the indices of all levels, and the struct
+// ends with
+//   size_t num_lods;
+//   struct { uint32_t first_index; uint32_t index_count; float error; }
+//       lods[num_lods];
+// Nothing is added if no simplified level was worth keeping.
+//
+// Usage: convert_obj_to_c input.obj [-o output] [--binary] [--optimize]
+//                         [--lods N] [--verbose]
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mesh_optimizer.h"
+#include "vulkan_helpers/model_file.h"
+
+namespace {
+
+struct Vertex {
+  float position[3];
+  float uv[2];
+  float normal[3];
+};
+static_assert(sizeof(Vertex) == sizeof(float) * 8,
+              "Vertex must not contain padding, it is read as a float array");
+
+// A vertex as it was written in the .obj file. Vertices are welded and
+// written to c headers at this precision, like the python script does, so
+// that both write the same headers.
+struct SourceVertex {
+  double position[3];
+  double uv[2];
+  double normal[3];
+
+  // Compares values rather than bits, so -0 and 0 are welded together.
+  bool operator==(const SourceVertex& other) const {
+    return std::equal(position, position + 3, other.position) &&
+           std::equal(uv, uv + 2, other.uv) &&
+           std::equal(normal, normal + 3, other.normal);
+  }
+
+  Vertex ToVertex() const {
+    Vertex vertex;
+    for (size_t i = 0; i < 3; ++i) {
+      vertex.position[i] = static_cast<float>(position[i]);
+      vertex.normal[i] = static_cast<float>(normal[i]);
+    }
+    for (size_t i = 0; i < 2; ++i) {
+      vertex.uv[i] = static_cast<float>(uv[i]);
+    }
+    return vertex;
+  }
+};
+
+struct SourceVertexHash {
+  size_t operator()(const SourceVertex& vertex) const {
+    // FNV-1a over the bytes of the values. Adding 0 turns -0 into 0, as they
+    // compare equal.
+    uint64_t hash = 14695981039346656037ull;
+    auto add = [&hash](const double* values, size_t count) {
+      for (size_t i = 0; i < count; ++i) {
+        const double value = values[i] + 0.0;
+        const unsigned char* bytes =
+            reinterpret_cast<const unsigned char*>(&value);
+        for (size_t j = 0; j < sizeof(value); ++j) {
+          hash = (hash ^ bytes[j]) * 1099511628211ull;
+        }
+      }
+    };
+    add(vertex.position, 3);
+    add(vertex.uv, 2);
+    add(vertex.normal, 3);
+    return static_cast<size_t>(hash);
+  }
+};
+
+// One corner of a face, as 0-based indices into the attribute lists. -1
+// means that the attribute was not given.
+struct Corner {
+  int64_t position;
+  int64_t uv;
+  int64_t normal;
+};
+
+class ObjConverter {
+ public:
+  explicit ObjConverter(const char* filename) : filename_(filename) {}
+
+  // Parses |data|, which must be null-terminated. Returns false and prints
+  // an error if the file is malformed.
+  bool Parse(const char* data) {
+    const char* line = data;
+    size_t line_number = 1;
+    while (*line) {
+      const char* end = line + strcspn(line, "\r\n");
+      if (!ParseLine(line, end)) {
+        fprintf(stderr, "%s:%zu: Could not parse %.*s\n", filename_,
+                line_number, static_cast<int>(end - line), line);
+        return false;
+      }
+      line = end;
+      if (*line == '\r') ++line;
+      if (*line == '\n') ++line;
+      ++line_number;
+    }
+    return true;
+  }
+
+  bool Write(FILE* f) const;
+  bool WriteBinary(FILE* f) const;
+
+  size_t num_vertices() const { return vertices_.size(); }
+  size_t num_indices() const { return indices_.size(); }
+
+  // Adds up to |num_lods| - 1 simplified levels of detail after the full
+  // model. A level is only kept if it has at most 3/4 of the triangles of
+  // the one before. Prints every level if |verbose| is true.
+  void GenerateLods(size_t num_lods, bool verbose) {
+    const std::vector<uint32_t> full(indices_);
+    lods_.assign(1, {0, static_cast<uint32_t>(full.size()), 0.0f, 0});
+    while (lods_.size() < num_lods) {
+      const uint32_t previous = lods_.back().index_count;
+      float error;
+      const std::vector<uint32_t> lod = mesh_optimizer::Simplify(
+          full, vertices_.empty() ? nullptr : vertices_[0].position,
+          vertices_.size(), sizeof(Vertex) / sizeof(float),
+          previous / 6 * 3, &error);
+      if (lod.empty() || lod.size() > previous / 4 * 3) {
+        break;
+      }
+      lods_.push_back({static_cast<uint32_t>(indices_.size()),
+                       static_cast<uint32_t>(lod.size()), error, 0});
+      indices_.insert(indices_.end(), lod.begin(), lod.end());
+    }
+    if (verbose) {
+      for (size_t i = 0; i < lods_.size(); ++i) {
+        printf("%s: LOD %zu, %u triangles, error %g\n", filename_, i,
+               lods_[i].index_count / 3, lods_[i].error);
+      }
+    }
+  }
+
+  // Reorders the triangles and vertices, see mesh_optimizer.h. Every level of
+  // detail is optimized on its own, and the vertices in the order that the
+  // full model uses them. Prints the vertex cache statistics of the full
+  // model before and after if |verbose| is true.
+  void Optimize(bool verbose) {
+    using namespace mesh_optimizer;
+    const size_t num_vertices = vertices_.size();
+    const CacheStatistics before = AnalyzeVertexCache(Lod(0), num_vertices);
+
+    const std::vector<vulkan::ModelLod> lods = Lods();
+    for (size_t i = 0; i < lods.size(); ++i) {
+      std::vector<uint32_t> lod = Lod(i);
+      OptimizeVertexCache(&lod, num_vertices);
+      OptimizeOverdraw(&lod, vertices_.empty() ? nullptr
+                                               : vertices_[0].position,
+                       num_vertices, sizeof(Vertex) / sizeof(float));
+      std::copy(lod.begin(), lod.end(),
+                indices_.begin() + lods[i].first_index);
+    }
+    const std::vector<uint32_t> old_index =
+        OptimizeVertexFetch(&indices_, num_vertices);
+    std::vector<Vertex> vertices(num_vertices);
+    std::vector<SourceVertex> source_vertices(num_vertices);
+    for (size_t i = 0; i < num_vertices; ++i) {
+      vertices[i] = vertices_[old_index[i]];
+      source_vertices[i] = source_vertices_[old_index[i]];
+    }
+    vertices_.swap(vertices);
+    source_vertices_.swap(source_vertices);
+    // The indices in the map are no longer valid.
+    vertex_indices_.clear();
+
+    if (verbose) {
+      const CacheStatistics after = AnalyzeVertexCache(Lod(0), num_vertices);
+      printf("%s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f (%zu entry cache)\n",
+             filename_, before.acmr, after.acmr, before.atvr, after.atvr,
+             kCacheSize);
+    }
+  }
+
+ private:
+  // Returns the levels of detail, which is just the full model unless
+  // GenerateLods added more.
+  std::vector<vulkan::ModelLod> Lods() const {
+    if (!lods_.empty()) {
+      return lods_;
+    }
+    return {{0, static_cast<uint32_t>(indices_.size()), 0.0f, 0}};
+  }
+
+  // Returns the indices of level of detail |i|.
+  std::vector<uint32_t> Lod(size_t i) const {
+    const vulkan::ModelLod lod = Lods()[i];
+    return std::vector<uint32_t>(
+        indices_.begin() + lod.first_index,
+        indices_.begin() + lod.first_index + lod.index_count);
+  }
+
+  static const char* SkipSpace(const char* c) {
+    while (*c == ' ' || *c == '\t') ++c;
+    return c;
+  }
+
+  // Parses |count| numbers from |c|, ignoring anything that follows them.
+  static bool ParseNumbers(const char* c, double* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+      char* next;
+      out[i] = strtod(c, &next);
+      if (next == c) return false;
+      c = next;
+    }
+    return true;
+  }
+
+  // Parses one index of a face corner and turns it into a 0-based index into
+  // a list of |size| elements.
+  static bool ParseIndex(const char** c, size_t size, int64_t* out) {
+    char* next;
+    const long long index = strtoll(*c, &next, 10);
+    if (next == *c) return false;
+    *c = next;
+    *out = index < 0 ? static_cast<int64_t>(size) + index : index - 1;
+    return *out >= 0 && *out < static_cast<int64_t>(size);
+  }
+
+  bool ParseLine(const char* c, const char* end) {
+    c = SkipSpace(c);
+    if (c == end || *c == '#') return true;
+    const size_t keyword_length = strcspn(c, " \t\r\n");
+    const std::string keyword(c, keyword_length);
+    c += keyword_length;
+    if (keyword == "v") {
+      double p[3];
+      if (!ParseNumbers(c, p, 3)) return false;
+      positions_.insert(positions_.end(), p, p + 3);
+    } else if (keyword == "vt") {
+      // The v coordinate is optional.
+      double uv[2] = {0.0, 0.0};
+      if (!ParseNumbers(c, uv, 1)) return false;
+      ParseNumbers(c, uv, 2);
+      uvs_.insert(uvs_.end(), uv, uv + 2);
+    } else if (keyword == "vn") {
+      double n[3];
+      if (!ParseNumbers(c, n, 3)) return false;
+      normals_.insert(normals_.end(), n, n + 3);
+    } else if (keyword == "f") {
+      return ParseFace(c, end);
+    }
+    // Everything else (objects, groups, materials, lines...) does not affect
+    // the output.
+    return true;
+  }
+
+  bool ParseFace(const char* c, const char* end) {
+    corners_.clear();
+    for (c = SkipSpace(c); c != end; c = SkipSpace(c)) {
+      Corner corner = {-1, -1, -1};
+      if (!ParseIndex(&c, positions_.size() / 3, &corner.position)) {
+        return false;
+      }
+      if (*c == '/') {
+        ++c;
+        if (*c != '/' && !ParseIndex(&c, uvs_.size() / 2, &corner.uv)) {
+          return false;
+        }
+        if (*c == '/') {
+          ++c;
+          if (!ParseIndex(&c, normals_.size() / 3, &corner.normal)) {
+            return false;
+          }
+        }
+      }
+      if (c != end && *c != ' ' && *c != '\t') return false;
+      corners_.push_back(corner);
+    }
+    if (corners_.size() < 3) return false;
+
+    double face_normal[3];
+    ComputeFaceNormal(face_normal);
+    for (size_t i = 1; i + 1 < corners_.size(); ++i) {
+      AddVertex(corners_[0], face_normal);
+      AddVertex(corners_[i], face_normal);
+      AddVertex(corners_[i + 1], face_normal);
+    }
+    return true;
+  }
+
+  // Computes the normal of the polygon in corners_ with Newell's method,
+  // which also works for polygons that are not quite planar.
+  void ComputeFaceNormal(double* normal) const {
+    double n[3] = {0.0, 0.0, 0.0};
+    for (size_t i = 0; i < corners_.size(); ++i) {
+      const double* a = &positions_[corners_[i].position * 3];
+      const double* b =
+          &positions_[corners_[(i + 1) % corners_.size()].position * 3];
+      n[0] += (a[1] - b[1]) * (a[2] + b[2]);
+      n[1] += (a[2] - b[2]) * (a[0] + b[0]);
+      n[2] += (a[0] - b[0]) * (a[1] + b[1]);
+    }
+    const double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    for (size_t i = 0; i < 3; ++i) {
+      normal[i] = length > 0.0 ? n[i] / length + 0.0 : 0.0;
+    }
+  }
+
+  void AddVertex(const Corner& corner, const double* face_normal) {
+    SourceVertex vertex;
+    memcpy(vertex.position, &positions_[corner.position * 3],
+           sizeof(vertex.position));
+    if (corner.uv >= 0) {
+      memcpy(vertex.uv, &uvs_[corner.uv * 2], sizeof(vertex.uv));
+    } else {
+      vertex.uv[0] = vertex.uv[1] = 0.0;
+    }
+    memcpy(vertex.normal,
+           corner.normal >= 0 ? &normals_[corner.normal * 3] : face_normal,
+           sizeof(vertex.normal));
+
+    auto inserted = vertex_indices_.insert(
+        std::make_pair(vertex, static_cast<uint32_t>(vertices_.size())));
+    if (inserted.second) {
+      source_vertices_.push_back(vertex);
+      vertices_.push_back(vertex.ToVertex());
+    }
+    indices_.push_back(inserted.first->second);
+  }
+
+  const char* filename_;
+  std::vector<double> positions_;
+  std::vector<double> uvs_;
+  std::vector<double> normals_;
+  std::vector<Corner> corners_;
+
+  // The welded vertices, and the same vertices as floats.
+  std::vector<SourceVertex> source_vertices_;
+  std::vector<Vertex> vertices_;
+  std::vector<uint32_t> indices_;
+  std::vector<vulkan::ModelLod> lods_;
+  std::unordered_map<SourceVertex, uint32_t, SourceVertexHash>
+      vertex_indices_;
+};
+
+// Writes |value| as the shortest float literal that reads back as exactly
+// |value|. 9 digits are always enough.
+void WriteFloat(FILE* f, float value) {
+  char buffer[32];
+  for (int precision = 6; precision <= 9; ++precision) {
+    snprintf(buffer, sizeof(buffer), "%.*g", precision, value);
+    if (strtof(buffer, nullptr) == value) break;
+  }
+  // 1f is not a valid literal, 1.0f is.
+  if (!strpbrk(buffer, ".e")) {
+    strcat(buffer, ".0");
+  }
+  fputs(buffer, f);
+  fputc('f', f);
+}
+
+// Writes |value| as a float literal the way python's repr() writes it: the
+// shortest decimal that reads back as exactly |value|, in positional notation
+// with at least one fractional digit unless the exponent is below -4 or above
+// 15.
+void WriteNumber(FILE* f, double value) {
+  char buffer[40];
+  for (int precision = 1; precision <= 17; ++precision) {
+    snprintf(buffer, sizeof(buffer), "%.*e", precision - 1, value);
+    if (strtod(buffer, nullptr) == value) break;
+  }
+  // Split "-d.ddde+XX" into the sign, the digits and the exponent.
+  const char* exponent_start = strchr(buffer, 'e');
+  const int exponent = atoi(exponent_start + 1);
+  std::string digits;
+  for (const char* c = buffer; c != exponent_start; ++c) {
+    if (*c >= '0' && *c <= '9') digits += *c;
+  }
+  std::string number = buffer[0] == '-' ? "-" : "";
+  if (exponent < -4 || exponent > 15) {
+    number += digits[0];
+    if (digits.size() > 1) {
+      number += "." + digits.substr(1);
+    }
+    char exponent_text[16];
+    snprintf(exponent_text, sizeof(exponent_text), "e%c%02d",
+             exponent < 0 ? '-' : '+', abs(exponent));
+    number += exponent_text;
+  } else if (exponent < 0) {
+    number += "0." + std::string(-exponent - 1, '0') + digits;
+  } else if (digits.size() > static_cast<size_t>(exponent) + 1) {
+    number += digits.substr(0, exponent + 1) + "." +
+              digits.substr(exponent + 1);
+  } else {
+    number += digits + std::string(exponent + 1 - digits.size(), '0') + ".0";
+  }
+  fputs(number.c_str(), f);
+  fputc('f', f);
+}
+
+bool ObjConverter::Write(FILE* f) const {
+  const size_t num_vertices = vertices_.size();
+  fprintf(f, "const struct {\n");
+  fprintf(f, "    size_t num_vertices;\n");
+  fprintf(f, "    float positions[%zu];\n", num_vertices * 3);
+  fprintf(f, "    float uv[%zu];\n", num_vertices * 2);
+  fprintf(f, "    float normals[%zu];\n", num_vertices * 3);
+  fprintf(f, "    size_t num_indices;\n");
+  fprintf(f, "    uint32_t indices[%zu];\n", indices_.size());
+  if (lods_.size() > 1) {
+    fprintf(f, "    size_t num_lods;\n");
+    fprintf(f, "    struct {\n");
+    fprintf(f, "        uint32_t first_index;\n");
+    fprintf(f, "        uint32_t index_count;\n");
+    fprintf(f, "        float error;\n");
+    fprintf(f, "    } lods[%zu];\n", lods_.size());
+  }
+  fprintf(f, "} model = {\n");
+  fprintf(f, "%zu,\n", num_vertices);
+
+  struct {
+    const char* name;
+    size_t offset;
+    size_t count;
+  } attributes[] = {
+      {"/*positions*/      {", offsetof(SourceVertex, position), 3},
+      {"/*texture_coords*/ {", offsetof(SourceVertex, uv), 2},
+      {"/*normals*/        {", offsetof(SourceVertex, normal), 3},
+  };
+  for (const auto& attribute : attributes) {
+    fputs(attribute.name, f);
+    for (size_t i = 0; i < num_vertices; ++i) {
+      const double* values = reinterpret_cast<const double*>(
+          reinterpret_cast<const char*>(&source_vertices_[i]) +
+          attribute.offset);
+      for (size_t j = 0; j < attribute.count; ++j) {
+        if (i != 0 || j != 0) fputs(", ", f);
+        WriteNumber(f, values[j]);
+      }
+    }
+    fputs("},\n", f);
+  }
+
+  fprintf(f, "%zu,\n", indices_.size());
+  fputs("/*indices*/        {", f);
+  for (size_t i = 0; i < indices_.size(); ++i) {
+    fprintf(f, i == 0 ? "%u" : ", %u", indices_[i]);
+  }
+  fputs("}", f);
+  if (lods_.size() > 1) {
+    fprintf(f, ",\n%zu,\n", lods_.size());
+    fputs("/*lods*/           {", f);
+    for (size_t i = 0; i < lods_.size(); ++i) {
+      fprintf(f, i == 0 ? "{%u, %u, " : ", {%u, %u, ", lods_[i].first_index,
+              lods_[i].index_count);
+      WriteFloat(f, lods_[i].error);
+      fputs("}", f);
+    }
+    fputs("}", f);
+  }
+  fputs("\n};\n", f);
+  fputs("#ifndef _WIN32\n", f);
+  fprintf(f,
+          "static_assert(model.positions + %zu == model.uv, "
+          "\"Memory layout is not as expected\");\n",
+          num_vertices * 3);
+  fprintf(f,
+          "static_assert(model.uv + %zu == model.normals, "
+          "\"Memory layout is not as expected\");\n",
+          num_vertices * 2);
+  fputs("#endif\n", f);
+  return !ferror(f);
+}
+
+bool ObjConverter::WriteBinary(FILE* f) const {
+  const uint64_t num_vertices = vertices_.size();
+  const uint64_t num_indices = indices_.size();
+  const std::vector<vulkan::ModelLod> lods = Lods();
+  // 0xFFFF is left out, as it restarts primitives if that is enabled.
+  const uint32_t index_size = num_vertices < 0xFFFF ? 2 : 4;
+  auto align = [](uint64_t offset) {
+    return (offset + vulkan::kModelFileStreamAlignment - 1) &
+           ~(vulkan::kModelFileStreamAlignment - 1);
+  };
+
+  vulkan::ModelFileHeader header = {};
+  memcpy(header.magic, vulkan::kModelFileMagic, sizeof(header.magic));
+  header.version = vulkan::kModelFileVersion;
+  header.num_vertices = num_vertices;
+  header.num_indices = num_indices;
+  header.index_size = index_size;
+  header.num_lods = static_cast<uint32_t>(lods.size());
+  header.positions_offset = align(sizeof(header));
+  header.texture_coords_offset =
+      align(header.positions_offset + num_vertices * sizeof(float) * 3);
+  header.normals_offset =
+      align(header.texture_coords_offset + num_vertices * sizeof(float) * 2);
+  header.indices_offset =
+      align(header.normals_offset + num_vertices * sizeof(float) * 3);
+  header.lods_offset = align(header.indices_offset + num_indices * index_size);
+  header.file_size = header.lods_offset + lods.size() * sizeof(lods[0]);
+
+  uint64_t written = 0;
+  auto write = [f, &written](const void* data, size_t size) {
+    written += fwrite(data, 1, size, f);
+  };
+  auto pad_to = [&write, &written](uint64_t offset) {
+    static const char zeros[vulkan::kModelFileStreamAlignment] = {};
+    write(zeros, static_cast<size_t>(offset - written));
+  };
+
+  write(&header, sizeof(header));
+  const struct {
+    uint64_t offset;
+    size_t member_offset;
+    size_t count;
+  } streams[] = {
+      {header.positions_offset, offsetof(Vertex, position), 3},
+      {header.texture_coords_offset, offsetof(Vertex, uv), 2},
+      {header.normals_offset, offsetof(Vertex, normal), 3},
+  };
+  for (const auto& stream : streams) {
+    pad_to(stream.offset);
+    for (const Vertex& vertex : vertices_) {
+      write(reinterpret_cast<const char*>(&vertex) + stream.member_offset,
+            sizeof(float) * stream.count);
+    }
+  }
+  pad_to(header.indices_offset);
+  if (index_size == 2) {
+    std::vector<uint16_t> indices(indices_.begin(), indices_.end());
+    write(indices.data(), indices.size() * sizeof(uint16_t));
+  } else {
+    write(indices_.data(), indices_.size() * sizeof(uint32_t));
+  }
+  pad_to(header.lods_offset);
+  write(lods.data(), lods.size() * sizeof(lods[0]));
+  return !ferror(f) && written == header.file_size;
+}
+
+// Reads all of |filename| into |data|, followed by a null terminator.
+bool ReadFile(const char* filename, std::vector<char>* data) {
+  FILE* f = fopen(filename, "rb");
+  if (!f) {
+    fprintf(stderr, "Could not open %s\n", filename);
+    return false;
+  }
+  char buffer[1 << 16];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+    data->insert(data->end(), buffer, buffer + read);
+  }
+  const bool success = !ferror(f);
+  fclose(f);
+  data->push_back('\0');
+  if (!success) {
+    fprintf(stderr, "Could not read %s\n", filename);
+  }
+  return success;
+}
+
+}  // anonymous namespace
+
+int main(int argc, char** argv) {
+  const char* input = nullptr;
+  std::string output;
+  bool verbose = false;
+  bool binary = false;
+  bool optimize = false;
+  size_t num_lods = 1;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      output = argv[++i];
+    } else if (strcmp(argv[i], "--verbose") == 0) {
+      verbose = true;
+    } else if (strcmp(argv[i], "--binary") == 0) {
+      binary = true;
+    } else if (strcmp(argv[i], "--optimize") == 0) {
+      optimize = true;
+    } else if (strcmp(argv[i], "--lods") == 0 && i + 1 < argc &&
+               atoi(argv[i + 1]) > 0) {
+      num_lods = static_cast<size_t>(atoi(argv[++i]));
+    } else if (!input && argv[i][0] != '-') {
+      input = argv[i];
+    } else {
+      input = nullptr;
+      break;
+    }
+  }
+  if (!input) {
+    fprintf(stderr,
+            "Usage: %s input.obj [-o output] [--binary] [--optimize] "
+            "[--lods N] [--verbose]\n",
+            argv[0]);
+    return 1;
+  }
+  if (output.empty()) {
+    output = std::string(input) + (binary ? ".model" : ".h");
+  }
+
+  std::vector<char> data;
+  if (!ReadFile(input, &data)) {
+    return 1;
+  }
+  ObjConverter converter(input);
+  if (!converter.Parse(data.data())) {
+    return 1;
+  }
+  if (num_lods > 1) {
+    converter.GenerateLods(num_lods, verbose);
+  }
+  if (optimize) {
+    converter.Optimize(verbose);
+  }
+
+  FILE* f = fopen(output.c_str(), binary ? "wb" : "w");
+  if (!f) {
+    fprintf(stderr, "Could not open %s\n", output.c_str());
+    return 1;
+  }
+  const bool success = binary ? converter.WriteBinary(f) : converter.Write(f);
+  if (fclose(f) != 0 || !success) {
+    fprintf(stderr, "Could not write %s\n", output.c_str());
+    remove(output.c_str());
+    return 1;
+  }
+  if (verbose) {
+    printf("%s: %zu vertices, %zu indices\n", input,
+           converter.num_vertices(), converter.num_indices());
+  }
+  return 0;
+}
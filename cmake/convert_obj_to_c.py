@@ -55,6 +55,7 @@ def main():
     normals = []
     faces = []
     vertices = []
+    vertex_indices = {}
     indices = []
 
     number = r'(-?\d+(?:.\d+)?(?:e-?\d+)?)'
@@ -126,11 +127,10 @@ def main():
                          normals[face_verts[2][2] - 1])
                     ]
                     for cfv in constructed_face_verts:
-                        if cfv in vertices:
-                            indices.append(vertices.index(cfv))
-                        else:
+                        if cfv not in vertex_indices:
+                            vertex_indices[cfv] = len(vertices)
                             vertices.append(cfv)
-                            indices.append(len(vertices) - 1)
+                        indices.append(vertex_indices[cfv])
         with open(args.o, "w") as f:
             num_vertices = len(vertices)
             f.write("const struct {\n")
@@ -0,0 +1,566 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace mesh_optimizer {
+namespace {
+const uint32_t kInvalid = ~0u;
+
+// A FIFO vertex cache, as used by most GPUs.
+class VertexCache {
+ public:
+  VertexCache(size_t num_vertices, size_t cache_size)
+      : cache_size_(cache_size), timestamps_(num_vertices, 0), time_(0) {}
+
+  // Returns true if |vertex| missed the cache, and puts it in the cache.
+  bool Access(uint32_t vertex) {
+    // A vertex is in the cache if fewer than cache_size_ other vertices
+    // entered it since it did.
+    if (timestamps_[vertex] != 0 &&
+        time_ - timestamps_[vertex] < cache_size_) {
+      return false;
+    }
+    timestamps_[vertex] = ++time_;
+    return true;
+  }
+
+  void Clear() { time_ += cache_size_; }
+
+ private:
+  size_t cache_size_;
+  std::vector<size_t> timestamps_;
+  size_t time_;
+};
+
+// For every vertex, the triangles that use it, as offsets into one array.
+struct Adjacency {
+  Adjacency(const std::vector<uint32_t>& indices, size_t num_vertices)
+      : offsets(num_vertices + 1, 0), triangles(indices.size()) {
+    for (uint32_t index : indices) {
+      ++offsets[index + 1];
+    }
+    for (size_t i = 0; i < num_vertices; ++i) {
+      offsets[i + 1] += offsets[i];
+    }
+    std::vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); ++i) {
+      triangles[next[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+  }
+
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> triangles;
+};
+
+// The sum of the squared distances to a set of planes, weighted by area, as
+// the 10 distinct values of a symmetric 4x4 matrix.
+struct Quadric {
+  double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+  double weight;
+
+  // Adds the plane through |p| with the unit |normal|.
+  void AddPlane(const double* normal, const float* p, double area) {
+    const double a = normal[0], b = normal[1], c = normal[2];
+    const double d = -(a * p[0] + b * p[1] + c * p[2]);
+    a2 += a * a * area;
+    ab += a * b * area;
+    ac += a * c * area;
+    ad += a * d * area;
+    b2 += b * b * area;
+    bc += b * c * area;
+    bd += b * d * area;
+    c2 += c * c * area;
+    cd += c * d * area;
+    d2 += d * d * area;
+    weight += area;
+  }
+
+  void Add(const Quadric& other) {
+    a2 += other.a2;
+    ab += other.ab;
+    ac += other.ac;
+    ad += other.ad;
+    b2 += other.b2;
+    bc += other.bc;
+    bd += other.bd;
+    c2 += other.c2;
+    cd += other.cd;
+    d2 += other.d2;
+    weight += other.weight;
+  }
+
+  // Returns the mean squared distance of |p| to the planes.
+  double Error(const float* p) const {
+    const double x = p[0], y = p[1], z = p[2];
+    const double error = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z +
+                         2 * ad * x + b2 * y * y + 2 * bc * y * z +
+                         2 * bd * y + c2 * z * z + 2 * cd * z + d2;
+    return weight > 0.0 ? std::max(error, 0.0) / weight : 0.0;
+  }
+};
+
+// Returns the unnormalized normal of the triangle |p0|, |p1|, |p2|.
+void TriangleNormal(const float* p0, const float* p1, const float* p2,
+                    double* normal) {
+  const double e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+  const double e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+  normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+  normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+  normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+// Returns true if vertices |a| and |b| are at the same position.
+bool SamePosition(const float* a, const float* b) {
+  return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+}
+}  // anonymous namespace
+
+CacheStatistics AnalyzeVertexCache(const std::vector<uint32_t>& indices,
+                                   size_t num_vertices, size_t cache_size) {
+  VertexCache cache(num_vertices, cache_size);
+  size_t misses = 0;
+  for (uint32_t index : indices) {
+    misses += cache.Access(index) ? 1 : 0;
+  }
+  CacheStatistics statistics = {0.0f, 0.0f};
+  if (!indices.empty()) {
+    statistics.acmr = static_cast<float>(misses) / (indices.size() / 3);
+    statistics.atvr = static_cast<float>(misses) / num_vertices;
+  }
+  return statistics;
+}
+
+void OptimizeVertexCache(std::vector<uint32_t>* indices, size_t num_vertices,
+                         size_t cache_size) {
+  const size_t num_triangles = indices->size() / 3;
+  const std::vector<uint32_t>& in = *indices;
+  Adjacency adjacency(in, num_vertices);
+
+  // The number of triangles that use each vertex, and are not emitted yet.
+  std::vector<uint32_t> live(num_vertices);
+  for (size_t i = 0; i < num_vertices; ++i) {
+    live[i] = adjacency.offsets[i + 1] - adjacency.offsets[i];
+  }
+  // When each vertex last entered the cache. Time starts at cache_size + 1
+  // so that no vertex starts in the cache.
+  std::vector<size_t> cache_time(num_vertices, 0);
+  size_t time = cache_size + 1;
+  std::vector<bool> emitted(num_triangles, false);
+  std::vector<uint32_t> dead_end;
+  std::vector<uint32_t> candidates;
+  std::vector<uint32_t> out;
+  out.reserve(in.size());
+  uint32_t next_unused = 0;
+
+  uint32_t fan = num_vertices > 0 ? 0 : kInvalid;
+  while (fan != kInvalid) {
+    // Emit every triangle around the fanning vertex.
+    candidates.clear();
+    for (uint32_t i = adjacency.offsets[fan]; i < adjacency.offsets[fan + 1];
+         ++i) {
+      const uint32_t triangle = adjacency.triangles[i];
+      if (emitted[triangle]) {
+        continue;
+      }
+      emitted[triangle] = true;
+      for (size_t j = 0; j < 3; ++j) {
+        const uint32_t vertex = in[triangle * 3 + j];
+        out.push_back(vertex);
+        dead_end.push_back(vertex);
+        candidates.push_back(vertex);
+        --live[vertex];
+        if (time - cache_time[vertex] > cache_size) {
+          cache_time[vertex] = time++;
+        }
+      }
+    }
+
+    // Continue with the candidate that will still be in the cache once all
+    // of its triangles are emitted, and that entered the cache first.
+    fan = kInvalid;
+    size_t best_priority = 0;
+    for (uint32_t vertex : candidates) {
+      if (live[vertex] == 0) {
+        continue;
+      }
+      size_t priority = 0;
+      if (time - cache_time[vertex] + 2 * live[vertex] <= cache_size) {
+        priority = time - cache_time[vertex];
+      }
+      if (priority > best_priority) {
+        best_priority = priority;
+        fan = vertex;
+      }
+    }
+
+    // Otherwise continue with a recently used vertex, or any vertex that
+    // still has triangles.
+    while (fan == kInvalid && !dead_end.empty()) {
+      const uint32_t vertex = dead_end.back();
+      dead_end.pop_back();
+      if (live[vertex] > 0) {
+        fan = vertex;
+      }
+    }
+    for (; fan == kInvalid && next_unused < num_vertices; ++next_unused) {
+      if (live[next_unused] > 0) {
+        fan = next_unused;
+      }
+    }
+  }
+  indices->swap(out);
+}
+
+void OptimizeOverdraw(std::vector<uint32_t>* indices, const float* positions,
+                      size_t num_vertices, size_t stride, float threshold,
+                      size_t cache_size) {
+  const size_t num_triangles = indices->size() / 3;
+  const std::vector<uint32_t>& in = *indices;
+  if (num_triangles == 0) {
+    return;
+  }
+
+  // Hard boundaries are where all 3 vertices of a triangle miss the cache,
+  // as reordering there cannot make the vertex cache any worse.
+  std::vector<size_t> hard_boundaries;
+  {
+    VertexCache cache(num_vertices, cache_size);
+    for (size_t t = 0; t < num_triangles; ++t) {
+      size_t misses = 0;
+      for (size_t j = 0; j < 3; ++j) {
+        misses += cache.Access(in[t * 3 + j]) ? 1 : 0;
+      }
+      if (t == 0 || misses == 3) {
+        hard_boundaries.push_back(t);
+      }
+    }
+    hard_boundaries.push_back(num_triangles);
+  }
+
+  // Soft boundaries split the clusters further, wherever the cluster so far
+  // is at most |threshold| times worse than the whole mesh.
+  const float acmr = AnalyzeVertexCache(in, num_vertices, cache_size).acmr;
+  std::vector<size_t> clusters;
+  {
+    VertexCache cache(num_vertices, cache_size);
+    for (size_t h = 0; h + 1 < hard_boundaries.size(); ++h) {
+      size_t start = hard_boundaries[h];
+      size_t misses = 0;
+      cache.Clear();
+      clusters.push_back(start);
+      for (size_t t = start; t < hard_boundaries[h + 1]; ++t) {
+        for (size_t j = 0; j < 3; ++j) {
+          misses += cache.Access(in[t * 3 + j]) ? 1 : 0;
+        }
+        const size_t triangles = t + 1 - start;
+        if (t + 1 < hard_boundaries[h + 1] &&
+            misses <= threshold * acmr * triangles) {
+          start = t + 1;
+          misses = 0;
+          cache.Clear();
+          clusters.push_back(start);
+        }
+      }
+    }
+    clusters.push_back(num_triangles);
+  }
+
+  // Clusters that face away from the center of the mesh are likely to occlude
+  // the others, so they are drawn first.
+  const size_t num_clusters = clusters.size() - 1;
+  double mesh_center[3] = {0.0, 0.0, 0.0};
+  double mesh_area = 0.0;
+  std::vector<double> cluster_data(num_clusters * 7, 0.0);
+  for (size_t c = 0; c < num_clusters; ++c) {
+    double* center = &cluster_data[c * 7];
+    double* normal = center + 3;
+    double& area = center[6];
+    for (size_t t = clusters[c]; t < clusters[c + 1]; ++t) {
+      const float* p0 = positions + in[t * 3] * stride;
+      const float* p1 = positions + in[t * 3 + 1] * stride;
+      const float* p2 = positions + in[t * 3 + 2] * stride;
+      const double e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+      const double e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+      const double n[3] = {e1[1] * e2[2] - e1[2] * e2[1],
+                           e1[2] * e2[0] - e1[0] * e2[2],
+                           e1[0] * e2[1] - e1[1] * e2[0]};
+      const double triangle_area =
+          std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]) * 0.5;
+      for (size_t i = 0; i < 3; ++i) {
+        center[i] += (p0[i] + p1[i] + p2[i]) / 3.0 * triangle_area;
+        normal[i] += n[i];
+      }
+      area += triangle_area;
+    }
+    for (size_t i = 0; i < 3; ++i) {
+      mesh_center[i] += center[i];
+    }
+    mesh_area += area;
+  }
+  std::vector<std::pair<double, size_t>> order(num_clusters);
+  for (size_t c = 0; c < num_clusters; ++c) {
+    const double* center = &cluster_data[c * 7];
+    const double* normal = center + 3;
+    const double area = center[6];
+    const double length = std::sqrt(normal[0] * normal[0] +
+                                    normal[1] * normal[1] +
+                                    normal[2] * normal[2]);
+    double sort_key = 0.0;
+    if (area > 0.0 && mesh_area > 0.0 && length > 0.0) {
+      for (size_t i = 0; i < 3; ++i) {
+        sort_key += (center[i] / area - mesh_center[i] / mesh_area) *
+                    normal[i] / length;
+      }
+    }
+    order[c] = std::make_pair(-sort_key, c);
+  }
+  std::stable_sort(order.begin(), order.end());
+
+  std::vector<uint32_t> out;
+  out.reserve(in.size());
+  for (const auto& cluster : order) {
+    out.insert(out.end(), in.begin() + clusters[cluster.second] * 3,
+               in.begin() + clusters[cluster.second + 1] * 3);
+  }
+  indices->swap(out);
+}
+
+std::vector<uint32_t> OptimizeVertexFetch(std::vector<uint32_t>* indices,
+                                          size_t num_vertices) {
+  std::vector<uint32_t> new_index(num_vertices, kInvalid);
+  std::vector<uint32_t> old_index;
+  old_index.reserve(num_vertices);
+  for (uint32_t& index : *indices) {
+    if (new_index[index] == kInvalid) {
+      new_index[index] = static_cast<uint32_t>(old_index.size());
+      old_index.push_back(index);
+    }
+    index = new_index[index];
+  }
+  // Vertices that no triangle uses go at the end.
+  for (uint32_t i = 0; i < num_vertices; ++i) {
+    if (new_index[i] == kInvalid) {
+      old_index.push_back(i);
+    }
+  }
+  return old_index;
+}
+
+std::vector<uint32_t> Simplify(const std::vector<uint32_t>& indices,
+                               const float* positions, size_t num_vertices,
+                               size_t stride, size_t target_index_count,
+                               float* error) {
+  std::vector<uint32_t> result(indices);
+  *error = 0.0f;
+  if (result.size() <= target_index_count) {
+    return result;
+  }
+  auto position = [positions, stride](uint32_t vertex) {
+    return positions + vertex * stride;
+  };
+
+  // Vertices that share their position with another one are locked, and
+  // every other vertex is identified by its position from here on.
+  std::vector<uint32_t> by_position(num_vertices);
+  for (uint32_t i = 0; i < num_vertices; ++i) {
+    by_position[i] = i;
+  }
+  std::sort(by_position.begin(), by_position.end(),
+            [&position](uint32_t a, uint32_t b) {
+              return std::lexicographical_compare(
+                  position(a), position(a) + 3, position(b), position(b) + 3);
+            });
+  std::vector<uint32_t> canonical(num_vertices);
+  std::vector<bool> locked(num_vertices, false);
+  for (size_t i = 0; i < num_vertices;) {
+    size_t end = i + 1;
+    while (end < num_vertices &&
+           SamePosition(position(by_position[i]), position(by_position[end]))) {
+      ++end;
+    }
+    for (size_t j = i; j < end; ++j) {
+      canonical[by_position[j]] = by_position[i];
+      locked[by_position[j]] = end - i > 1;
+    }
+    i = end;
+  }
+
+  // Edges that do not have exactly two triangles are on a border, or are
+  // not manifold.
+  std::vector<uint64_t> edges;
+  edges.reserve(result.size());
+  for (size_t i = 0; i < result.size(); i += 3) {
+    for (size_t j = 0; j < 3; ++j) {
+      const uint64_t a = canonical[result[i + j]];
+      const uint64_t b = canonical[result[i + (j + 1) % 3]];
+      edges.push_back(a < b ? (a << 32) | b : (b << 32) | a);
+    }
+  }
+  std::sort(edges.begin(), edges.end());
+  std::vector<bool> border(num_vertices, false);
+  for (size_t i = 0; i < edges.size();) {
+    size_t end = i + 1;
+    while (end < edges.size() && edges[end] == edges[i]) {
+      ++end;
+    }
+    if (end - i != 2) {
+      border[edges[i] >> 32] = true;
+      border[edges[i] & 0xFFFFFFFF] = true;
+    }
+    i = end;
+  }
+  for (size_t i = 0; i < num_vertices; ++i) {
+    locked[i] = locked[i] || border[canonical[i]];
+  }
+
+  std::vector<Quadric> quadrics(num_vertices, Quadric());
+  for (size_t i = 0; i < result.size(); i += 3) {
+    double normal[3];
+    TriangleNormal(position(result[i]), position(result[i + 1]),
+                   position(result[i + 2]), normal);
+    const double length = std::sqrt(normal[0] * normal[0] +
+                                    normal[1] * normal[1] +
+                                    normal[2] * normal[2]);
+    if (length == 0.0) {
+      continue;
+    }
+    for (size_t j = 0; j < 3; ++j) {
+      normal[j] /= length;
+    }
+    for (size_t j = 0; j < 3; ++j) {
+      quadrics[result[i + j]].AddPlane(normal, position(result[i]),
+                                       length * 0.5);
+    }
+  }
+
+  // Every pass collapses the cheapest edges that do not share any triangles,
+  // and then rebuilds the mesh, until the target is met or nothing can be
+  // collapsed any more.
+  struct Collapse {
+    double cost;
+    uint32_t from;
+    uint32_t to;
+    bool operator<(const Collapse& other) const { return cost < other.cost; }
+  };
+  const size_t target_triangles = target_index_count / 3;
+  double max_cost = 0.0;
+  std::vector<Collapse> collapses;
+  std::vector<uint32_t> remap(num_vertices);
+  std::vector<bool> touched(num_vertices);
+  while (result.size() / 3 > target_triangles) {
+    collapses.clear();
+    for (size_t i = 0; i < result.size(); i += 3) {
+      for (size_t j = 0; j < 3; ++j) {
+        const uint32_t a = result[i + j];
+        const uint32_t b = result[i + (j + 1) % 3];
+        Quadric q = quadrics[a];
+        q.Add(quadrics[b]);
+        if (!locked[a]) {
+          collapses.push_back({q.Error(position(b)), a, b});
+        }
+        if (!locked[b]) {
+          collapses.push_back({q.Error(position(a)), b, a});
+        }
+      }
+    }
+    if (collapses.empty()) {
+      break;
+    }
+    // Only the cheapest quarter is considered, as the collapses in this pass
+    // make cheaper ones possible for the next.
+    const size_t considered = std::max<size_t>(1, collapses.size() / 4);
+    std::partial_sort(collapses.begin(), collapses.begin() + considered,
+                      collapses.end());
+
+    Adjacency adjacency(result, num_vertices);
+    for (uint32_t i = 0; i < num_vertices; ++i) {
+      remap[i] = i;
+    }
+    std::fill(touched.begin(), touched.end(), false);
+    size_t num_triangles = result.size() / 3;
+    for (size_t c = 0; c < considered && num_triangles > target_triangles;
+         ++c) {
+      const Collapse& collapse = collapses[c];
+      if (touched[collapse.from] || touched[collapse.to]) {
+        continue;
+      }
+      // Moving |from| must not flip any of the triangles that remain.
+      bool flips = false;
+      size_t removed = 0;
+      for (uint32_t i = adjacency.offsets[collapse.from];
+           i < adjacency.offsets[collapse.from + 1] && !flips; ++i) {
+        const uint32_t* triangle = &result[adjacency.triangles[i] * 3];
+        if (triangle[0] == collapse.to || triangle[1] == collapse.to ||
+            triangle[2] == collapse.to) {
+          ++removed;
+          continue;
+        }
+        const float* p[3];
+        const float* moved[3];
+        for (size_t j = 0; j < 3; ++j) {
+          p[j] = position(triangle[j]);
+          moved[j] = triangle[j] == collapse.from ? position(collapse.to)
+                                                  : p[j];
+        }
+        double before[3], after[3];
+        TriangleNormal(p[0], p[1], p[2], before);
+        TriangleNormal(moved[0], moved[1], moved[2], after);
+        flips = before[0] * after[0] + before[1] * after[1] +
+                    before[2] * after[2] <=
+                0.0;
+      }
+      if (flips) {
+        continue;
+      }
+      // Nothing around |from| can collapse again in this pass, so that the
+      // adjacency and the flip test stay valid.
+      for (uint32_t i = adjacency.offsets[collapse.from];
+           i < adjacency.offsets[collapse.from + 1]; ++i) {
+        for (size_t j = 0; j < 3; ++j) {
+          touched[result[adjacency.triangles[i] * 3 + j]] = true;
+        }
+      }
+      remap[collapse.from] = collapse.to;
+      quadrics[collapse.to].Add(quadrics[collapse.from]);
+      num_triangles -= removed;
+      max_cost = std::max(max_cost, collapse.cost);
+    }
+    if (num_triangles == result.size() / 3) {
+      break;
+    }
+
+    std::vector<uint32_t> out;
+    out.reserve(num_triangles * 3);
+    for (size_t i = 0; i < result.size(); i += 3) {
+      const uint32_t a = remap[result[i]];
+      const uint32_t b = remap[result[i + 1]];
+      const uint32_t c = remap[result[i + 2]];
+      if (a != b && b != c && c != a) {
+        out.push_back(a);
+        out.push_back(b);
+        out.push_back(c);
+      }
+    }
+    result.swap(out);
+  }
+  *error = static_cast<float>(std::sqrt(max_cost));
+  return result;
+}
+
+}  // namespace mesh_optimizer
@@ -0,0 +1,83 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CMAKE_MESH_OPTIMIZER_H_
+#define CMAKE_MESH_OPTIMIZER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Offline optimizations of indexed triangle lists, used by convert_obj_to_c
+// with --optimize and --lods. Apart from Simplify, they only change the order
+// of the triangles and the vertices, never the mesh itself.
+namespace mesh_optimizer {
+
+// The size of the FIFO post-transform vertex cache that is optimized for and
+// analyzed with. Most GPUs have at least this many entries.
+const size_t kCacheSize = 16;
+
+struct CacheStatistics {
+  // The average number of cache misses per triangle, between 0.5 for an
+  // ideal large mesh and 3.
+  float acmr;
+  // The average number of cache misses per vertex, 1 is ideal.
+  float atvr;
+};
+
+// Simulates a FIFO vertex cache of |cache_size| entries for |indices|.
+CacheStatistics AnalyzeVertexCache(const std::vector<uint32_t>& indices,
+                                   size_t num_vertices,
+                                   size_t cache_size = kCacheSize);
+
+// Reorders the triangles in |indices| so that consecutive triangles share
+// vertices, using Tipsify from "Fast Triangle Reordering for Vertex Locality
+// and Reduced Overdraw" by Sander, Nehab and Barczak. It runs in linear time.
+void OptimizeVertexCache(std::vector<uint32_t>* indices, size_t num_vertices,
+                         size_t cache_size = kCacheSize);
+
+// Reorders clusters of the triangles in |indices|, which should already be
+// optimized for the vertex cache, so that the clusters that are most likely
+// to occlude the others are drawn first, following the same paper. Clusters
+// are only split where that makes the ACMR at most |threshold| times worse.
+// |positions| holds 3 floats for every vertex, |stride| floats apart.
+void OptimizeOverdraw(std::vector<uint32_t>* indices, const float* positions,
+                      size_t num_vertices, size_t stride,
+                      float threshold = 1.05f,
+                      size_t cache_size = kCacheSize);
+
+// Renumbers the vertices in the order in which |indices| first uses them,
+// so that vertex fetches are as sequential as possible, and rewrites
+// |indices| to match. Returns the old index of every new vertex.
+std::vector<uint32_t> OptimizeVertexFetch(std::vector<uint32_t>* indices,
+                                          size_t num_vertices);
+
+// Returns |indices| simplified to at most |target_index_count| indices, or as
+// close to that as possible, by collapsing edges in the order of the quadric
+// error metric from "Surface Simplification Using Quadric Error Metrics" by
+// Garland and Heckbert. Vertices only ever collapse onto other vertices, so
+// the result uses the same vertices as |indices|. Vertices on open borders,
+// and vertices that share their position with others, such as along texture
+// seams, never move, so that no holes open up. Sets |error| to an estimate of
+// how far the surface moved, in the units of |positions|, which holds 3
+// floats for every vertex, |stride| floats apart.
+std::vector<uint32_t> Simplify(const std::vector<uint32_t>& indices,
+                               const float* positions, size_t num_vertices,
+                               size_t stride, size_t target_index_count,
+                               float* error);
+
+}  // namespace mesh_optimizer
+
+#endif  // CMAKE_MESH_OPTIMIZER_H_
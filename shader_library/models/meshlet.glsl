@@ -0,0 +1,71 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// The meshlets of a VulkanModel whose VulkanModelLayout enables meshlets,
+// as stored in VulkanModel::MeshletBuffer(). All bounds are in model space.
+struct Meshlet {
+    // The center and radius of the bounding sphere.
+    vec4 sphere;
+    // The axis and cutoff of the normal cone.
+    vec4 cone;
+    // first_index, index_count, vertex_count and a reserved value.
+    uvec4 draw;
+};
+
+// Matches VkDrawIndexedIndirectCommand.
+struct DrawIndexedCommand {
+    uint index_count;
+    uint instance_count;
+    uint first_index;
+    int vertex_offset;
+    uint first_instance;
+};
+
+// Returns the planes of the view frustum of |mvp|, in model space, with
+// normals pointing inwards and normalized, so that the distance of a point
+// to a plane is dot(plane.xyz, point) + plane.w.
+void get_frustum_planes(mat4 mvp, out vec4 planes[6]) {
+    mat4 rows = transpose(mvp);
+    planes[0] = rows[3] + rows[0];
+    planes[1] = rows[3] - rows[0];
+    planes[2] = rows[3] + rows[1];
+    planes[3] = rows[3] - rows[1];
+    // Vulkan clips z to [0, w].
+    planes[4] = rows[2];
+    planes[5] = rows[3] - rows[2];
+    for (int i = 0; i < 6; ++i) {
+        planes[i] /= length(planes[i].xyz);
+    }
+}
+
+// Returns true if |meshlet| is entirely outside of the frustum |planes|.
+bool is_meshlet_outside_frustum(Meshlet meshlet, vec4 planes[6]) {
+    for (int i = 0; i < 6; ++i) {
+        if (dot(planes[i].xyz, meshlet.sphere.xyz) + planes[i].w <
+            -meshlet.sphere.w) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Returns true if every triangle of |meshlet| faces away from |camera|,
+// given in model space. This is conservative: it only needs the bounding
+// sphere and the normal cone, and never culls a visible triangle.
+bool is_meshlet_back_facing(Meshlet meshlet, vec3 camera) {
+    vec3 view = meshlet.sphere.xyz - camera;
+    return dot(view, meshlet.cone.xyz) >
+        meshlet.cone.w * length(view) + meshlet.sphere.w;
+}
@@ -13,9 +13,15 @@
  * limitations under the License.
  */
 
+// Define MODEL_OCTAHEDRAL_NORMALS before including this for models whose
+// VulkanModelLayout has octahedral normals.
 layout(location = 0) in vec3 _position;
 layout(location = 1) in vec2 _texture_coord;
+#ifdef MODEL_OCTAHEDRAL_NORMALS
+layout(location = 2) in vec2 _normal;
+#else
 layout(location = 2) in vec3 _normal;
+#endif
 
 vec4 get_position() {
     return vec4(_position, 1.0);
@@ -26,5 +32,15 @@ vec2 get_texcoord() {
 }
 
 vec4 get_normal() {
+#ifdef MODEL_OCTAHEDRAL_NORMALS
+    // Unfold the square back onto the octahedron, and then project that
+    // onto the unit sphere.
+    vec3 normal = vec3(_normal, 1.0 - abs(_normal.x) - abs(_normal.y));
+    float fold = max(-normal.z, 0.0);
+    normal.x += normal.x >= 0.0 ? -fold : fold;
+    normal.y += normal.y >= 0.0 ? -fold : fold;
+    return vec4(normalize(normal), 1.0);
+#else
     return vec4(_normal, 1.0);
+#endif
 }
\ No newline at end of file
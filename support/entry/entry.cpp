@@ -24,6 +24,7 @@
 #include <thread>
 
 #include "support/entry/entry_config.h"
+#include "support/log/async_logger.h"
 #include "support/log/log.h"
 
 #if defined __ANDROID__
@@ -45,29 +46,76 @@ namespace internal {
 void dummy_function() {}
 }  // namespace internal
 
-EntryData::EntryData(containers::Allocator* allocator, uint32_t width,
-                     uint32_t height, bool fixed_timestep,
-                     bool separate_present, int64_t output_frame_index,
-                     const char* output_frame_file, const char* shader_compiler,
-                     bool validation, const char* load_pipeline_cache,
-                     const char* write_pipeline_cache
+namespace {
+containers::unique_ptr<logging::Logger> CreateLogger(
+    containers::Allocator* allocator, const char* log_level, bool async_log,
+    const char* binary_log) {
+  containers::unique_ptr<logging::Logger> log = logging::GetLogger(allocator);
+  if (async_log || binary_log) {
+    log = containers::make_unique<logging::AsyncLogger>(
+        allocator, allocator, std::move(log), binary_log);
+  }
+  logging::Severity severity = logging::Severity::kInfo;
+  if (!logging::GetSeverity(log_level, &severity)) {
+    log->LogError("Unknown log level ", log_level, ", using info");
+  }
+  log->set_min_severity(severity);
+  return log;
+}
+
+std::string StringOrEmpty(const char* value) { return value ? value : ""; }
+
+// Returns the options that are used unless the command line overrides them.
+EntryOptions DefaultEntryOptions() {
+  EntryOptions options;
+  options.width = DEFAULT_WINDOW_WIDTH;
+  options.height = DEFAULT_WINDOW_HEIGHT;
+  options.fixed_timestep = FIXED_TIMESTEP;
+  options.prefer_separate_present = PREFER_SEPARATE_PRESENT;
+  options.output_frame_index = OUTPUT_FRAME;
+  options.output_frame_file = OUTPUT_FILE;
+  options.output_format = OUTPUT_FORMAT;
+  options.shader_compiler = SHADER_COMPILER;
+  options.headless = HEADLESS;
+  options.log_level = LOG_LEVEL;
+  options.async_log = ASYNC_LOG;
+  return options;
+}
+}  // anonymous namespace
+
+EntryData::EntryData(containers::Allocator* allocator,
+                     const EntryOptions& options
 #if defined __ANDROID__
                      ,
                      android_app* app
 #endif
                      )
-    : fixed_timestep_(fixed_timestep),
-      prefer_separate_present_(separate_present),
-      width_(width),
-      height_(height),
-      output_frame_index_(output_frame_index),
-      output_frame_file_(output_frame_file),
-      shader_compiler_(shader_compiler),
-      validation_(validation),
-      log_(logging::GetLogger(allocator)),
+    : fixed_timestep_(options.fixed_timestep),
+      prefer_separate_present_(options.prefer_separate_present),
+      width_(options.width),
+      height_(options.height),
+      output_frame_index_(options.output_frame_index),
+      output_frame_file_(options.output_frame_file),
+      output_frame_count_(options.output_frame_count),
+      output_frame_stride_(options.output_frame_stride),
+      output_format_(options.output_format),
+      shader_compiler_(options.shader_compiler),
+      validation_(options.validation),
+      headless_(options.headless),
+      benchmark_frames_(options.benchmark_frames),
+      benchmark_warmup_frames_(options.benchmark_warmup_frames),
+      benchmark_file_(StringOrEmpty(options.benchmark_file)),
+      gpu_trace_file_(StringOrEmpty(options.gpu_trace_file)),
+      trace_api_calls_(options.trace_api_calls),
+      null_driver_(options.null_driver),
+      log_(CreateLogger(allocator, options.log_level, options.async_log,
+                        options.binary_log)),
       allocator_(allocator),
-      load_pipeline_cache_(load_pipeline_cache ? load_pipeline_cache : ""),
-      write_pipeline_cache_(write_pipeline_cache ? write_pipeline_cache : "")
+      load_pipeline_cache_(StringOrEmpty(options.load_pipeline_cache)),
+      write_pipeline_cache_(StringOrEmpty(options.write_pipeline_cache)),
+      shader_source_dir_(StringOrEmpty(options.shader_source_dir)),
+      shader_cache_dir_(StringOrEmpty(options.shader_cache_dir)),
+      image_dir_(StringOrEmpty(options.image_dir))
 #if defined __ANDROID__
       ,
       native_window_handle_(app->window),
@@ -139,17 +187,8 @@ bool EntryData::WindowClosing() const {
 #if defined __linux__ || defined _WIN32 || \
     defined __APPLE__ && !(defined __ANDROID__)
 struct CommandLineArgs {
-  uint32_t window_width;
-  uint32_t window_height;
-  bool fixed_timestep;
-  bool prefer_separate_present;
-  int32_t output_frame;
-  const char* output_file;
-  const char* shader_compiler;
+  entry::EntryOptions options;
   bool wait_for_debugger;
-  bool validation;
-  const char* load_pipeline_cache;
-  const char* write_pipeline_cache;
 };
 
 void print_usage(const char** argv) {
@@ -161,10 +200,27 @@ void print_usage(const char** argv) {
   std::cerr << "  -fixed                        Simulates the application with a fixed timestep" << std::endl;
   std::cerr << "  -separate-present             Prefers a separate present queue" << std::endl;
   std::cerr << "  -output-frame=<frame>         Dumps the given frame to a file an exits" << std::endl;
+  std::cerr << "  -output-frame-count=<count>   Dumps this many frames, starting at -output-frame" << std::endl;
+  std::cerr << "  -output-frame-stride=<n>      Dumps every n-th frame, starting at -output-frame" << std::endl;
+  std::cerr << "  -output-format=<format>       Sets the format of dumped frames, one of ppm, png, raw or stream" << std::endl;
   std::cerr << "  -load-pipeline-cache=<file>   Loads and uses a pipeline cache from the given location" << std::endl;
   std::cerr << "  -write-pipeline-cache=<file>  Writes the applicaitons pipeline cache to the given location" << std::endl;
   std::cerr << "  -shader-compiler=<string>     Sets the shader compiler to the given one, if the sample could use multiple" << std::endl;
+  std::cerr << "  -shader-source-dir=<dir>      Compiles shaders from the given directory at runtime, if the sample supports it" << std::endl;
+  std::cerr << "  -shader-cache-dir=<dir>       Caches SPIR-V compiled at runtime in the given directory" << std::endl;
+  std::cerr << "  -image-dir=<dir>              Loads images from the given directory at runtime, if the sample supports it" << std::endl;
   std::cerr << "  -validation                   Turns on the validation layers if available" << std::endl;
+  std::cerr << "  -headless                     Renders without a window, using VK_EXT_headless_surface" << std::endl;
+  std::cerr << "  -benchmark=<frames>           Times the given number of frames, writes the results as JSON and exits" << std::endl;
+  std::cerr << "  -benchmark-warmup=<frames>    Renders the given number of frames before -benchmark starts timing" << std::endl;
+  std::cerr << "  -benchmark-file=<file>        Writes the -benchmark results to the given file instead of the log" << std::endl;
+  std::cerr << "  -gpu-trace=<file>             Writes a Chrome trace of CPU and GPU scopes to the given file, if the sample supports it" << std::endl;
+  std::cerr << "  -log-level=<level>            Only logs messages of at least the given level, one of debug, info or error" << std::endl;
+  std::cerr << "  -async-log                    Writes log messages from a background thread" << std::endl;
+  std::cerr << "  -sync-log                     Writes log messages before the logging call returns" << std::endl;
+  std::cerr << "  -binary-log=<file>            Also writes every log message to the given file in a binary format" << std::endl;
+  std::cerr << "  -trace-api-calls              Times every Vulkan call and logs the cost of each entry point per frame on exit" << std::endl;
+  std::cerr << "  -null-driver                  Runs on the built-in CPU-only null driver instead of the system's Vulkan" << std::endl;
   std::cerr << "  -output-file                  Sets the output file for the output-frame argument" << std::endl;
   std::cerr << "  -wait-for-debugger            Forces the application to pause on starup until a debugger is attached" << std::endl;
   std::cerr << "  -help                         Print this help" << std::endl;
@@ -172,39 +228,65 @@ void print_usage(const char** argv) {
 }
 
 void parse_args(CommandLineArgs* args, int argc, const char** argv) {
-  args->window_width = DEFAULT_WINDOW_WIDTH;
-  args->window_height = DEFAULT_WINDOW_HEIGHT;
-  args->fixed_timestep = FIXED_TIMESTEP;
-  args->prefer_separate_present = PREFER_SEPARATE_PRESENT;
-  args->output_frame = OUTPUT_FRAME;
-  args->output_file = OUTPUT_FILE;
-  args->shader_compiler = SHADER_COMPILER;
+  args->options = entry::DefaultEntryOptions();
   args->wait_for_debugger = false;
-  args->validation = false;
-  args->load_pipeline_cache = nullptr;
-  args->write_pipeline_cache = nullptr;
+  entry::EntryOptions& options = args->options;
 
   for (int i = 1; i < argc; ++i) {
     if (strncmp(argv[i], "-w=", 3) == 0) {
-      args->window_width = atoi(argv[i] + 3);
+      options.width = atoi(argv[i] + 3);
     } else if (strncmp(argv[i], "-h=", 3) == 0) {
-      args->window_height = atoi(argv[i] + 3);
+      options.height = atoi(argv[i] + 3);
     } else if (strncmp(argv[i], "-fixed", 6) == 0) {
-      args->fixed_timestep = true;
+      options.fixed_timestep = true;
     } else if (strncmp(argv[i], "-separate-present", 17) == 0) {
-      args->prefer_separate_present = true;
+      options.prefer_separate_present = true;
     } else if (strncmp(argv[i], "-output-frame=", 14) == 0) {
-      args->output_frame = atoi(argv[i] + 14);
+      options.output_frame_index = atoi(argv[i] + 14);
+    } else if (strncmp(argv[i], "-output-frame-count=", 20) == 0) {
+      options.output_frame_count = atoi(argv[i] + 20);
+    } else if (strncmp(argv[i], "-output-frame-stride=", 21) == 0) {
+      options.output_frame_stride = atoi(argv[i] + 21);
+    } else if (strncmp(argv[i], "-output-format=", 15) == 0) {
+      options.output_format = argv[i] + 15;
     } else if (strncmp(argv[i], "-load-pipeline-cache=", 21) == 0) {
-      args->load_pipeline_cache = argv[i] + 21;
+      options.load_pipeline_cache = argv[i] + 21;
     } else if (strncmp(argv[i], "-write-pipeline-cache=", 22) == 0) {
-      args->write_pipeline_cache = argv[i] + 22;
+      options.write_pipeline_cache = argv[i] + 22;
     } else if (strncmp(argv[i], "-validation", 11) == 0) {
-      args->validation = true;
+      options.validation = true;
+    } else if (strncmp(argv[i], "-headless", 9) == 0) {
+      options.headless = true;
+    } else if (strncmp(argv[i], "-benchmark=", 11) == 0) {
+      options.benchmark_frames = atoi(argv[i] + 11);
+    } else if (strncmp(argv[i], "-benchmark-warmup=", 18) == 0) {
+      options.benchmark_warmup_frames = atoi(argv[i] + 18);
+    } else if (strncmp(argv[i], "-benchmark-file=", 16) == 0) {
+      options.benchmark_file = argv[i] + 16;
+    } else if (strncmp(argv[i], "-gpu-trace=", 11) == 0) {
+      options.gpu_trace_file = argv[i] + 11;
+    } else if (strncmp(argv[i], "-log-level=", 11) == 0) {
+      options.log_level = argv[i] + 11;
+    } else if (strncmp(argv[i], "-sync-log", 9) == 0) {
+      options.async_log = false;
+    } else if (strncmp(argv[i], "-async-log", 10) == 0) {
+      options.async_log = true;
+    } else if (strncmp(argv[i], "-binary-log=", 12) == 0) {
+      options.binary_log = argv[i] + 12;
+    } else if (strncmp(argv[i], "-trace-api-calls", 16) == 0) {
+      options.trace_api_calls = true;
+    } else if (strncmp(argv[i], "-null-driver", 12) == 0) {
+      options.null_driver = true;
     } else if (strncmp(argv[i], "-output-file=", 13) == 0) {
-      args->output_file = argv[i] + 13;
+      options.output_frame_file = argv[i] + 13;
     } else if (strncmp(argv[i], "-shader-compiler=", 17) == 0) {
-      args->shader_compiler = argv[i] + 17;
+      options.shader_compiler = argv[i] + 17;
+    } else if (strncmp(argv[i], "-shader-source-dir=", 19) == 0) {
+      options.shader_source_dir = argv[i] + 19;
+    } else if (strncmp(argv[i], "-shader-cache-dir=", 18) == 0) {
+      options.shader_cache_dir = argv[i] + 18;
+    } else if (strncmp(argv[i], "-image-dir=", 11) == 0) {
+      options.image_dir = argv[i] + 11;
     } else if (strncmp(argv[i], "-wait-for-debugger", 19) == 0) {
       args->wait_for_debugger = true;
     } else if (strncmp(argv[i], "-help", 5) == 0) {
@@ -251,9 +333,7 @@ void HandleAppCommand(android_app* app, int32_t cmd) {
 // This method is called by android_native_app_glue. This is the main entry
 // point for any native android activity.
 void android_main(android_app* app) {
-  int32_t output_frame = OUTPUT_FRAME;
-  const char* output_file = OUTPUT_FILE;
-  const char* shader_compiler = SHADER_COMPILER;
+  entry::EntryOptions options = entry::DefaultEntryOptions();
 
   // Simply wait for 10 seconds, this is useful if we have to attach late.
   if (access("/sdcard/wait-for-debugger.txt", F_OK) != -1) {
@@ -268,18 +348,18 @@ void android_main(android_app* app) {
 
   std::thread main_thread([&]() {
     data.start_mutex.lock();
-    int32_t width = output_frame >= 0 ? DEFAULT_WINDOW_WIDTH
-                                      : ANativeWindow_getWidth(app->window);
-    int32_t height = output_frame >= 0 ? DEFAULT_WINDOW_HEIGHT
-                                       : ANativeWindow_getHeight(app->window);
+    if (options.output_frame_index < 0) {
+      options.width =
+          static_cast<uint32_t>(ANativeWindow_getWidth(app->window));
+      options.height =
+          static_cast<uint32_t>(ANativeWindow_getHeight(app->window));
+    }
+    // There is no command line, and the window is always there.
+    options.headless = false;
 
     containers::LeakCheckAllocator root_allocator;
     {
-      entry::EntryData entry_data(&root_allocator, static_cast<uint32_t>(width),
-                                  static_cast<uint32_t>(height), FIXED_TIMESTEP,
-                                  PREFER_SEPARATE_PRESENT, output_frame,
-                                  output_file, shader_compiler, false, nullptr,
-                                  nullptr, app);
+      entry::EntryData entry_data(&root_allocator, options, app);
       data.entry_data = &entry_data;
       int return_value = main_entry(&entry_data);
       // Do not modify this line, scripts may look for it in the output.
@@ -363,12 +443,8 @@ int main(int argc, const char** argv) {
   int return_value = 0;
   containers::LeakCheckAllocator root_allocator;
   {
-    entry::EntryData entry_data(
-        &root_allocator, args.window_width, args.window_height,
-        args.fixed_timestep, args.prefer_separate_present, args.output_frame,
-        args.output_file, args.shader_compiler, args.validation,
-        args.load_pipeline_cache, args.write_pipeline_cache);
-    if (args.output_frame == -1) {
+    entry::EntryData entry_data(&root_allocator, args.options);
+    if (args.options.output_frame_index == -1 && !args.options.headless) {
       bool window_created = entry_data.CreateWindow();
       if (!window_created) {
         entry_data.logger()->LogError("Window creation failed");
@@ -446,7 +522,7 @@ int main(int argc, const char** argv) {
   CommandLineArgs args;
   parse_args(&args, argc, argv);
 
-  if (args.output_frame != -1) {
+  if (args.options.output_frame_index != -1 && !args.options.headless) {
     int path_len = readlink("/proc/self/exe", file_path, 1024 * 1024 - 1);
     if (path_len != -1) {
       file_path[path_len] = '\0';
@@ -473,12 +549,8 @@ int main(int argc, const char** argv) {
   int return_value = 0;
   containers::LeakCheckAllocator root_allocator;
   {
-    entry::EntryData entry_data(
-        &root_allocator, args.window_width, args.window_height,
-        args.fixed_timestep, args.prefer_separate_present, args.output_frame,
-        args.output_file, args.shader_compiler, args.validation,
-        args.load_pipeline_cache, args.write_pipeline_cache);
-    if (args.output_frame == -1) {
+    entry::EntryData entry_data(&root_allocator, args.options);
+    if (args.options.output_frame_index == -1 && !args.options.headless) {
       bool window_created = entry_data.CreateWindow();
       if (!window_created) {
         entry_data.logger()->LogError("Window creation failed");
@@ -590,7 +662,7 @@ int main(int argc, const char** argv) {
   CommandLineArgs args;
   parse_args(&args, argc, argv);
 
-  if (args.output_frame != -1) {
+  if (args.options.output_frame_index != -1 && !args.options.headless) {
     DWORD path_len = GetModuleFileNameA(NULL, file_path, 1024 * 1024 - 1);
     if (path_len != -1) {
       file_path[path_len] = '\0';
@@ -616,13 +688,9 @@ int main(int argc, const char** argv) {
   int return_value = 0;
   containers::LeakCheckAllocator root_allocator;
   {
-    entry::EntryData entry_data(
-        &root_allocator, args.window_width, args.window_height,
-        args.fixed_timestep, args.prefer_separate_present, args.output_frame,
-        args.output_file, args.shader_compiler, args.validation,
-        args.load_pipeline_cache, args.write_pipeline_cache);
+    entry::EntryData entry_data(&root_allocator, args.options);
 
-    if (args.output_frame == -1) {
+    if (args.options.output_frame_index == -1 && !args.options.headless) {
       bool window_created = entry_data.CreateWindowWin32();
       if (!window_created) {
         entry_data.logger()->LogError("Window creation failed");
@@ -664,12 +732,8 @@ int main(int argc, const char** argv) {
   while (args.wait_for_debugger)
     ;
   containers::LeakCheckAllocator root_allocator;
-  entry::EntryData entry_data(
-      &root_allocator, args.window_width, args.window_height,
-      args.fixed_timestep, args.prefer_separate_present, args.output_frame,
-      args.output_file, args.shader_compiler, args.validation,
-      args.load_pipeline_cache, args.write_pipeline_cache);
-  if (args.output_frame == -1) {
+  entry::EntryData entry_data(&root_allocator, args.options);
+  if (args.options.output_frame_index == -1 && !args.options.headless) {
     bool window_created = entry_data.CreateWindow();
     if (!window_created) {
       entry_data.logger()->LogError("Window creation failed");
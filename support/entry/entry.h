@@ -53,6 +53,40 @@ struct dummy {
 static internal::dummy __attribute__((used)) test_dummy;
 #endif
 
+// The application options that EntryData is created with, mostly from the
+// command line. See the accessors of EntryData for what each one means.
+struct EntryOptions {
+  // For Android, the width and height should be the window size provided by
+  // the app pointer. For Linux and Windows, the window size should come from
+  // command line or the default value.
+  uint32_t width = 0;
+  uint32_t height = 0;
+  bool fixed_timestep = false;
+  bool prefer_separate_present = false;
+  int64_t output_frame_index = -1;
+  const char* output_frame_file = nullptr;
+  uint32_t output_frame_count = 1;
+  uint32_t output_frame_stride = 1;
+  const char* output_format = nullptr;
+  const char* shader_compiler = nullptr;
+  bool validation = false;
+  bool headless = false;
+  uint32_t benchmark_frames = 0;
+  uint32_t benchmark_warmup_frames = 60;
+  const char* benchmark_file = nullptr;
+  const char* gpu_trace_file = nullptr;
+  const char* log_level = nullptr;
+  bool async_log = false;
+  const char* binary_log = nullptr;
+  bool trace_api_calls = false;
+  bool null_driver = false;
+  const char* load_pipeline_cache = nullptr;
+  const char* write_pipeline_cache = nullptr;
+  const char* shader_source_dir = nullptr;
+  const char* shader_cache_dir = nullptr;
+  const char* image_dir = nullptr;
+};
+
 // EntryData contains the information about the window and application options
 // like fixed time step etc. On Windows and Linux it is used to create a
 // window and cache the handles of the window for display.
@@ -63,15 +97,7 @@ class EntryData {
   EntryData& operator=(const EntryData&) = delete;
   EntryData& operator=(EntryData&&) = delete;
 
-  // For Android, the width and height should be the window size provided by
-  // the app pointer. For Linux and Windows, the window size should come from
-  // command line or the default value.
-  EntryData(containers::Allocator* allocator, uint32_t width, uint32_t height,
-            bool fixed_timestep, bool separate_present,
-            int64_t output_frame_index, const char* output_frame_file,
-            const char* shader_compiler, bool validation,
-            const char* load_pipeline_cache,
-            const char* write_pipeline_cache
+  EntryData(containers::Allocator* allocator, const EntryOptions& options
 #if defined __ANDROID__
             ,
             android_app* app
@@ -131,14 +157,59 @@ class EntryData {
   uint32_t height() const { return height_; }
   int64_t output_frame_index() const { return output_frame_index_; }
   const char* output_frame_file() const { return output_frame_file_; }
+  // The number of frames to output, starting at output_frame_index(), and
+  // the distance between them.
+  uint32_t output_frame_count() const { return output_frame_count_; }
+  uint32_t output_frame_stride() const { return output_frame_stride_; }
+  // One of "ppm", "png", "raw" or "stream".
+  const char* output_format() const { return output_format_; }
   const char* shader_compiler() const { return shader_compiler_; }
   bool validation() const { return validation_; }
+  // When true there is no window. Surfaces are created with
+  // VK_EXT_headless_surface, and -output-frame does not need the
+  // CallbackSwapchain layer.
+  bool headless() const { return headless_; }
+  // The number of frames that -benchmark times, or 0 if it is off, and the
+  // number of frames that are rendered before timing starts.
+  uint32_t benchmark_frames() const { return benchmark_frames_; }
+  uint32_t benchmark_warmup_frames() const { return benchmark_warmup_frames_; }
+  // The file that the benchmark results are written to, or nullptr if they
+  // should be logged.
+  const char* benchmark_file() const {
+    return benchmark_file_.empty() ? nullptr : benchmark_file_.c_str();
+  }
+  // The file that samples which use vulkan::GpuProfiler write their Chrome
+  // trace to, or nullptr if they should not profile.
+  const char* gpu_trace_file() const {
+    return gpu_trace_file_.empty() ? nullptr : gpu_trace_file_.c_str();
+  }
+  // When true, the time spent in every Vulkan entry point is traced with
+  // vulkan::CallTracer and logged when the application exits.
+  bool trace_api_calls() const { return trace_api_calls_; }
+  // When true, Vulkan is not loaded from the system, and every call goes to
+  // the CPU-only driver in vulkan_wrapper/null_driver.h instead.
+  bool null_driver() const { return null_driver_; }
   const char* load_pipeline_cache() const { 
     return load_pipeline_cache_.empty()? nullptr: load_pipeline_cache_.c_str();
   }
   const char* write_pipeline_cache() const {
     return write_pipeline_cache_.empty()? nullptr: write_pipeline_cache_.c_str();
   }
+  // The directory that shader sources should be compiled from at runtime,
+  // or nullptr if the embedded SPIR-V should be used.
+  const char* shader_source_dir() const {
+    return shader_source_dir_.empty() ? nullptr : shader_source_dir_.c_str();
+  }
+  // The directory that SPIR-V compiled at runtime is cached in, or nullptr
+  // if it should be cached next to the shader sources.
+  const char* shader_cache_dir() const {
+    return shader_cache_dir_.empty() ? nullptr : shader_cache_dir_.c_str();
+  }
+  // The directory that images should be loaded from at runtime, or nullptr
+  // if the embedded images should be used.
+  const char* image_dir() const {
+    return image_dir_.empty() ? nullptr : image_dir_.c_str();
+  }
 
  private:
   bool fixed_timestep_;
@@ -147,12 +218,25 @@ class EntryData {
   uint32_t height_;
   int64_t output_frame_index_;
   const char* output_frame_file_;
+  uint32_t output_frame_count_;
+  uint32_t output_frame_stride_;
+  const char* output_format_;
   const char* shader_compiler_;
   const bool validation_;
+  const bool headless_;
+  const uint32_t benchmark_frames_;
+  const uint32_t benchmark_warmup_frames_;
+  std::string benchmark_file_;
+  std::string gpu_trace_file_;
+  const bool trace_api_calls_;
+  const bool null_driver_;
   containers::unique_ptr<logging::Logger> log_;
   containers::Allocator* allocator_;
   std::string load_pipeline_cache_;
   std::string write_pipeline_cache_;
+  std::string shader_source_dir_;
+  std::string shader_cache_dir_;
+  std::string image_dir_;
 
 #if defined __ANDROID__
   ANativeWindow* native_window_handle_;
@@ -0,0 +1,187 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "support/log/async_logger.h"
+
+#include <chrono>
+#include <cstring>
+
+namespace logging {
+namespace {
+// Returns a small number that identifies the calling thread.
+uint32_t ThreadIndex() {
+  static std::atomic<uint32_t> next_index(0);
+  thread_local uint32_t index = next_index++;
+  return index;
+}
+
+uint64_t Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void AppendLittleEndian(char* out, uint64_t value, size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    out[i] = static_cast<char>(value >> (i * 8));
+  }
+}
+}  // anonymous namespace
+
+AsyncLogger::AsyncLogger(containers::Allocator* allocator,
+                         containers::unique_ptr<Logger> sink,
+                         const char* binary_file, size_t slot_count)
+    : sink_(std::move(sink)),
+      slots_(slot_count, allocator),
+      mask_(slot_count - 1),
+      enqueue_position_(0),
+      dequeue_position_(0),
+      exiting_(false) {
+  LOG_ASSERT(==, sink_.get(), 0u, slot_count & mask_);
+  for (size_t i = 0; i < slot_count; ++i) {
+    slots_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  if (binary_file) {
+    binary_log_.open(binary_file, std::ofstream::out | std::ofstream::binary);
+    if (!binary_log_) {
+      sink_->LogError("Could not open the binary log ", binary_file);
+    } else {
+      binary_log_.write("VTALOG1\n", 8);
+    }
+  }
+  thread_ = std::thread([this]() { ConsumeLoop(); });
+}
+
+AsyncLogger::~AsyncLogger() {
+  exiting_ = true;
+  thread_.join();
+  sink_->Flush();
+}
+
+void AsyncLogger::LogErrorString(const char* str) {
+  Write(Severity::kError, str, strlen(str));
+}
+
+void AsyncLogger::LogInfoString(const char* str) {
+  Write(Severity::kInfo, str, strlen(str));
+}
+
+void AsyncLogger::Write(Severity severity, const char* message,
+                        size_t length) {
+  if (length >= kSlotTextSize) {
+    // Keep the order of this thread's messages.
+    Flush();
+    std::lock_guard<std::mutex> lock(sink_mutex_);
+    WriteToSinks(severity, ThreadIndex(), Now(), message, length);
+    return;
+  }
+
+  // A bounded queue in the style of Dmitry Vyukov's: a slot is free for the
+  // producer at |position| once its sequence is |position|, and ready for
+  // the consumer once it is |position| + 1.
+  size_t position = enqueue_position_.load(std::memory_order_relaxed);
+  Slot* slot;
+  while (true) {
+    slot = &slots_[position & mask_];
+    const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+    const intptr_t difference =
+        static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+    if (difference == 0) {
+      if (enqueue_position_.compare_exchange_weak(
+              position, position + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (difference < 0) {
+      // The ring is full, wait for the consumer.
+      std::this_thread::yield();
+      position = enqueue_position_.load(std::memory_order_relaxed);
+    } else {
+      position = enqueue_position_.load(std::memory_order_relaxed);
+    }
+  }
+  slot->severity = severity;
+  slot->thread = ThreadIndex();
+  slot->time = Now();
+  slot->length = static_cast<uint32_t>(length);
+  memcpy(slot->text, message, length);
+  slot->text[length] = '\0';
+  slot->sequence.store(position + 1, std::memory_order_release);
+
+  if (severity == Severity::kError) {
+    Flush();
+  }
+}
+
+void AsyncLogger::WriteToSinks(Severity severity, uint32_t thread,
+                               uint64_t time, const char* message,
+                               size_t length) {
+  sink_->Write(severity, message, length);
+  if (binary_log_.is_open()) {
+    char header[20];
+    AppendLittleEndian(header, time, 8);
+    AppendLittleEndian(header + 8, static_cast<uint32_t>(severity), 4);
+    AppendLittleEndian(header + 12, thread, 4);
+    AppendLittleEndian(header + 16, length, 4);
+    binary_log_.write(header, sizeof(header));
+    binary_log_.write(message, length);
+  }
+}
+
+bool AsyncLogger::Consume() {
+  size_t position = dequeue_position_.load(std::memory_order_relaxed);
+  bool consumed = false;
+  std::lock_guard<std::mutex> lock(sink_mutex_);
+  while (true) {
+    Slot* slot = &slots_[position & mask_];
+    if (slot->sequence.load(std::memory_order_acquire) != position + 1) {
+      break;
+    }
+    WriteToSinks(slot->severity, slot->thread, slot->time, slot->text,
+                 slot->length);
+    slot->sequence.store(position + mask_ + 1, std::memory_order_release);
+    ++position;
+    dequeue_position_.store(position, std::memory_order_release);
+    consumed = true;
+  }
+  return consumed;
+}
+
+void AsyncLogger::ConsumeLoop() {
+  while (true) {
+    // Read |exiting_| first, so that the last messages are not missed.
+    const bool exiting = exiting_;
+    if (Consume()) {
+      continue;
+    }
+    if (exiting) {
+      return;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+void AsyncLogger::Flush() {
+  const size_t target = enqueue_position_.load(std::memory_order_acquire);
+  while (dequeue_position_.load(std::memory_order_acquire) < target) {
+    std::this_thread::yield();
+  }
+  std::lock_guard<std::mutex> lock(sink_mutex_);
+  sink_->Flush();
+  if (binary_log_.is_open()) {
+    binary_log_.flush();
+  }
+}
+
+}  // namespace logging
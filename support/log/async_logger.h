@@ -0,0 +1,102 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SUPPORT_LOG_ASYNC_LOGGER_H_
+#define SUPPORT_LOG_ASYNC_LOGGER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+#include "support/containers/allocator.h"
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "support/log/log.h"
+
+namespace logging {
+
+// AsyncLogger hands messages to a background thread, which writes them to
+// another logger, and optionally to a binary log file.
+//
+// Messages go through a fixed ring of slots that any number of threads can
+// write to without locking, so logging costs little more than formatting
+// the message. If the ring is full, loggers wait for a free slot rather
+// than drop messages. Messages that do not fit in a slot, and errors, are
+// written before the call returns, so that nothing is lost if the program
+// crashes right after.
+//
+// The binary log starts with the 8 bytes "VTALOG1\n". Every message follows
+// as a little-endian uint64_t time in nanoseconds, uint32_t severity,
+// uint32_t thread index and uint32_t length, and then the text of the
+// message.
+class AsyncLogger : public Logger {
+ public:
+  static const size_t kDefaultSlotCount = 1024;
+
+  // |slot_count| has to be a power of two. |binary_file| may be nullptr.
+  AsyncLogger(containers::Allocator* allocator,
+              containers::unique_ptr<Logger> sink, const char* binary_file,
+              size_t slot_count = kDefaultSlotCount);
+  // Writes every message that is left.
+  ~AsyncLogger() override;
+
+  // Waits until every message logged so far has been written.
+  void Flush() override;
+
+ private:
+  static const size_t kSlotTextSize = 232;
+
+  struct Slot {
+    // Tells producers and the consumer whose turn it is, see Write().
+    std::atomic<size_t> sequence;
+    Severity severity;
+    uint32_t thread;
+    uint64_t time;
+    uint32_t length;
+    char text[kSlotTextSize];
+  };
+
+  void Write(Severity severity, const char* message, size_t length) override;
+  void LogErrorString(const char* str) override;
+  void LogInfoString(const char* str) override;
+
+  // Writes a message to the sink and the binary log. Callers need to hold
+  // |sink_mutex_|.
+  void WriteToSinks(Severity severity, uint32_t thread, uint64_t time,
+                    const char* message, size_t length);
+  // Runs on |thread_|.
+  void ConsumeLoop();
+  // Writes the messages that are ready. Returns false if there were none.
+  bool Consume();
+
+  containers::unique_ptr<Logger> sink_;
+  std::ofstream binary_log_;
+  containers::vector<Slot> slots_;
+  const size_t mask_;
+  // The next slot to write to, shared by all producers.
+  std::atomic<size_t> enqueue_position_;
+  // The next slot to read from. Only written by the consumer.
+  std::atomic<size_t> dequeue_position_;
+  // Guards writing to |sink_| and |binary_log_|.
+  std::mutex sink_mutex_;
+  std::atomic<bool> exiting_;
+  std::thread thread_;
+};
+
+}  // namespace logging
+
+#endif  // SUPPORT_LOG_ASYNC_LOGGER_H_
@@ -17,6 +17,93 @@
 #include <cstring>
 
 namespace logging {
+
+bool GetSeverity(const char* name, Severity* severity) {
+  if (strcmp(name, "debug") == 0) {
+    *severity = Severity::kDebug;
+  } else if (strcmp(name, "info") == 0) {
+    *severity = Severity::kInfo;
+  } else if (strcmp(name, "error") == 0) {
+    *severity = Severity::kError;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void Message::Append(const char* str, size_t length) {
+  if (overflow_.empty() && size_ + length < kInlineSize) {
+    memcpy(inline_ + size_, str, length);
+    inline_[size_ + length] = '\0';
+  } else {
+    if (overflow_.empty()) {
+      overflow_.assign(inline_, size_);
+    }
+    overflow_.append(str, length);
+  }
+  size_ += length;
+}
+
+void Logger::Write(Severity severity, const char* message, size_t) {
+  if (severity == Severity::kError) {
+    LogErrorString(message);
+  } else {
+    LogInfoString(message);
+  }
+}
+
+void Logger::LogF(Severity severity, const char* format, va_list args) {
+  char buffer[512];
+  va_list copy;
+  va_copy(copy, args);
+  int length = vsnprintf(buffer, sizeof(buffer), format, args);
+  if (length < 0) {
+    va_end(copy);
+    return;
+  }
+  Message message;
+  if (static_cast<size_t>(length) < sizeof(buffer)) {
+    message.Append(buffer, length);
+  } else {
+    std::string long_message(length, '\0');
+    vsnprintf(&long_message[0], length + 1, format, copy);
+    message.Append(long_message.c_str(), length);
+  }
+  va_end(copy);
+  message.Append("\n", 1);
+  Write(severity, message.data(), message.size());
+}
+
+void Logger::LogErrorF(const char* format, ...) {
+  if (!enabled(Severity::kError)) {
+    return;
+  }
+  va_list args;
+  va_start(args, format);
+  LogF(Severity::kError, format, args);
+  va_end(args);
+}
+
+void Logger::LogInfoF(const char* format, ...) {
+  if (!enabled(Severity::kInfo)) {
+    return;
+  }
+  va_list args;
+  va_start(args, format);
+  LogF(Severity::kInfo, format, args);
+  va_end(args);
+}
+
+void Logger::LogDebugF(const char* format, ...) {
+  if (!enabled(Severity::kDebug)) {
+    return;
+  }
+  va_list args;
+  va_start(args, format);
+  LogF(Severity::kDebug, format, args);
+  va_end(args);
+}
+
 #if defined __ANDROID__
 #include <android/log.h>
 
@@ -33,25 +120,21 @@ class InternalLogger : public Logger {
 #include <cstdio>
 class InternalLogger : public Logger {
  public:
-  void LogErrorString(const char* str) override {
-    fprintf(stderr, "error: ");
-    int len = strlen(str);
-    int pos = 0;
-    while (len) {
-      int written = fprintf(stderr, "%s", str + pos);
-      pos += written;
-      len -= written;
+  void Write(Severity severity, const char* message, size_t length) override {
+    if (severity == Severity::kError) {
+      fputs("error: ", stderr);
+      fwrite(message, 1, length, stderr);
+    } else {
+      fwrite(message, 1, length, stdout);
     }
   }
 
+  void LogErrorString(const char* str) override {
+    Write(Severity::kError, str, strlen(str));
+  }
+
   void LogInfoString(const char* str) override {
-    int len = strlen(str);
-    int pos = 0;
-    while (len) {
-      int written = fprintf(stdout, "%s", str + pos);
-      pos += written;
-      len -= written;
-    }
+    Write(Severity::kInfo, str, strlen(str));
   }
 
   void Flush() override {
@@ -16,6 +16,10 @@
 #ifndef SUPPORT_LOG_LOG_H_
 #define SUPPORT_LOG_LOG_H_
 
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <memory>
 #include <sstream>
 #include <string>
@@ -24,6 +28,15 @@
 #include "support/containers/vector.h"
 namespace logging {
 
+// Lets the compiler check the arguments of printf-style functions. The
+// indices count from 1, and the implicit this of member functions counts.
+#if defined __GNUC__ || defined __clang__
+#define LOG_PRINTF_FORMAT(format_index, first_argument) \
+  __attribute__((format(printf, format_index, first_argument)))
+#else
+#define LOG_PRINTF_FORMAT(format_index, first_argument)
+#endif
+
 // Tests the result of "res op exp" and if the result is not "true"
 // then logs an error to LogError of the given log.
 #define LOG_EXPECT(op, log, res, exp)                                          \
@@ -57,11 +70,46 @@ namespace logging {
     *reinterpret_cast<volatile int*>(intptr_t(0)) = 4; \
   } while (0);
 
+// How important a log message is. Messages below the minimum severity of a
+// logger are dropped before they are formatted.
+enum class Severity : uint32_t {
+  kDebug,
+  kInfo,
+  kError,
+};
+
+// Returns the severity named |name| (debug, info or error) in |severity|.
+// Returns false if there is no such severity.
+bool GetSeverity(const char* name, Severity* severity);
+
+// A log message that is being built. Short messages are kept on the stack,
+// longer ones move to the heap.
+class Message {
+ public:
+  Message() : size_(0) { inline_[0] = '\0'; }
+
+  void Append(const char* str, size_t length);
+  void Append(const char* str) { Append(str, strlen(str)); }
+
+  // Always null-terminated.
+  const char* data() const {
+    return overflow_.empty() ? inline_ : overflow_.c_str();
+  }
+  size_t size() const { return size_; }
+
+ private:
+  static const size_t kInlineSize = 512;
+  char inline_[kInlineSize];
+  size_t size_;
+  std::string overflow_;
+};
+
 // Logging class base. It provides the functionality to
 // generate log messages for use by any inherited classes.
-// Ideally this would take an allocator and do all memory
-// allocations (in stringstream) using that. Unfortunately
-// the c++11 spec is missing allocator-aware streams. :(
+// Common types are formatted into a Message without allocating, anything
+// else goes through an ostringstream. Ideally this would take an allocator
+// and do all of those allocations using that. Unfortunately the c++11 spec
+// is missing allocator-aware streams. :(
 // We will have to assume that the STL is doing the right thing here.
 class Logger {
  public:
@@ -70,48 +118,121 @@ class Logger {
   // Logs a set of values to the error stream of the logger.
   template <typename... Args>
   void LogError(Args... args) {
-    std::ostringstream str;
-    LogHelper(&str, args...);
-    str << "\n";
-    LogErrorString(str.str().c_str());
+    Log(Severity::kError, args...);
   }
 
   // Logs a set of values to the info stream of the logger.
   template <typename... Args>
   void LogInfo(Args... args) {
-    std::ostringstream str;
-    LogHelper(&str, args...);
-    str << "\n";
-    LogInfoString(str.str().c_str());
+    Log(Severity::kInfo, args...);
+  }
+
+  // Logs a set of values to the info stream of the logger, if debug
+  // messages are enabled.
+  template <typename... Args>
+  void LogDebug(Args... args) {
+    Log(Severity::kDebug, args...);
   }
 
+  // The same as LogError, LogInfo and LogDebug, but formatted like printf.
+  void LogErrorF(const char* format, ...) LOG_PRINTF_FORMAT(2, 3);
+  void LogInfoF(const char* format, ...) LOG_PRINTF_FORMAT(2, 3);
+  void LogDebugF(const char* format, ...) LOG_PRINTF_FORMAT(2, 3);
+
+  // Returns true if messages of |severity| are logged. Callers can check
+  // this to skip work that is only needed for a message.
+  bool enabled(Severity severity) const { return severity >= min_severity_; }
+  void set_min_severity(Severity severity) { min_severity_ = severity; }
+
  private:
+  template <typename... Args>
+  void Log(Severity severity, Args... args) {
+    if (!enabled(severity)) {
+      return;
+    }
+    Message message;
+    LogHelper(&message, args...);
+    message.Append("\n", 1);
+    Write(severity, message.data(), message.size());
+  }
+  void LogF(Severity severity, const char* format, va_list args);
+
   // Helper function, the recursive base of LogHelper.
   template <typename T>
-  void LogHelper(std::ostringstream* stream, const T& val) {
-    *stream << val;
+  void LogHelper(Message* message, const T& val) {
+    std::ostringstream stream;
+    stream << val;
+    const std::string str = stream.str();
+    message->Append(str.c_str(), str.size());
+  }
+  void LogHelper(Message* message, const char* val) { message->Append(val); }
+  void LogHelper(Message* message, char* val) { message->Append(val); }
+  void LogHelper(Message* message, char val) { message->Append(&val, 1); }
+  template <typename Traits, typename Alloc>
+  void LogHelper(Message* message,
+                 const std::basic_string<char, Traits, Alloc>& val) {
+    message->Append(val.c_str(), val.size());
+  }
+  void LogHelper(Message* message, int val) { LogNumber(message, "%d", val); }
+  void LogHelper(Message* message, unsigned int val) {
+    LogNumber(message, "%u", val);
+  }
+  void LogHelper(Message* message, long val) {
+    LogNumber(message, "%ld", val);
+  }
+  void LogHelper(Message* message, unsigned long val) {
+    LogNumber(message, "%lu", val);
+  }
+  void LogHelper(Message* message, long long val) {
+    LogNumber(message, "%lld", val);
+  }
+  void LogHelper(Message* message, unsigned long long val) {
+    LogNumber(message, "%llu", val);
+  }
+  // The same as the default formatting of streams.
+  void LogHelper(Message* message, float val) {
+    LogNumber(message, "%g", static_cast<double>(val));
+  }
+  void LogHelper(Message* message, double val) {
+    LogNumber(message, "%g", val);
+  }
+
+  template <typename T>
+  void LogNumber(Message* message, const char* format, T val) {
+    char buffer[32];
+    int length = snprintf(buffer, sizeof(buffer), format, val);
+    message->Append(buffer, static_cast<size_t>(length));
   }
 
   template <typename T>
-  void LogHelper(std::ostringstream* stream, const containers::vector<T>& val) {
-    *stream << "[";
+  void LogHelper(Message* message, const containers::vector<T>& val) {
+    message->Append("[", 1);
     for (size_t i = 0; i < val.size(); ++i) {
       if (i != 0) {
-        *stream << ", ";
+        message->Append(", ", 2);
       }
-      LogHelper(stream, val[i]);
+      LogHelper(message, val[i]);
     }
-    *stream << "]";
+    message->Append("]", 1);
   }
 
   // Helper function to recursively add elements from Args to
-  // the stream.
+  // the message.
   template <typename T, typename... Args>
-  void LogHelper(std::ostringstream* stream, const T& val, Args... args) {
-    LogHelper(stream, val);
-    LogHelper(stream, args...);
+  void LogHelper(Message* message, const T& val, Args... args) {
+    LogHelper(message, val);
+    LogHelper(message, args...);
   }
 
+  Severity min_severity_ = Severity::kInfo;
+
+ protected:
+  friend class AsyncLogger;
+  // Writes a complete |message| of |length| characters, which ends in a
+  // newline and is null-terminated. By default errors go to
+  // LogErrorString, and everything else to LogInfoString.
+  virtual void Write(Severity severity, const char* message, size_t length);
+
   // This should be overriden by child classes to log the
   // input null-terminated
   // string to the STDERR equivalent.
@@ -0,0 +1,115 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "support/mapped_file/mapped_file.h"
+
+#if defined _WIN32
+#include <windows.h>
+namespace mapped_file {
+class InternalMappedFile : public MappedFile {
+ public:
+  InternalMappedFile(const char* path) : data_(nullptr), size_(0) {
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+      return;
+    }
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+      // The mapping object and the view keep the file open, so both handles
+      // can be closed right away.
+      HANDLE mapping =
+          CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (mapping) {
+        data_ = static_cast<const uint8_t*>(
+            MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        size_ = static_cast<size_t>(size.QuadPart);
+        CloseHandle(mapping);
+      }
+    }
+    CloseHandle(file);
+  }
+
+  ~InternalMappedFile() override {
+    if (is_valid()) {
+      UnmapViewOfFile(data_);
+    }
+  }
+
+  const uint8_t* data() const override { return data_; }
+  size_t size() const override { return size_; }
+  bool is_valid() const { return nullptr != data_; }
+
+ private:
+  const uint8_t* data_;
+  size_t size_;
+};
+}  // namespace mapped_file
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mapped_file {
+class InternalMappedFile : public MappedFile {
+ public:
+  InternalMappedFile(const char* path) : data_(nullptr), size_(0) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+      return;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+      // The mapping keeps the file open, so the descriptor can be closed
+      // right away.
+      void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ,
+                        MAP_PRIVATE, fd, 0);
+      if (data != MAP_FAILED) {
+        data_ = static_cast<const uint8_t*>(data);
+        size_ = static_cast<size_t>(info.st_size);
+      }
+    }
+    close(fd);
+  }
+
+  ~InternalMappedFile() override {
+    if (is_valid()) {
+      munmap(const_cast<uint8_t*>(data_), size_);
+    }
+  }
+
+  const uint8_t* data() const override { return data_; }
+  size_t size() const override { return size_; }
+  bool is_valid() const { return nullptr != data_; }
+
+ private:
+  const uint8_t* data_;
+  size_t size_;
+};
+}  // namespace mapped_file
+#endif
+
+namespace mapped_file {
+containers::unique_ptr<MappedFile> OpenFile(containers::Allocator* allocator,
+                                            const char* path) {
+  containers::unique_ptr<InternalMappedFile> file(
+      containers::make_unique<InternalMappedFile>(allocator, path));
+  if (!file->is_valid()) {
+    return nullptr;
+  }
+  return std::move(file);
+}
+}  // namespace mapped_file
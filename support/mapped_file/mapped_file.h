@@ -0,0 +1,45 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SUPPORT_MAPPED_FILE_MAPPED_FILE_H_
+#define SUPPORT_MAPPED_FILE_MAPPED_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "support/containers/allocator.h"
+#include "support/containers/unique_ptr.h"
+
+namespace mapped_file {
+// This wraps a file that is mapped read-only into memory with the system's
+// memory mapping functions. The file stays mapped until this is destroyed.
+class MappedFile {
+ public:
+  virtual ~MappedFile() {}
+
+  // Returns the first byte of the file. The mapping is page-aligned.
+  virtual const uint8_t* data() const = 0;
+  // Returns the size of the file in bytes.
+  virtual size_t size() const = 0;
+};
+
+// Maps the file at |path| into memory. Returns nullptr if the file could not
+// be opened or mapped, or if it is empty.
+containers::unique_ptr<MappedFile> OpenFile(containers::Allocator* allocator,
+                                            const char* path);
+
+}  // namespace mapped_file
+
+#endif  // SUPPORT_MAPPED_FILE_MAPPED_FILE_H_
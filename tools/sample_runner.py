@@ -0,0 +1,473 @@
+#!/usr/bin/env python3
+# Copyright 2022 Google Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+'''Runs all of the sample applications in parallel, and reports the results.
+
+The samples are read from the samples.txt file that CMake writes next to the
+executables, which lists every target that was added with
+add_vulkan_sample_application. Every sample is run headless, with a fixed
+timestep, up to twice:
+  - once to capture a frame with -output-frame, which is compared against the
+    same frame in the baseline directory, if there is one.
+  - once to time frames with -benchmark, whose results are compared against
+    the benchmark results in the baseline directory, if there are any.
+The frame captures run in parallel. The benchmarks run one at a time after
+them, so that their timings are not skewed by other samples.
+
+All of the output ends up in the output directory, along with report.json,
+which holds the results of every run. Running with --update-baseline copies
+the frames and benchmark results into the baseline directory afterwards.
+'''
+
+import argparse
+import concurrent.futures
+import fnmatch
+import json
+import multiprocessing
+import os
+import platform
+import shutil
+import subprocess
+import sys
+import time
+
+SUCCESS = 0
+FAILURE = 1
+
+WIN = platform.system() == 'Windows'
+
+# The statistic of the benchmark results that performance is compared by.
+BENCHMARK_STATISTIC = 'p50'
+
+
+def read_ppm(path):
+    '''Reads a binary PPM file. Returns (width, height, pixels), where pixels
+    holds 3 bytes per pixel.'''
+    with open(path, 'rb') as ppm:
+        data = ppm.read()
+    # The header is 4 whitespace separated fields, which may be interleaved
+    # with comments.
+    fields = []
+    position = 0
+    while len(fields) < 4:
+        while data[position:position + 1].isspace():
+            position += 1
+        if data[position:position + 1] == b'#':
+            position = data.index(b'\n', position)
+            continue
+        end = position
+        while not data[end:end + 1].isspace():
+            end += 1
+        fields.append(data[position:end])
+        position = end
+    if fields[0] != b'P6' or int(fields[3]) != 255:
+        raise ValueError(path + ' is not an 8 bit binary PPM file')
+    width = int(fields[1])
+    height = int(fields[2])
+    # A single whitespace character separates the header from the pixels.
+    pixels = data[position + 1:position + 1 + width * height * 3]
+    return width, height, pixels
+
+
+def write_ppm(path, width, height, pixels):
+    with open(path, 'wb') as ppm:
+        ppm.write(b'P6\n%d %d\n255\n' % (width, height))
+        ppm.write(pixels)
+
+
+def compare_images(path, baseline_path, diff_path, tolerance):
+    '''Compares the image at path to the one at baseline_path. Pixels that
+    differ by more than tolerance in any channel are counted, and drawn in red
+    on a darkened copy of the baseline in diff_path.
+    Returns a dictionary that describes the differences.'''
+    width, height, pixels = read_ppm(path)
+    baseline_width, baseline_height, baseline_pixels = read_ppm(baseline_path)
+    if (width, height) != (baseline_width, baseline_height):
+        return {
+            'passed': False,
+            'error': 'the image is %dx%d, the baseline is %dx%d' %
+            (width, height, baseline_width, baseline_height)
+        }
+    if pixels == baseline_pixels:
+        return {'passed': True, 'different_pixels': 0, 'max_difference': 0}
+
+    different_pixels = 0
+    max_difference = 0
+    diff = bytearray(len(pixels))
+    for i in range(0, len(pixels), 3):
+        difference = max(
+            abs(pixels[i + c] - baseline_pixels[i + c]) for c in range(3))
+        max_difference = max(max_difference, difference)
+        if difference > tolerance:
+            different_pixels += 1
+            diff[i] = 255
+        else:
+            diff[i:i + 3] = bytes(b // 4 for b in baseline_pixels[i:i + 3])
+    write_ppm(diff_path, width, height, bytes(diff))
+    return {
+        'passed': different_pixels == 0,
+        'different_pixels': different_pixels,
+        'max_difference': max_difference,
+        'diff': diff_path
+    }
+
+
+def compare_benchmarks(results, baseline, threshold):
+    '''Compares the frame and phase times of two -benchmark results.
+    Returns a dictionary that describes the changes, in percent. The
+    comparison fails if the frame time got more than threshold percent
+    slower.'''
+    deltas = {}
+    for name, times in results['milliseconds'].items():
+        baseline_times = baseline['milliseconds'].get(name)
+        if not times or not baseline_times:
+            continue
+        old = baseline_times[BENCHMARK_STATISTIC]
+        new = times[BENCHMARK_STATISTIC]
+        deltas[name] = {
+            'baseline': old,
+            'current': new,
+            'delta_percent': (new - old) / old * 100.0 if old else 0.0
+        }
+    frame = deltas.get('frame')
+    return {
+        'passed': frame is None or frame['delta_percent'] <= threshold,
+        'deltas': deltas
+    }
+
+
+class SampleRun(object):
+    '''One run of one sample, either to capture a frame or to benchmark.'''
+
+    def __init__(self, sample, kind, executable, output_dir, args):
+        self.sample = sample
+        self.kind = kind
+        self.executable = executable
+        self.output_dir = output_dir
+        self.args = args
+
+    def output_path(self, suffix):
+        return os.path.join(self.output_dir, self.sample + suffix)
+
+    def command(self):
+        command = [self.executable, '-headless', '-fixed']
+        if self.args.null_driver:
+            command.append('-null-driver')
+        if self.kind == 'frame':
+            command += [
+                '-output-frame=' + str(self.args.frame),
+                '-output-file=' + self.output_path('.ppm')
+            ]
+        else:
+            command += [
+                '-benchmark=' + str(self.args.benchmark_frames),
+                '-benchmark-warmup=' + str(self.args.benchmark_warmup),
+                '-benchmark-file=' + self.output_path('.json')
+            ]
+        return command + self.args.sample_args
+
+    def run(self):
+        '''Runs the sample. Returns a dictionary with the results.'''
+        result = {'sample': self.sample, 'kind': self.kind}
+        log_path = self.output_path('.' + self.kind + '.log')
+        result['log'] = log_path
+        # Do not mistake the output of an earlier run for that of this one.
+        suffixes = ['.ppm', '.diff.ppm'] if self.kind == 'frame' else ['.json']
+        for suffix in suffixes:
+            if os.path.isfile(self.output_path(suffix)):
+                os.remove(self.output_path(suffix))
+        start = time.time()
+        with open(log_path, 'w') as log:
+            try:
+                process = subprocess.run(
+                    self.command(),
+                    stdout=log,
+                    stderr=subprocess.STDOUT,
+                    cwd=os.path.dirname(self.executable),
+                    timeout=self.args.timeout)
+                result['status'] = process.returncode
+            except subprocess.TimeoutExpired:
+                result['status'] = 'timeout'
+        result['seconds'] = time.time() - start
+        result['passed'] = result['status'] == 0
+
+        if self.kind == 'frame':
+            self.check_frame(result)
+        else:
+            self.check_benchmark(result)
+        return result
+
+    def check_frame(self, result):
+        frame = self.output_path('.ppm')
+        if not os.path.isfile(frame):
+            result['passed'] = False
+            result['error'] = 'no frame was written'
+            return
+        result['frame'] = frame
+        baseline = os.path.join(self.args.baseline_dir or '',
+                                self.sample + '.ppm')
+        if not self.args.baseline_dir or not os.path.isfile(baseline):
+            return
+        try:
+            comparison = compare_images(frame, baseline,
+                                        self.output_path('.diff.ppm'),
+                                        self.args.tolerance)
+        except (IOError, ValueError) as error:
+            comparison = {'passed': False, 'error': str(error)}
+        result['image'] = comparison
+        result['passed'] = result['passed'] and comparison['passed']
+
+    def check_benchmark(self, result):
+        path = self.output_path('.json')
+        if not os.path.isfile(path):
+            result['passed'] = False
+            result['error'] = 'no benchmark results were written'
+            return
+        try:
+            with open(path) as results_file:
+                results = json.load(results_file)
+        except (OSError, ValueError) as error:
+            result['passed'] = False
+            result['error'] = ('could not read the benchmark results: ' +
+                               str(error))
+            return
+        result['benchmark'] = path
+        baseline = os.path.join(self.args.baseline_dir or '',
+                                self.sample + '.json')
+        if not self.args.baseline_dir or not os.path.isfile(baseline):
+            return
+        try:
+            with open(baseline) as baseline_file:
+                comparison = compare_benchmarks(results,
+                                                json.load(baseline_file),
+                                                self.args.perf_threshold)
+        except (OSError, ValueError, KeyError) as error:
+            result['passed'] = False
+            result['error'] = ('could not compare against ' + baseline +
+                               ': ' + str(error))
+            return
+        result['performance'] = comparison
+        result['passed'] = result['passed'] and comparison['passed']
+
+
+def find_samples(bin_dir, filters, excludes):
+    '''Returns the names of the samples listed in samples.txt that match any
+    of filters and none of excludes.'''
+    samples_file = os.path.join(bin_dir, 'samples.txt')
+    if not os.path.isfile(samples_file):
+        print('Error: ' + samples_file + ' was not found, is --bin-dir the '
+              'directory that the samples were built into?')
+        return None
+    with open(samples_file) as samples:
+        names = [line.strip() for line in samples if line.strip()]
+    return [
+        name for name in names
+        if any(fnmatch.fnmatch(name, f) for f in filters) and
+        not any(fnmatch.fnmatch(name, e) for e in excludes)
+    ]
+
+
+def describe(result):
+    '''Returns a one line description of why a run failed, or what changed.'''
+    details = []
+    if result['status'] != 0:
+        details.append('exited with ' + str(result['status']))
+    if 'error' in result:
+        details.append(result['error'])
+    image = result.get('image')
+    if image:
+        if 'error' in image:
+            details.append(image['error'])
+        elif image['different_pixels']:
+            details.append('%d pixels differ by up to %d, see %s' %
+                           (image['different_pixels'],
+                            image['max_difference'], image['diff']))
+    performance = result.get('performance')
+    if performance and 'frame' in performance['deltas']:
+        frame = performance['deltas']['frame']
+        details.append('frame %s %.3f ms -> %.3f ms (%+.1f%%)' %
+                       (BENCHMARK_STATISTIC, frame['baseline'],
+                        frame['current'], frame['delta_percent']))
+    return ', '.join(details)
+
+
+def print_result(result):
+    name = result['sample'] + ' (' + result['kind'] + ')'
+    status = 'OK' if result['passed'] else 'FAILED'
+    print('[ ' + status.rjust(10) + ' ] ' + name + ' ' + describe(result))
+
+
+def update_baseline(results, baseline_dir):
+    if not os.path.isdir(baseline_dir):
+        os.makedirs(baseline_dir)
+    for result in results:
+        for key in ['frame', 'benchmark']:
+            if result['status'] == 0 and key in result:
+                shutil.copy(result[key], baseline_dir)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument(
+        '--bin-dir',
+        required=True,
+        help='Directory containing the sample executables and samples.txt')
+    parser.add_argument(
+        '--output-dir',
+        default='sample_results',
+        help='Directory that frames, benchmark results, logs and the report '
+        'are written to')
+    parser.add_argument(
+        '--baseline-dir',
+        help='Directory containing the frames and benchmark results to '
+        'compare against')
+    parser.add_argument(
+        '--update-baseline',
+        action='store_true',
+        help='Copy the frames and benchmark results of the samples that '
+        'exited successfully into --baseline-dir')
+    parser.add_argument(
+        '--filter',
+        action='append',
+        help='Only run the samples that match this pattern, may be repeated')
+    parser.add_argument(
+        '--exclude',
+        action='append',
+        default=[],
+        help='Do not run the samples that match this pattern, may be repeated')
+    parser.add_argument(
+        '--jobs',
+        type=int,
+        default=multiprocessing.cpu_count(),
+        help='The number of frame captures to run at the same time, '
+        'benchmarks always run one at a time')
+    parser.add_argument(
+        '--timeout',
+        type=float,
+        default=120.0,
+        help='The number of seconds after which a run is killed')
+    parser.add_argument(
+        '--frame',
+        type=int,
+        default=100,
+        help='The frame to capture, or -1 to capture none')
+    parser.add_argument(
+        '--benchmark-frames',
+        type=int,
+        default=0,
+        help='The number of frames to benchmark, 0 turns benchmarking off')
+    parser.add_argument(
+        '--benchmark-warmup',
+        type=int,
+        default=60,
+        help='The number of frames rendered before benchmarking starts')
+    parser.add_argument(
+        '--tolerance',
+        type=int,
+        default=0,
+        help='The largest difference in any channel of a pixel that is not '
+        'counted as a difference')
+    parser.add_argument(
+        '--perf-threshold',
+        type=float,
+        default=10.0,
+        help='How many percent the frame time may get slower before a '
+        'benchmark fails')
+    parser.add_argument(
+        '--null-driver',
+        action='store_true',
+        help='Run the samples on the null driver, which needs no GPU')
+    parser.add_argument(
+        'sample_args',
+        nargs='*',
+        help='Additional arguments for every sample, after --')
+    args = parser.parse_args()
+
+    if args.update_baseline and not args.baseline_dir:
+        print('Error: --update-baseline requires --baseline-dir')
+        return FAILURE
+
+    samples = find_samples(args.bin_dir, args.filter or ['*'], args.exclude)
+    if samples is None:
+        return FAILURE
+    if not samples:
+        print('Error: no samples matched')
+        return FAILURE
+
+    output_dir = os.path.abspath(args.output_dir)
+    if not os.path.isdir(output_dir):
+        os.makedirs(output_dir)
+
+    frame_runs = []
+    benchmark_runs = []
+    for sample in samples:
+        executable = os.path.abspath(
+            os.path.join(args.bin_dir, sample + ('.exe' if WIN else '')))
+        if not os.path.isfile(executable):
+            print('Warning: ' + executable + ' was not found, skipping it')
+            continue
+        if args.frame >= 0:
+            frame_runs.append(
+                SampleRun(sample, 'frame', executable, output_dir, args))
+        if args.benchmark_frames > 0:
+            benchmark_runs.append(
+                SampleRun(sample, 'benchmark', executable, output_dir, args))
+
+    results = []
+    start = time.time()
+    with concurrent.futures.ThreadPoolExecutor(max(args.jobs, 1)) as pool:
+        futures = [pool.submit(run.run) for run in frame_runs]
+        for future in concurrent.futures.as_completed(futures):
+            result = future.result()
+            results.append(result)
+            print_result(result)
+    # Nothing else may run while a benchmark is timing frames.
+    for run in benchmark_runs:
+        result = run.run()
+        results.append(result)
+        print_result(result)
+    results.sort(key=lambda result: (result['sample'], result['kind']))
+
+    failed = [result for result in results if not result['passed']]
+    report = {
+        'bin_dir': os.path.abspath(args.bin_dir),
+        'baseline_dir':
+        os.path.abspath(args.baseline_dir) if args.baseline_dir else None,
+        'seconds': time.time() - start,
+        'runs': len(results),
+        'failed': len(failed),
+        'results': results
+    }
+    report_path = os.path.join(output_dir, 'report.json')
+    with open(report_path, 'w') as report_file:
+        json.dump(report, report_file, indent=2, sort_keys=True)
+
+    if args.update_baseline:
+        update_baseline(results, args.baseline_dir)
+
+    print('====================================================')
+    print('Total Runs: ' + str(len(results)) + ' in %.1f seconds' %
+          report['seconds'])
+    print('Total Runs Passed: ' + str(len(results) - len(failed)))
+    for result in failed:
+        print('[ ' + 'FAILED'.rjust(10) + ' ] ' + result['sample'] + ' (' +
+              result['kind'] + ') ' + describe(result))
+    print('Report: ' + report_path)
+    return FAILURE if failed else SUCCESS
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,216 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vulkan_helpers/bindless_heap.h"
+
+namespace vulkan {
+namespace {
+const VkDescriptorType kBindingTypes[BindlessHeap::kNumBindings] = {
+    VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,   // kSampledImageBinding
+    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // kStorageBufferBinding
+    VK_DESCRIPTOR_TYPE_SAMPLER,         // kSamplerBinding
+};
+
+VkDescriptorSetLayout CreateHeapLayout(
+    VkDevice* device, const uint32_t (&counts)[BindlessHeap::kNumBindings]) {
+  VkDescriptorSetLayoutBinding bindings[BindlessHeap::kNumBindings];
+  VkDescriptorBindingFlagsEXT binding_flags[BindlessHeap::kNumBindings];
+  for (uint32_t i = 0; i < BindlessHeap::kNumBindings; ++i) {
+    bindings[i] = {
+        i,                    // binding
+        kBindingTypes[i],     // descriptorType
+        counts[i],            // descriptorCount
+        VK_SHADER_STAGE_ALL,  // stageFlags
+        nullptr               // pImmutableSamplers
+    };
+    binding_flags[i] =
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+        VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+  }
+
+  VkDescriptorSetLayoutBindingFlagsCreateInfoEXT binding_flags_info{
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT,
+      nullptr,                     // pNext
+      BindlessHeap::kNumBindings,  // bindingCount
+      binding_flags,               // pBindingFlags
+  };
+  VkDescriptorSetLayoutCreateInfo info{
+      /* sType = */ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      /* pNext = */ &binding_flags_info,
+      /* flags = */
+      VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT,
+      /* bindingCount = */ BindlessHeap::kNumBindings,
+      /* pBindings = */ bindings,
+  };
+
+  ::VkDescriptorSetLayout raw_layout;
+  LOG_ASSERT(==, device->GetLogger(), VK_SUCCESS,
+             (*device)->vkCreateDescriptorSetLayout(*device, &info, nullptr,
+                                                    &raw_layout));
+  return VkDescriptorSetLayout(raw_layout, nullptr, device);
+}
+
+VkDescriptorPool CreateHeapPool(
+    VkDevice* device, const uint32_t (&counts)[BindlessHeap::kNumBindings]) {
+  VkDescriptorPoolSize pool_sizes[BindlessHeap::kNumBindings];
+  uint32_t num_pool_sizes = 0;
+  for (uint32_t i = 0; i < BindlessHeap::kNumBindings; ++i) {
+    if (counts[i] != 0) {
+      pool_sizes[num_pool_sizes++] = {kBindingTypes[i], counts[i]};
+    }
+  }
+
+  VkDescriptorPoolCreateInfo info{
+      /* sType = */ VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+      /* pNext = */ nullptr,
+      /* flags = */ VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT,
+      /* maxSets = */ 1,
+      /* poolSizeCount = */ num_pool_sizes,
+      /* pPoolSizes = */ pool_sizes};
+
+  ::VkDescriptorPool raw_pool;
+  LOG_ASSERT(
+      ==, device->GetLogger(), VK_SUCCESS,
+      (*device)->vkCreateDescriptorPool(*device, &info, nullptr, &raw_pool));
+  return VkDescriptorPool(raw_pool, nullptr, device);
+}
+
+::VkDescriptorSet AllocateHeapSet(VkDevice* device, ::VkDescriptorPool pool,
+                                  ::VkDescriptorSetLayout layout) {
+  VkDescriptorSetAllocateInfo alloc_info{
+      /* sType = */ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+      /* pNext = */ nullptr,
+      /* descriptorPool = */ pool,
+      /* descriptorSetCount = */ 1,
+      /* pSetLayouts = */ &layout,
+  };
+  ::VkDescriptorSet set;
+  LOG_ASSERT(==, device->GetLogger(), VK_SUCCESS,
+             (*device)->vkAllocateDescriptorSets(*device, &alloc_info, &set));
+  return set;
+}
+}  // anonymous namespace
+
+BindlessHeap::BindlessHeap(containers::Allocator* allocator, VkDevice* device,
+                           uint32_t max_sampled_images,
+                           uint32_t max_storage_buffers, uint32_t max_samplers)
+    : device_(device),
+      layout_(CreateHeapLayout(
+          device, {max_sampled_images, max_storage_buffers, max_samplers})),
+      pool_(CreateHeapPool(
+          device, {max_sampled_images, max_storage_buffers, max_samplers})),
+      set_(AllocateHeapSet(device, pool_, layout_)),
+      indices_{{allocator, max_sampled_images},
+               {allocator, max_storage_buffers},
+               {allocator, max_samplers}},
+      current_frame_(0) {}
+
+uint32_t BindlessHeap::AllocateIndex(uint32_t binding) {
+  IndexAllocator& indices = indices_[binding];
+  if (!indices.free_indices.empty()) {
+    uint32_t index = indices.free_indices.back();
+    indices.free_indices.pop_back();
+    return index;
+  }
+  // Running out here usually means that indices are freed, but frames are
+  // never completed.
+  LOG_ASSERT(<, device_->GetLogger(), indices.next_unused, indices.capacity);
+  return indices.next_unused++;
+}
+
+void BindlessHeap::Write(uint32_t binding, VkDescriptorType type,
+                         uint32_t index,
+                         const VkDescriptorImageInfo* image_info,
+                         const VkDescriptorBufferInfo* buffer_info) {
+  VkWriteDescriptorSet write{
+      VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+      nullptr,                                 // pNext
+      set_,                                    // dstSet
+      binding,                                 // dstbinding
+      index,                                   // dstArrayElement
+      1,                                       // descriptorCount
+      type,                                    // descriptorType
+      image_info,                              // pImageInfo
+      buffer_info,                             // pBufferInfo
+      nullptr,                                 // pTexelBufferView
+  };
+  (*device_)->vkUpdateDescriptorSets(*device_, 1, &write, 0, nullptr);
+}
+
+uint32_t BindlessHeap::AddSampledImage(::VkImageView view,
+                                       VkImageLayout layout) {
+  const uint32_t index = AllocateIndex(kSampledImageBinding);
+  VkDescriptorImageInfo info{
+      VK_NULL_HANDLE,  // sampler
+      view,            // imageView
+      layout,          // imageLayout
+  };
+  Write(kSampledImageBinding, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, index, &info,
+        nullptr);
+  return index;
+}
+
+uint32_t BindlessHeap::AddStorageBuffer(::VkBuffer buffer,
+                                        VkDeviceSize offset,
+                                        VkDeviceSize range) {
+  const uint32_t index = AllocateIndex(kStorageBufferBinding);
+  VkDescriptorBufferInfo info{
+      buffer,  // buffer
+      offset,  // offset
+      range,   // range
+  };
+  Write(kStorageBufferBinding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, index,
+        nullptr, &info);
+  return index;
+}
+
+uint32_t BindlessHeap::AddSampler(::VkSampler sampler) {
+  const uint32_t index = AllocateIndex(kSamplerBinding);
+  VkDescriptorImageInfo info{
+      sampler,                    // sampler
+      VK_NULL_HANDLE,             // imageView
+      VK_IMAGE_LAYOUT_UNDEFINED,  // imageLayout
+  };
+  Write(kSamplerBinding, VK_DESCRIPTOR_TYPE_SAMPLER, index, &info, nullptr);
+  return index;
+}
+
+void BindlessHeap::Free(uint32_t binding, uint32_t index) {
+  LOG_ASSERT(<, device_->GetLogger(), binding, kNumBindings);
+  LOG_ASSERT(<, device_->GetLogger(), index, indices_[binding].next_unused);
+  indices_[binding].pending.push_back({current_frame_, index});
+}
+
+uint64_t BindlessHeap::BeginFrame() { return ++current_frame_; }
+
+void BindlessHeap::FrameCompleted(uint64_t frame) {
+  for (IndexAllocator& indices : indices_) {
+    while (!indices.pending.empty() && indices.pending.front().first <= frame) {
+      indices.free_indices.push_back(indices.pending.front().second);
+      indices.pending.pop_front();
+    }
+  }
+}
+
+void BindlessHeap::Bind(VkCommandBuffer* command_buffer,
+                        VkPipelineBindPoint bind_point,
+                        ::VkPipelineLayout layout, uint32_t set_index) const {
+  (*command_buffer)
+      ->vkCmdBindDescriptorSets(*command_buffer, bind_point, layout, set_index,
+                                1, &set_, 0, nullptr);
+}
+
+}  // namespace vulkan
@@ -0,0 +1,163 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_BINDLESS_HEAP_H_
+#define VULKAN_HELPERS_BINDLESS_HEAP_H_
+
+#include <cstdint>
+#include <utility>
+
+#include "support/containers/allocator.h"
+#include "support/containers/deque.h"
+#include "support/containers/vector.h"
+#include "vulkan_wrapper/command_buffer_wrapper.h"
+#include "vulkan_wrapper/device_wrapper.h"
+#include "vulkan_wrapper/sub_objects.h"
+
+namespace vulkan {
+
+// BindlessHeap is a single descriptor set holding large arrays of sampled
+// images, storage buffers and samplers, which shaders index into with
+// indices that are passed to them by other means (push constants, buffers).
+// Binding the heap once per command buffer replaces binding a descriptor set
+// per draw.
+//
+// The arrays are created with VK_EXT_descriptor_indexing update-after-bind
+// and partially-bound flags, so resources can be added and removed while the
+// set is bound in command buffers that are in flight. The device must have
+// been created with VK_EXT_descriptor_indexing (or Vulkan 1.2) and the
+// descriptorBindingPartiallyBound, descriptorBindingUpdateUnusedWhilePending,
+// runtimeDescriptorArray and the matching *UpdateAfterBind features enabled.
+//
+// Indices that are freed are not handed out again until every frame that
+// could still be using them has completed. Frames are delimited by
+// BeginFrame(), and FrameCompleted() has to be called with the value
+// BeginFrame() returned once that frame's work is done on the device.
+//
+// This is not thread-safe.
+class BindlessHeap {
+ public:
+  // The bindings of the arrays in the heap's descriptor set.
+  static const uint32_t kSampledImageBinding = 0;
+  static const uint32_t kStorageBufferBinding = 1;
+  static const uint32_t kSamplerBinding = 2;
+  static const uint32_t kNumBindings = 3;
+
+  static const uint32_t kInvalidIndex = 0xFFFFFFFF;
+
+  BindlessHeap(containers::Allocator* allocator, VkDevice* device,
+               uint32_t max_sampled_images, uint32_t max_storage_buffers,
+               uint32_t max_samplers);
+
+  // Each of these writes the resource to a free index in its array and
+  // returns that index.
+  uint32_t AddSampledImage(
+      ::VkImageView view,
+      VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  uint32_t AddStorageBuffer(::VkBuffer buffer, VkDeviceSize offset = 0,
+                            VkDeviceSize range = VK_WHOLE_SIZE);
+  uint32_t AddSampler(::VkSampler sampler);
+
+  // Returns |index| in the array at |binding| to the heap. The index will
+  // be reused once the current frame has completed.
+  void Free(uint32_t binding, uint32_t index);
+
+  // Starts a new frame, and returns the value to pass to FrameCompleted()
+  // once it is done.
+  uint64_t BeginFrame();
+  // Makes every index that was freed during |frame|, or any frame before
+  // it, available again.
+  void FrameCompleted(uint64_t frame);
+
+  // Binds the heap as set |set_index| of |layout|.
+  void Bind(VkCommandBuffer* command_buffer, VkPipelineBindPoint bind_point,
+            ::VkPipelineLayout layout, uint32_t set_index) const;
+
+  ::VkDescriptorSetLayout layout() const { return layout_; }
+  const ::VkDescriptorSet& set() const { return set_; }
+
+ private:
+  // Hands out the indices of one array.
+  struct IndexAllocator {
+    IndexAllocator(containers::Allocator* allocator, uint32_t capacity)
+        : capacity(capacity),
+          next_unused(0),
+          free_indices(allocator),
+          pending(allocator) {}
+    uint32_t capacity;
+    // Every index at or above this one has never been handed out.
+    uint32_t next_unused;
+    containers::vector<uint32_t> free_indices;
+    // Freed indices, and the frame they were freed in, oldest first.
+    containers::deque<std::pair<uint64_t, uint32_t>> pending;
+  };
+
+  uint32_t AllocateIndex(uint32_t binding);
+  void Write(uint32_t binding, VkDescriptorType type, uint32_t index,
+             const VkDescriptorImageInfo* image_info,
+             const VkDescriptorBufferInfo* buffer_info);
+
+  VkDevice* device_;
+  VkDescriptorSetLayout layout_;
+  VkDescriptorPool pool_;
+  // Owned by |pool_|.
+  ::VkDescriptorSet set_;
+  IndexAllocator indices_[kNumBindings];
+  uint64_t current_frame_;
+};
+
+// BindlessIndex owns an index in one of the arrays of a BindlessHeap, and
+// frees it when it is destroyed.
+class BindlessIndex {
+ public:
+  BindlessIndex()
+      : heap_(nullptr), binding_(0), index_(BindlessHeap::kInvalidIndex) {}
+  BindlessIndex(BindlessHeap* heap, uint32_t binding, uint32_t index)
+      : heap_(heap), binding_(binding), index_(index) {}
+  BindlessIndex(BindlessIndex&& other)
+      : heap_(other.heap_), binding_(other.binding_), index_(other.index_) {
+    other.heap_ = nullptr;
+    other.index_ = BindlessHeap::kInvalidIndex;
+  }
+  BindlessIndex(const BindlessIndex& other) = delete;
+  BindlessIndex& operator=(BindlessIndex&& other) {
+    Reset();
+    std::swap(heap_, other.heap_);
+    std::swap(binding_, other.binding_);
+    std::swap(index_, other.index_);
+    return *this;
+  }
+  ~BindlessIndex() { Reset(); }
+
+  void Reset() {
+    if (heap_) {
+      heap_->Free(binding_, index_);
+    }
+    heap_ = nullptr;
+    index_ = BindlessHeap::kInvalidIndex;
+  }
+
+  bool is_valid() const { return heap_ != nullptr; }
+  uint32_t index() const { return index_; }
+
+ private:
+  BindlessHeap* heap_;
+  uint32_t binding_;
+  uint32_t index_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_BINDLESS_HEAP_H_
@@ -152,6 +152,12 @@ class BufferFrameData {
       if ((usage & VK_BUFFER_USAGE_CONDITIONAL_RENDERING_BIT_EXT) != 0) {
         barrier.dstAccessMask |= VK_ACCESS_CONDITIONAL_RENDERING_READ_BIT_EXT;
       }
+      if ((usage & VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT) != 0) {
+        barrier.dstAccessMask |= VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+      }
+      if ((usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) != 0) {
+        barrier.dstAccessMask |= VK_ACCESS_SHADER_READ_BIT;
+      }
       barrier.buffer = *buffer_;
       update_commands_.back()->vkCmdPipelineBarrier(
           update_commands_.back(), VK_PIPELINE_STAGE_TRANSFER_BIT,
@@ -0,0 +1,308 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vulkan_helpers/descriptor_allocator.h"
+
+#include <algorithm>
+
+#include "vulkan_helpers/helper_functions.h"
+
+namespace vulkan {
+namespace {
+// FNV-1a, applied to each field separately so that padding in
+// VkDescriptorSetLayoutBinding does not affect the result.
+template <typename T>
+void HashCombine(size_t* hash, const T& value) {
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    *hash = (*hash ^ bytes[i]) * 1099511628211ull;
+  }
+}
+
+// Returns true if the immutable samplers of |binding| are used. They are
+// ignored for all other descriptor types.
+bool HasImmutableSamplers(const VkDescriptorSetLayoutBinding& binding) {
+  return binding.pImmutableSamplers != nullptr &&
+         (binding.descriptorType == VK_DESCRIPTOR_TYPE_SAMPLER ||
+          binding.descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+}
+
+size_t HashBindings(
+    const std::initializer_list<VkDescriptorSetLayoutBinding>& bindings,
+    VkDescriptorSetLayoutCreateFlags flags) {
+  size_t hash = static_cast<size_t>(14695981039346656037ull);
+  HashCombine(&hash, flags);
+  for (const auto& binding : bindings) {
+    HashCombine(&hash, binding.binding);
+    HashCombine(&hash, binding.descriptorType);
+    HashCombine(&hash, binding.descriptorCount);
+    HashCombine(&hash, binding.stageFlags);
+    const bool has_immutable_samplers = HasImmutableSamplers(binding);
+    HashCombine(&hash, has_immutable_samplers);
+    if (has_immutable_samplers) {
+      for (uint32_t i = 0; i < binding.descriptorCount; ++i) {
+        HashCombine(&hash, binding.pImmutableSamplers[i]);
+      }
+    }
+  }
+  return hash;
+}
+
+bool BindingsEqual(const VkDescriptorSetLayoutBinding& a,
+                   const VkDescriptorSetLayoutBinding& b) {
+  if (a.binding != b.binding || a.descriptorType != b.descriptorType ||
+      a.descriptorCount != b.descriptorCount ||
+      a.stageFlags != b.stageFlags ||
+      HasImmutableSamplers(a) != HasImmutableSamplers(b)) {
+    return false;
+  }
+  return !HasImmutableSamplers(a) ||
+         std::equal(a.pImmutableSamplers,
+                    a.pImmutableSamplers + a.descriptorCount,
+                    b.pImmutableSamplers);
+}
+}  // anonymous namespace
+
+DescriptorAllocator::CachedLayout::CachedLayout(
+    containers::Allocator* allocator,
+    std::initializer_list<VkDescriptorSetLayoutBinding> bindings,
+    VkDescriptorSetLayoutCreateFlags flags, VkDescriptorSetLayout&& layout)
+    : bindings(bindings, allocator),
+      immutable_samplers(allocator),
+      flags(flags),
+      layout(std::move(layout)) {
+  size_t num_samplers = 0;
+  for (const auto& binding : bindings) {
+    if (HasImmutableSamplers(binding)) {
+      num_samplers += binding.descriptorCount;
+    }
+  }
+  // Reserve everything up front, so that the pointers stay valid.
+  immutable_samplers.reserve(num_samplers);
+  for (auto& binding : this->bindings) {
+    if (HasImmutableSamplers(binding)) {
+      const size_t first = immutable_samplers.size();
+      immutable_samplers.insert(
+          immutable_samplers.end(), binding.pImmutableSamplers,
+          binding.pImmutableSamplers + binding.descriptorCount);
+      binding.pImmutableSamplers = immutable_samplers.data() + first;
+    } else {
+      binding.pImmutableSamplers = nullptr;
+    }
+  }
+}
+
+DescriptorAllocator::DescriptorAllocator(containers::Allocator* allocator,
+                                         VkDevice* device,
+                                         uint32_t sets_per_pool,
+                                         VkDescriptorPoolCreateFlags pool_flags,
+                                         uint32_t max_sets_per_pool)
+    : allocator_(allocator),
+      device_(device),
+      pool_flags_(pool_flags),
+      sets_per_pool_(sets_per_pool),
+      max_sets_per_pool_(std::max(sets_per_pool, max_sets_per_pool)),
+      layouts_(allocator),
+      layout_counts_(allocator),
+      max_descriptor_counts_(allocator),
+      pools_(allocator) {}
+
+::VkDescriptorSetLayout DescriptorAllocator::GetLayout(
+    std::initializer_list<VkDescriptorSetLayoutBinding> bindings,
+    VkDescriptorSetLayoutCreateFlags flags) {
+  const size_t hash = HashBindings(bindings, flags);
+  auto it = layouts_.find(hash);
+  if (it == layouts_.end()) {
+    it = layouts_
+             .emplace(hash, containers::vector<CachedLayout>(allocator_))
+             .first;
+  }
+
+  for (const auto& cached : it->second) {
+    if (cached.flags != flags || cached.bindings.size() != bindings.size()) {
+      continue;
+    }
+    if (std::equal(bindings.begin(), bindings.end(), cached.bindings.begin(),
+                   BindingsEqual)) {
+      return cached.layout;
+    }
+  }
+
+  // Grow the pools that get created from now on, so that they can hold
+  // |sets_per_pool_| of this layout as well.
+  containers::unordered_map<uint32_t, uint32_t> counts(allocator_);
+  for (const auto& binding : bindings) {
+    counts[static_cast<uint32_t>(binding.descriptorType)] +=
+        binding.descriptorCount;
+  }
+  containers::vector<VkDescriptorPoolSize> layout_counts(allocator_);
+  layout_counts.reserve(counts.size());
+  for (const auto& count : counts) {
+    if (count.second == 0) {
+      continue;
+    }
+    uint32_t& max_count = max_descriptor_counts_[count.first];
+    max_count = std::max(max_count, count.second);
+    layout_counts.push_back(
+        {static_cast<VkDescriptorType>(count.first), count.second});
+  }
+
+  it->second.emplace_back(
+      allocator_, bindings, flags,
+      CreateDescriptorSetLayout(allocator_, device_, bindings, flags));
+  ::VkDescriptorSetLayout layout = it->second.back().layout;
+  layout_counts_.emplace(layout, std::move(layout_counts));
+  return layout;
+}
+
+DescriptorAllocator::Pool DescriptorAllocator::CreatePool(
+    uint32_t num_sets) {
+  containers::vector<VkDescriptorPoolSize> pool_sizes(allocator_);
+  pool_sizes.reserve(max_descriptor_counts_.size());
+  for (const auto& count : max_descriptor_counts_) {
+    pool_sizes.push_back(
+        {static_cast<VkDescriptorType>(count.first), count.second * num_sets});
+  }
+
+  VkDescriptorPoolCreateInfo info{
+      /* sType = */ VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+      /* pNext = */ nullptr,
+      /* flags = */ pool_flags_,
+      /* maxSets = */ num_sets,
+      /* poolSizeCount = */ static_cast<uint32_t>(pool_sizes.size()),
+      /* pPoolSizes = */ pool_sizes.data()};
+
+  ::VkDescriptorPool raw_pool;
+  LOG_ASSERT(==, device_->GetLogger(), VK_SUCCESS,
+             (*device_)->vkCreateDescriptorPool(*device_, &info, nullptr,
+                                                &raw_pool));
+  return Pool(VkDescriptorPool(raw_pool, nullptr, device_), num_sets,
+              std::move(pool_sizes));
+}
+
+bool DescriptorAllocator::HasRoom(
+    const Pool& pool, const containers::vector<VkDescriptorPoolSize>& counts) {
+  if (pool.free_sets == 0) {
+    return false;
+  }
+  for (const auto& count : counts) {
+    auto free = std::find_if(pool.free_descriptors.begin(),
+                             pool.free_descriptors.end(),
+                             [&count](const VkDescriptorPoolSize& size) {
+                               return size.type == count.type;
+                             });
+    if (free == pool.free_descriptors.end() ||
+        free->descriptorCount < count.descriptorCount) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void DescriptorAllocator::Account(
+    Pool* pool, const containers::vector<VkDescriptorPoolSize>& counts,
+    bool allocated) {
+  pool->free_sets = allocated ? pool->free_sets - 1 : pool->free_sets + 1;
+  for (const auto& count : counts) {
+    for (auto& free : pool->free_descriptors) {
+      if (free.type != count.type) {
+        continue;
+      }
+      if (allocated) {
+        free.descriptorCount -= count.descriptorCount;
+      } else {
+        free.descriptorCount += count.descriptorCount;
+      }
+    }
+  }
+}
+
+::VkDescriptorSet DescriptorAllocator::Allocate(::VkDescriptorSetLayout layout,
+                                                ::VkDescriptorPool* pool) {
+  auto counts = layout_counts_.find(layout);
+  LOG_ASSERT(==, device_->GetLogger(), true,
+             counts != layout_counts_.end());
+
+  VkDescriptorSetAllocateInfo alloc_info{
+      /* sType = */ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+      /* pNext = */ nullptr,
+      /* descriptorPool = */ VK_NULL_HANDLE,
+      /* descriptorSetCount = */ 1,
+      /* pSetLayouts = */ &layout,
+  };
+  ::VkDescriptorSet set = VK_NULL_HANDLE;
+
+  // Take the set from the first pool that has room for it. Pools that allow
+  // freeing sets can still fail if they are fragmented.
+  for (auto& candidate : pools_) {
+    if (!HasRoom(candidate, counts->second)) {
+      continue;
+    }
+    alloc_info.descriptorPool = candidate.pool;
+    VkResult result =
+        (*device_)->vkAllocateDescriptorSets(*device_, &alloc_info, &set);
+    if (result == VK_SUCCESS) {
+      Account(&candidate, counts->second, true);
+      if (pool) {
+        *pool = candidate.pool;
+      }
+      return set;
+    }
+    LOG_ASSERT(==, device_->GetLogger(), true,
+               result == VK_ERROR_FRAGMENTED_POOL ||
+                   result == VK_ERROR_OUT_OF_POOL_MEMORY);
+  }
+
+  const uint32_t num_sets =
+      pools_.empty() ? sets_per_pool_
+                     : std::min(pools_.back().num_sets * 2, max_sets_per_pool_);
+  pools_.push_back(CreatePool(num_sets));
+  Pool& new_pool = pools_.back();
+
+  alloc_info.descriptorPool = new_pool.pool;
+  LOG_ASSERT(==, device_->GetLogger(), VK_SUCCESS,
+             (*device_)->vkAllocateDescriptorSets(*device_, &alloc_info, &set));
+  Account(&new_pool, counts->second, true);
+  if (pool) {
+    *pool = new_pool.pool;
+  }
+  return set;
+}
+
+void DescriptorAllocator::Free(::VkDescriptorSet set,
+                               ::VkDescriptorSetLayout layout,
+                               ::VkDescriptorPool pool) {
+  auto counts = layout_counts_.find(layout);
+  LOG_ASSERT(==, device_->GetLogger(), true,
+             counts != layout_counts_.end());
+  auto owner = std::find_if(
+      pools_.begin(), pools_.end(),
+      [pool](const Pool& candidate) { return candidate.pool == pool; });
+  LOG_ASSERT(==, device_->GetLogger(), true, owner != pools_.end());
+  LOG_ASSERT(==, device_->GetLogger(), VK_SUCCESS,
+             (*device_)->vkFreeDescriptorSets(*device_, pool, 1, &set));
+  Account(&*owner, counts->second, false);
+}
+
+void DescriptorAllocator::Reset() {
+  for (auto& pool : pools_) {
+    LOG_ASSERT(==, device_->GetLogger(), VK_SUCCESS,
+               (*device_)->vkResetDescriptorPool(*device_, pool.pool, 0));
+    pool.free_sets = pool.num_sets;
+    pool.free_descriptors = pool.sizes;
+  }
+}
+
+}  // namespace vulkan
@@ -0,0 +1,149 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_DESCRIPTOR_ALLOCATOR_H_
+#define VULKAN_HELPERS_DESCRIPTOR_ALLOCATOR_H_
+
+#include <cstdint>
+#include <initializer_list>
+#include <utility>
+
+#include "support/containers/allocator.h"
+#include "support/containers/unordered_map.h"
+#include "support/containers/vector.h"
+#include "vulkan_wrapper/device_wrapper.h"
+#include "vulkan_wrapper/sub_objects.h"
+
+namespace vulkan {
+
+// DescriptorAllocator hands out descriptor sets from a chain of shared
+// VkDescriptorPools, and caches the VkDescriptorSetLayouts used for them.
+//
+// Layouts are cached by the hash of their bindings and flags, so asking for
+// the same bindings twice returns the same VkDescriptorSetLayout. Immutable
+// samplers are compared by their handles.
+// Pools are sized to hold |sets_per_pool| sets of the largest layout (per
+// descriptor type) that has been seen so far. The number of sets and of
+// descriptors of every type that are left in each pool is counted, and sets
+// come from the first pool in the chain with room for them. Only if there is
+// none, a new pool is created with twice as many sets, up to
+// |max_sets_per_pool|. No pool is ever asked for more than it has left, which
+// Vulkan 1.0 without VK_KHR_maintenance1 does not allow.
+//
+// Reset() returns every set to the pools with one vkResetDescriptorPool per
+// pool, which makes a DescriptorAllocator per frame in flight a cheap way to
+// allocate transient sets. Individual sets can only be freed with Free(), if
+// |pool_flags| contains VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
+// and their room is then reused by the next allocations.
+//
+// This is not thread-safe.
+class DescriptorAllocator {
+ public:
+  DescriptorAllocator(containers::Allocator* allocator, VkDevice* device,
+                      uint32_t sets_per_pool = 64,
+                      VkDescriptorPoolCreateFlags pool_flags = 0,
+                      uint32_t max_sets_per_pool = 4096);
+
+  DescriptorAllocator(DescriptorAllocator&& other) = default;
+  DescriptorAllocator(const DescriptorAllocator& other) = delete;
+
+  // Returns the cached layout for the given bindings and flags, creating
+  // it if this is the first time it has been asked for. The layout is owned
+  // by this allocator.
+  ::VkDescriptorSetLayout GetLayout(
+      std::initializer_list<VkDescriptorSetLayoutBinding> bindings,
+      VkDescriptorSetLayoutCreateFlags flags = 0);
+
+  // Allocates a descriptor set for a layout that was returned from
+  // GetLayout(). The set is owned by the pool it was allocated from, which
+  // is written to |pool| if it is not nullptr.
+  ::VkDescriptorSet Allocate(::VkDescriptorSetLayout layout,
+                             ::VkDescriptorPool* pool = nullptr);
+
+  // Frees |set|, which was allocated with |layout| from |pool|, and makes its
+  // room available again. It must not be in use by the device.
+  void Free(::VkDescriptorSet set, ::VkDescriptorSetLayout layout,
+            ::VkDescriptorPool pool);
+
+  // Returns all of the sets allocated from this allocator to their pools.
+  // None of them may be in use by the device. The cached layouts are kept.
+  void Reset();
+
+  // The number of VkDescriptorPools that have been created so far.
+  size_t num_pools() const { return pools_.size(); }
+
+ private:
+  struct CachedLayout {
+    CachedLayout(containers::Allocator* allocator,
+                 std::initializer_list<VkDescriptorSetLayoutBinding> bindings,
+                 VkDescriptorSetLayoutCreateFlags flags,
+                 VkDescriptorSetLayout&& layout);
+    CachedLayout(CachedLayout&& other) = default;
+    // The bindings point into |immutable_samplers|, not at the samplers that
+    // were passed in.
+    containers::vector<VkDescriptorSetLayoutBinding> bindings;
+    containers::vector<::VkSampler> immutable_samplers;
+    VkDescriptorSetLayoutCreateFlags flags;
+    VkDescriptorSetLayout layout;
+  };
+
+  // A pool in the chain, and how much is left in it.
+  struct Pool {
+    Pool(VkDescriptorPool&& pool, uint32_t num_sets,
+         containers::vector<VkDescriptorPoolSize>&& sizes)
+        : pool(std::move(pool)),
+          num_sets(num_sets),
+          free_sets(num_sets),
+          sizes(sizes),
+          free_descriptors(std::move(sizes)) {}
+    Pool(Pool&& other) = default;
+    VkDescriptorPool pool;
+    uint32_t num_sets;
+    uint32_t free_sets;
+    containers::vector<VkDescriptorPoolSize> sizes;
+    containers::vector<VkDescriptorPoolSize> free_descriptors;
+  };
+
+  // Creates a new pool sized for |num_sets| of the largest known layout.
+  Pool CreatePool(uint32_t num_sets);
+  // Returns true if |pool| has room for a set with |counts| descriptors.
+  static bool HasRoom(const Pool& pool,
+                      const containers::vector<VkDescriptorPoolSize>& counts);
+  // Takes the room for a set with |counts| descriptors from |pool| if
+  // |allocated| is true, and gives it back otherwise.
+  static void Account(Pool* pool,
+                      const containers::vector<VkDescriptorPoolSize>& counts,
+                      bool allocated);
+
+  containers::Allocator* allocator_;
+  VkDevice* device_;
+  VkDescriptorPoolCreateFlags pool_flags_;
+  uint32_t sets_per_pool_;
+  uint32_t max_sets_per_pool_;
+  // Maps from the hash of the bindings to every layout with that hash.
+  containers::unordered_map<size_t, containers::vector<CachedLayout>>
+      layouts_;
+  // The number of descriptors of each type in every cached layout.
+  containers::unordered_map<::VkDescriptorSetLayout,
+                            containers::vector<VkDescriptorPoolSize>>
+      layout_counts_;
+  // The largest number of descriptors of each type in a single layout.
+  containers::unordered_map<uint32_t, uint32_t> max_descriptor_counts_;
+  containers::vector<Pool> pools_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_DESCRIPTOR_ALLOCATOR_H_
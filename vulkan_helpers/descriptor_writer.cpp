@@ -0,0 +1,316 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vulkan_helpers/descriptor_writer.h"
+
+#include <cstring>
+#include <utility>
+
+namespace vulkan {
+namespace {
+template <typename T>
+void HashCombine(size_t* hash, const T& value) {
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    *hash = (*hash ^ bytes[i]) * 1099511628211ull;
+  }
+}
+}  // anonymous namespace
+
+DescriptorWriter::DescriptorWriter(containers::Allocator* allocator,
+                                   VkDevice* device,
+                                   uint32_t template_threshold)
+    : allocator_(allocator),
+      device_(device),
+      template_threshold_(template_threshold),
+      num_templates_(0),
+      sets_(allocator),
+      writes_(allocator),
+      image_infos_(allocator),
+      buffer_infos_(allocator),
+      texel_buffer_views_(allocator),
+      layout_keys_(allocator),
+      write_structs_(allocator),
+      write_struct_sets_(allocator),
+      template_data_(allocator),
+      templates_(allocator) {}
+
+DescriptorWriter& DescriptorWriter::Begin(
+    ::VkDescriptorSet set, ::VkDescriptorSetLayout layout,
+    std::initializer_list<VkDescriptorSetLayoutBinding> bindings) {
+  const size_t layout_key_offset = layout_keys_.size();
+  auto append = [this](const void* value, size_t size) {
+    layout_keys_.append(reinterpret_cast<const char*>(value), size);
+  };
+  for (const auto& binding : bindings) {
+    append(&binding.binding, sizeof(binding.binding));
+    append(&binding.descriptorType, sizeof(binding.descriptorType));
+    append(&binding.descriptorCount, sizeof(binding.descriptorCount));
+    append(&binding.stageFlags, sizeof(binding.stageFlags));
+    const bool has_immutable_samplers =
+        binding.pImmutableSamplers != nullptr &&
+        (binding.descriptorType == VK_DESCRIPTOR_TYPE_SAMPLER ||
+         binding.descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    append(&has_immutable_samplers, sizeof(has_immutable_samplers));
+    if (has_immutable_samplers) {
+      append(binding.pImmutableSamplers,
+             sizeof(::VkSampler) * binding.descriptorCount);
+    }
+  }
+  sets_.push_back({set, layout, layout_key_offset,
+                   layout_keys_.size() - layout_key_offset, writes_.size(),
+                   0});
+  return *this;
+}
+
+DescriptorWriter& DescriptorWriter::AddWrite(uint32_t binding,
+                                             VkDescriptorType type,
+                                             InfoKind kind, size_t first_info,
+                                             uint32_t count,
+                                             uint32_t array_element) {
+  LOG_ASSERT(==, device_->GetLogger(), false, sets_.empty());
+  writes_.push_back({binding, array_element, count, type, kind, first_info});
+  sets_.back().num_writes++;
+  return *this;
+}
+
+DescriptorWriter& DescriptorWriter::WriteBuffers(
+    uint32_t binding, VkDescriptorType type,
+    const VkDescriptorBufferInfo* infos, uint32_t count,
+    uint32_t array_element) {
+  size_t first = buffer_infos_.size();
+  buffer_infos_.insert(buffer_infos_.end(), infos, infos + count);
+  return AddWrite(binding, type, InfoKind::kBuffer, first, count,
+                  array_element);
+}
+
+DescriptorWriter& DescriptorWriter::WriteImages(
+    uint32_t binding, VkDescriptorType type, const VkDescriptorImageInfo* infos,
+    uint32_t count, uint32_t array_element) {
+  size_t first = image_infos_.size();
+  image_infos_.insert(image_infos_.end(), infos, infos + count);
+  return AddWrite(binding, type, InfoKind::kImage, first, count,
+                  array_element);
+}
+
+DescriptorWriter& DescriptorWriter::WriteTexelBuffers(
+    uint32_t binding, VkDescriptorType type, const ::VkBufferView* views,
+    uint32_t count, uint32_t array_element) {
+  size_t first = texel_buffer_views_.size();
+  texel_buffer_views_.insert(texel_buffer_views_.end(), views, views + count);
+  return AddWrite(binding, type, InfoKind::kTexelBuffer, first, count,
+                  array_element);
+}
+
+bool DescriptorWriter::Matches(const UpdateTemplate& update_template,
+                               const PendingSet& set) const {
+  if (update_template.entries.size() != set.num_writes ||
+      layout_keys_.compare(set.layout_key_offset, set.layout_key_size,
+                           update_template.layout_key) != 0) {
+    return false;
+  }
+  for (size_t i = 0; i < set.num_writes; ++i) {
+    const PendingWrite& write = writes_[set.first_write + i];
+    const VkDescriptorUpdateTemplateEntry& entry = update_template.entries[i];
+    if (entry.dstBinding != write.binding ||
+        entry.dstArrayElement != write.array_element ||
+        entry.descriptorCount != write.count ||
+        entry.descriptorType != write.type) {
+      return false;
+    }
+  }
+  return true;
+}
+
+DescriptorWriter::UpdateTemplate* DescriptorWriter::FindTemplate(
+    const PendingSet& set) {
+  size_t hash = static_cast<size_t>(14695981039346656037ull);
+  for (size_t i = 0; i < set.layout_key_size; ++i) {
+    HashCombine(&hash, layout_keys_[set.layout_key_offset + i]);
+  }
+  for (size_t i = 0; i < set.num_writes; ++i) {
+    const PendingWrite& write = writes_[set.first_write + i];
+    HashCombine(&hash, write.binding);
+    HashCombine(&hash, write.array_element);
+    HashCombine(&hash, write.count);
+    HashCombine(&hash, write.type);
+  }
+
+  auto it = templates_.find(hash);
+  if (it == templates_.end()) {
+    it = templates_
+             .emplace(hash, containers::vector<UpdateTemplate>(allocator_))
+             .first;
+  }
+  for (auto& candidate : it->second) {
+    if (Matches(candidate, set)) {
+      return &candidate;
+    }
+  }
+
+  it->second.emplace_back(
+      allocator_, device_,
+      containers::string(layout_keys_, set.layout_key_offset,
+                         set.layout_key_size, allocator_));
+  UpdateTemplate* update_template = &it->second.back();
+  update_template->entries.reserve(set.num_writes);
+  for (size_t i = 0; i < set.num_writes; ++i) {
+    const PendingWrite& write = writes_[set.first_write + i];
+    size_t stride = 0;
+    switch (write.kind) {
+      case InfoKind::kImage:
+        stride = sizeof(VkDescriptorImageInfo);
+        break;
+      case InfoKind::kBuffer:
+        stride = sizeof(VkDescriptorBufferInfo);
+        break;
+      case InfoKind::kTexelBuffer:
+        stride = sizeof(::VkBufferView);
+        break;
+    }
+    update_template->entries.push_back({
+        write.binding,               // dstBinding
+        write.array_element,         // dstArrayElement
+        write.count,                 // descriptorCount
+        write.type,                  // descriptorType
+        update_template->data_size,  // offset
+        stride                       // stride
+    });
+    update_template->data_size += stride * write.count;
+  }
+  return update_template;
+}
+
+void DescriptorWriter::CreateTemplate(UpdateTemplate* update_template,
+                                      ::VkDescriptorSetLayout layout) {
+  VkDescriptorUpdateTemplateCreateInfo create_info{
+      VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO,  // sType
+      nullptr,                                                   // pNext
+      0,                                                         // flags
+      static_cast<uint32_t>(
+          update_template->entries.size()),  // descriptorUpdateEntryCount
+      update_template->entries.data(),       // pDescriptorUpdateEntries
+      VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET,  // templateType
+      layout,                           // descriptorSetLayout
+      VK_PIPELINE_BIND_POINT_GRAPHICS,  // pipelineBindPoint (ignored)
+      VK_NULL_HANDLE,                   // pipelineLayout (ignored)
+      0                                 // set (ignored)
+  };
+  ::VkDescriptorUpdateTemplate raw_template;
+  LOG_ASSERT(==, device_->GetLogger(), VK_SUCCESS,
+             (*device_)->vkCreateDescriptorUpdateTemplateKHR(
+                 *device_, &create_info, nullptr, &raw_template));
+  update_template->update_template.initialize(raw_template);
+  ++num_templates_;
+}
+
+void DescriptorWriter::PackTemplateData(const UpdateTemplate& update_template,
+                                        const PendingSet& set) {
+  template_data_.resize(update_template.data_size);
+  for (size_t i = 0; i < set.num_writes; ++i) {
+    const PendingWrite& write = writes_[set.first_write + i];
+    const VkDescriptorUpdateTemplateEntry& entry = update_template.entries[i];
+    const void* source = nullptr;
+    switch (write.kind) {
+      case InfoKind::kImage:
+        source = &image_infos_[write.first_info];
+        break;
+      case InfoKind::kBuffer:
+        source = &buffer_infos_[write.first_info];
+        break;
+      case InfoKind::kTexelBuffer:
+        source = &texel_buffer_views_[write.first_info];
+        break;
+    }
+    memcpy(template_data_.data() + entry.offset, source,
+           entry.stride * write.count);
+  }
+}
+
+void DescriptorWriter::FlushWriteStructs() {
+  if (!write_structs_.empty()) {
+    (*device_)->vkUpdateDescriptorSets(
+        *device_, static_cast<uint32_t>(write_structs_.size()),
+        write_structs_.data(), 0, nullptr);
+  }
+  write_structs_.clear();
+  write_struct_sets_.clear();
+}
+
+void DescriptorWriter::Flush() {
+  write_structs_.clear();
+  write_structs_.reserve(writes_.size());
+  write_struct_sets_.clear();
+
+  for (const PendingSet& set : sets_) {
+    if (set.num_writes == 0) {
+      continue;
+    }
+    if (template_threshold_ != 0) {
+      UpdateTemplate* update_template = FindTemplate(set);
+      if (update_template->update_template == VK_NULL_HANDLE &&
+          ++update_template->uses >= template_threshold_) {
+        CreateTemplate(update_template, set.layout);
+      }
+      if (update_template->update_template != VK_NULL_HANDLE) {
+        // Earlier writes to the same set that are still batched have to be
+        // applied first, or they would overwrite this one.
+        if (write_struct_sets_.count(set.set) != 0) {
+          FlushWriteStructs();
+        }
+        PackTemplateData(*update_template, set);
+        (*device_)->vkUpdateDescriptorSetWithTemplateKHR(
+            *device_, set.set, update_template->update_template,
+            static_cast<const void*>(template_data_.data()));
+        continue;
+      }
+    }
+
+    write_struct_sets_.insert(set.set);
+    for (size_t i = 0; i < set.num_writes; ++i) {
+      const PendingWrite& write = writes_[set.first_write + i];
+      write_structs_.push_back({
+          VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,  // sType
+          nullptr,                                 // pNext
+          set.set,                                 // dstSet
+          write.binding,                           // dstbinding
+          write.array_element,                     // dstArrayElement
+          write.count,                             // descriptorCount
+          write.type,                              // descriptorType
+          write.kind == InfoKind::kImage ? &image_infos_[write.first_info]
+                                         : nullptr,  // pImageInfo
+          write.kind == InfoKind::kBuffer ? &buffer_infos_[write.first_info]
+                                          : nullptr,  // pBufferInfo
+          write.kind == InfoKind::kTexelBuffer
+              ? &texel_buffer_views_[write.first_info]
+              : nullptr,  // pTexelBufferView
+      });
+    }
+  }
+
+  FlushWriteStructs();
+  Clear();
+}
+
+void DescriptorWriter::Clear() {
+  sets_.clear();
+  writes_.clear();
+  image_infos_.clear();
+  buffer_infos_.clear();
+  texel_buffer_views_.clear();
+  layout_keys_.clear();
+}
+
+}  // namespace vulkan
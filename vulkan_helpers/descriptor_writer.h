@@ -0,0 +1,190 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_DESCRIPTOR_WRITER_H_
+#define VULKAN_HELPERS_DESCRIPTOR_WRITER_H_
+
+#include <cstdint>
+#include <initializer_list>
+
+#include "support/containers/allocator.h"
+#include "support/containers/string.h"
+#include "support/containers/unordered_map.h"
+#include "support/containers/unordered_set.h"
+#include "support/containers/vector.h"
+#include "vulkan_wrapper/device_wrapper.h"
+#include "vulkan_wrapper/sub_objects.h"
+
+namespace vulkan {
+
+// DescriptorWriter collects descriptor writes for any number of descriptor
+// sets and applies all of them at once in Flush().
+//
+// Writes that are not handled by a template are passed to a single
+// vkUpdateDescriptorSets call. If |template_threshold| is not 0, every set
+// that has been written with the same layout bindings and the same sequence
+// of (binding, array element, count, type) writes |template_threshold| times
+// gets a VkDescriptorUpdateTemplate, and later sets with that shape are
+// updated through vkUpdateDescriptorSetWithTemplateKHR instead. Templates
+// are looked up by the bindings rather than the layout handle, so they stay
+// correct when a layout is destroyed and its handle reused. Templates need
+// VK_KHR_descriptor_update_template or Vulkan 1.1.
+//
+// Writes to the same set are applied in the order they were made, even if
+// some of them go through a template and some do not.
+//
+// Usage:
+//   writer.Begin(set, layout, {camera_binding, image_binding})
+//       .WriteBuffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, camera_info)
+//       .WriteImage(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, image_info);
+//   ... more sets ...
+//   writer.Flush();
+//
+// The write infos are copied, so they do not have to outlive the Write*
+// calls. This is not thread-safe.
+class DescriptorWriter {
+ public:
+  DescriptorWriter(containers::Allocator* allocator, VkDevice* device,
+                   uint32_t template_threshold = 0);
+
+  // Directs all following writes to |set|, which must have been allocated
+  // with |layout|. |bindings| are the bindings |layout| was created with.
+  DescriptorWriter& Begin(
+      ::VkDescriptorSet set, ::VkDescriptorSetLayout layout,
+      std::initializer_list<VkDescriptorSetLayoutBinding> bindings);
+
+  DescriptorWriter& WriteBuffer(uint32_t binding, VkDescriptorType type,
+                                const VkDescriptorBufferInfo& info,
+                                uint32_t array_element = 0) {
+    return WriteBuffers(binding, type, &info, 1, array_element);
+  }
+  DescriptorWriter& WriteBuffers(uint32_t binding, VkDescriptorType type,
+                                 const VkDescriptorBufferInfo* infos,
+                                 uint32_t count, uint32_t array_element = 0);
+
+  DescriptorWriter& WriteImage(uint32_t binding, VkDescriptorType type,
+                               const VkDescriptorImageInfo& info,
+                               uint32_t array_element = 0) {
+    return WriteImages(binding, type, &info, 1, array_element);
+  }
+  DescriptorWriter& WriteImages(uint32_t binding, VkDescriptorType type,
+                                const VkDescriptorImageInfo* infos,
+                                uint32_t count, uint32_t array_element = 0);
+
+  DescriptorWriter& WriteTexelBuffer(uint32_t binding, VkDescriptorType type,
+                                     ::VkBufferView view,
+                                     uint32_t array_element = 0) {
+    return WriteTexelBuffers(binding, type, &view, 1, array_element);
+  }
+  DescriptorWriter& WriteTexelBuffers(uint32_t binding, VkDescriptorType type,
+                                      const ::VkBufferView* views,
+                                      uint32_t count,
+                                      uint32_t array_element = 0);
+
+  // Applies all of the writes since the last Flush().
+  void Flush();
+
+  // Drops all of the writes since the last Flush() without applying them.
+  void Clear();
+
+  // The number of VkDescriptorUpdateTemplates that have been created.
+  size_t num_templates() const { return num_templates_; }
+
+ private:
+  enum class InfoKind { kImage, kBuffer, kTexelBuffer };
+
+  struct PendingWrite {
+    uint32_t binding;
+    uint32_t array_element;
+    uint32_t count;
+    VkDescriptorType type;
+    InfoKind kind;
+    // Index of the first info in the array that matches |kind|.
+    size_t first_info;
+  };
+
+  struct PendingSet {
+    ::VkDescriptorSet set;
+    ::VkDescriptorSetLayout layout;
+    // The bindings of |layout|, in |layout_keys_|.
+    size_t layout_key_offset;
+    size_t layout_key_size;
+    size_t first_write;
+    size_t num_writes;
+  };
+
+  // A template candidate: the bindings of a layout and the shape of the
+  // writes to it.
+  struct UpdateTemplate {
+    UpdateTemplate(containers::Allocator* allocator, VkDevice* device,
+                   containers::string&& layout_key)
+        : layout_key(std::move(layout_key)),
+          entries(allocator),
+          data_size(0),
+          uses(0),
+          update_template(VK_NULL_HANDLE, nullptr, device) {}
+    UpdateTemplate(UpdateTemplate&& other) = default;
+    containers::string layout_key;
+    containers::vector<VkDescriptorUpdateTemplateEntry> entries;
+    size_t data_size;
+    uint32_t uses;
+    VkDescriptorUpdateTemplate update_template;
+  };
+
+  DescriptorWriter& AddWrite(uint32_t binding, VkDescriptorType type,
+                             InfoKind kind, size_t first_info, uint32_t count,
+                             uint32_t array_element);
+  // Returns the template candidate for the given set, creating it if needed.
+  UpdateTemplate* FindTemplate(const PendingSet& set);
+  bool Matches(const UpdateTemplate& update_template,
+               const PendingSet& set) const;
+  // Creates the VkDescriptorUpdateTemplate for sets with |layout|.
+  void CreateTemplate(UpdateTemplate* update_template,
+                      ::VkDescriptorSetLayout layout);
+  // Applies the writes in |write_structs_|.
+  void FlushWriteStructs();
+  // Packs the infos of |set| into |template_data_| at the template offsets.
+  void PackTemplateData(const UpdateTemplate& update_template,
+                        const PendingSet& set);
+
+  containers::Allocator* allocator_;
+  VkDevice* device_;
+  uint32_t template_threshold_;
+  size_t num_templates_;
+
+  containers::vector<PendingSet> sets_;
+  containers::vector<PendingWrite> writes_;
+  containers::vector<VkDescriptorImageInfo> image_infos_;
+  containers::vector<VkDescriptorBufferInfo> buffer_infos_;
+  containers::vector<::VkBufferView> texel_buffer_views_;
+
+  // The bindings of the layouts of |sets_|.
+  containers::string layout_keys_;
+
+  // Scratch storage reused by every Flush().
+  containers::vector<VkWriteDescriptorSet> write_structs_;
+  // The sets that |write_structs_| writes to.
+  containers::unordered_set<::VkDescriptorSet> write_struct_sets_;
+  containers::vector<uint8_t> template_data_;
+
+  // Maps from the hash of a set's shape to every template candidate with
+  // that hash.
+  containers::unordered_map<size_t, containers::vector<UpdateTemplate>>
+      templates_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_DESCRIPTOR_WRITER_H_
@@ -0,0 +1,541 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vulkan_helpers/frame_capture.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "vulkan_helpers/helper_functions.h"
+
+namespace vulkan {
+namespace {
+void AppendBigEndian32(containers::vector<uint8_t>* out, uint32_t value) {
+  out->push_back(static_cast<uint8_t>(value >> 24));
+  out->push_back(static_cast<uint8_t>(value >> 16));
+  out->push_back(static_cast<uint8_t>(value >> 8));
+  out->push_back(static_cast<uint8_t>(value));
+}
+
+uint32_t Crc32(const uint8_t* data, size_t size) {
+  static uint32_t table[256] = {};
+  if (table[1] == 0) {
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; ++k) {
+        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      }
+      table[i] = c;
+    }
+  }
+  uint32_t crc = 0xFFFFFFFFu;
+  for (size_t i = 0; i < size; ++i) {
+    crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return crc ^ 0xFFFFFFFFu;
+}
+
+// Appends a PNG chunk of type |type| that holds |data|.
+void AppendPngChunk(containers::vector<uint8_t>* out, const char* type,
+                    const uint8_t* data, size_t size) {
+  AppendBigEndian32(out, static_cast<uint32_t>(size));
+  const size_t start = out->size();
+  out->insert(out->end(), type, type + 4);
+  out->insert(out->end(), data, data + size);
+  AppendBigEndian32(out, Crc32(out->data() + start, size + 4));
+}
+
+// Appends an RGBA8 PNG of |rows|, which are already prefixed with their
+// filter type. The image data is stored in uncompressed deflate blocks, which
+// is large, but cheap enough not to fall behind the frames being captured.
+void AppendPng(containers::Allocator* allocator,
+               containers::vector<uint8_t>* out, uint32_t width,
+               uint32_t height, const containers::vector<uint8_t>& rows) {
+  const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  out->insert(out->end(), signature, signature + 8);
+
+  containers::vector<uint8_t> header(allocator);
+  AppendBigEndian32(&header, width);
+  AppendBigEndian32(&header, height);
+  const uint8_t format[5] = {
+      8,  // bit depth
+      6,  // color type, RGBA
+      0,  // compression method
+      0,  // filter method
+      0,  // interlace method
+  };
+  header.insert(header.end(), format, format + 5);
+  AppendPngChunk(out, "IHDR", header.data(), header.size());
+
+  const size_t kMaxBlockSize = 0xFFFF;
+  containers::vector<uint8_t> zlib(allocator);
+  zlib.reserve(rows.size() + (rows.size() / kMaxBlockSize + 1) * 5 + 6);
+  zlib.push_back(0x78);
+  zlib.push_back(0x01);
+  uint32_t adler_a = 1;
+  uint32_t adler_b = 0;
+  size_t offset = 0;
+  do {
+    const size_t block_size = std::min(kMaxBlockSize, rows.size() - offset);
+    const bool final_block = offset + block_size == rows.size();
+    zlib.push_back(final_block ? 1 : 0);
+    zlib.push_back(static_cast<uint8_t>(block_size));
+    zlib.push_back(static_cast<uint8_t>(block_size >> 8));
+    zlib.push_back(static_cast<uint8_t>(~block_size));
+    zlib.push_back(static_cast<uint8_t>(~block_size >> 8));
+    for (size_t i = offset; i < offset + block_size; ++i) {
+      adler_a = (adler_a + rows[i]) % 65521;
+      adler_b = (adler_b + adler_a) % 65521;
+    }
+    zlib.insert(zlib.end(), rows.begin() + offset,
+                rows.begin() + offset + block_size);
+    offset += block_size;
+  } while (offset < rows.size());
+  AppendBigEndian32(&zlib, (adler_b << 16) | adler_a);
+  AppendPngChunk(out, "IDAT", zlib.data(), zlib.size());
+
+  AppendPngChunk(out, "IEND", nullptr, 0);
+}
+}  // anonymous namespace
+
+CaptureFormat GetCaptureFormat(logging::Logger* log, const char* name) {
+  if (strcmp(name, "ppm") == 0) {
+    return CaptureFormat::kPpm;
+  } else if (strcmp(name, "png") == 0) {
+    return CaptureFormat::kPng;
+  } else if (strcmp(name, "raw") == 0) {
+    return CaptureFormat::kRaw;
+  } else if (strcmp(name, "stream") == 0) {
+    return CaptureFormat::kStream;
+  }
+  log->LogError("Unknown output format ", name, ", writing ppm instead");
+  return CaptureFormat::kPpm;
+}
+
+FrameCapture::FrameCapture(containers::Allocator* allocator,
+                           logging::Logger* log, VkDevice* device,
+                           uint32_t queue_family_index, uint32_t width,
+                           uint32_t height, VkFormat image_format,
+                           uint64_t first_frame, uint32_t frame_count,
+                           uint32_t frame_stride, CaptureFormat format,
+                           const char* file_name, uint32_t ring_size)
+    : allocator_(allocator),
+      log_(log),
+      device_(device),
+      width_(width),
+      height_(height),
+      bgra_(image_format == VK_FORMAT_B8G8R8A8_UNORM ||
+            image_format == VK_FORMAT_B8G8R8A8_SRGB),
+      first_frame_(first_frame),
+      frame_count_(frame_count),
+      frame_stride_(frame_stride ? frame_stride : 1),
+      format_(format),
+      file_name_(file_name),
+      presented_frames_(0),
+      captured_frames_(0),
+      next_slot_(0),
+      slots_(allocator),
+      encode_queue_(allocator),
+      exiting_(false),
+      encode_buffer_(allocator) {
+  if (device_) {
+    command_pool_ = containers::make_unique<VkCommandPool>(
+        allocator_, CreateDefaultCommandPool(allocator_, *device_, false,
+                                             queue_family_index));
+  }
+  slots_.reserve(ring_size);
+  for (uint32_t i = 0; i < ring_size; ++i) {
+    slots_.push_back(containers::make_unique<Slot>(allocator_, allocator_));
+  }
+  encode_thread_ = std::thread([this]() { EncodeLoop(); });
+}
+
+FrameCapture::~FrameCapture() {
+  Flush();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    exiting_ = true;
+  }
+  slot_queued_.notify_all();
+  encode_thread_.join();
+}
+
+bool FrameCapture::NextFrame() {
+  const uint64_t frame = ++presented_frames_;
+  if (done() || frame < first_frame_) {
+    return false;
+  }
+  return (frame - first_frame_) % frame_stride_ == 0;
+}
+
+FrameCapture::Slot* FrameCapture::AcquireSlot() {
+  Slot* slot = slots_[next_slot_].get();
+  next_slot_ = (next_slot_ + 1) % slots_.size();
+  if (slot->copying) {
+    // Every slot is busy, so the frame loop has to wait for the oldest copy.
+    RetireCopies(true);
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  slot_freed_.wait(lock, [slot]() { return !slot->encoding; });
+  return slot;
+}
+
+void FrameCapture::QueueForEncoding(Slot* slot) {
+  slot->copying = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    slot->encoding = true;
+    encode_queue_.push_back(slot);
+  }
+  slot_queued_.notify_one();
+}
+
+void FrameCapture::RetireCopies(bool wait) {
+  // Copies finish in the order they were submitted, so slots are retired
+  // starting with the oldest one.
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    Slot* slot = slots_[(next_slot_ + i) % slots_.size()].get();
+    if (!slot->copying) {
+      continue;
+    }
+    ::VkFence fence = *slot->fence;
+    if (wait) {
+      LOG_ASSERT(==, log_, VK_SUCCESS,
+                 (*device_)->vkWaitForFences(*device_, 1, &fence, VK_TRUE,
+                                             0xFFFFFFFFFFFFFFFF));
+    } else if ((*device_)->vkGetFenceStatus(*device_, fence) != VK_SUCCESS) {
+      return;
+    }
+    if (!slot->coherent) {
+      VkMappedMemoryRange range{
+          VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,  // sType
+          nullptr,                                // pNext
+          *slot->memory,                          // memory
+          0,                                      // offset
+          VK_WHOLE_SIZE,                          // size
+      };
+      LOG_ASSERT(==, log_, VK_SUCCESS,
+                 (*device_)->vkInvalidateMappedMemoryRanges(*device_, 1,
+                                                            &range));
+    }
+    QueueForEncoding(slot);
+  }
+}
+
+void FrameCapture::CreateDeviceResources(Slot* slot) {
+  const VkDeviceSize size = VkDeviceSize(width_) * height_ * 4;
+  VkBufferCreateInfo create_info{
+      VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
+      nullptr,                               // pNext
+      0,                                     // flags
+      size,                                  // size
+      VK_BUFFER_USAGE_TRANSFER_DST_BIT,      // usage
+      VK_SHARING_MODE_EXCLUSIVE,             // sharingMode
+      0,                                     // queueFamilyIndexCount
+      nullptr                                // pQueueFamilyIndices
+  };
+  ::VkBuffer raw_buffer;
+  LOG_ASSERT(==, log_, VK_SUCCESS,
+             (*device_)->vkCreateBuffer(*device_, &create_info, nullptr,
+                                        &raw_buffer));
+  slot->buffer = containers::make_unique<VkBuffer>(
+      allocator_, VkBuffer(raw_buffer, nullptr, device_));
+
+  VkMemoryRequirements requirements;
+  (*device_)->vkGetBufferMemoryRequirements(*device_, raw_buffer,
+                                            &requirements);
+
+  // Reading back from cached memory is a lot faster, if there is any.
+  const VkPhysicalDeviceMemoryProperties& properties =
+      device_->physical_device_memory_properties();
+  uint32_t memory_index = properties.memoryTypeCount;
+  for (uint32_t i = 0; i < properties.memoryTypeCount; ++i) {
+    const VkMemoryPropertyFlags flags = properties.memoryTypes[i].propertyFlags;
+    if (!(requirements.memoryTypeBits & (1 << i)) ||
+        !(flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) {
+      continue;
+    }
+    if (memory_index == properties.memoryTypeCount ||
+        (flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT)) {
+      memory_index = i;
+    }
+    if (flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) {
+      break;
+    }
+  }
+  LOG_ASSERT(!=, log_, memory_index, properties.memoryTypeCount);
+  slot->coherent = (properties.memoryTypes[memory_index].propertyFlags &
+                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+  slot->memory = containers::make_unique<VkDeviceMemory>(
+      allocator_,
+      AllocateDeviceMemory(device_, memory_index, requirements.size));
+  LOG_ASSERT(==, log_, VK_SUCCESS,
+             (*device_)->vkBindBufferMemory(*device_, raw_buffer,
+                                            *slot->memory, 0));
+  void* mapped = nullptr;
+  LOG_ASSERT(==, log_, VK_SUCCESS,
+             (*device_)->vkMapMemory(*device_, *slot->memory, 0,
+                                     VK_WHOLE_SIZE, 0, &mapped));
+  slot->pixels = static_cast<const uint8_t*>(mapped);
+
+  slot->command_buffer = containers::make_unique<VkCommandBuffer>(
+      allocator_, CreateDefaultCommandBuffer(command_pool_.get(), device_));
+  slot->fence =
+      containers::make_unique<VkFence>(allocator_, CreateFence(device_));
+  slot->semaphore = containers::make_unique<VkSemaphore>(
+      allocator_, CreateSemaphore(device_));
+}
+
+::VkSemaphore FrameCapture::CaptureImage(VkQueue* queue, ::VkImage image,
+                                         VkImageLayout layout,
+                                         ::VkSemaphore wait_semaphore) {
+  LOG_ASSERT(!=, log_, static_cast<VkDevice*>(nullptr), device_);
+  RetireCopies(false);
+  if (!NextFrame()) {
+    return wait_semaphore;
+  }
+
+  Slot* slot = AcquireSlot();
+  if (!slot->buffer) {
+    CreateDeviceResources(slot);
+  }
+  slot->frame = presented_frames_;
+  ::VkFence fence = *slot->fence;
+  LOG_ASSERT(==, log_, VK_SUCCESS,
+             (*device_)->vkResetFences(*device_, 1, &fence));
+
+  VkCommandBuffer& command_buffer = *slot->command_buffer;
+  VkCommandBufferBeginInfo begin_info{
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr,
+      VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr};
+  command_buffer->vkBeginCommandBuffer(command_buffer, &begin_info);
+
+  VkImageMemoryBarrier image_barrier{
+      VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
+      nullptr,                                 // pNext
+      VK_ACCESS_MEMORY_WRITE_BIT,              // srcAccessMask
+      VK_ACCESS_TRANSFER_READ_BIT,             // dstAccessMask
+      layout,                                  // oldLayout
+      VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,    // newLayout
+      VK_QUEUE_FAMILY_IGNORED,                 // srcQueueFamilyIndex
+      VK_QUEUE_FAMILY_IGNORED,                 // dstQueueFamilyIndex
+      image,                                   // image
+      {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}  // subresourceRange
+  };
+  command_buffer->vkCmdPipelineBarrier(
+      command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1,
+      &image_barrier);
+
+  VkBufferImageCopy copy{
+      0,                                     // bufferOffset
+      0,                                     // bufferRowLength
+      0,                                     // bufferImageHeight
+      {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},  // imageSubresource
+      {0, 0, 0},                             // imageOffset
+      {width_, height_, 1},                  // imageExtent
+  };
+  command_buffer->vkCmdCopyImageToBuffer(command_buffer, image,
+                                         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                         *slot->buffer, 1, &copy);
+
+  image_barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  image_barrier.dstAccessMask = 0;
+  image_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  image_barrier.newLayout = layout;
+  VkMemoryBarrier host_barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr,
+                               VK_ACCESS_TRANSFER_WRITE_BIT,
+                               VK_ACCESS_HOST_READ_BIT};
+  command_buffer->vkCmdPipelineBarrier(
+      command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 1,
+      &host_barrier, 0, nullptr, 1, &image_barrier);
+  command_buffer->vkEndCommandBuffer(command_buffer);
+
+  const VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+  ::VkSemaphore signal_semaphore = *slot->semaphore;
+  VkSubmitInfo submit_info{
+      VK_STRUCTURE_TYPE_SUBMIT_INFO,                   // sType
+      nullptr,                                         // pNext
+      wait_semaphore != VK_NULL_HANDLE ? 1u : 0u,      // waitSemaphoreCount
+      &wait_semaphore,                                 // pWaitSemaphores
+      &wait_stage,                                     // pWaitDstStageMask
+      1,                                               // commandBufferCount
+      &command_buffer.get_command_buffer(),            // pCommandBuffers
+      1,                                               // signalSemaphoreCount
+      &signal_semaphore                                // pSignalSemaphores
+  };
+  LOG_ASSERT(==, log_, VK_SUCCESS,
+             (*queue)->vkQueueSubmit(*queue, 1, &submit_info, fence));
+
+  slot->copying = true;
+  ++captured_frames_;
+  return signal_semaphore;
+}
+
+void FrameCapture::CaptureHostData(const uint8_t* data, size_t size) {
+  RetireCopies(false);
+  if (!NextFrame()) {
+    return;
+  }
+  LOG_ASSERT(==, log_, size_t(width_) * height_ * 4, size);
+
+  Slot* slot = AcquireSlot();
+  slot->frame = presented_frames_;
+  slot->host_data.assign(data, data + size);
+  slot->pixels = slot->host_data.data();
+  ++captured_frames_;
+  QueueForEncoding(slot);
+}
+
+void FrameCapture::Flush() {
+  if (device_) {
+    RetireCopies(true);
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  slot_freed_.wait(lock, [this]() {
+    for (auto& slot : slots_) {
+      if (slot->encoding) {
+        return false;
+      }
+    }
+    return true;
+  });
+}
+
+void FrameCapture::EncodeLoop() {
+  while (true) {
+    Slot* slot = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      slot_queued_.wait(
+          lock, [this]() { return exiting_ || !encode_queue_.empty(); });
+      if (encode_queue_.empty()) {
+        return;
+      }
+      slot = encode_queue_.front();
+      encode_queue_.pop_front();
+    }
+    Encode(*slot);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      slot->encoding = false;
+    }
+    slot_freed_.notify_all();
+  }
+}
+
+void FrameCapture::Encode(const Slot& slot) {
+  const size_t num_pixels = size_t(width_) * height_;
+  const size_t red = bgra_ ? 2 : 0;
+  const size_t blue = bgra_ ? 0 : 2;
+  encode_buffer_.clear();
+
+  switch (format_) {
+    case CaptureFormat::kPpm:
+    case CaptureFormat::kStream: {
+      char header[64];
+      const int header_size =
+          snprintf(header, sizeof(header), "P6 %u %u 255\n", width_, height_);
+      encode_buffer_.reserve(header_size + num_pixels * 3);
+      encode_buffer_.insert(encode_buffer_.end(), header,
+                            header + header_size);
+      for (size_t i = 0; i < num_pixels; ++i) {
+        const uint8_t* pixel = slot.pixels + i * 4;
+        encode_buffer_.push_back(pixel[red]);
+        encode_buffer_.push_back(pixel[1]);
+        encode_buffer_.push_back(pixel[blue]);
+      }
+      break;
+    }
+    case CaptureFormat::kRaw: {
+      encode_buffer_.reserve(num_pixels * 4);
+      for (size_t i = 0; i < num_pixels; ++i) {
+        const uint8_t* pixel = slot.pixels + i * 4;
+        const uint8_t rgba[4] = {pixel[red], pixel[1], pixel[blue], pixel[3]};
+        encode_buffer_.insert(encode_buffer_.end(), rgba, rgba + 4);
+      }
+      break;
+    }
+    case CaptureFormat::kPng: {
+      containers::vector<uint8_t> rows(allocator_);
+      rows.reserve(height_ + num_pixels * 4);
+      for (uint32_t y = 0; y < height_; ++y) {
+        rows.push_back(0);  // No filter
+        for (uint32_t x = 0; x < width_; ++x) {
+          const uint8_t* pixel = slot.pixels + (size_t(y) * width_ + x) * 4;
+          const uint8_t rgba[4] = {pixel[red], pixel[1], pixel[blue],
+                                   pixel[3]};
+          rows.insert(rows.end(), rgba, rgba + 4);
+        }
+      }
+      AppendPng(allocator_, &encode_buffer_, width_, height_, rows);
+      break;
+    }
+  }
+
+  char name[4096];
+  FileNameForFrame(slot.frame, name, sizeof(name));
+  if (format_ == CaptureFormat::kStream) {
+    if (!stream_.is_open()) {
+      stream_.open(name, std::ofstream::out | std::ofstream::binary);
+    }
+    stream_.write(reinterpret_cast<const char*>(encode_buffer_.data()),
+                  encode_buffer_.size());
+    stream_.flush();
+  } else {
+    std::ofstream file(name, std::ofstream::out | std::ofstream::binary);
+    file.write(reinterpret_cast<const char*>(encode_buffer_.data()),
+               encode_buffer_.size());
+    file.close();
+  }
+}
+
+void FrameCapture::FileNameForFrame(uint64_t frame, char* name,
+                                    size_t size) const {
+  if (frame_count_ == 1 || format_ == CaptureFormat::kStream) {
+    snprintf(name, size, "%s", file_name_);
+    return;
+  }
+  // Substitute the first %d or %0Nd by hand, so the name is never used as
+  // a format string.
+  for (const char* percent = strchr(file_name_, '%'); percent;
+       percent = strchr(percent + 1, '%')) {
+    const char* spec = percent + 1;
+    int width = 0;
+    if (*spec == '0') {
+      while (*spec >= '0' && *spec <= '9' && width < 100) {
+        width = width * 10 + (*spec++ - '0');
+      }
+    }
+    if (*spec != 'd') {
+      continue;
+    }
+    snprintf(name, size, "%.*s%0*llu%s",
+             static_cast<int>(percent - file_name_), file_name_, width,
+             static_cast<unsigned long long>(frame), spec + 1);
+    return;
+  }
+  const char* extension = strrchr(file_name_, '.');
+  const char* directory = strrchr(file_name_, '/');
+  if (!extension || (directory && extension < directory)) {
+    extension = file_name_ + strlen(file_name_);
+  }
+  snprintf(name, size, "%.*s_%llu%s", static_cast<int>(extension - file_name_),
+           file_name_, static_cast<unsigned long long>(frame), extension);
+}
+
+}  // namespace vulkan
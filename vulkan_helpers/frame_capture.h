@@ -0,0 +1,181 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_FRAME_CAPTURE_H_
+#define VULKAN_HELPERS_FRAME_CAPTURE_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+#include "support/containers/allocator.h"
+#include "support/containers/deque.h"
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "support/log/log.h"
+#include "vulkan_wrapper/command_buffer_wrapper.h"
+#include "vulkan_wrapper/device_wrapper.h"
+#include "vulkan_wrapper/queue_wrapper.h"
+#include "vulkan_wrapper/sub_objects.h"
+
+namespace vulkan {
+
+// The file formats that FrameCapture can write.
+enum class CaptureFormat {
+  // One binary PPM per frame.
+  kPpm,
+  // One uncompressed RGBA PNG per frame.
+  kPng,
+  // One file of tightly packed RGBA8 pixels per frame.
+  kRaw,
+  // Every frame as a PPM, concatenated into a single file.
+  kStream,
+};
+
+// Returns the CaptureFormat named |name| (ppm, png, raw or stream). Logs an
+// error and returns kPpm if there is no such format.
+CaptureFormat GetCaptureFormat(logging::Logger* log, const char* name);
+
+// FrameCapture writes a range of presented frames to disk: |frame_count|
+// frames, |frame_stride| frames apart, starting at the |first_frame|th
+// presented frame (counting from 1).
+//
+// Every presented frame has to be passed to either CaptureImage(), which
+// copies the image into a ring of host-visible buffers on the device, or
+// CaptureHostData(), for pixels that are already on the host. Copies are
+// handed to a background thread once their fence has signaled, and that
+// thread converts and writes them, so the frame loop only waits when every
+// buffer in the ring is still in use.
+//
+// Files are named after |file_name|. If more than one file is written, the
+// first %d or %0Nd in |file_name| is replaced with the frame number, or if
+// there is none, the frame number is added before its extension. Nothing
+// else in |file_name| is interpreted.
+//
+// All member functions have to be called from the same thread.
+class FrameCapture {
+ public:
+  static const uint32_t kDefaultRingSize = 3;
+
+  // Captured images must be |width| x |height| and have an 8-bit RGBA or
+  // BGRA |image_format|. If |device| is nullptr, only CaptureHostData() may
+  // be used. Otherwise copies are recorded in command buffers for
+  // |queue_family_index|.
+  FrameCapture(containers::Allocator* allocator, logging::Logger* log,
+               VkDevice* device, uint32_t queue_family_index, uint32_t width,
+               uint32_t height, VkFormat image_format, uint64_t first_frame,
+               uint32_t frame_count, uint32_t frame_stride,
+               CaptureFormat format, const char* file_name,
+               uint32_t ring_size = kDefaultRingSize);
+  // Waits for every frame to be written.
+  ~FrameCapture();
+
+  // Counts a presented frame, and if it is one of the requested frames,
+  // submits a copy of |image| to |queue|. The copy waits for
+  // |wait_semaphore| if it is not VK_NULL_HANDLE. |image| must be in
+  // |layout|, and is put back into it.
+  //
+  // Returns the semaphore that presenting |image| has to wait for instead of
+  // |wait_semaphore|. This is |wait_semaphore| itself if nothing was copied.
+  ::VkSemaphore CaptureImage(VkQueue* queue, ::VkImage image,
+                             VkImageLayout layout,
+                             ::VkSemaphore wait_semaphore);
+
+  // Counts a presented frame, and if it is one of the requested frames,
+  // copies |size| bytes of |image_format| pixels from |data| and writes them.
+  void CaptureHostData(const uint8_t* data, size_t size);
+
+  // Returns true once every requested frame has been captured. They may not
+  // have been written yet, see Flush().
+  bool done() const { return captured_frames_ == frame_count_; }
+
+  // Waits until every frame that was captured has been written.
+  void Flush();
+
+ private:
+  // One readback buffer in the ring. A slot is free when it is neither
+  // copying nor encoding.
+  struct Slot {
+    Slot(containers::Allocator* allocator) : host_data(allocator) {}
+    uint64_t frame = 0;
+    // Set while the copy into |memory| may still be running. Only used on
+    // the capturing thread.
+    bool copying = false;
+    // Set while the frame is queued for, or being, written. Guarded by
+    // |mutex_|.
+    bool encoding = false;
+    // Only used by CaptureImage().
+    containers::unique_ptr<VkDeviceMemory> memory;
+    containers::unique_ptr<VkBuffer> buffer;
+    containers::unique_ptr<VkCommandBuffer> command_buffer;
+    containers::unique_ptr<VkFence> fence;
+    containers::unique_ptr<VkSemaphore> semaphore;
+    bool coherent = true;
+    // Where the pixels of the frame are, either the mapped |memory| or
+    // |host_data|.
+    const uint8_t* pixels = nullptr;
+    containers::vector<uint8_t> host_data;
+  };
+
+  // Counts a presented frame, and returns true if it has to be captured.
+  bool NextFrame();
+  // Returns the next slot in the ring, once it is free.
+  Slot* AcquireSlot();
+  // Hands every slot whose copy has finished to the encoding thread. If
+  // |wait| is true, waits for the copies first.
+  void RetireCopies(bool wait);
+  void QueueForEncoding(Slot* slot);
+  void CreateDeviceResources(Slot* slot);
+
+  // Runs on |encode_thread_|.
+  void EncodeLoop();
+  void Encode(const Slot& slot);
+  void FileNameForFrame(uint64_t frame, char* name, size_t size) const;
+
+  containers::Allocator* allocator_;
+  logging::Logger* log_;
+  VkDevice* device_;
+  containers::unique_ptr<VkCommandPool> command_pool_;
+  const uint32_t width_;
+  const uint32_t height_;
+  const bool bgra_;
+  const uint64_t first_frame_;
+  const uint32_t frame_count_;
+  const uint32_t frame_stride_;
+  const CaptureFormat format_;
+  const char* file_name_;
+
+  uint64_t presented_frames_;
+  uint32_t captured_frames_;
+  size_t next_slot_;
+  containers::vector<containers::unique_ptr<Slot>> slots_;
+
+  // Guards Slot::encoding, |encode_queue_| and |exiting_|.
+  std::mutex mutex_;
+  std::condition_variable slot_queued_;
+  std::condition_variable slot_freed_;
+  containers::deque<Slot*> encode_queue_;
+  bool exiting_;
+  // Only used by |encode_thread_|.
+  std::ofstream stream_;
+  containers::vector<uint8_t> encode_buffer_;
+  std::thread encode_thread_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_FRAME_CAPTURE_H_
@@ -0,0 +1,373 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vulkan_helpers/gpu_profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+#include "vulkan_helpers/helper_functions.h"
+
+#if defined _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace vulkan {
+namespace {
+// Writes |name| as a JSON string.
+void WriteJsonString(std::ostream& out, const char* name) {
+  out << '"';
+  for (const char* c = name; *c; ++c) {
+    if (*c == '"' || *c == '\\') {
+      out << '\\';
+    }
+    out << *c;
+  }
+  out << '"';
+}
+
+void WriteMetadata(std::ostream& out, const char* type, uint32_t process,
+                   uint32_t track, const char* name) {
+  out << "{\"ph\": \"M\", \"name\": \"" << type << "\", \"pid\": " << process
+      << ", \"tid\": " << track << ", \"args\": {\"name\": ";
+  WriteJsonString(out, name);
+  out << "}}";
+}
+}  // anonymous namespace
+
+GpuProfiler::Scope::Scope(GpuProfiler* profiler,
+                          VkCommandBuffer* command_buffer, const char* name,
+                          uint32_t queue)
+    : profiler_(profiler),
+      command_buffer_(command_buffer),
+      pool_(VK_NULL_HANDLE),
+      query_(UINT32_MAX) {
+  if (!profiler_) {
+    return;
+  }
+  query_ = profiler_->AllocateQueries(name, queue);
+  if (query_ == UINT32_MAX) {
+    return;
+  }
+  pool_ = *profiler_->recording_frame_->pool;
+  (*command_buffer_)
+      ->vkCmdWriteTimestamp(*command_buffer_,
+                            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, pool_, query_);
+}
+
+GpuProfiler::Scope::~Scope() {
+  if (query_ == UINT32_MAX) {
+    return;
+  }
+  (*command_buffer_)
+      ->vkCmdWriteTimestamp(*command_buffer_,
+                            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, pool_,
+                            query_ + 1);
+}
+
+GpuProfiler::CpuScope::CpuScope(GpuProfiler* profiler, const char* name)
+    : profiler_(profiler), name_(name), begin_(HostTime()) {}
+
+GpuProfiler::CpuScope::~CpuScope() {
+  if (profiler_) {
+    profiler_->AddCpuEvent(name_, begin_, HostTime());
+  }
+}
+
+GpuProfiler::GpuProfiler(containers::Allocator* allocator,
+                         VkInstance* instance, VkDevice* device,
+                         uint32_t queue_family_index, uint32_t frame_count,
+                         bool calibrated_timestamps,
+                         uint32_t queries_per_frame)
+    : allocator_(allocator),
+      log_(device->GetLogger()),
+      device_(device),
+      queries_per_frame_(queries_per_frame),
+      calibrated_timestamps_(false),
+#if defined _WIN32
+      host_domain_(VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT),
+#else
+      host_domain_(VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT),
+#endif
+      timestamp_period_(0.0f),
+      timestamp_mask_(0),
+      frames_(allocator),
+      current_frame_(0),
+      recording_frame_(nullptr),
+      dropped_scopes_(0),
+      results_(allocator),
+      events_(allocator),
+      threads_(allocator),
+      queue_names_(allocator) {
+  ::VkPhysicalDevice physical_device = device->physical_device();
+  containers::vector<VkQueueFamilyProperties> families =
+      GetQueueFamilyProperties(allocator, *instance, physical_device);
+  LOG_ASSERT(<, log_, queue_family_index, families.size());
+  const uint32_t valid_bits = families[queue_family_index].timestampValidBits;
+  if (valid_bits == 0) {
+    log_->LogInfo("Queue family ", queue_family_index,
+                  " cannot write timestamps, only CPU scopes are profiled");
+    return;
+  }
+  timestamp_mask_ =
+      valid_bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << valid_bits) - 1;
+  VkPhysicalDeviceProperties properties;
+  (*instance)->vkGetPhysicalDeviceProperties(physical_device, &properties);
+  timestamp_period_ = properties.limits.timestampPeriod;
+
+  if (calibrated_timestamps) {
+    uint32_t count = 0;
+    (*instance)->vkGetPhysicalDeviceCalibrateableTimeDomainsEXT(
+        physical_device, &count, nullptr);
+    containers::vector<VkTimeDomainEXT> domains(
+        count, VK_TIME_DOMAIN_DEVICE_EXT, allocator);
+    (*instance)->vkGetPhysicalDeviceCalibrateableTimeDomainsEXT(
+        physical_device, &count, domains.data());
+    bool has_device = false;
+    bool has_host = false;
+    for (VkTimeDomainEXT domain : domains) {
+      has_device |= domain == VK_TIME_DOMAIN_DEVICE_EXT;
+      has_host |= domain == host_domain_;
+    }
+    calibrated_timestamps_ = has_device && has_host;
+    if (!calibrated_timestamps_) {
+      log_->LogInfo(
+          "The device and host clocks cannot be calibrated, GPU times are "
+          "approximated from the start of each frame");
+    }
+  }
+
+  VkQueryPoolCreateInfo create_info = {
+      VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,  // sType
+      nullptr,                                   // pNext
+      0,                                         // flags
+      VK_QUERY_TYPE_TIMESTAMP,                   // queryType
+      queries_per_frame_,                        // queryCount
+      0,                                         // pipelineStatistics
+  };
+  frames_.reserve(frame_count);
+  for (uint32_t i = 0; i < frame_count; ++i) {
+    frames_.push_back(containers::make_unique<Frame>(allocator, allocator));
+    frames_.back()->pool = containers::make_unique<VkQueryPool>(
+        allocator, CreateQueryPool(device, create_info));
+  }
+  results_.resize(queries_per_frame_);
+}
+
+uint64_t GpuProfiler::HostTime() {
+#if defined _WIN32
+  LARGE_INTEGER counter;
+  QueryPerformanceCounter(&counter);
+  return static_cast<uint64_t>(counter.QuadPart);
+#else
+  timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return static_cast<uint64_t>(time.tv_sec) * 1000000000u +
+         static_cast<uint64_t>(time.tv_nsec);
+#endif
+}
+
+uint64_t GpuProfiler::ToNanoseconds(uint64_t host_time) {
+#if defined _WIN32
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+  return static_cast<uint64_t>(static_cast<double>(host_time) * 1e9 /
+                               static_cast<double>(frequency.QuadPart));
+#else
+  return host_time;
+#endif
+}
+
+void GpuProfiler::BeginFrame(VkCommandBuffer* command_buffer) {
+  if (!gpu_enabled()) {
+    return;
+  }
+  current_frame_ = (current_frame_ + 1) % frames_.size();
+  Frame* frame = frames_[current_frame_].get();
+  // The results of the frame that used this pool last are read back now,
+  // rather than as soon as they are available, because until the reset
+  // below has run on the GPU the pool still holds the previous results.
+  if (frame->pending && !Resolve(frame)) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    dropped_scopes_ += static_cast<uint32_t>(frame->scopes.size());
+  }
+  (*command_buffer)
+      ->vkCmdResetQueryPool(*command_buffer, *frame->pool, 0,
+                            queries_per_frame_);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    frame->scopes.clear();
+  }
+  frame->next_query = 0;
+  frame->pending = true;
+  Calibrate(frame);
+  recording_frame_ = frame;
+}
+
+void GpuProfiler::Calibrate(Frame* frame) {
+  frame->calibrated = false;
+  frame->host_time = ToNanoseconds(HostTime());
+  if (!calibrated_timestamps_) {
+    return;
+  }
+  VkCalibratedTimestampInfoEXT infos[2] = {
+      {VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT, nullptr,
+       VK_TIME_DOMAIN_DEVICE_EXT},
+      {VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT, nullptr,
+       host_domain_}};
+  uint64_t timestamps[2];
+  uint64_t max_deviation;
+  if ((*device_)->vkGetCalibratedTimestampsEXT(*device_, 2, infos, timestamps,
+                                               &max_deviation) != VK_SUCCESS) {
+    return;
+  }
+  frame->calibrated = true;
+  frame->gpu_ticks = timestamps[0];
+  frame->host_time = ToNanoseconds(timestamps[1]);
+}
+
+uint32_t GpuProfiler::AllocateQueries(const char* name, uint32_t queue) {
+  if (!recording_frame_) {
+    return UINT32_MAX;
+  }
+  const uint32_t query = recording_frame_->next_query.fetch_add(2);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (query + 2 > queries_per_frame_) {
+    ++dropped_scopes_;
+    return UINT32_MAX;
+  }
+  recording_frame_->scopes.push_back({name, queue, query});
+  return query;
+}
+
+void GpuProfiler::AddCpuEvent(const char* name, uint64_t begin, uint64_t end) {
+  const std::thread::id thread = std::this_thread::get_id();
+  std::lock_guard<std::mutex> lock(mutex_);
+  uint32_t track = 0;
+  while (track < threads_.size() && threads_[track] != thread) {
+    ++track;
+  }
+  if (track == threads_.size()) {
+    threads_.push_back(thread);
+  }
+  events_.push_back({name, 0, track, ToNanoseconds(begin), ToNanoseconds(end)});
+}
+
+uint64_t GpuProfiler::TicksToNanoseconds(uint64_t ticks) const {
+  return static_cast<uint64_t>(static_cast<double>(ticks & timestamp_mask_) *
+                               timestamp_period_);
+}
+
+bool GpuProfiler::Resolve(Frame* frame) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const uint32_t query_count = static_cast<uint32_t>(frame->scopes.size()) * 2;
+  if (query_count != 0) {
+    VkResult result = (*device_)->vkGetQueryPoolResults(
+        *device_, *frame->pool, 0, query_count,
+        query_count * sizeof(uint64_t), results_.data(), sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) {
+      return false;
+    }
+  }
+  frame->pending = false;
+
+  // Without calibration, line the earliest scope up with BeginFrame().
+  uint64_t base_ticks = frame->gpu_ticks;
+  if (!frame->calibrated) {
+    base_ticks = ~uint64_t(0);
+    for (const PendingScope& scope : frame->scopes) {
+      base_ticks = std::min(base_ticks, results_[scope.query]);
+    }
+  }
+  for (const PendingScope& scope : frame->scopes) {
+    const uint64_t begin = results_[scope.query];
+    const uint64_t end = results_[scope.query + 1];
+    const uint64_t host_begin =
+        frame->host_time + TicksToNanoseconds(begin - base_ticks);
+    const uint64_t duration = TicksToNanoseconds(end - begin);
+    events_.push_back(
+        {scope.name, 1, scope.queue, host_begin, host_begin + duration});
+  }
+  return true;
+}
+
+void GpuProfiler::SetQueueName(uint32_t queue, const char* name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (queue_names_.size() <= queue) {
+    queue_names_.resize(queue + 1, nullptr);
+  }
+  queue_names_[queue] = name;
+}
+
+void GpuProfiler::WriteChromeTrace(const char* file_name) {
+  // Oldest first, so that the events stay in order.
+  for (size_t i = 1; gpu_enabled() && i <= frames_.size(); ++i) {
+    Frame* frame = frames_[(current_frame_ + i) % frames_.size()].get();
+    if (frame->pending && !Resolve(frame)) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      dropped_scopes_ += static_cast<uint32_t>(frame->scopes.size());
+      frame->pending = false;
+    }
+  }
+  std::ofstream out(file_name, std::ofstream::out);
+  if (!out) {
+    log_->LogError("Could not write the trace to ", file_name);
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (dropped_scopes_ != 0) {
+    log_->LogInfo(dropped_scopes_,
+                  " GPU scopes were dropped, they did not fit in the query "
+                  "pool or were not finished in time");
+  }
+  uint64_t start = ~uint64_t(0);
+  for (const Event& event : events_) {
+    start = std::min(start, event.begin);
+  }
+
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+  WriteMetadata(out, "process_name", 0, 0, "CPU");
+  out << ",\n";
+  WriteMetadata(out, "process_name", 1, 0, "GPU");
+  for (uint32_t i = 0; i < threads_.size(); ++i) {
+    char name[32];
+    snprintf(name, sizeof(name), "Thread %u", i);
+    out << ",\n";
+    WriteMetadata(out, "thread_name", 0, i, name);
+  }
+  for (uint32_t i = 0; i < queue_names_.size(); ++i) {
+    if (queue_names_[i]) {
+      out << ",\n";
+      WriteMetadata(out, "thread_name", 1, i, queue_names_[i]);
+    }
+  }
+  // Chrome traces are in microseconds.
+  for (const Event& event : events_) {
+    out << ",\n{\"ph\": \"X\", \"name\": ";
+    WriteJsonString(out, event.name);
+    out << ", \"pid\": " << event.process << ", \"tid\": " << event.track
+        << ", \"ts\": " << static_cast<double>(event.begin - start) / 1000.0
+        << ", \"dur\": "
+        << static_cast<double>(event.end - event.begin) / 1000.0 << "}";
+  }
+  out << "\n]}\n";
+}
+
+}  // namespace vulkan
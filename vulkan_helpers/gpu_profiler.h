@@ -0,0 +1,191 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_GPU_PROFILER_H_
+#define VULKAN_HELPERS_GPU_PROFILER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "support/containers/allocator.h"
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "support/log/log.h"
+#include "vulkan_wrapper/command_buffer_wrapper.h"
+#include "vulkan_wrapper/device_wrapper.h"
+#include "vulkan_wrapper/instance_wrapper.h"
+#include "vulkan_wrapper/sub_objects.h"
+
+namespace vulkan {
+
+// GpuProfiler times named scopes of command buffers with timestamp queries,
+// and named scopes of CPU code with the host clock, and writes both to a
+// Chrome trace file (chrome://tracing or ui.perfetto.dev).
+//
+// Every frame gets its own query pool, out of a ring of |frame_count|
+// pools, which has to be at least the number of frames in flight. The
+// results of a frame are read back without waiting when BeginFrame() comes
+// back around to its pool, by which time the GPU has finished it.
+//
+// If |calibrated_timestamps| is set, VK_EXT_calibrated_timestamps has to be
+// enabled on the device, and it is used to put GPU times on the host clock.
+// Otherwise the first GPU scope of each frame is assumed to start when
+// BeginFrame() was called, which is only good enough to see the GPU times
+// next to the CPU ones.
+//
+// Scopes may be recorded from any thread, but not while BeginFrame() runs.
+class GpuProfiler {
+ public:
+  static const uint32_t kDefaultQueriesPerFrame = 512;
+
+  // Times the commands that are recorded into |command_buffer| during its
+  // lifetime. |name| has to outlive the profiler. |queue| identifies the
+  // queue the command buffer will be submitted to, it is the track that the
+  // scope is shown on. Does nothing if |profiler| is nullptr.
+  class Scope {
+   public:
+    Scope(GpuProfiler* profiler, VkCommandBuffer* command_buffer,
+          const char* name, uint32_t queue = 0);
+    ~Scope();
+
+   private:
+    GpuProfiler* profiler_;
+    VkCommandBuffer* command_buffer_;
+    ::VkQueryPool pool_;
+    uint32_t query_;
+  };
+
+  // Times the CPU code that runs during its lifetime, on a track for the
+  // current thread. |name| has to outlive the profiler. Does nothing if
+  // |profiler| is nullptr.
+  class CpuScope {
+   public:
+    CpuScope(GpuProfiler* profiler, const char* name);
+    ~CpuScope();
+
+   private:
+    GpuProfiler* profiler_;
+    const char* name_;
+    uint64_t begin_;
+  };
+
+  // Timestamps are written for queues from |queue_family_index|. If that
+  // family cannot write timestamps, only CPU scopes are recorded.
+  GpuProfiler(containers::Allocator* allocator, VkInstance* instance,
+              VkDevice* device, uint32_t queue_family_index,
+              uint32_t frame_count, bool calibrated_timestamps,
+              uint32_t queries_per_frame = kDefaultQueriesPerFrame);
+
+  // Moves on to the next query pool in the ring, and records its reset into
+  // |command_buffer|. That has to be submitted before any command buffer
+  // with scopes for this frame. The frame that used the pool last should
+  // have finished on the GPU, if its results are not available by now they
+  // are dropped.
+  void BeginFrame(VkCommandBuffer* command_buffer);
+
+  // Names the track of |queue|, as passed to Scope.
+  void SetQueueName(uint32_t queue, const char* name);
+
+  // Writes every scope recorded so far to |file_name|. The device has to be
+  // idle.
+  void WriteChromeTrace(const char* file_name);
+
+  // Returns true if GPU scopes are timed.
+  bool gpu_enabled() const { return timestamp_mask_ != 0; }
+
+ private:
+  struct Event {
+    const char* name;
+    // 0 for the CPU, 1 for the GPU.
+    uint32_t process;
+    // The thread or queue.
+    uint32_t track;
+    // In nanoseconds on the host clock.
+    uint64_t begin;
+    uint64_t end;
+  };
+
+  // A scope that has been recorded, but not read back yet.
+  struct PendingScope {
+    const char* name;
+    uint32_t queue;
+    // The first of its two queries.
+    uint32_t query;
+  };
+
+  struct Frame {
+    Frame(containers::Allocator* allocator)
+        : next_query(0), scopes(allocator), pending(false) {}
+    containers::unique_ptr<VkQueryPool> pool;
+    std::atomic<uint32_t> next_query;
+    // Guarded by |mutex_|.
+    containers::vector<PendingScope> scopes;
+    // Set from BeginFrame() until the results are read back.
+    bool pending;
+    // A GPU timestamp and the host time at the same moment.
+    uint64_t gpu_ticks;
+    uint64_t host_time;
+    bool calibrated;
+  };
+
+  // Returns the host time in the clock domain that calibrated timestamps are
+  // taken in.
+  static uint64_t HostTime();
+  // Converts a time from HostTime() to nanoseconds.
+  static uint64_t ToNanoseconds(uint64_t host_time);
+  // Converts a difference of GPU timestamps to nanoseconds.
+  uint64_t TicksToNanoseconds(uint64_t ticks) const;
+
+  // Returns the first of two queries in the current frame, or UINT32_MAX if
+  // they have run out.
+  uint32_t AllocateQueries(const char* name, uint32_t queue);
+  void AddCpuEvent(const char* name, uint64_t begin, uint64_t end);
+  // Converts the results of |frame| into events, without waiting. Returns
+  // false if they are not all available yet.
+  bool Resolve(Frame* frame);
+  void Calibrate(Frame* frame);
+
+  containers::Allocator* allocator_;
+  logging::Logger* log_;
+  VkDevice* device_;
+  const uint32_t queries_per_frame_;
+  bool calibrated_timestamps_;
+  VkTimeDomainEXT host_domain_;
+  // The length of a timestamp tick in nanoseconds.
+  float timestamp_period_;
+  // The valid bits of a timestamp, or 0 if the GPU is not timed.
+  uint64_t timestamp_mask_;
+
+  containers::vector<containers::unique_ptr<Frame>> frames_;
+  // The index of the current frame in |frames_|.
+  size_t current_frame_;
+  // The frame from BeginFrame(), if there has been one.
+  Frame* recording_frame_;
+  uint32_t dropped_scopes_;
+  containers::vector<uint64_t> results_;
+
+  // Guards Frame::scopes, |events_| and |threads_|.
+  std::mutex mutex_;
+  containers::vector<Event> events_;
+  // The index of a thread in this is its track.
+  containers::vector<std::thread::id> threads_;
+  containers::vector<const char*> queue_names_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_GPU_PROFILER_H_
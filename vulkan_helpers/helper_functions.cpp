@@ -132,23 +132,36 @@ VkInstance CreateVerisonedInstanceForApplicaiton(
 #endif
   };
 
-  const auto num_default_extensions =
-      sizeof(default_extensions) / sizeof(default_extensions[0]);
+  // Headless applications have no window, so they use
+  // VK_EXT_headless_surface instead of the platform's surface extension.
+  const char* headless_extensions[] = {
+      VK_KHR_SURFACE_EXTENSION_NAME,
+      VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME,
+  };
+
+  const char* const* surface_extensions =
+      data->headless() ? headless_extensions : default_extensions;
+  const auto num_surface_extensions =
+      data->headless()
+          ? sizeof(headless_extensions) / sizeof(headless_extensions[0])
+          : sizeof(default_extensions) / sizeof(default_extensions[0]);
 
   const char* validation_layer = "VK_LAYER_KHRONOS_validation";
   const char* callback_layer = "CallbackSwapchain";
   const char* layer = nullptr;
 
-  if (data->output_frame_index() >= 0) {
+  // Headless applications read back -output-frame themselves, and do not
+  // need the virtual swapchain.
+  if (data->output_frame_index() >= 0 && !data->headless()) {
     layer = callback_layer;
   } else if (data->validation()) {
     layer = validation_layer;
   }
 
   std::vector<const char*> extensions;
-  extensions.reserve(num_default_extensions + instance_extensions.size());
-  extensions.insert(extensions.end(), default_extensions,
-                    default_extensions + num_default_extensions);
+  extensions.reserve(num_surface_extensions + instance_extensions.size());
+  extensions.insert(extensions.end(), surface_extensions,
+                    surface_extensions + num_surface_extensions);
   extensions.insert(extensions.end(), instance_extensions.begin(),
                     instance_extensions.end());
 
@@ -961,6 +974,15 @@ VkCommandPool CreateDefaultCommandPool(containers::Allocator* allocator,
 VkSurfaceKHR CreateDefaultSurface(VkInstance* instance,
                                   const entry::EntryData* data) {
   ::VkSurfaceKHR surface;
+  if (data->headless()) {
+    VkHeadlessSurfaceCreateInfoEXT create_info{
+        VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT, nullptr, 0};
+    LOG_ASSERT(==, instance->GetLogger(),
+               (*instance)->vkCreateHeadlessSurfaceEXT(*instance, &create_info,
+                                                       nullptr, &surface),
+               VK_SUCCESS);
+    return VkSurfaceKHR(surface, nullptr, instance);
+  }
 #if defined __ANDROID__
   VkAndroidSurfaceCreateInfoKHR create_info{
       VK_STRUCTURE_TYPE_ANDROID_SURFACE_CREATE_INFO_KHR, 0, 0,
@@ -1121,6 +1143,14 @@ VkSwapchainKHR CreateDefaultSwapchain(
       image_extent = VkExtent2D{data->width(), data->height()};
     }
 
+    VkImageUsageFlags image_usage =
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    // Headless applications copy -output-frame out of the swapchain images.
+    if (data->headless() &&
+        (surface_caps.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)) {
+      image_usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
+
     // By default double-buffer our swapchain images, and use
     // min_image_count if explicitly provided.
     uint32_t minSwapchains = min_image_count ? min_image_count : 2;
@@ -1155,8 +1185,7 @@ VkSwapchainKHR CreateDefaultSwapchain(
         surface_formats[0].colorSpace,                // colorSpace
         image_extent,                                 // imageExtent
         1,                                            // imageArrayLayers
-        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
-            VK_IMAGE_USAGE_TRANSFER_DST_BIT,  // imageUsage
+        image_usage,                                  // imageUsage
         has_multiple_queues ? VK_SHARING_MODE_CONCURRENT
                             : VK_SHARING_MODE_EXCLUSIVE,  // sharingMode
         has_multiple_queues ? 2u : 0u,
@@ -1247,9 +1276,11 @@ VkSampler CreateSampler(VkDevice* device, VkFilter minFilter,
       /* sType = */ VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
       /* pNext = */ extension,
       /* flags = */ 0,
-      /* magFilter = */ minFilter,
-      /* minFilter = */ magFilter,
-      /* mipmapMode = */ VK_SAMPLER_MIPMAP_MODE_NEAREST,
+      /* magFilter = */ magFilter,
+      /* minFilter = */ minFilter,
+      /* mipmapMode = */ minFilter == VK_FILTER_LINEAR
+          ? VK_SAMPLER_MIPMAP_MODE_LINEAR
+          : VK_SAMPLER_MIPMAP_MODE_NEAREST,
       /* addressModeU = */ addressModeU,
       /* addressModeV = */ addressModeV,
       /* addressModeW = */ addressModeW,
@@ -1259,7 +1290,7 @@ VkSampler CreateSampler(VkDevice* device, VkFilter minFilter,
       /* compareEnable = */ false,
       /* compareOp = */ VK_COMPARE_OP_NEVER,
       /* minLod = */ 0.f,
-      /* maxLod = */ 0.f,
+      /* maxLod = */ VK_LOD_CLAMP_NONE,
       /* borderColor = */ VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK,
       /* unnormalizedCoordinates = */ false,
   };
@@ -1491,18 +1522,37 @@ std::tuple<uint32_t, uint32_t, uint32_t> GetElementAndTexelBlockSize(
           1, 1, 1);  // element size, texel block width, texel height
     case VK_FORMAT_D16_UNORM:
     case VK_FORMAT_R16_UNORM:
+    case VK_FORMAT_R8G8_UNORM:
       return std::make_tuple(2, 1, 1);
     case VK_FORMAT_R8G8B8_UNORM:
       return std::make_tuple(3, 1, 1);
     case VK_FORMAT_R32_SFLOAT:
     case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
     case VK_FORMAT_R8G8B8A8_UINT:
     case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
       return std::make_tuple(4, 1, 1);
     case VK_FORMAT_D32_SFLOAT_S8_UINT:
       return std::make_tuple(5, 1, 1);
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+    case VK_FORMAT_EAC_R11_UNORM_BLOCK:
+      return std::make_tuple(8, 4, 4);
     case VK_FORMAT_BC2_UNORM_BLOCK:
     case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+    case VK_FORMAT_EAC_R11G11_UNORM_BLOCK:
       return std::make_tuple(16, 4, 4);
     case VK_FORMAT_R16G16B16A16_SFLOAT:
       return std::make_tuple(8, 1, 1);
@@ -209,8 +209,10 @@ VkImage CreateDefault2DColorImage(VkDevice* device, uint32_t width,
 // anisotropy and compare is disabled.
 VkSampler CreateDefaultSampler(VkDevice* device);
 
-// Creates a default sampler as above, but with the specified minFilter,
-// magFilter, addressModes, and extension.
+// Creates a sampler as above, but with the specified minFilter, magFilter,
+// addressModes, and extension, that can sample every mip level. With a linear
+// minFilter, it also filters linearly between mip levels, which makes it
+// trilinear.
 VkSampler CreateSampler(
     VkDevice* device, VkFilter minFilter, VkFilter magFilter,
     VkSamplerAddressMode addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
@@ -0,0 +1,1146 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vulkan_helpers/image_loader.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "support/mapped_file/mapped_file.h"
+#include "vulkan_helpers/helper_functions.h"
+
+namespace vulkan {
+namespace {
+// The size of the staging chunks is a multiple of this.
+const size_t kStagingAlignment = 16;
+
+// Returns the alignment of the texels of |format| in the staging ring:
+// vkCmdCopyBufferToImage needs offsets that are multiples of both 4 and the
+// texel block size, which is not a power of two for 3, 6 and 12 byte texels.
+size_t StagingAlignment(VkFormat format) {
+  const size_t element_size = std::get<0>(GetElementAndTexelBlockSize(format));
+  if (element_size % 4 == 0) {
+    return element_size;
+  }
+  return element_size % 2 == 0 ? element_size * 2 : element_size * 4;
+}
+
+size_t AlignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+uint32_t ReadBigEndian32(const uint8_t* data) {
+  return (uint32_t(data[0]) << 24) | (uint32_t(data[1]) << 16) |
+         (uint32_t(data[2]) << 8) | uint32_t(data[3]);
+}
+
+uint32_t ReadLittleEndian32(const uint8_t* data) {
+  return uint32_t(data[0]) | (uint32_t(data[1]) << 8) |
+         (uint32_t(data[2]) << 16) | (uint32_t(data[3]) << 24);
+}
+
+uint64_t ReadLittleEndian64(const uint8_t* data) {
+  return uint64_t(ReadLittleEndian32(data)) |
+         (uint64_t(ReadLittleEndian32(data + 4)) << 32);
+}
+
+// Reads the bits of a deflate stream, least significant first. Reading past
+// the end yields zeros.
+class BitReader {
+ public:
+  BitReader(const uint8_t* data, size_t size)
+      : data_(data), size_(size), position_(0), bits_(0), count_(0) {}
+
+  // Makes sure that at least |count| bits, at most 57, are buffered.
+  void Fill(uint32_t count) {
+    while (count_ < count) {
+      if (position_ < size_) {
+        bits_ |= uint64_t(data_[position_]) << count_;
+      }
+      ++position_;
+      count_ += 8;
+    }
+  }
+
+  // Returns true if more bits were read than there are.
+  bool overrun() const { return position_ * 8 - count_ > size_ * 8; }
+
+  uint32_t Peek(uint32_t count) {
+    Fill(count);
+    return uint32_t(bits_ & ((uint64_t(1) << count) - 1));
+  }
+
+  void Skip(uint32_t count) {
+    bits_ >>= count;
+    count_ -= count;
+  }
+
+  uint32_t Read(uint32_t count) {
+    const uint32_t value = Peek(count);
+    Skip(count);
+    return value;
+  }
+
+  // Drops the bits up to the next byte boundary, and returns the rest of the
+  // input from there.
+  const uint8_t* AlignToByte(size_t* remaining) {
+    Skip(count_ % 8);
+    const size_t position = position_ - count_ / 8;
+    bits_ = 0;
+    count_ = 0;
+    position_ = position;
+    *remaining = position < size_ ? size_ - position : 0;
+    return data_ + std::min(position, size_);
+  }
+
+  void Advance(size_t bytes) { position_ += bytes; }
+
+ private:
+  const uint8_t* data_;
+  size_t size_;
+  size_t position_;
+  uint64_t bits_;
+  uint32_t count_;
+};
+
+// A canonical Huffman code, as used by deflate.
+class HuffmanCode {
+ public:
+  // Builds the code from the code length of each of |count| symbols.
+  // Returns false if the lengths are over-subscribed.
+  bool Build(const uint8_t* lengths, uint32_t count) {
+    memset(counts_, 0, sizeof(counts_));
+    memset(fast_, 0, sizeof(fast_));
+    for (uint32_t i = 0; i < count; ++i) {
+      ++counts_[lengths[i]];
+    }
+    counts_[0] = 0;
+    int32_t left = 1;
+    for (uint32_t length = 1; length <= kMaxBits; ++length) {
+      left = (left << 1) - counts_[length];
+      if (left < 0) {
+        return false;
+      }
+    }
+
+    uint16_t offsets[kMaxBits + 2] = {};
+    uint32_t next_code[kMaxBits + 1] = {};
+    uint32_t code = 0;
+    for (uint32_t length = 1; length <= kMaxBits; ++length) {
+      offsets[length + 1] = offsets[length] + counts_[length];
+      code = (code + counts_[length - 1]) << 1;
+      next_code[length] = code;
+    }
+    for (uint32_t symbol = 0; symbol < count; ++symbol) {
+      const uint32_t length = lengths[symbol];
+      if (length == 0) {
+        continue;
+      }
+      symbols_[offsets[length]++] = uint16_t(symbol);
+      if (length > kFastBits) {
+        continue;
+      }
+      // Codes are read starting with their most significant bit.
+      const uint32_t assigned = next_code[length]++;
+      uint32_t reversed = 0;
+      for (uint32_t i = 0; i < length; ++i) {
+        reversed |= ((assigned >> i) & 1) << (length - 1 - i);
+      }
+      for (uint32_t i = reversed; i < (1u << kFastBits); i += 1u << length) {
+        fast_[i] = uint16_t((length << 9) | symbol);
+      }
+    }
+    return true;
+  }
+
+  // Returns the next symbol, or -1 if the bits are not a code.
+  int32_t Decode(BitReader* reader) const {
+    const uint16_t entry = fast_[reader->Peek(kFastBits)];
+    if (entry != 0) {
+      reader->Skip(entry >> 9);
+      return entry & 0x1FF;
+    }
+    // Longer codes are decoded one bit at a time.
+    int32_t code = 0;
+    int32_t first = 0;
+    int32_t index = 0;
+    for (uint32_t length = 1; length <= kMaxBits; ++length) {
+      code |= int32_t(reader->Read(1));
+      const int32_t count = counts_[length];
+      if (code - first < count) {
+        return symbols_[index + code - first];
+      }
+      index += count;
+      first = (first + count) << 1;
+      code <<= 1;
+    }
+    return -1;
+  }
+
+ private:
+  static const uint32_t kMaxBits = 15;
+  static const uint32_t kFastBits = 9;
+  uint16_t counts_[kMaxBits + 1];
+  uint16_t symbols_[320];
+  // Indexed by the next kFastBits bits, the length and symbol of codes that
+  // are no longer than that, or 0.
+  uint16_t fast_[1 << kFastBits];
+};
+
+const uint16_t kLengthBase[29] = {3,  4,  5,  6,   7,   8,   9,   10,  11, 13,
+                                  15, 17, 19, 23,  27,  31,  35,  43,  51, 59,
+                                  67, 83, 99, 115, 131, 163, 195, 227, 258};
+const uint8_t kLengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+                                  1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                  4, 4, 4, 4, 5, 5, 5, 5, 0};
+const uint16_t kDistanceBase[30] = {
+    1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,   65,
+    97,  129, 193, 257, 385, 513,  769,  1025, 1537, 2049, 3073, 4097, 6145,
+    8193, 12289, 16385, 24577};
+const uint8_t kDistanceExtra[30] = {0, 0, 0, 0, 1, 1, 2,  2,  3,  3,
+                                    4, 4, 5, 5, 6, 6, 7,  7,  8,  8,
+                                    9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// Inflates the compressed blocks of one Huffman coded deflate block into
+// |out|, which is filled up to |*written| bytes.
+bool InflateBlock(BitReader* reader, const HuffmanCode& lengths,
+                  const HuffmanCode& distances, uint8_t* out, size_t out_size,
+                  size_t* written) {
+  size_t position = *written;
+  for (;;) {
+    const int32_t symbol = lengths.Decode(reader);
+    if (symbol < 0 || reader->overrun()) {
+      return false;
+    }
+    if (symbol < 256) {
+      if (position == out_size) {
+        return false;
+      }
+      out[position++] = uint8_t(symbol);
+      continue;
+    }
+    if (symbol == 256) {
+      break;
+    }
+    const uint32_t length_index = uint32_t(symbol) - 257;
+    if (length_index >= 29) {
+      return false;
+    }
+    const size_t length = kLengthBase[length_index] +
+                          reader->Read(kLengthExtra[length_index]);
+    const int32_t distance_index = distances.Decode(reader);
+    if (distance_index < 0 || distance_index >= 30) {
+      return false;
+    }
+    const size_t distance = kDistanceBase[distance_index] +
+                            reader->Read(kDistanceExtra[distance_index]);
+    if (distance > position || length > out_size - position) {
+      return false;
+    }
+    // The copy may overlap what it writes, so it goes byte by byte.
+    const uint8_t* from = out + position - distance;
+    for (size_t i = 0; i < length; ++i) {
+      out[position + i] = from[i];
+    }
+    position += length;
+  }
+  *written = position;
+  return true;
+}
+
+// Inflates the zlib stream in |data| into exactly |out_size| bytes at |out|.
+bool Inflate(const uint8_t* data, size_t size, uint8_t* out,
+             size_t out_size) {
+  if (size < 2 || (data[0] & 0x0F) != 8 ||
+      ((uint32_t(data[0]) << 8) | data[1]) % 31 != 0 || (data[1] & 0x20)) {
+    return false;
+  }
+  BitReader reader(data + 2, size - 2);
+  HuffmanCode lengths;
+  HuffmanCode distances;
+  size_t written = 0;
+  bool final_block = false;
+  while (!final_block) {
+    final_block = reader.Read(1) != 0;
+    const uint32_t type = reader.Read(2);
+    if (type == 0) {
+      size_t remaining = 0;
+      const uint8_t* block = reader.AlignToByte(&remaining);
+      if (remaining < 4) {
+        return false;
+      }
+      const size_t block_size = block[0] | (size_t(block[1]) << 8);
+      if ((block_size ^ 0xFFFF) != (block[2] | (size_t(block[3]) << 8)) ||
+          block_size > remaining - 4 || block_size > out_size - written) {
+        return false;
+      }
+      memcpy(out + written, block + 4, block_size);
+      written += block_size;
+      reader.Advance(4 + block_size);
+      continue;
+    }
+
+    uint8_t code_lengths[320];
+    uint32_t num_lengths = 288;
+    uint32_t num_distances = 30;
+    if (type == 1) {
+      for (uint32_t i = 0; i < 288; ++i) {
+        code_lengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+      }
+      for (uint32_t i = 0; i < 30; ++i) {
+        code_lengths[288 + i] = 5;
+      }
+    } else if (type == 2) {
+      num_lengths = reader.Read(5) + 257;
+      num_distances = reader.Read(5) + 1;
+      const uint32_t num_code_lengths = reader.Read(4) + 4;
+      static const uint8_t kOrder[19] = {16, 17, 18, 0, 8,  7, 9,  6, 10, 5,
+                                         11, 4,  12, 3, 13, 2, 14, 1, 15};
+      uint8_t lengths_of_lengths[19] = {};
+      for (uint32_t i = 0; i < num_code_lengths; ++i) {
+        lengths_of_lengths[kOrder[i]] = uint8_t(reader.Read(3));
+      }
+      HuffmanCode length_code;
+      if (!length_code.Build(lengths_of_lengths, 19)) {
+        return false;
+      }
+      const uint32_t total = num_lengths + num_distances;
+      uint32_t i = 0;
+      while (i < total) {
+        const int32_t symbol = length_code.Decode(&reader);
+        if (symbol < 0 || reader.overrun()) {
+          return false;
+        }
+        if (symbol < 16) {
+          code_lengths[i++] = uint8_t(symbol);
+          continue;
+        }
+        uint8_t value = 0;
+        uint32_t repeat = 0;
+        if (symbol == 16) {
+          if (i == 0) {
+            return false;
+          }
+          value = code_lengths[i - 1];
+          repeat = 3 + reader.Read(2);
+        } else if (symbol == 17) {
+          repeat = 3 + reader.Read(3);
+        } else {
+          repeat = 11 + reader.Read(7);
+        }
+        if (i + repeat > total) {
+          return false;
+        }
+        memset(code_lengths + i, value, repeat);
+        i += repeat;
+      }
+    } else {
+      return false;
+    }
+    if (!lengths.Build(code_lengths, num_lengths) ||
+        !distances.Build(code_lengths + num_lengths, num_distances) ||
+        !InflateBlock(&reader, lengths, distances, out, out_size, &written)) {
+      return false;
+    }
+  }
+  return written == out_size && !reader.overrun();
+}
+
+// What DecodePng needs from the chunks of a PNG.
+struct PngInfo {
+  uint32_t width;
+  uint32_t height;
+  uint32_t bit_depth;
+  uint32_t color_type;
+  const uint8_t* palette = nullptr;
+  uint32_t palette_size = 0;
+  const uint8_t* transparency = nullptr;
+  uint32_t transparency_size = 0;
+};
+
+// Calls |fn| with the type, data and size of every chunk of the PNG in
+// |data| after its signature, until it returns false. Returns false if the
+// chunks run past the end of the file.
+template <typename Function>
+bool ForEachPngChunk(const uint8_t* data, size_t size, Function fn) {
+  size_t position = 8;
+  while (position + 12 <= size) {
+    const size_t length = ReadBigEndian32(data + position);
+    if (length > size - position - 12) {
+      return false;
+    }
+    if (!fn(data + position + 4, data + position + 8, length)) {
+      return true;
+    }
+    position += length + 12;
+  }
+  return position == size;
+}
+
+// Reads the header of the PNG in |data|. Returns false if it is not a PNG,
+// or one that DecodePng cannot decode.
+bool ReadPngInfo(const uint8_t* data, size_t size, PngInfo* info) {
+  const uint8_t kSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  if (size < 8 + 25 || memcmp(data, kSignature, 8) != 0 ||
+      memcmp(data + 12, "IHDR", 4) != 0 || ReadBigEndian32(data + 8) != 13) {
+    return false;
+  }
+  const uint8_t* header = data + 16;
+  info->width = ReadBigEndian32(header);
+  info->height = ReadBigEndian32(header + 4);
+  info->bit_depth = header[8];
+  info->color_type = header[9];
+  // Compression, filter and interlace methods.
+  if (header[10] != 0 || header[11] != 0 || header[12] != 0 ||
+      info->width == 0 || info->height == 0) {
+    return false;
+  }
+  const uint32_t depth = info->bit_depth;
+  switch (info->color_type) {
+    case 0:
+      if (depth != 1 && depth != 2 && depth != 4 && depth != 8 &&
+          depth != 16) {
+        return false;
+      }
+      break;
+    case 3:
+      if (depth != 1 && depth != 2 && depth != 4 && depth != 8) {
+        return false;
+      }
+      break;
+    case 2:
+    case 4:
+    case 6:
+      if (depth != 8 && depth != 16) {
+        return false;
+      }
+      break;
+    default:
+      return false;
+  }
+  return ForEachPngChunk(
+             data, size,
+             [info](const uint8_t* type, const uint8_t* chunk, size_t length) {
+               if (memcmp(type, "PLTE", 4) == 0) {
+                 info->palette = chunk;
+                 info->palette_size = uint32_t(length / 3);
+               } else if (memcmp(type, "tRNS", 4) == 0) {
+                 info->transparency = chunk;
+                 info->transparency_size = uint32_t(length);
+               }
+               return memcmp(type, "IEND", 4) != 0;
+             }) &&
+         (info->color_type != 3 || info->palette != nullptr);
+}
+
+// Returns the |index|th sample of |row|, which has |depth| bits per sample.
+uint32_t PngSample(const uint8_t* row, size_t index, uint32_t depth) {
+  switch (depth) {
+    case 16:
+      return (uint32_t(row[index * 2]) << 8) | row[index * 2 + 1];
+    case 8:
+      return row[index];
+    default: {
+      const size_t bit = index * depth;
+      return (row[bit / 8] >> (8 - depth - bit % 8)) & ((1u << depth) - 1);
+    }
+  }
+}
+
+uint8_t PngSampleTo8Bits(uint32_t sample, uint32_t depth) {
+  if (depth == 16) {
+    return uint8_t(sample >> 8);
+  }
+  return uint8_t(sample * 255 / ((1u << depth) - 1));
+}
+
+uint8_t PaethPredictor(int32_t a, int32_t b, int32_t c) {
+  const int32_t p = a + b - c;
+  const int32_t pa = std::abs(p - a);
+  const int32_t pb = std::abs(p - b);
+  const int32_t pc = std::abs(p - c);
+  if (pa <= pb && pa <= pc) {
+    return uint8_t(a);
+  }
+  return uint8_t(pb <= pc ? b : c);
+}
+
+// Decodes the PNG described by |info| in |data| to |info.width| x
+// |info.height| RGBA8 texels at |texels|.
+bool DecodePng(containers::Allocator* allocator, const uint8_t* data,
+               size_t size, const PngInfo& info, uint8_t* texels) {
+  containers::vector<uint8_t> compressed(allocator);
+  ForEachPngChunk(data, size,
+                  [&compressed](const uint8_t* type, const uint8_t* chunk,
+                                size_t length) {
+                    if (memcmp(type, "IDAT", 4) == 0) {
+                      compressed.insert(compressed.end(), chunk,
+                                        chunk + length);
+                    }
+                    return memcmp(type, "IEND", 4) != 0;
+                  });
+
+  const uint32_t kChannels[7] = {1, 0, 3, 1, 2, 0, 4};
+  const uint32_t depth = info.bit_depth;
+  const uint32_t channels = kChannels[info.color_type];
+  const size_t stride = (size_t(info.width) * channels * depth + 7) / 8;
+  // Filters work on the bytes of the previous pixel, or byte.
+  const size_t pixel_size = std::max<size_t>(1, channels * depth / 8);
+  containers::vector<uint8_t> rows(allocator);
+  rows.resize((stride + 1) * info.height);
+  if (!Inflate(compressed.data(), compressed.size(), rows.data(),
+               rows.size())) {
+    return false;
+  }
+
+  containers::vector<uint8_t> zero_row(allocator);
+  zero_row.resize(stride);
+  const uint8_t* previous = zero_row.data();
+  for (uint32_t y = 0; y < info.height; ++y) {
+    uint8_t* row = rows.data() + y * (stride + 1) + 1;
+    const uint8_t filter = row[-1];
+    for (size_t i = 0; i < stride; ++i) {
+      const uint8_t left = i >= pixel_size ? row[i - pixel_size] : 0;
+      const uint8_t up_left = i >= pixel_size ? previous[i - pixel_size] : 0;
+      switch (filter) {
+        case 0:
+          break;
+        case 1:
+          row[i] += left;
+          break;
+        case 2:
+          row[i] += previous[i];
+          break;
+        case 3:
+          row[i] += uint8_t((uint32_t(left) + previous[i]) / 2);
+          break;
+        case 4:
+          row[i] += PaethPredictor(left, previous[i], up_left);
+          break;
+        default:
+          return false;
+      }
+    }
+    previous = row;
+
+    uint8_t* out = texels + size_t(y) * info.width * 4;
+    const uint8_t* key = info.transparency;
+    for (uint32_t x = 0; x < info.width; ++x, out += 4) {
+      switch (info.color_type) {
+        case 0: {
+          const uint32_t gray = PngSample(row, x, depth);
+          out[0] = out[1] = out[2] = PngSampleTo8Bits(gray, depth);
+          const bool keyed = info.transparency_size >= 2 &&
+                             gray == ((uint32_t(key[0]) << 8) | key[1]);
+          out[3] = keyed ? 0 : 255;
+          break;
+        }
+        case 2: {
+          bool keyed = info.transparency_size >= 6;
+          for (uint32_t c = 0; c < 3; ++c) {
+            const uint32_t sample = PngSample(row, x * 3 + c, depth);
+            out[c] = PngSampleTo8Bits(sample, depth);
+            keyed = keyed &&
+                    sample == ((uint32_t(key[c * 2]) << 8) | key[c * 2 + 1]);
+          }
+          out[3] = keyed ? 0 : 255;
+          break;
+        }
+        case 3: {
+          const uint32_t index = PngSample(row, x, depth);
+          if (index >= info.palette_size) {
+            return false;
+          }
+          memcpy(out, info.palette + index * 3, 3);
+          out[3] = index < info.transparency_size ? key[index] : 255;
+          break;
+        }
+        case 4:
+          out[0] = out[1] = out[2] =
+              PngSampleTo8Bits(PngSample(row, x * 2, depth), depth);
+          out[3] = PngSampleTo8Bits(PngSample(row, x * 2 + 1, depth), depth);
+          break;
+        case 6:
+          for (uint32_t c = 0; c < 4; ++c) {
+            out[c] = PngSampleTo8Bits(PngSample(row, x * 4 + c, depth), depth);
+          }
+          break;
+      }
+    }
+  }
+  return true;
+}
+
+// Reads the header and level index of the KTX2 file in |data|. |levels|
+// gets the texels of each level, from the largest to the smallest. Returns
+// false if it is not a KTX2 file, or one that has to be transcoded.
+bool ReadKtx2(const uint8_t* data, size_t size, VkFormat* format,
+              uint32_t* width, uint32_t* height,
+              containers::vector<const uint8_t*>* levels) {
+  const uint8_t kIdentifier[12] = {0xAB, 'K',  'T', 'X',  ' ',  '2',
+                                   '0',  0xBB, '\r', '\n', 0x1A, '\n'};
+  const size_t kHeaderSize = 80;
+  if (size < kHeaderSize || memcmp(data, kIdentifier, 12) != 0) {
+    return false;
+  }
+  *format = VkFormat(ReadLittleEndian32(data + 12));
+  *width = ReadLittleEndian32(data + 20);
+  *height = ReadLittleEndian32(data + 24);
+  const uint32_t depth = ReadLittleEndian32(data + 28);
+  const uint32_t layers = ReadLittleEndian32(data + 32);
+  const uint32_t faces = ReadLittleEndian32(data + 36);
+  const uint32_t level_count = std::max(1u, ReadLittleEndian32(data + 40));
+  const uint32_t supercompression = ReadLittleEndian32(data + 44);
+  // A full mip chain ends with the first level of 1x1 texels.
+  uint32_t max_level_count = 1;
+  for (uint32_t extent = std::max(*width, *height); extent > 1; extent >>= 1) {
+    ++max_level_count;
+  }
+  if (*format == VK_FORMAT_UNDEFINED || *width == 0 || *height == 0 ||
+      depth > 1 || layers > 1 || faces != 1 || supercompression != 0 ||
+      level_count > max_level_count ||
+      size < kHeaderSize + level_count * 24) {
+    return false;
+  }
+  for (uint32_t level = 0; level < level_count; ++level) {
+    const uint8_t* entry = data + kHeaderSize + level * 24;
+    const uint64_t offset = ReadLittleEndian64(entry);
+    const uint64_t length = ReadLittleEndian64(entry + 8);
+    const VkExtent3D extent = {std::max(*width >> level, 1u),
+                               std::max(*height >> level, 1u), 1};
+    if (offset > size || length > size - offset ||
+        length < GetImageExtentSizeInBytes(extent, *format)) {
+      return false;
+    }
+    levels->push_back(data + offset);
+  }
+  return true;
+}
+}  // anonymous namespace
+
+ImageFileFormat GetImageFileFormat(const char* path) {
+  const char* extension = strrchr(path, '.');
+  if (extension != nullptr && strcmp(extension, ".png") == 0) {
+    return ImageFileFormat::kPng;
+  } else if (extension != nullptr && strcmp(extension, ".ktx2") == 0) {
+    return ImageFileFormat::kKtx2;
+  }
+  return ImageFileFormat::kRaw;
+}
+
+ImageLoader::ImageLoader(VulkanApplication* application,
+                         uint32_t thread_count, size_t staging_size,
+                         size_t sparse_binding_block_size)
+    : application_(application),
+      allocator_(application->GetAllocator()),
+      log_(application->GetLogger()),
+      staging_size_(staging_size),
+      max_chunk_size_(staging_size / 4 / kStagingAlignment *
+                      kStagingAlignment),
+      sparse_binding_block_size_(sparse_binding_block_size),
+      images_(allocator_),
+      pending_(0),
+      uploads_(allocator_),
+      free_uploads_(allocator_),
+      load_queue_(allocator_),
+      chunks_(allocator_),
+      staging_head_(0),
+      staging_used_(0),
+      first_allocation_(0),
+      allocations_(allocator_),
+      exiting_(false),
+      threads_(allocator_) {
+  LOG_ASSERT(>, log_, max_chunk_size_, 0u);
+  staging_buffer_ = application_->CreateAndBindDefaultExclusiveHostBuffer(
+      staging_size_, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+  staging_ = reinterpret_cast<uint8_t*>(staging_buffer_->base_address());
+  for (uint32_t i = 0; i < std::max(thread_count, 1u); ++i) {
+    threads_.push_back(std::thread([this]() { LoadLoop(); }));
+  }
+}
+
+ImageLoader::~ImageLoader() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    exiting_ = true;
+  }
+  image_queued_.notify_all();
+  staging_freed_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+  RetireUploads(true);
+}
+
+StreamedImage* ImageLoader::Load(const char* path, bool srgb) {
+  const ImageFileFormat file_format = GetImageFileFormat(path);
+  LOG_ASSERT(==, log_, false, file_format == ImageFileFormat::kRaw);
+  return Queue(path, file_format, VK_FORMAT_UNDEFINED, 0, 0, srgb);
+}
+
+StreamedImage* ImageLoader::LoadRaw(const char* path, VkFormat format,
+                                    uint32_t width, uint32_t height) {
+  return Queue(path, ImageFileFormat::kRaw, format, width, height, false);
+}
+
+StreamedImage* ImageLoader::Queue(const char* path,
+                                  ImageFileFormat file_format,
+                                  VkFormat format, uint32_t width,
+                                  uint32_t height, bool srgb) {
+  // StreamedImage can only be constructed by its friends, so it cannot go
+  // through make_unique.
+  StreamedImage* queued = new (allocator_->malloc(sizeof(StreamedImage)))
+      StreamedImage(allocator_, path, file_format, format, width, height);
+  queued->srgb_ = srgb;
+  images_.push_back(containers::unique_ptr<StreamedImage>(
+      queued, containers::UniqueDeleter(allocator_, sizeof(StreamedImage))));
+  ++pending_;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    load_queue_.push_back(queued);
+  }
+  image_queued_.notify_one();
+  return queued;
+}
+
+void ImageLoader::LoadLoop() {
+  for (;;) {
+    StreamedImage* image = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      image_queued_.wait(
+          lock, [this]() { return exiting_ || !load_queue_.empty(); });
+      if (exiting_) {
+        return;
+      }
+      image = load_queue_.front();
+      load_queue_.pop_front();
+    }
+    LoadImage(image);
+  }
+}
+
+void ImageLoader::LoadImage(StreamedImage* image) {
+  auto file = mapped_file::OpenFile(allocator_, image->path_.c_str());
+  if (!file) {
+    QueueFailure(image, "the file could not be opened");
+    return;
+  }
+  const uint8_t* data = file->data();
+  const size_t size = file->size();
+
+  // Where the texels of each level are, unless they still have to be
+  // decoded.
+  containers::vector<const uint8_t*> levels(allocator_);
+  PngInfo png;
+  switch (image->file_format_) {
+    case ImageFileFormat::kPng:
+      if (!ReadPngInfo(data, size, &png)) {
+        QueueFailure(image, "it is not a PNG that can be decoded");
+        return;
+      }
+      image->format_ = image->srgb_ ? VK_FORMAT_R8G8B8A8_SRGB
+                                    : VK_FORMAT_R8G8B8A8_UNORM;
+      image->width_ = png.width;
+      image->height_ = png.height;
+      break;
+    case ImageFileFormat::kKtx2:
+      if (!ReadKtx2(data, size, &image->format_, &image->width_,
+                    &image->height_, &levels)) {
+        QueueFailure(image, "it is not a KTX2 file without supercompression");
+        return;
+      }
+      image->mip_levels_ = uint32_t(levels.size());
+      break;
+    case ImageFileFormat::kRaw:
+      levels.push_back(data);
+      break;
+  }
+
+  containers::vector<size_t> level_sizes(allocator_);
+  size_t total_size = 0;
+  const size_t alignment = StagingAlignment(image->format_);
+  for (uint32_t level = 0; level < image->mip_levels_; ++level) {
+    const VkExtent3D extent = {std::max(image->width_ >> level, 1u),
+                               std::max(image->height_ >> level, 1u), 1};
+    level_sizes.push_back(GetImageExtentSizeInBytes(extent, image->format_));
+    total_size += AlignUp(level_sizes.back(), alignment);
+  }
+  if (level_sizes[0] == 0) {
+    QueueFailure(image, "its format is not supported");
+    return;
+  }
+  if (image->file_format_ == ImageFileFormat::kRaw &&
+      size < level_sizes[0]) {
+    QueueFailure(image, "the file is smaller than its size and format");
+    return;
+  }
+  VkFormatProperties properties = {};
+  application_->instance()->vkGetPhysicalDeviceFormatProperties(
+      application_->device().physical_device(), image->format_, &properties);
+  if (!(properties.optimalTilingFeatures &
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+    QueueFailure(image, "the device cannot sample its format");
+    return;
+  }
+
+  const uint32_t block_height =
+      std::get<2>(GetElementAndTexelBlockSize(image->format_));
+  auto level_copy = [image](uint32_t level, size_t offset, uint32_t first_row,
+                            uint32_t rows) {
+    const uint32_t width = std::max(image->width_ >> level, 1u);
+    const uint32_t height = std::max(image->height_ >> level, 1u);
+    return VkBufferImageCopy{
+        offset,                                    // bufferOffset
+        0,                                         // bufferRowLength
+        0,                                         // bufferImageHeight
+        {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1},  // imageSubresource
+        {0, int32_t(first_row), 0},                // imageOffset
+        {width, std::min(rows, height - first_row), 1}  // imageExtent
+    };
+  };
+
+  // Small images are decoded or copied into a single chunk.
+  if (total_size <= max_chunk_size_) {
+    containers::unique_ptr<Chunk> chunk =
+        containers::make_unique<Chunk>(allocator_, allocator_);
+    chunk->image = image;
+    chunk->size = total_size;
+    if (!Reserve(total_size, alignment, &chunk->allocation,
+                 &chunk->offset)) {
+      return;
+    }
+    size_t offset = chunk->offset;
+    for (uint32_t level = 0; level < image->mip_levels_; ++level) {
+      chunk->copies.push_back(level_copy(level, offset, 0, ~0u));
+      if (image->file_format_ == ImageFileFormat::kPng) {
+        if (!DecodePng(allocator_, data, size, png, staging_ + offset)) {
+          chunk->failed = true;
+          chunk->reason = "its image data is corrupt";
+        }
+      } else {
+        memcpy(staging_ + offset, levels[level], level_sizes[level]);
+      }
+      offset += AlignUp(level_sizes[level], alignment);
+    }
+    chunk->resident_level = 0;
+    QueueChunk(std::move(chunk));
+    return;
+  }
+
+  // Larger PNGs are decoded in one piece first, and then everything is
+  // uploaded in bands of rows, starting with the smallest level.
+  containers::vector<uint8_t> decoded(allocator_);
+  if (image->file_format_ == ImageFileFormat::kPng) {
+    decoded.resize(level_sizes[0]);
+    if (!DecodePng(allocator_, data, size, png, decoded.data())) {
+      QueueFailure(image, "its image data is corrupt");
+      return;
+    }
+    levels.push_back(decoded.data());
+  }
+  auto block_rows_of_level = [image, block_height](uint32_t level) {
+    const uint32_t height = std::max(image->height_ >> level, 1u);
+    return size_t(height + block_height - 1) / block_height;
+  };
+  if (level_sizes[0] / block_rows_of_level(0) > max_chunk_size_) {
+    QueueFailure(image, "its rows do not fit into the staging ring");
+    return;
+  }
+  image->sparse_ = sparse_binding_block_size_ != 0;
+  for (uint32_t level = image->mip_levels_; level-- > 0;) {
+    const size_t block_rows = block_rows_of_level(level);
+    const size_t row_size = level_sizes[level] / block_rows;
+    const size_t rows_per_chunk = max_chunk_size_ / row_size;
+    for (size_t row = 0; row < block_rows; row += rows_per_chunk) {
+      const size_t rows = std::min(rows_per_chunk, block_rows - row);
+      containers::unique_ptr<Chunk> chunk =
+          containers::make_unique<Chunk>(allocator_, allocator_);
+      chunk->image = image;
+      chunk->size = rows * row_size;
+      if (!Reserve(chunk->size, alignment, &chunk->allocation,
+                   &chunk->offset)) {
+        return;
+      }
+      memcpy(staging_ + chunk->offset, levels[level] + row * row_size,
+             chunk->size);
+      chunk->copies.push_back(
+          level_copy(level, chunk->offset, uint32_t(row * block_height),
+                     uint32_t(rows * block_height)));
+      if (row + rows == block_rows) {
+        chunk->resident_level = level;
+      }
+      QueueChunk(std::move(chunk));
+    }
+  }
+}
+
+void ImageLoader::QueueChunk(containers::unique_ptr<Chunk> chunk) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    chunks_.push_back(std::move(chunk));
+  }
+  chunk_queued_.notify_one();
+}
+
+void ImageLoader::QueueFailure(StreamedImage* image, const char* reason) {
+  containers::unique_ptr<Chunk> chunk =
+      containers::make_unique<Chunk>(allocator_, allocator_);
+  chunk->image = image;
+  chunk->failed = true;
+  chunk->reason = reason;
+  QueueChunk(std::move(chunk));
+}
+
+bool ImageLoader::Reserve(size_t size, size_t alignment, uint64_t* allocation,
+                          size_t* offset) {
+  size = AlignUp(size, kStagingAlignment);
+  LOG_ASSERT(<=, log_, size, max_chunk_size_);
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    if (exiting_) {
+      return false;
+    }
+    if (staging_used_ == 0) {
+      staging_head_ = 0;
+    }
+    const size_t tail =
+        (staging_head_ + staging_size_ - staging_used_) % staging_size_;
+    // Allocations start at a multiple of |alignment|, and do not wrap
+    // around. The space before the start, or at the end of the ring, is
+    // skipped instead.
+    size_t start = AlignUp(staging_head_, alignment);
+    size_t skipped = 0;
+    bool fits = false;
+    if (staging_used_ == staging_size_) {
+      fits = false;
+    } else if (tail <= staging_head_) {
+      if (staging_size_ >= start && staging_size_ - start >= size) {
+        skipped = start - staging_head_;
+        fits = true;
+      } else if (tail >= size) {
+        start = 0;
+        skipped = staging_size_ - staging_head_;
+        fits = true;
+      }
+    } else if (tail >= start && tail - start >= size) {
+      skipped = start - staging_head_;
+      fits = true;
+    }
+    if (fits) {
+      *offset = start;
+      staging_head_ = (*offset + size) % staging_size_;
+      staging_used_ += skipped + size;
+      *allocation = first_allocation_ + allocations_.size();
+      allocations_.push_back({skipped + size, false});
+      return true;
+    }
+    staging_freed_.wait(lock);
+  }
+}
+
+void ImageLoader::Free(uint64_t allocation) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    allocations_[allocation - first_allocation_].freed = true;
+    while (!allocations_.empty() && allocations_.front().freed) {
+      staging_used_ -= allocations_.front().size;
+      allocations_.pop_front();
+      ++first_allocation_;
+    }
+  }
+  staging_freed_.notify_all();
+}
+
+void ImageLoader::CreateImage(StreamedImage* image,
+                              VkCommandBuffer* command_buffer) {
+  VkImageCreateInfo create_info = {
+      VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,  // sType
+      nullptr,                              // pNext
+      0,                                    // flags
+      VK_IMAGE_TYPE_2D,                     // imageType
+      image->format_,                       // format
+      {image->width_, image->height_, 1},   // extent
+      image->mip_levels_,                   // mipLevels
+      1,                                    // arrayLayers
+      VK_SAMPLE_COUNT_1_BIT,                // samples
+      VK_IMAGE_TILING_OPTIMAL,              // tiling
+      VK_IMAGE_USAGE_SAMPLED_BIT |
+          VK_IMAGE_USAGE_TRANSFER_DST_BIT,  // usage
+      VK_SHARING_MODE_EXCLUSIVE,            // sharingMode
+      0,                                    // queueFamilyIndexCount
+      nullptr,                              // pQueueFamilyIndices
+      VK_IMAGE_LAYOUT_UNDEFINED             // initialLayout
+  };
+  if (image->sparse_) {
+    create_info.flags = VK_IMAGE_CREATE_SPARSE_BINDING_BIT;
+    image->sparse_image_ = application_->CreateAndBindSparseImage(
+        &create_info, sparse_binding_block_size_);
+  } else {
+    image->image_ = application_->CreateAndBindImage(&create_info);
+  }
+  RecordImageLayoutTransition(
+      image->image(), {VK_IMAGE_ASPECT_COLOR_BIT, 0, image->mip_levels_, 0, 1},
+      VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      VK_ACCESS_TRANSFER_WRITE_BIT, command_buffer);
+}
+
+void ImageLoader::RecordChunk(const Chunk& chunk, Upload* upload) {
+  StreamedImage* image = chunk.image;
+  VkCommandBuffer& command_buffer = upload->command_buffer;
+  if (image->image_ == nullptr && image->sparse_image_ == nullptr) {
+    CreateImage(image, &command_buffer);
+  }
+  staging_buffer_->flush(chunk.offset, chunk.size);
+  command_buffer->vkCmdCopyBufferToImage(
+      command_buffer, *staging_buffer_, image->image(),
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, uint32_t(chunk.copies.size()),
+      chunk.copies.data());
+  upload->allocations.push_back(chunk.allocation);
+
+  // Levels are made ready for sampling as soon as they are complete.
+  if (chunk.resident_level < image->recorded_level_) {
+    const uint32_t end = std::min(image->recorded_level_, image->mip_levels_);
+    RecordImageLayoutTransition(
+        image->image(),
+        {VK_IMAGE_ASPECT_COLOR_BIT, chunk.resident_level,
+         end - chunk.resident_level, 0, 1},
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT,
+        &command_buffer);
+    image->recorded_level_ = chunk.resident_level;
+    upload->images.push_back(std::make_pair(image, chunk.resident_level));
+  }
+}
+
+uint32_t ImageLoader::Update(VkQueue* queue) {
+  uint32_t finished = RetireUploads(false);
+
+  containers::deque<containers::unique_ptr<Chunk>> chunks(allocator_);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    chunks.swap(chunks_);
+  }
+  if (chunks.empty()) {
+    return finished;
+  }
+
+  containers::unique_ptr<Upload> upload;
+  if (!free_uploads_.empty()) {
+    upload = std::move(free_uploads_.back());
+    free_uploads_.pop_back();
+  } else {
+    upload = containers::make_unique<Upload>(
+        allocator_, allocator_, application_->GetCommandBuffer(queue->index()),
+        CreateFence(&application_->device()));
+  }
+  VkCommandBuffer& command_buffer = upload->command_buffer;
+  application_->BeginCommandBuffer(&command_buffer);
+  bool recorded = false;
+  for (const auto& chunk : chunks) {
+    if (chunk->failed) {
+      log_->LogError("Could not load ", chunk->image->path_.c_str(), ", ",
+                     chunk->reason);
+      chunk->image->failed_ = true;
+      --pending_;
+      ++finished;
+      if (chunk->size != 0) {
+        Free(chunk->allocation);
+      }
+      continue;
+    }
+    RecordChunk(*chunk, upload.get());
+    recorded = true;
+  }
+  if (!recorded) {
+    command_buffer->vkEndCommandBuffer(command_buffer);
+    free_uploads_.push_back(std::move(upload));
+    return finished;
+  }
+  LOG_ASSERT(==, log_, VK_SUCCESS,
+             application_->EndAndSubmitCommandBuffer(
+                 &command_buffer, queue, {}, {}, {}, upload->fence));
+  uploads_.push_back(std::move(upload));
+  return finished;
+}
+
+uint32_t ImageLoader::RetireUploads(bool wait) {
+  uint32_t finished = 0;
+  VkDevice& device = application_->device();
+  while (!uploads_.empty()) {
+    Upload* upload = uploads_.front().get();
+    ::VkFence fence = upload->fence;
+    if (wait) {
+      LOG_ASSERT(==, log_, VK_SUCCESS,
+                 device->vkWaitForFences(device, 1, &fence, VK_TRUE,
+                                         0xFFFFFFFFFFFFFFFF));
+    } else if (device->vkGetFenceStatus(device, fence) != VK_SUCCESS) {
+      break;
+    }
+    LOG_ASSERT(==, log_, VK_SUCCESS,
+               device->vkResetFences(device, 1, &fence));
+    for (uint64_t allocation : upload->allocations) {
+      Free(allocation);
+    }
+    for (const auto& resident : upload->images) {
+      StreamedImage* image = resident.first;
+      image->resident_level_ = resident.second;
+      VkImageViewCreateInfo view_create_info = {
+          VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,  // sType
+          nullptr,                                   // pNext
+          0,                                         // flags
+          image->image(),                            // image
+          VK_IMAGE_VIEW_TYPE_2D,                     // viewType
+          image->format_,                            // format
+          {VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G,
+           VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A},
+          {VK_IMAGE_ASPECT_COLOR_BIT, resident.second,
+           image->mip_levels_ - resident.second, 0, 1}};
+      ::VkImageView raw_view;
+      LOG_ASSERT(==, log_, VK_SUCCESS,
+                 device->vkCreateImageView(device, &view_create_info, nullptr,
+                                           &raw_view));
+      image->views_.push_back(containers::make_unique<VkImageView>(
+          allocator_, VkImageView(raw_view, nullptr, &device)));
+      if (image->ready()) {
+        --pending_;
+        ++finished;
+      }
+    }
+    upload->allocations.clear();
+    upload->images.clear();
+    free_uploads_.push_back(std::move(uploads_.front()));
+    uploads_.pop_front();
+  }
+  return finished;
+}
+
+void ImageLoader::Flush(VkQueue* queue) {
+  while (pending_ > 0) {
+    Update(queue);
+    if (pending_ == 0) {
+      break;
+    }
+    if (!uploads_.empty()) {
+      RetireUploads(true);
+    } else {
+      std::unique_lock<std::mutex> lock(mutex_);
+      chunk_queued_.wait(lock, [this]() { return !chunks_.empty(); });
+    }
+  }
+}
+
+}  // namespace vulkan
@@ -0,0 +1,265 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_IMAGE_LOADER_H_
+#define VULKAN_HELPERS_IMAGE_LOADER_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "support/containers/allocator.h"
+#include "support/containers/deque.h"
+#include "support/containers/string.h"
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "support/log/log.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+namespace vulkan {
+
+// The file formats that ImageLoader can read.
+enum class ImageFileFormat {
+  // Non-interlaced PNGs of any color type, which are uploaded as 8-bit RGBA.
+  kPng,
+  // KTX2 files without supercompression, which are uploaded in their own
+  // format with all of their mip levels.
+  kKtx2,
+  // Tightly packed texels of a format and size that is given when loading,
+  // like the raw frames written by FrameCapture.
+  kRaw,
+};
+
+// Returns the format of the file at |path|, from its extension. Files that
+// are neither .png nor .ktx2 are raw.
+ImageFileFormat GetImageFileFormat(const char* path);
+
+// An image that is loaded by an ImageLoader. Everything but ready() and
+// failed() is only valid once the first level of the image is resident.
+class StreamedImage {
+ public:
+  // Returns true once every mip level has been uploaded.
+  bool ready() const { return resident_level_ == 0; }
+  // Returns true if the image could not be loaded. It never becomes ready.
+  bool failed() const { return failed_; }
+  // Returns true if at least the smallest mip level has been uploaded, so
+  // view() can be sampled.
+  bool resident() const { return resident_level_ != ~0u; }
+  // Returns the largest mip level that has been uploaded. Every smaller
+  // level has been uploaded as well.
+  uint32_t resident_level() const { return resident_level_; }
+
+  uint32_t width() const { return width_; }
+  uint32_t height() const { return height_; }
+  VkFormat format() const { return format_; }
+  uint32_t mip_levels() const { return mip_levels_; }
+
+  ::VkImage image() const {
+    return image_ != nullptr ? ::VkImage(*image_) : ::VkImage(*sparse_image_);
+  }
+  // Returns a view of the resident levels, in
+  // VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL. A new view is created whenever
+  // another level becomes resident. Older views stay valid as long as the
+  // ImageLoader.
+  ::VkImageView view() const { return *views_.back(); }
+
+ private:
+  friend class ImageLoader;
+  StreamedImage(containers::Allocator* allocator, const char* path,
+                ImageFileFormat file_format, VkFormat format, uint32_t width,
+                uint32_t height)
+      : path_(path, allocator),
+        file_format_(file_format),
+        format_(format),
+        width_(width),
+        height_(height),
+        mip_levels_(1),
+        views_(allocator) {}
+
+  const containers::string path_;
+  const ImageFileFormat file_format_;
+  // These are given for raw files, and otherwise read from the file on a
+  // loading thread before the first chunk of the image is queued.
+  VkFormat format_;
+  uint32_t width_;
+  uint32_t height_;
+  uint32_t mip_levels_;
+  bool srgb_ = false;
+  bool sparse_ = false;
+
+  // The rest is only used on the thread that calls Update().
+  bool failed_ = false;
+  // The largest level that has been made ready for sampling in a command
+  // buffer, which may not have finished yet.
+  uint32_t recorded_level_ = ~0u;
+  uint32_t resident_level_ = ~0u;
+  containers::unique_ptr<VulkanApplication::Image> image_;
+  containers::unique_ptr<VulkanApplication::SparseImage> sparse_image_;
+  containers::vector<containers::unique_ptr<VkImageView>> views_;
+};
+
+// ImageLoader loads PNG, KTX2 and raw image files at runtime and streams
+// them into device images, so large sets of images do not have to be
+// compiled into the application.
+//
+// Files are mapped and decoded on a pool of loading threads, straight into
+// a ring of host-visible staging memory. Update() then records the copies
+// of every chunk that has been decoded since the last call into a single
+// command buffer, so many images are uploaded with one submit.
+//
+// Images that do not fit into a quarter of the staging ring are uploaded in
+// bands of rows over several submits, from the smallest mip level to the
+// largest, and each level can be sampled as soon as it is resident. If a
+// |sparse_binding_block_size| is given, these images are bound with
+// CreateAndBindSparseImage instead of from a single allocation, which
+// requires the application to have been created with sparse binding.
+//
+// All member functions have to be called from the same thread.
+class ImageLoader {
+ public:
+  static const uint32_t kDefaultThreadCount = 2;
+  static const size_t kDefaultStagingSize = 32 * 1024 * 1024;
+
+  ImageLoader(VulkanApplication* application,
+              uint32_t thread_count = kDefaultThreadCount,
+              size_t staging_size = kDefaultStagingSize,
+              size_t sparse_binding_block_size = 0u);
+  // Waits for the loading threads and for every submitted upload.
+  ~ImageLoader();
+
+  // Queues the PNG or KTX2 file at |path| for loading. PNGs are uploaded as
+  // VK_FORMAT_R8G8B8A8_SRGB if |srgb| is true, and as
+  // VK_FORMAT_R8G8B8A8_UNORM otherwise. The returned image belongs to the
+  // loader.
+  StreamedImage* Load(const char* path, bool srgb = false);
+  // Queues the raw file at |path| for loading, which holds |width| x
+  // |height| tightly packed texels of |format|.
+  StreamedImage* LoadRaw(const char* path, VkFormat format, uint32_t width,
+                         uint32_t height);
+
+  // Records the upload of every chunk that has been decoded since the last
+  // call into one command buffer, and submits it to |queue|. Then updates the
+  // resident levels of the images whose uploads have finished. Returns the
+  // number of images that became ready or failed. This is meant to be called
+  // once per frame.
+  uint32_t Update(VkQueue* queue);
+  // Calls Update() until every queued image is ready or has failed.
+  void Flush(VkQueue* queue);
+
+  // Returns the number of images that are neither ready nor failed.
+  size_t pending() const { return pending_; }
+
+ private:
+  // A part of the staging ring that holds the texels for |copies|, which
+  // all go to |image|.
+  struct Chunk {
+    Chunk(containers::Allocator* allocator) : copies(allocator) {}
+    StreamedImage* image = nullptr;
+    // Set if the image could not be loaded, in which case there is nothing
+    // to copy.
+    bool failed = false;
+    uint64_t allocation = 0;
+    size_t offset = 0;
+    size_t size = 0;
+    containers::vector<VkBufferImageCopy> copies;
+    // The level of the image that is complete once this chunk has been
+    // copied, if any. Every smaller level is complete by then too.
+    uint32_t resident_level = ~0u;
+    // Why the image could not be loaded.
+    const char* reason = nullptr;
+  };
+
+  // One submit of Update(), with the chunks it copied.
+  struct Upload {
+    Upload(containers::Allocator* allocator, VkCommandBuffer&& command_buffer,
+           VkFence&& fence)
+        : command_buffer(std::move(command_buffer)),
+          fence(std::move(fence)),
+          allocations(allocator),
+          images(allocator) {}
+    VkCommandBuffer command_buffer;
+    VkFence fence;
+    containers::vector<uint64_t> allocations;
+    // The images that have new resident levels once the upload finishes.
+    containers::vector<std::pair<StreamedImage*, uint32_t>> images;
+  };
+
+  // An allocation in the staging ring, which are freed in the order they
+  // were made.
+  struct Allocation {
+    // Including the space that was skipped at the end of the ring.
+    size_t size;
+    bool freed;
+  };
+
+  StreamedImage* Queue(const char* path, ImageFileFormat file_format,
+                       VkFormat format, uint32_t width, uint32_t height,
+                       bool srgb);
+
+  // Runs on the loading threads.
+  void LoadLoop();
+  void LoadImage(StreamedImage* image);
+  void QueueChunk(containers::unique_ptr<Chunk> chunk);
+  void QueueFailure(StreamedImage* image, const char* reason);
+  // Reserves |size| bytes of the staging ring at a multiple of |alignment|,
+  // waiting for uploads to finish if there is not enough room. Returns false
+  // if the loader is exiting.
+  bool Reserve(size_t size, size_t alignment, uint64_t* allocation,
+               size_t* offset);
+
+  // Run on the thread that calls Update().
+  void CreateImage(StreamedImage* image, VkCommandBuffer* command_buffer);
+  void RecordChunk(const Chunk& chunk, Upload* upload);
+  uint32_t RetireUploads(bool wait);
+  void Free(uint64_t allocation);
+
+  VulkanApplication* application_;
+  containers::Allocator* allocator_;
+  logging::Logger* log_;
+  const size_t staging_size_;
+  const size_t max_chunk_size_;
+  const size_t sparse_binding_block_size_;
+  containers::unique_ptr<VulkanApplication::Buffer> staging_buffer_;
+  uint8_t* staging_;
+
+  containers::vector<containers::unique_ptr<StreamedImage>> images_;
+  size_t pending_;
+  // The uploads that have been submitted, oldest first, and the ones that
+  // can be reused.
+  containers::deque<containers::unique_ptr<Upload>> uploads_;
+  containers::vector<containers::unique_ptr<Upload>> free_uploads_;
+
+  // Guards everything below.
+  std::mutex mutex_;
+  std::condition_variable image_queued_;
+  std::condition_variable chunk_queued_;
+  std::condition_variable staging_freed_;
+  containers::deque<StreamedImage*> load_queue_;
+  containers::deque<containers::unique_ptr<Chunk>> chunks_;
+  // The staging ring holds |staging_used_| bytes that end at
+  // |staging_head_|, wrapping around at the end of the ring.
+  size_t staging_head_;
+  size_t staging_used_;
+  uint64_t first_allocation_;
+  containers::deque<Allocation> allocations_;
+  bool exiting_;
+  containers::vector<std::thread> threads_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_IMAGE_LOADER_H_
@@ -0,0 +1,115 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_MODEL_FILE_H_
+#define VULKAN_HELPERS_MODEL_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// The binary model format that convert_obj_to_c writes with --binary, and
+// that VulkanModel loads at runtime. This only depends on the standard
+// library, so that the converter can use it without Vulkan.
+//
+// A model file is a ModelFileHeader followed by the streams it points to:
+//   float positions[num_vertices * 3];
+//   float texture_coords[num_vertices * 2];
+//   float normals[num_vertices * 3];
+//   uint16_t or uint32_t indices[num_indices];
+//   ModelLod lods[num_lods];
+// Every stream starts at a multiple of kModelFileStreamAlignment, and the
+// three vertex streams are in this order, so that they can be copied to a
+// vertex buffer at once. Indices are stored in 16 bits if every index fits,
+// which halves their size, and can still be used by the GPU as they are.
+// The indices hold every level of detail, each one a range of them, with the
+// full model first. All values are little-endian.
+namespace vulkan {
+const char kModelFileMagic[4] = {'V', 'T', 'M', 'F'};
+const uint32_t kModelFileVersion = 2;
+const uint64_t kModelFileStreamAlignment = 16;
+
+// One level of detail of a model: a range of its indices, that all use the
+// same vertices.
+struct ModelLod {
+  uint32_t first_index;
+  uint32_t index_count;
+  // An estimate of how far the surface is from that of the full model, in
+  // model units. 0 for the full model.
+  float error;
+  uint32_t reserved;
+};
+static_assert(sizeof(ModelLod) == 16, "ModelLod must not contain padding");
+
+struct ModelFileHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t num_vertices;
+  uint64_t num_indices;
+  // Either 2 or 4.
+  uint32_t index_size;
+  // At least 1.
+  uint32_t num_lods;
+  // Offsets from the start of the file.
+  uint64_t positions_offset;
+  uint64_t texture_coords_offset;
+  uint64_t normals_offset;
+  uint64_t indices_offset;
+  uint64_t lods_offset;
+  // The size of the whole file, to catch truncated files.
+  uint64_t file_size;
+};
+static_assert(sizeof(ModelFileHeader) == 80,
+              "ModelFileHeader must not contain padding");
+
+// Returns true if |header| describes a valid model file of |size| bytes,
+// whose streams are all within the file. This does not check the levels of
+// detail themselves, see IsValidModelLod.
+inline bool IsValidModelFile(const ModelFileHeader& header, size_t size) {
+  if (size < sizeof(ModelFileHeader) ||
+      memcmp(header.magic, kModelFileMagic, sizeof(kModelFileMagic)) != 0 ||
+      header.version != kModelFileVersion || header.file_size != size ||
+      header.num_vertices > size || header.num_indices > size ||
+      (header.index_size != 2 && header.index_size != 4) ||
+      header.num_lods == 0 || header.num_lods > size) {
+    return false;
+  }
+  const uint64_t streams[5][2] = {
+      {header.positions_offset, header.num_vertices * sizeof(float) * 3},
+      {header.texture_coords_offset, header.num_vertices * sizeof(float) * 2},
+      {header.normals_offset, header.num_vertices * sizeof(float) * 3},
+      {header.indices_offset, header.num_indices * header.index_size},
+      {header.lods_offset, header.num_lods * sizeof(ModelLod)}};
+  uint64_t end = sizeof(ModelFileHeader);
+  for (const auto& stream : streams) {
+    if (stream[0] < end || stream[0] % kModelFileStreamAlignment != 0 ||
+        stream[1] > size - stream[0]) {
+      return false;
+    }
+    end = stream[0] + stream[1];
+  }
+  return true;
+}
+
+// Returns true if |lod| is a range of the |num_indices| indices of a model
+// that only holds whole triangles.
+inline bool IsValidModelLod(const ModelLod& lod, uint64_t num_indices) {
+  return lod.index_count % 3 == 0 && lod.first_index <= num_indices &&
+         lod.index_count <= num_indices - lod.first_index;
+}
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_MODEL_FILE_H_
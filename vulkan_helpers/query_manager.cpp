@@ -0,0 +1,281 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vulkan_helpers/query_manager.h"
+
+#include <cstring>
+
+#include "vulkan_helpers/helper_functions.h"
+
+namespace vulkan {
+namespace {
+// The order of the counters in the results follows the order of these bits.
+const VkQueryPipelineStatisticFlags kPipelineStatistics =
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+}  // anonymous namespace
+
+QueryManager::Scope::Scope(QueryManager* manager,
+                           VkCommandBuffer* command_buffer, const char* name,
+                           uint32_t query_bits)
+    : manager_(manager),
+      command_buffer_(command_buffer),
+      occlusion_query_(UINT32_MAX),
+      statistics_query_(UINT32_MAX) {
+  if (!manager_ || !manager_->recording_frame_) {
+    return;
+  }
+  Frame* frame = manager_->recording_frame_;
+  if (frame->passes.size() == manager_->max_passes_) {
+    ++manager_->dropped_passes_;
+    return;
+  }
+  if (query_bits & kOcclusionQuery) {
+    occlusion_query_ = frame->occlusion_queries++;
+    (*command_buffer_)
+        ->vkCmdBeginQuery(*command_buffer_, *frame->occlusion_pool,
+                          occlusion_query_, 0);
+  }
+  if (query_bits & kPipelineStatisticsQuery) {
+    statistics_query_ = frame->statistics_queries++;
+    (*command_buffer_)
+        ->vkCmdBeginQuery(*command_buffer_, *frame->statistics_pool,
+                          statistics_query_, 0);
+  }
+  frame->passes.push_back({name, occlusion_query_, statistics_query_});
+}
+
+QueryManager::Scope::~Scope() {
+  if (statistics_query_ != UINT32_MAX) {
+    (*command_buffer_)
+        ->vkCmdEndQuery(*command_buffer_,
+                        *manager_->recording_frame_->statistics_pool,
+                        statistics_query_);
+  }
+  if (occlusion_query_ != UINT32_MAX) {
+    (*command_buffer_)
+        ->vkCmdEndQuery(*command_buffer_,
+                        *manager_->recording_frame_->occlusion_pool,
+                        occlusion_query_);
+  }
+}
+
+QueryManager::QueryManager(containers::Allocator* allocator, VkDevice* device,
+                           uint32_t frame_count, bool host_query_reset,
+                           uint32_t max_passes)
+    : allocator_(allocator),
+      log_(device->GetLogger()),
+      device_(device),
+      max_passes_(max_passes),
+      host_query_reset_(host_query_reset),
+      frames_(allocator),
+      current_frame_(0),
+      recording_frame_(nullptr),
+      dropped_passes_(0),
+      mapped_results_(nullptr),
+      frame_result_size_(VkDeviceSize(max_passes) *
+                         (kOcclusionResultSize + kStatisticsResultSize) *
+                         sizeof(uint64_t)),
+      results_(allocator) {
+  VkQueryPoolCreateInfo occlusion_info = {
+      VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,  // sType
+      nullptr,                                   // pNext
+      0,                                         // flags
+      VK_QUERY_TYPE_OCCLUSION,                   // queryType
+      max_passes_,                               // queryCount
+      0,                                         // pipelineStatistics
+  };
+  VkQueryPoolCreateInfo statistics_info = occlusion_info;
+  statistics_info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+  statistics_info.pipelineStatistics = kPipelineStatistics;
+
+  frames_.reserve(frame_count);
+  for (uint32_t i = 0; i < frame_count; ++i) {
+    frames_.push_back(containers::make_unique<Frame>(allocator, allocator));
+    Frame* frame = frames_.back().get();
+    frame->occlusion_pool = containers::make_unique<VkQueryPool>(
+        allocator, CreateQueryPool(device, occlusion_info));
+    frame->statistics_pool = containers::make_unique<VkQueryPool>(
+        allocator, CreateQueryPool(device, statistics_info));
+    frame->passes.reserve(max_passes_);
+  }
+  results_.reserve(max_passes_);
+
+  VkBufferCreateInfo create_info{
+      VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
+      nullptr,                               // pNext
+      0,                                     // flags
+      frame_result_size_ * frame_count,      // size
+      VK_BUFFER_USAGE_TRANSFER_DST_BIT,      // usage
+      VK_SHARING_MODE_EXCLUSIVE,             // sharingMode
+      0,                                     // queueFamilyIndexCount
+      nullptr                                // pQueueFamilyIndices
+  };
+  ::VkBuffer raw_buffer;
+  LOG_ASSERT(==, log_, VK_SUCCESS,
+             (*device_)->vkCreateBuffer(*device_, &create_info, nullptr,
+                                        &raw_buffer));
+  result_buffer_ = containers::make_unique<VkBuffer>(
+      allocator_, VkBuffer(raw_buffer, nullptr, device_));
+
+  VkMemoryRequirements requirements;
+  (*device_)->vkGetBufferMemoryRequirements(*device_, raw_buffer,
+                                            &requirements);
+  const uint32_t memory_index =
+      GetMemoryIndex(device_, log_, requirements.memoryTypeBits,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  result_memory_ = containers::make_unique<VkDeviceMemory>(
+      allocator_,
+      AllocateDeviceMemory(device_, memory_index, requirements.size));
+  LOG_ASSERT(==, log_, VK_SUCCESS,
+             (*device_)->vkBindBufferMemory(*device_, raw_buffer,
+                                            *result_memory_, 0));
+  void* mapped = nullptr;
+  LOG_ASSERT(==, log_, VK_SUCCESS,
+             (*device_)->vkMapMemory(*device_, *result_memory_, 0,
+                                     VK_WHOLE_SIZE, 0, &mapped));
+  mapped_results_ = static_cast<uint64_t*>(mapped);
+  memset(mapped_results_, 0, frame_result_size_ * frame_count);
+}
+
+uint64_t* QueryManager::FrameResults(size_t frame) const {
+  return mapped_results_ + frame * (frame_result_size_ / sizeof(uint64_t));
+}
+
+void QueryManager::BeginFrame(VkCommandBuffer* command_buffer) {
+  current_frame_ = (current_frame_ + 1) % frames_.size();
+  Frame* frame = frames_[current_frame_].get();
+  if (frame->copied) {
+    ReadResults(current_frame_);
+    // Clear the availability of the old results, so that missing ones are
+    // noticed.
+    memset(FrameResults(current_frame_), 0, frame_result_size_);
+  }
+
+  if (host_query_reset_) {
+    (*device_)->vkResetQueryPoolEXT(*device_, *frame->occlusion_pool, 0,
+                                    max_passes_);
+    (*device_)->vkResetQueryPoolEXT(*device_, *frame->statistics_pool, 0,
+                                    max_passes_);
+  } else {
+    (*command_buffer)
+        ->vkCmdResetQueryPool(*command_buffer, *frame->occlusion_pool, 0,
+                              max_passes_);
+    (*command_buffer)
+        ->vkCmdResetQueryPool(*command_buffer, *frame->statistics_pool, 0,
+                              max_passes_);
+  }
+  frame->passes.clear();
+  frame->occlusion_queries = 0;
+  frame->statistics_queries = 0;
+  frame->copied = false;
+  recording_frame_ = frame;
+}
+
+void QueryManager::EndFrame(VkCommandBuffer* command_buffer) {
+  Frame* frame = recording_frame_;
+  if (!frame) {
+    return;
+  }
+  const VkDeviceSize offset = current_frame_ * frame_result_size_;
+  const VkQueryResultFlags flags = VK_QUERY_RESULT_64_BIT |
+                                   VK_QUERY_RESULT_WAIT_BIT |
+                                   VK_QUERY_RESULT_WITH_AVAILABILITY_BIT;
+  // The GPU waits for the queries, the CPU only looks at them once the
+  // frame is done.
+  if (frame->occlusion_queries != 0) {
+    (*command_buffer)
+        ->vkCmdCopyQueryPoolResults(
+            *command_buffer, *frame->occlusion_pool, 0,
+            frame->occlusion_queries, *result_buffer_, offset,
+            kOcclusionResultSize * sizeof(uint64_t), flags);
+  }
+  if (frame->statistics_queries != 0) {
+    (*command_buffer)
+        ->vkCmdCopyQueryPoolResults(
+            *command_buffer, *frame->statistics_pool, 0,
+            frame->statistics_queries, *result_buffer_,
+            offset + max_passes_ * kOcclusionResultSize * sizeof(uint64_t),
+            kStatisticsResultSize * sizeof(uint64_t), flags);
+  }
+  VkBufferMemoryBarrier barrier{
+      VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+      nullptr,                                  // pNext
+      VK_ACCESS_TRANSFER_WRITE_BIT,             // srcAccessMask
+      VK_ACCESS_HOST_READ_BIT,                  // dstAccessMask
+      VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
+      VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
+      *result_buffer_,                          // buffer
+      offset,                                   // offset
+      frame_result_size_,                       // size
+  };
+  (*command_buffer)
+      ->vkCmdPipelineBarrier(*command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1,
+                             &barrier, 0, nullptr);
+  frame->copied = true;
+  recording_frame_ = nullptr;
+}
+
+void QueryManager::ReadResults(size_t frame_index) {
+  const Frame& frame = *frames_[frame_index];
+  const uint64_t* occlusion = FrameResults(frame_index);
+  const uint64_t* statistics =
+      occlusion + max_passes_ * kOcclusionResultSize;
+
+  // The copy waited for every query, so they can only be missing if the
+  // frame has not finished, in which case the ring is too small.
+  for (const Pass& pass : frame.passes) {
+    if ((pass.occlusion_query != UINT32_MAX &&
+         !occlusion[pass.occlusion_query * kOcclusionResultSize + 1]) ||
+        (pass.statistics_query != UINT32_MAX &&
+         !statistics[pass.statistics_query * kStatisticsResultSize + 3])) {
+      dropped_passes_ += static_cast<uint32_t>(frame.passes.size());
+      log_->LogError("Query results were not ready, ", dropped_passes_,
+                     " passes have been dropped so far");
+      return;
+    }
+  }
+
+  results_.clear();
+  for (const Pass& pass : frame.passes) {
+    PassStatistics result = {pass.name, 0, 0, 0, 0};
+    if (pass.occlusion_query != UINT32_MAX) {
+      result.samples_passed =
+          occlusion[pass.occlusion_query * kOcclusionResultSize];
+    }
+    if (pass.statistics_query != UINT32_MAX) {
+      const uint64_t* counters =
+          statistics + pass.statistics_query * kStatisticsResultSize;
+      result.vertex_invocations = counters[0];
+      result.fragment_invocations = counters[1];
+      result.compute_invocations = counters[2];
+    }
+    results_.push_back(result);
+  }
+}
+
+const PassStatistics* QueryManager::GetPass(const char* name) const {
+  for (const PassStatistics& result : results_) {
+    if (result.name == name || strcmp(result.name, name) == 0) {
+      return &result;
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace vulkan
@@ -0,0 +1,154 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_QUERY_MANAGER_H_
+#define VULKAN_HELPERS_QUERY_MANAGER_H_
+
+#include <cstdint>
+
+#include "support/containers/allocator.h"
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "support/log/log.h"
+#include "vulkan_wrapper/command_buffer_wrapper.h"
+#include "vulkan_wrapper/device_wrapper.h"
+#include "vulkan_wrapper/sub_objects.h"
+
+namespace vulkan {
+
+// The queries that a QueryManager pass can use.
+enum QueryBits : uint32_t {
+  kOcclusionQuery = 1 << 0,
+  kPipelineStatisticsQuery = 1 << 1,
+};
+
+// The statistics of one pass of a frame. Counters of queries that the pass
+// did not use are 0.
+struct PassStatistics {
+  const char* name;
+  uint64_t samples_passed;
+  uint64_t vertex_invocations;
+  uint64_t fragment_invocations;
+  uint64_t compute_invocations;
+};
+
+// QueryManager collects occlusion and pipeline statistics queries for named
+// passes of each frame, without the CPU ever waiting on them.
+//
+// Every frame gets its own pair of query pools, out of a ring of
+// |frame_count|, which has to be at least the number of frames in flight.
+// They are reset in bulk by BeginFrame(), on the host if
+// |host_query_reset| is set (VulkanApplicationOptions::EnableHostQueryReset)
+// and with vkCmdResetQueryPool otherwise. EndFrame() copies every result of
+// the frame into a host-visible buffer with vkCmdCopyQueryPoolResults, and
+// they are read from there when BeginFrame() comes back around to the
+// frame, which makes them |frame_count| frames old.
+//
+// Pipeline statistics queries need the pipelineStatisticsQuery feature.
+// All member functions have to be called from the same thread.
+class QueryManager {
+ public:
+  static const uint32_t kDefaultMaxPasses = 64;
+
+  // Runs the queries in |query_bits| for the commands recorded into
+  // |command_buffer| during its lifetime. The same restrictions as for
+  // vkCmdBeginQuery apply, for example a scope that starts in a subpass has
+  // to end in it. |name| has to outlive the manager. Does nothing if
+  // |manager| is nullptr.
+  class Scope {
+   public:
+    Scope(QueryManager* manager, VkCommandBuffer* command_buffer,
+          const char* name, uint32_t query_bits);
+    ~Scope();
+
+   private:
+    QueryManager* manager_;
+    VkCommandBuffer* command_buffer_;
+    uint32_t occlusion_query_;
+    uint32_t statistics_query_;
+  };
+
+  QueryManager(containers::Allocator* allocator, VkDevice* device,
+               uint32_t frame_count, bool host_query_reset,
+               uint32_t max_passes = kDefaultMaxPasses);
+
+  // Reads back the results of the frame that used the next pools in the
+  // ring, which has to have finished on the GPU, and resets them. Unless
+  // host query reset is used, the reset is recorded into |command_buffer|,
+  // which has to be submitted before any scope of this frame.
+  void BeginFrame(VkCommandBuffer* command_buffer);
+  // Records the copy of the results of this frame into |command_buffer|,
+  // which has to be submitted after every scope of this frame, and outside
+  // of a render pass.
+  void EndFrame(VkCommandBuffer* command_buffer);
+
+  // The statistics of every pass of the last frame that has been read back.
+  const containers::vector<PassStatistics>& results() const {
+    return results_;
+  }
+  // Returns the statistics of the pass named |name|, or nullptr if the last
+  // frame that has been read back did not have one.
+  const PassStatistics* GetPass(const char* name) const;
+
+ private:
+  // The value and availability of each query.
+  static const uint32_t kOcclusionResultSize = 2;
+  // Three counters and the availability of each query.
+  static const uint32_t kStatisticsResultSize = 4;
+
+  struct Pass {
+    const char* name;
+    uint32_t occlusion_query;
+    uint32_t statistics_query;
+  };
+
+  struct Frame {
+    Frame(containers::Allocator* allocator) : passes(allocator) {}
+    containers::unique_ptr<VkQueryPool> occlusion_pool;
+    containers::unique_ptr<VkQueryPool> statistics_pool;
+    containers::vector<Pass> passes;
+    uint32_t occlusion_queries = 0;
+    uint32_t statistics_queries = 0;
+    // Set once EndFrame() has copied the results.
+    bool copied = false;
+  };
+
+  // Returns the results of |frame| in the mapped buffer.
+  uint64_t* FrameResults(size_t frame) const;
+  // Reads the results of |frame| into |results_|, if they are available.
+  void ReadResults(size_t frame);
+
+  containers::Allocator* allocator_;
+  logging::Logger* log_;
+  VkDevice* device_;
+  const uint32_t max_passes_;
+  const bool host_query_reset_;
+  containers::vector<containers::unique_ptr<Frame>> frames_;
+  size_t current_frame_;
+  Frame* recording_frame_;
+  uint32_t dropped_passes_;
+
+  // Holds the results of every frame, one after the other.
+  containers::unique_ptr<VkBuffer> result_buffer_;
+  containers::unique_ptr<VkDeviceMemory> result_memory_;
+  uint64_t* mapped_results_;
+  VkDeviceSize frame_result_size_;
+
+  containers::vector<PassStatistics> results_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_QUERY_MANAGER_H_
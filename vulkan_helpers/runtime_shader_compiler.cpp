@@ -0,0 +1,436 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vulkan_helpers/runtime_shader_compiler.h"
+
+#include <sys/stat.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#if defined _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+namespace vulkan {
+namespace {
+const uint64_t kFnvOffsetBasis = 14695981039346656037ull;
+const uint64_t kFnvPrime = 1099511628211ull;
+
+void HashBytes(uint64_t* hash, const void* data, size_t size) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    *hash = (*hash ^ bytes[i]) * kFnvPrime;
+  }
+}
+
+void HashString(uint64_t* hash, const containers::string& str) {
+  // Include the terminator, so that "ab","c" and "a","bc" hash differently.
+  HashBytes(hash, str.c_str(), str.size() + 1);
+}
+
+// Returns the modification time of |path|, or -1 if it does not exist.
+int64_t ModificationTime(const char* path) {
+  struct stat info;
+  if (stat(path, &info) != 0) {
+    return -1;
+  }
+  return static_cast<int64_t>(info.st_mtime);
+}
+
+bool FileExists(const containers::string& path) {
+  return ModificationTime(path.c_str()) != -1;
+}
+
+containers::string Directory(const containers::string& path) {
+  size_t separator = path.find_last_of("/\\");
+  if (separator == containers::string::npos) {
+    return containers::string(".", path.get_allocator());
+  }
+  return containers::string(path.c_str(), separator, path.get_allocator());
+}
+
+bool ReadFile(const char* path, containers::string* contents) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  std::ostringstream stream;
+  stream << file.rdbuf();
+  const std::string data = stream.str();
+  contents->assign(data.c_str(), data.size());
+  return !file.bad();
+}
+
+bool WriteFile(const char* path, const containers::string& contents) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file) {
+    return false;
+  }
+  file.write(contents.c_str(), contents.size());
+  return !file.bad();
+}
+
+bool ReadSpirv(const char* path, containers::vector<uint32_t>* code) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) {
+    return false;
+  }
+  size_t size = static_cast<size_t>(file.tellg());
+  if (size == 0 || size % sizeof(uint32_t) != 0) {
+    return false;
+  }
+  file.seekg(0, std::ios::beg);
+  code->resize(size / sizeof(uint32_t));
+  file.read(reinterpret_cast<char*>(code->data()), size);
+  return !file.bad();
+}
+
+// Returns the suffix that glslc uses for |stage| in -fshader-stage.
+const char* GlslcStageName(VkShaderStageFlagBits stage) {
+  switch (stage) {
+    case VK_SHADER_STAGE_VERTEX_BIT:
+      return "vert";
+    case VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT:
+      return "tesc";
+    case VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT:
+      return "tese";
+    case VK_SHADER_STAGE_GEOMETRY_BIT:
+      return "geom";
+    case VK_SHADER_STAGE_FRAGMENT_BIT:
+      return "frag";
+    case VK_SHADER_STAGE_COMPUTE_BIT:
+      return "comp";
+    default:
+      return nullptr;
+  }
+}
+
+// Returns the DXC target profile for |stage|.
+const char* DxcProfile(VkShaderStageFlagBits stage) {
+  switch (stage) {
+    case VK_SHADER_STAGE_VERTEX_BIT:
+      return "vs_6_0";
+    case VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT:
+      return "hs_6_0";
+    case VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT:
+      return "ds_6_0";
+    case VK_SHADER_STAGE_GEOMETRY_BIT:
+      return "gs_6_0";
+    case VK_SHADER_STAGE_FRAGMENT_BIT:
+      return "ps_6_0";
+    case VK_SHADER_STAGE_COMPUTE_BIT:
+      return "cs_6_0";
+    default:
+      return nullptr;
+  }
+}
+}  // anonymous namespace
+
+RuntimeShader::RuntimeShader(containers::Allocator* allocator,
+                             const char* path, VkShaderStageFlagBits stage,
+                             const char* entry_point,
+                             std::initializer_list<const char*> defines)
+    : path_(path, allocator),
+      stage_(stage),
+      entry_point_(entry_point, allocator),
+      defines_(allocator),
+      sources_(allocator),
+      code_(allocator),
+      generation_(0) {
+  for (const char* define : defines) {
+    defines_.emplace_back(define, allocator);
+  }
+}
+
+RuntimeShaderCompiler::RuntimeShaderCompiler(containers::Allocator* allocator,
+                                             logging::Logger* log,
+                                             const char* shader_compiler,
+                                             const char* cache_dir,
+                                             const char* compiler_binary)
+    : allocator_(allocator),
+      log_(log),
+      compiler_(Compiler::kGlslcGlsl),
+      compiler_binary_(allocator),
+      cache_dir_(cache_dir ? cache_dir : "", allocator),
+      compiler_version_(allocator),
+      include_directories_(allocator),
+      shaders_(allocator),
+      cache_hits_(0),
+      cache_misses_(0) {
+  if (strncmp(shader_compiler, "glslc-glsl", 10) == 0) {
+    compiler_ = Compiler::kGlslcGlsl;
+  } else if (strncmp(shader_compiler, "glslc-hlsl", 10) == 0) {
+    compiler_ = Compiler::kGlslcHlsl;
+  } else if (strncmp(shader_compiler, "dxc-hlsl", 8) == 0) {
+    compiler_ = Compiler::kDxcHlsl;
+  } else {
+    LOG_ASSERT(==, log, shader_compiler,
+               "glslc-glsl or glslc-hlsl or dxc-hlsl");
+  }
+  if (compiler_binary) {
+    compiler_binary_ = compiler_binary;
+  } else {
+    compiler_binary_ = compiler_ == Compiler::kDxcHlsl ? "dxc" : "glslc";
+  }
+
+  // The first line of the version output is enough to tell compiler builds
+  // apart, and is what ends up in every cache key.
+  containers::string command(allocator);
+  command.append("\"").append(compiler_binary_).append("\" --version 2>&1");
+  FILE* version = popen(command.c_str(), "r");
+  if (version) {
+    char line[256];
+    if (fgets(line, sizeof(line), version)) {
+      compiler_version_ = line;
+      while (!compiler_version_.empty() &&
+             (compiler_version_.back() == '\n' ||
+              compiler_version_.back() == '\r')) {
+        compiler_version_.pop_back();
+      }
+    }
+    if (pclose(version) != 0) {
+      compiler_version_.clear();
+    }
+  }
+  if (available()) {
+    log_->LogInfo("Compiling shaders at runtime with ", compiler_version_);
+  } else {
+    log_->LogError("Could not run ", compiler_binary_,
+                   ", only cached shaders can be loaded");
+  }
+}
+
+void RuntimeShaderCompiler::AddIncludeDirectory(const char* directory) {
+  include_directories_.emplace_back(directory, allocator_);
+}
+
+RuntimeShader* RuntimeShaderCompiler::Load(
+    const char* path, VkShaderStageFlagBits stage,
+    std::initializer_list<const char*> defines, const char* entry_point) {
+  auto shader = containers::make_unique<RuntimeShader>(
+      allocator_, allocator_, path, stage, entry_point, defines);
+  if (!Compile(shader.get())) {
+    return nullptr;
+  }
+  shaders_.push_back(std::move(shader));
+  return shaders_.back().get();
+}
+
+bool RuntimeShaderCompiler::PollForChanges() {
+  bool changed = false;
+  for (auto& shader : shaders_) {
+    bool modified = false;
+    for (const auto& source : shader->sources_) {
+      if (ModificationTime(source.path.c_str()) != source.modification_time) {
+        modified = true;
+        break;
+      }
+    }
+    if (!modified) {
+      continue;
+    }
+    log_->LogInfo("Reloading ", shader->path_);
+    if (Compile(shader.get())) {
+      changed = true;
+    } else {
+      // Remember the new modification times anyway, so that a broken
+      // shader is not recompiled every frame until it is fixed.
+      for (auto& source : shader->sources_) {
+        source.modification_time = ModificationTime(source.path.c_str());
+      }
+    }
+  }
+  return changed;
+}
+
+containers::string RuntimeShaderCompiler::ResolveInclude(
+    const containers::string& including_file, const containers::string& name) {
+  containers::string candidate(Directory(including_file));
+  candidate.append("/").append(name);
+  if (FileExists(candidate)) {
+    return candidate;
+  }
+  for (const auto& directory : include_directories_) {
+    candidate = directory;
+    candidate.append("/").append(name);
+    if (FileExists(candidate)) {
+      return candidate;
+    }
+  }
+  return containers::string(allocator_);
+}
+
+bool RuntimeShaderCompiler::GatherSources(
+    const char* path, containers::vector<RuntimeShader::SourceFile>* sources,
+    uint64_t* hash) {
+  for (const auto& source : *sources) {
+    if (source.path == path) {
+      return true;
+    }
+  }
+
+  containers::string contents(allocator_);
+  int64_t modification_time = ModificationTime(path);
+  if (!ReadFile(path, &contents)) {
+    log_->LogError("Could not read shader source ", path);
+    return false;
+  }
+  sources->push_back(
+      {containers::string(path, allocator_), modification_time});
+  HashString(hash, contents);
+
+  // Follow quoted #include directives, so that changes to included files
+  // invalidate the cache and trigger a reload. Includes that cannot be found
+  // are left for the compiler to report.
+  const containers::string including_file(path, allocator_);
+  size_t line_start = 0;
+  while (line_start < contents.size()) {
+    size_t line_end = contents.find('\n', line_start);
+    if (line_end == containers::string::npos) {
+      line_end = contents.size();
+    }
+    size_t directive = contents.find_first_not_of(" \t", line_start);
+    if (directive != containers::string::npos && directive < line_end &&
+        strncmp(contents.c_str() + directive, "#include", 8) == 0) {
+      size_t open = contents.find('"', directive + 8);
+      size_t close = open == containers::string::npos
+                         ? containers::string::npos
+                         : contents.find('"', open + 1);
+      if (close != containers::string::npos && close < line_end) {
+        containers::string included = ResolveInclude(
+            including_file,
+            containers::string(contents.c_str() + open + 1, close - open - 1,
+                               allocator_));
+        if (!included.empty() &&
+            !GatherSources(included.c_str(), sources, hash)) {
+          return false;
+        }
+      }
+    }
+    line_start = line_end + 1;
+  }
+  return true;
+}
+
+containers::string RuntimeShaderCompiler::CompileCommand(
+    const RuntimeShader& shader, const containers::string& output) {
+  containers::string command(allocator_);
+  command.append("\"").append(compiler_binary_).append("\"");
+  if (compiler_ == Compiler::kDxcHlsl) {
+    command.append(" -spirv -T ")
+        .append(DxcProfile(shader.stage_))
+        .append(" -E ")
+        .append(shader.entry_point_);
+    for (const auto& directory : include_directories_) {
+      command.append(" -I \"").append(directory).append("\"");
+    }
+    for (const auto& define : shader.defines_) {
+      command.append(" -D \"").append(define).append("\"");
+    }
+    command.append(" -Fo \"").append(output).append("\"");
+  } else {
+    command.append(" -fshader-stage=").append(GlslcStageName(shader.stage_));
+    if (compiler_ == Compiler::kGlslcHlsl) {
+      command.append(" -x hlsl -fentry-point=").append(shader.entry_point_);
+    }
+    for (const auto& directory : include_directories_) {
+      command.append(" -I\"").append(directory).append("\"");
+    }
+    for (const auto& define : shader.defines_) {
+      command.append(" -D\"").append(define).append("\"");
+    }
+    command.append(" -o \"").append(output).append("\"");
+  }
+  command.append(" \"").append(shader.path_).append("\"");
+  return command;
+}
+
+bool RuntimeShaderCompiler::Compile(RuntimeShader* shader) {
+  if (!GlslcStageName(shader->stage_)) {
+    log_->LogError("Unsupported shader stage ", shader->stage_, " for ",
+                   shader->path_);
+    return false;
+  }
+
+  containers::vector<RuntimeShader::SourceFile> sources(allocator_);
+  uint64_t hash = kFnvOffsetBasis;
+  if (!GatherSources(shader->path_.c_str(), &sources, &hash)) {
+    return false;
+  }
+  HashBytes(&hash, &compiler_, sizeof(compiler_));
+  HashBytes(&hash, &shader->stage_, sizeof(shader->stage_));
+  HashString(&hash, shader->entry_point_);
+  for (const auto& define : shader->defines_) {
+    HashString(&hash, define);
+  }
+
+  char name[32];
+  snprintf(name, sizeof(name), "/%016llx.spv",
+           static_cast<unsigned long long>(hash));
+  containers::string cache_file(
+      cache_dir_.empty() ? Directory(shader->path_) : cache_dir_);
+  cache_file.append(name);
+  // The compiler version that wrote the entry. It is only checked when
+  // there is a compiler to replace an outdated entry with.
+  containers::string version_file(cache_file);
+  version_file.append(".version");
+
+  containers::vector<uint32_t> code(allocator_);
+  containers::string cached_version(allocator_);
+  if (ReadSpirv(cache_file.c_str(), &code) &&
+      (!available() || (ReadFile(version_file.c_str(), &cached_version) &&
+                        cached_version == compiler_version_))) {
+    ++cache_hits_;
+  } else {
+    ++cache_misses_;
+    if (!available()) {
+      log_->LogError("Cannot compile ", shader->path_,
+                     " without a shader compiler");
+      return false;
+    }
+    // Compile to a temporary file first, so that a failed or interrupted
+    // compile never leaves a bad entry in the cache.
+    containers::string temporary(cache_file);
+    temporary.append(".tmp");
+    containers::string command = CompileCommand(*shader, temporary);
+    if (std::system(command.c_str()) != 0) {
+      log_->LogError("Failed to compile ", shader->path_, ":\n  ", command);
+      std::remove(temporary.c_str());
+      return false;
+    }
+    std::remove(cache_file.c_str());
+    if (std::rename(temporary.c_str(), cache_file.c_str()) != 0 ||
+        !ReadSpirv(cache_file.c_str(), &code)) {
+      log_->LogError("Could not read compiled shader ", cache_file);
+      return false;
+    }
+    if (!WriteFile(version_file.c_str(), compiler_version_)) {
+      log_->LogError("Could not write ", version_file,
+                     ", the shader will be compiled again next time");
+    }
+  }
+
+  shader->code_.swap(code);
+  shader->sources_.swap(sources);
+  ++shader->generation_;
+  return true;
+}
+
+}  // namespace vulkan
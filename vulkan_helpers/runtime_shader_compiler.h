@@ -0,0 +1,149 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_RUNTIME_SHADER_COMPILER_H_
+#define VULKAN_HELPERS_RUNTIME_SHADER_COMPILER_H_
+
+#include <cstdint>
+#include <initializer_list>
+
+#include "support/containers/allocator.h"
+#include "support/containers/string.h"
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "support/log/log.h"
+#include "vulkan_helpers/vulkan_header_wrapper.h"
+
+namespace vulkan {
+
+// A shader that was compiled to SPIR-V at runtime by a
+// RuntimeShaderCompiler. Its code is replaced when the compiler notices that
+// one of its source files changed.
+class RuntimeShader {
+ public:
+  RuntimeShader(containers::Allocator* allocator, const char* path,
+                VkShaderStageFlagBits stage, const char* entry_point,
+                std::initializer_list<const char*> defines);
+
+  uint32_t* code() { return code_.data(); }
+  uint32_t word_count() const { return static_cast<uint32_t>(code_.size()); }
+  VkShaderStageFlagBits stage() const { return stage_; }
+  const char* entry_point() const { return entry_point_.c_str(); }
+  // Incremented every time the shader gets new code.
+  uint32_t generation() const { return generation_; }
+
+ private:
+  friend class RuntimeShaderCompiler;
+
+  // A file the shader was compiled from, and its modification time at that
+  // point.
+  struct SourceFile {
+    containers::string path;
+    int64_t modification_time;
+  };
+
+  containers::string path_;
+  VkShaderStageFlagBits stage_;
+  containers::string entry_point_;
+  containers::vector<containers::string> defines_;
+  // The shader itself, followed by every file it includes.
+  containers::vector<SourceFile> sources_;
+  containers::vector<uint32_t> code_;
+  uint32_t generation_;
+};
+
+// RuntimeShaderCompiler compiles GLSL or HLSL shaders to SPIR-V while the
+// application is running, by invoking glslc or DXC, so that shaders can be
+// changed without rebuilding the samples that use them.
+//
+// Compiled SPIR-V is cached on disk. The cache key is a hash of the shader
+// source and everything it includes, the defines, stage and entry point, so
+// changing any of them compiles the shader again, and changing them back
+// hits the cache. The version reported by the compiler is stored next to
+// each entry, and entries from another version are compiled again. Without
+// a compiler, entries are used whatever version wrote them, so a cache that
+// was filled on another machine can be shipped with the application.
+//
+// Shaders that are loaded are watched: PollForChanges() recompiles every
+// shader whose source files changed since it was last compiled.
+class RuntimeShaderCompiler {
+ public:
+  // |shader_compiler| selects the compiler and source language, and accepts
+  // the same values as ShaderCollection: glslc-glsl, glslc-hlsl or
+  // dxc-hlsl. The compiler is run as |compiler_binary|, or glslc or dxc from
+  // the PATH if that is nullptr. SPIR-V is cached in |cache_dir|, or next
+  // to each shader source if that is nullptr.
+  RuntimeShaderCompiler(containers::Allocator* allocator,
+                        logging::Logger* log, const char* shader_compiler,
+                        const char* cache_dir,
+                        const char* compiler_binary = nullptr);
+
+  // Returns true if the compiler could be run. If it could not, every
+  // shader that is not in the cache fails to load.
+  bool available() const { return !compiler_version_.empty(); }
+  const containers::string& compiler_version() const {
+    return compiler_version_;
+  }
+
+  // Adds a directory that #include directives are resolved against.
+  void AddIncludeDirectory(const char* directory);
+
+  // Loads the shader at |path| for |stage|. Each of |defines| is either
+  // NAME or NAME=VALUE. Returns nullptr if the shader could not be compiled.
+  // The shader is owned by the compiler.
+  RuntimeShader* Load(const char* path, VkShaderStageFlagBits stage,
+                      std::initializer_list<const char*> defines = {},
+                      const char* entry_point = "main");
+
+  // Recompiles every loaded shader whose sources changed. Returns true if
+  // any shader got new code. A shader that fails to compile keeps its old
+  // code.
+  bool PollForChanges();
+
+  size_t cache_hits() const { return cache_hits_; }
+  size_t cache_misses() const { return cache_misses_; }
+
+ private:
+  enum class Compiler { kGlslcGlsl, kGlslcHlsl, kDxcHlsl };
+
+  // Finds the shader's source files and compiles it, either from the cache
+  // or by running the compiler. Returns false, and leaves the shader's code
+  // untouched, if that fails.
+  bool Compile(RuntimeShader* shader);
+  // Appends |path| and every file it includes to |sources|, and hashes
+  // their contents into |hash|.
+  bool GatherSources(const char* path,
+                     containers::vector<RuntimeShader::SourceFile>* sources,
+                     uint64_t* hash);
+  containers::string ResolveInclude(const containers::string& including_file,
+                                    const containers::string& name);
+  containers::string CompileCommand(const RuntimeShader& shader,
+                                    const containers::string& output);
+
+  containers::Allocator* allocator_;
+  logging::Logger* log_;
+  Compiler compiler_;
+  containers::string compiler_binary_;
+  containers::string cache_dir_;
+  containers::string compiler_version_;
+  containers::vector<containers::string> include_directories_;
+  containers::vector<containers::unique_ptr<RuntimeShader>> shaders_;
+  size_t cache_hits_;
+  size_t cache_misses_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_RUNTIME_SHADER_COMPILER_H_
@@ -0,0 +1,296 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vulkan_helpers/texture_compression.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace vulkan {
+namespace {
+
+const size_t kBlockSize = 4;
+
+// The texels of one decoded block, in rows, with 4 channels per texel. Only
+// the first channel is used for single channel formats.
+typedef uint8_t DecodedBlock[kBlockSize * kBlockSize][4];
+
+uint8_t Clamp255(int value) {
+  return static_cast<uint8_t>(std::min(std::max(value, 0), 255));
+}
+
+uint64_t ReadLittleEndian(const uint8_t* data, size_t num_bytes) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < num_bytes; ++i) {
+    value |= uint64_t(data[i]) << (8 * i);
+  }
+  return value;
+}
+
+uint64_t ReadBigEndian(const uint8_t* data, size_t num_bytes) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < num_bytes; ++i) {
+    value = (value << 8) | data[i];
+  }
+  return value;
+}
+
+// Decodes the 8 byte color block of BC1, or of BC3, which always uses four
+// colors.
+void DecodeBC1Color(const uint8_t* block, bool always_four_colors,
+                    DecodedBlock* out) {
+  const uint32_t c[2] = {static_cast<uint32_t>(ReadLittleEndian(block, 2)),
+                         static_cast<uint32_t>(ReadLittleEndian(block + 2, 2))};
+  int palette[4][4];
+  for (size_t i = 0; i < 2; ++i) {
+    const uint32_t r = (c[i] >> 11) & 0x1f;
+    const uint32_t g = (c[i] >> 5) & 0x3f;
+    const uint32_t b = c[i] & 0x1f;
+    palette[i][0] = (r << 3) | (r >> 2);
+    palette[i][1] = (g << 2) | (g >> 4);
+    palette[i][2] = (b << 3) | (b >> 2);
+    palette[i][3] = 255;
+  }
+  const bool four_colors = always_four_colors || c[0] > c[1];
+  for (size_t ch = 0; ch < 3; ++ch) {
+    if (four_colors) {
+      palette[2][ch] = (2 * palette[0][ch] + palette[1][ch]) / 3;
+      palette[3][ch] = (palette[0][ch] + 2 * palette[1][ch]) / 3;
+    } else {
+      palette[2][ch] = (palette[0][ch] + palette[1][ch]) / 2;
+      palette[3][ch] = 0;
+    }
+  }
+  palette[2][3] = palette[3][3] = 255;
+
+  const uint64_t indices = ReadLittleEndian(block + 4, 4);
+  for (size_t i = 0; i < kBlockSize * kBlockSize; ++i) {
+    const int* color = palette[(indices >> (2 * i)) & 0x3];
+    for (size_t ch = 0; ch < 4; ++ch) {
+      (*out)[i][ch] = static_cast<uint8_t>(color[ch]);
+    }
+  }
+}
+
+// Decodes the 8 byte single channel block of BC4, or the alpha of BC3, into
+// |channel| of every texel.
+void DecodeBC4(const uint8_t* block, size_t channel, DecodedBlock* out) {
+  const int r0 = block[0];
+  const int r1 = block[1];
+  int palette[8] = {r0, r1};
+  if (r0 > r1) {
+    for (int i = 1; i < 7; ++i) {
+      palette[i + 1] = ((7 - i) * r0 + i * r1 + 3) / 7;
+    }
+  } else {
+    for (int i = 1; i < 5; ++i) {
+      palette[i + 1] = ((5 - i) * r0 + i * r1 + 2) / 5;
+    }
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+  const uint64_t indices = ReadLittleEndian(block + 2, 6);
+  for (size_t i = 0; i < kBlockSize * kBlockSize; ++i) {
+    (*out)[i][channel] =
+        static_cast<uint8_t>(palette[(indices >> (3 * i)) & 0x7]);
+  }
+}
+
+// Decodes an ETC2 color block that uses the individual or differential mode
+// of ETC1. Returns false for the T, H and planar modes.
+bool DecodeETC2Color(const uint8_t* block, DecodedBlock* out) {
+  static const int kModifiers[8][2] = {{2, 8},   {5, 17},  {9, 29},
+                                       {13, 42}, {18, 60}, {24, 80},
+                                       {33, 106}, {47, 183}};
+  const uint64_t bits = ReadBigEndian(block, 8);
+  const bool differential = (bits >> 33) & 0x1;
+  const bool flip = (bits >> 32) & 0x1;
+
+  int base[2][3];
+  for (size_t ch = 0; ch < 3; ++ch) {
+    const size_t shift = 59 - 8 * ch;
+    if (differential) {
+      const int c = (bits >> shift) & 0x1f;
+      // The delta is a 3 bit two's complement number.
+      const int delta = (static_cast<int>((bits >> (shift - 3)) & 0x7) ^ 4) - 4;
+      if (c + delta < 0 || c + delta > 31) {
+        return false;
+      }
+      base[0][ch] = (c << 3) | (c >> 2);
+      base[1][ch] = ((c + delta) << 3) | ((c + delta) >> 2);
+    } else {
+      const int c0 = (bits >> (shift + 1)) & 0xf;
+      const int c1 = (bits >> (shift - 3)) & 0xf;
+      base[0][ch] = (c0 << 4) | c0;
+      base[1][ch] = (c1 << 4) | c1;
+    }
+  }
+  const size_t tables[2] = {static_cast<size_t>((bits >> 37) & 0x7),
+                            static_cast<size_t>((bits >> 34) & 0x7)};
+
+  for (size_t y = 0; y < kBlockSize; ++y) {
+    for (size_t x = 0; x < kBlockSize; ++x) {
+      // The indices are stored by column.
+      const size_t i = x * kBlockSize + y;
+      const size_t index =
+          (((bits >> (16 + i)) & 0x1) << 1) | ((bits >> i) & 0x1);
+      const size_t subblock = (flip ? y : x) >= 2 ? 1 : 0;
+      const int magnitude = kModifiers[tables[subblock]][index & 0x1];
+      const int modifier = (index & 0x2) ? -magnitude : magnitude;
+      for (size_t ch = 0; ch < 3; ++ch) {
+        (*out)[y * kBlockSize + x][ch] =
+            Clamp255(base[subblock][ch] + modifier);
+      }
+      (*out)[y * kBlockSize + x][3] = 255;
+    }
+  }
+  return true;
+}
+
+const int kEACModifiers[16][8] = {
+    {-3, -6, -9, -15, 2, 5, 8, 14}, {-3, -7, -10, -13, 2, 6, 9, 12},
+    {-2, -5, -8, -13, 1, 4, 7, 12}, {-2, -4, -6, -13, 1, 3, 5, 12},
+    {-3, -6, -8, -12, 2, 5, 7, 11}, {-3, -7, -9, -11, 2, 6, 8, 10},
+    {-4, -7, -8, -11, 3, 6, 7, 10}, {-3, -5, -8, -11, 2, 4, 7, 10},
+    {-2, -6, -8, -10, 1, 5, 7, 9},  {-2, -5, -8, -10, 1, 4, 7, 9},
+    {-2, -4, -8, -10, 1, 3, 7, 9},  {-2, -5, -7, -10, 1, 4, 6, 9},
+    {-3, -4, -7, -10, 2, 3, 6, 9},  {-1, -2, -3, -10, 0, 1, 2, 9},
+    {-4, -6, -8, -9, 3, 5, 7, 8},   {-3, -5, -7, -9, 2, 4, 6, 8}};
+
+// Decodes an EAC block into |channel| of every texel, either as the 8 bit
+// alpha of ETC2 or as an 11 bit red channel, which is rounded to 8 bits.
+void DecodeEAC(const uint8_t* block, bool eleven_bits, size_t channel,
+               DecodedBlock* out) {
+  const int base = block[0];
+  const int multiplier = block[1] >> 4;
+  const int* modifiers = kEACModifiers[block[1] & 0xf];
+  const uint64_t indices = ReadBigEndian(block + 2, 6);
+  for (size_t y = 0; y < kBlockSize; ++y) {
+    for (size_t x = 0; x < kBlockSize; ++x) {
+      // The indices are stored by column, starting from the top bits.
+      const size_t i = x * kBlockSize + y;
+      const int modifier = modifiers[(indices >> (45 - 3 * i)) & 0x7];
+      uint8_t value;
+      if (eleven_bits) {
+        const int scaled =
+            multiplier == 0 ? modifier : modifier * multiplier * 8;
+        const int value11 = std::min(std::max(base * 8 + 4 + scaled, 0), 2047);
+        value = static_cast<uint8_t>((value11 * 255 + 1023) / 2047);
+      } else {
+        value = Clamp255(base + modifier * multiplier);
+      }
+      (*out)[y * kBlockSize + x][channel] = value;
+    }
+  }
+}
+
+}  // anonymous namespace
+
+size_t CompressedBlockSize(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+    case VK_FORMAT_EAC_R11_UNORM_BLOCK:
+      return 8;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+      return 16;
+    default:
+      return 0;
+  }
+}
+
+size_t CompressedImageSize(VkFormat format, size_t width, size_t height) {
+  return ((width + kBlockSize - 1) / kBlockSize) *
+         ((height + kBlockSize - 1) / kBlockSize) * CompressedBlockSize(format);
+}
+
+VkFormat DecompressedFormat(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+    case VK_FORMAT_EAC_R11_UNORM_BLOCK:
+      return VK_FORMAT_R8_UNORM;
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+      return VK_FORMAT_R8G8B8A8_SRGB;
+    default:
+      return VK_FORMAT_R8G8B8A8_UNORM;
+  }
+}
+
+bool DecompressImage(VkFormat format, size_t width, size_t height,
+                     const uint8_t* blocks, uint8_t* texels) {
+  const size_t block_size = CompressedBlockSize(format);
+  const size_t texel_size =
+      DecompressedFormat(format) == VK_FORMAT_R8_UNORM ? 1 : 4;
+  DecodedBlock decoded;
+  for (size_t block_y = 0; block_y < height; block_y += kBlockSize) {
+    for (size_t block_x = 0; block_x < width; block_x += kBlockSize) {
+      switch (format) {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+          DecodeBC1Color(blocks, false, &decoded);
+          break;
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+          DecodeBC1Color(blocks + 8, true, &decoded);
+          DecodeBC4(blocks, 3, &decoded);
+          break;
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+          DecodeBC4(blocks, 0, &decoded);
+          break;
+        case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+          if (!DecodeETC2Color(blocks, &decoded)) {
+            return false;
+          }
+          break;
+        case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+          if (!DecodeETC2Color(blocks + 8, &decoded)) {
+            return false;
+          }
+          DecodeEAC(blocks, false, 3, &decoded);
+          break;
+        case VK_FORMAT_EAC_R11_UNORM_BLOCK:
+          DecodeEAC(blocks, true, 0, &decoded);
+          break;
+        default:
+          return false;
+      }
+      blocks += block_size;
+
+      // Partial blocks at the right and bottom edges are cut off.
+      const size_t rows = std::min(kBlockSize, height - block_y);
+      const size_t columns = std::min(kBlockSize, width - block_x);
+      for (size_t y = 0; y < rows; ++y) {
+        for (size_t x = 0; x < columns; ++x) {
+          memcpy(texels + ((block_y + y) * width + block_x + x) * texel_size,
+                 decoded[y * kBlockSize + x], texel_size);
+        }
+      }
+    }
+  }
+  return true;
+}
+
+}  // namespace vulkan
@@ -0,0 +1,57 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_TEXTURE_COMPRESSION_H_
+#define VULKAN_HELPERS_TEXTURE_COMPRESSION_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "vulkan_helpers/vulkan_header_wrapper.h"
+
+// CPU decoding of the block compressed formats that convert_img_to_c.py
+// writes with --compress, for devices that cannot sample them:
+//   VK_FORMAT_BC1_RGB_UNORM_BLOCK, VK_FORMAT_BC3_UNORM_BLOCK and
+//   VK_FORMAT_BC4_UNORM_BLOCK on desktop,
+//   VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK, VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK
+//   and VK_FORMAT_EAC_R11_UNORM_BLOCK on mobile,
+// along with the _SRGB variants of the color formats, written with --srgb.
+// All of them use blocks of 4x4 texels.
+namespace vulkan {
+
+// Returns the size in bytes of a block of |format|, or 0 if |format| is not
+// one of the formats above.
+size_t CompressedBlockSize(VkFormat format);
+
+// Returns the size in bytes of a |width| x |height| image of |format|, which
+// must be one of the formats above. Partial blocks at the edges take up a
+// whole block.
+size_t CompressedImageSize(VkFormat format, size_t width, size_t height);
+
+// Returns the format that DecompressImage decodes |format| to, either
+// VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R8G8B8A8_SRGB or VK_FORMAT_R8_UNORM.
+VkFormat DecompressedFormat(VkFormat format);
+
+// Decodes a |width| x |height| image of |format| from |blocks| into
+// |texels|, which must have room for width * height texels of
+// DecompressedFormat(format). ETC2 color blocks may only use the modes it
+// shares with ETC1, which are the only ones that the converter writes.
+// Returns false if a block uses any other mode.
+bool DecompressImage(VkFormat format, size_t width, size_t height,
+                     const uint8_t* blocks, uint8_t* texels);
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_TEXTURE_COMPRESSION_H_
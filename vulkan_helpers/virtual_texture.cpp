@@ -0,0 +1,672 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vulkan_helpers/virtual_texture.h"
+
+#include <algorithm>
+#include <cstring>
+#include <tuple>
+#include <utility>
+
+#include "vulkan_helpers/helper_functions.h"
+
+namespace vulkan {
+namespace {
+// The page table starts with a uvec4 of information about the pages.
+const size_t kPageTableHeaderSize = 4 * sizeof(uint32_t);
+// Mip levels of the tail start at a multiple of this in its staging buffer.
+const size_t kStagingAlignment = 16;
+
+uint32_t FullMipChainLength(uint32_t width, uint32_t height) {
+  uint32_t levels = 1;
+  for (uint32_t size = std::max(width, height); size > 1; size /= 2) {
+    ++levels;
+  }
+  return levels;
+}
+}  // anonymous namespace
+
+const uint32_t VirtualTexture::kNone;
+
+VirtualTexture::VirtualTexture(VulkanApplication* application,
+                               VkFormat format, uint32_t width,
+                               uint32_t height, uint32_t page_budget,
+                               uint32_t frames_in_flight,
+                               PageFunction fill_page,
+                               uint32_t max_uploads_per_frame)
+    : application_(application),
+      allocator_(application->GetAllocator()),
+      log_(application->GetLogger()),
+      format_(format),
+      width_(width),
+      height_(height),
+      mip_levels_(FullMipChainLength(width, height)),
+      page_budget_(page_budget),
+      frames_in_flight_(frames_in_flight),
+      max_uploads_per_frame_(max_uploads_per_frame),
+      fill_page_(std::move(fill_page)),
+      texel_size_(0),
+      level_first_page_(allocator_),
+      level_pages_x_(allocator_),
+      num_pages_(0),
+      page_state_(allocator_),
+      page_slot_(allocator_),
+      page_bound_slot_(allocator_),
+      slot_page_(allocator_),
+      lru_previous_(allocator_),
+      lru_next_(allocator_),
+      slot_last_used_(allocator_),
+      lru_first_(kNone),
+      lru_last_(kNone),
+      free_slots_(allocator_),
+      retired_(allocator_),
+      retired_slots_(0),
+      resident_pages_(0),
+      free_staging_(allocator_),
+      filled_(allocator_),
+      frames_(allocator_),
+      frame_(0),
+      min_level_(allocator_),
+      page_table_version_(0),
+      page_table_dirty_(false),
+      jobs_(allocator_),
+      done_(allocator_),
+      exiting_(false) {
+  LOG_ASSERT(==, log_, 0u, width_ & (width_ - 1));
+  LOG_ASSERT(==, log_, 0u, height_ & (height_ - 1));
+  LOG_ASSERT(>, log_, page_budget_, 0u);
+  uint32_t block_width;
+  uint32_t block_height;
+  std::tie(texel_size_, block_width, block_height) =
+      GetElementAndTexelBlockSize(format_);
+  LOG_ASSERT(==, log_, 1u, block_width * block_height);
+
+  VkDevice& device = application_->device();
+  const VkImageUsageFlags usage =
+      VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  uint32_t num_format_properties = 0;
+  application_->instance()->vkGetPhysicalDeviceSparseImageFormatProperties(
+      device.physical_device(), format_, VK_IMAGE_TYPE_2D,
+      VK_SAMPLE_COUNT_1_BIT, usage, VK_IMAGE_TILING_OPTIMAL,
+      &num_format_properties, nullptr);
+  if (num_format_properties == 0) {
+    log_->LogError("The format of the virtual texture cannot be sparse");
+  }
+  LOG_ASSERT(>, log_, num_format_properties, 0u);
+
+  VkImageCreateInfo image_create_info = {
+      VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,  // sType
+      nullptr,                              // pNext
+      VK_IMAGE_CREATE_SPARSE_BINDING_BIT |
+          VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT,  // flags
+      VK_IMAGE_TYPE_2D,                          // imageType
+      format_,                                   // format
+      {width_, height_, 1},                      // extent
+      mip_levels_,                               // mipLevels
+      1,                                         // arrayLayers
+      VK_SAMPLE_COUNT_1_BIT,                     // samples
+      VK_IMAGE_TILING_OPTIMAL,                   // tiling
+      usage,                                     // usage
+      VK_SHARING_MODE_EXCLUSIVE,                 // sharingMode
+      0,                                         // queueFamilyIndexCount
+      nullptr,                                   // pQueueFamilyIndices
+      VK_IMAGE_LAYOUT_UNDEFINED,                 // initialLayout
+  };
+  image_ = application_->CreateSparseResidentImage(&image_create_info);
+
+  // Every page takes one sparse block of memory, which is as large as the
+  // alignment of the image.
+  VkMemoryRequirements requirements;
+  device->vkGetImageMemoryRequirements(device, *image_, &requirements);
+  uint32_t num_sparse_requirements = 0;
+  device->vkGetImageSparseMemoryRequirements(
+      device, *image_, &num_sparse_requirements, nullptr);
+  containers::vector<VkSparseImageMemoryRequirements> sparse_requirements(
+      allocator_);
+  sparse_requirements.resize(num_sparse_requirements);
+  device->vkGetImageSparseMemoryRequirements(
+      device, *image_, &num_sparse_requirements, sparse_requirements.data());
+  const VkSparseImageMemoryRequirements* color_requirements = nullptr;
+  for (const auto& sparse_requirement : sparse_requirements) {
+    if ((sparse_requirement.formatProperties.aspectMask &
+         VK_IMAGE_ASPECT_COLOR_BIT) != 0) {
+      color_requirements = &sparse_requirement;
+    }
+  }
+  LOG_ASSERT(==, log_, color_requirements != nullptr, true);
+  page_extent_ = color_requirements->formatProperties.imageGranularity;
+  page_extent_.depth = 1;
+  page_memory_size_ = requirements.alignment;
+  LOG_ASSERT(<=, log_,
+             ::VkDeviceSize(page_extent_.width) * page_extent_.height *
+                 texel_size_,
+             page_memory_size_);
+  tail_first_level_ =
+      std::min(color_requirements->imageMipTailFirstLod, mip_levels_);
+  // A full mip chain always ends in levels that are smaller than a page.
+  LOG_ASSERT(<, log_, tail_first_level_, mip_levels_);
+
+  page_memory_ = containers::make_unique<VkDeviceMemory>(
+      allocator_,
+      AllocateDeviceMemory(
+          &device,
+          GetMemoryIndex(&device, log_, requirements.memoryTypeBits,
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+          page_memory_size_ * page_budget_));
+
+  VkImageViewCreateInfo view_create_info = {
+      VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,  // sType
+      nullptr,                                   // pNext
+      0,                                         // flags
+      *image_,                                   // image
+      VK_IMAGE_VIEW_TYPE_2D,                     // viewType
+      format_,                                   // format
+      {VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B,
+       VK_COMPONENT_SWIZZLE_A},
+      {VK_IMAGE_ASPECT_COLOR_BIT, 0, mip_levels_, 0, 1}};
+  ::VkImageView raw_view;
+  LOG_ASSERT(==, log_, VK_SUCCESS,
+             device->vkCreateImageView(device, &view_create_info, nullptr,
+                                       &raw_view));
+  image_view_ = containers::make_unique<VkImageView>(
+      allocator_, VkImageView(raw_view, nullptr, &device));
+
+  // The levels before the mip tail are whole numbers of pages.
+  for (uint32_t level = 0; level < tail_first_level_; ++level) {
+    const uint32_t pages_x = (width_ >> level) / page_extent_.width;
+    const uint32_t pages_y = (height_ >> level) / page_extent_.height;
+    level_first_page_.push_back(num_pages_);
+    level_pages_x_.push_back(pages_x);
+    num_pages_ += pages_x * pages_y;
+  }
+  level_first_page_.push_back(num_pages_);
+  page_state_.resize(num_pages_, PageState::kNonResident);
+  page_slot_.resize(num_pages_, kNone);
+  page_bound_slot_.resize(num_pages_, kNone);
+
+  slot_page_.resize(page_budget_, kNone);
+  lru_previous_.resize(page_budget_, kNone);
+  lru_next_.resize(page_budget_, kNone);
+  slot_last_used_.resize(page_budget_, 0);
+  for (uint32_t slot = page_budget_; slot > 0; --slot) {
+    free_slots_.push_back(slot - 1);
+  }
+
+  // Enough staging for a frame's uploads while the previous frames' are
+  // still in flight.
+  staging_page_size_ =
+      size_t(page_extent_.width) * page_extent_.height * texel_size_;
+  const uint32_t num_staging =
+      max_uploads_per_frame_ * (frames_in_flight_ + 1);
+  staging_buffer_ = application_->CreateAndBindDefaultExclusiveHostBuffer(
+      staging_page_size_ * num_staging, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+  for (uint32_t staging = num_staging; staging > 0; --staging) {
+    free_staging_.push_back(staging - 1);
+  }
+
+  // Until any page is resident, every page samples the mip tail.
+  const uint32_t level_0_pages =
+      tail_first_level_ > 0 ? level_first_page_[1] : 1;
+  min_level_.resize(level_0_pages, tail_first_level_);
+  const uint32_t page_table_info[4] = {
+      page_extent_.width, page_extent_.height,
+      tail_first_level_ > 0 ? level_pages_x_[0] : 1, tail_first_level_};
+  for (uint32_t i = 0; i < frames_in_flight_; ++i) {
+    frames_.push_back(containers::make_unique<Frame>(
+        allocator_,
+        application_->GetCommandBuffer(application_->render_queue().index()),
+        CreateSemaphore(&device)));
+    Frame* frame = frames_.back().get();
+    frame->feedback =
+        application_->CreateAndBindDefaultExclusiveCoherentBuffer(
+            std::max(num_pages_, 1u) * sizeof(uint32_t),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    memset(frame->feedback->base_address(), 0, frame->feedback->size());
+    frame->page_table =
+        application_->CreateAndBindDefaultExclusiveCoherentBuffer(
+            kPageTableHeaderSize + level_0_pages * sizeof(uint32_t),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    memcpy(frame->page_table->base_address(), page_table_info,
+           kPageTableHeaderSize);
+    memcpy(frame->page_table->base_address() + kPageTableHeaderSize,
+           min_level_.data(), min_level_.size() * sizeof(uint32_t));
+  }
+
+  thread_ = std::thread([this]() { PageLoop(); });
+}
+
+VirtualTexture::~VirtualTexture() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    exiting_ = true;
+  }
+  job_queued_.notify_all();
+  thread_.join();
+  application_->sparse_binding_queue()->vkQueueWaitIdle(
+      application_->sparse_binding_queue());
+}
+
+void VirtualTexture::InitializeData(VkCommandBuffer* initialization_buffer) {
+  containers::vector<VkBufferImageCopy> copies(allocator_);
+  size_t staging_size = 0;
+  for (uint32_t level = tail_first_level_; level < mip_levels_; ++level) {
+    const uint32_t level_width = std::max(width_ >> level, 1u);
+    const uint32_t level_height = std::max(height_ >> level, 1u);
+    copies.push_back({
+        staging_size,                              // bufferOffset
+        0,                                         // bufferRowLength
+        0,                                         // bufferImageHeight
+        {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1},  // imageSubresource
+        {0, 0, 0},                                 // imageOffset
+        {level_width, level_height, 1},            // imageExtent
+    });
+    staging_size += (size_t(level_width) * level_height * texel_size_ +
+                     kStagingAlignment - 1) /
+                    kStagingAlignment * kStagingAlignment;
+  }
+  tail_staging_buffer_ =
+      application_->CreateAndBindDefaultExclusiveHostBuffer(
+          staging_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+  for (const auto& copy : copies) {
+    fill_page_(copy.imageSubresource.mipLevel, 0, 0, copy.imageExtent.width,
+               copy.imageExtent.height,
+               reinterpret_cast<uint8_t*>(
+                   tail_staging_buffer_->base_address() + copy.bufferOffset));
+  }
+  tail_staging_buffer_->flush();
+
+  // The image stays in VK_IMAGE_LAYOUT_GENERAL, as pages are copied into it
+  // while other pages are sampled.
+  const VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0,
+                                         mip_levels_, 0, 1};
+  RecordImageLayoutTransition(*image_, range, VK_IMAGE_LAYOUT_UNDEFINED, 0,
+                              VK_IMAGE_LAYOUT_GENERAL,
+                              VK_ACCESS_TRANSFER_WRITE_BIT,
+                              initialization_buffer);
+  (*initialization_buffer)
+      ->vkCmdCopyBufferToImage(*initialization_buffer, *tail_staging_buffer_,
+                               *image_, VK_IMAGE_LAYOUT_GENERAL,
+                               uint32_t(copies.size()), copies.data());
+  RecordImageLayoutTransition(*image_, range, VK_IMAGE_LAYOUT_GENERAL,
+                              VK_ACCESS_TRANSFER_WRITE_BIT,
+                              VK_IMAGE_LAYOUT_GENERAL,
+                              VK_ACCESS_SHADER_READ_BIT,
+                              initialization_buffer);
+}
+
+void VirtualTexture::InitializationComplete() { tail_staging_buffer_.reset(); }
+
+void VirtualTexture::BeginFrame(VkQueue* queue, size_t frame_index) {
+  Frame& frame = *frames_[frame_index];
+  // The frame that last used this index has finished. Frame indices may be
+  // reused in any order, so whatever was retired is only free once every
+  // frame up to it has finished, not after a fixed number of frames.
+  frame.in_flight = 0;
+  uint64_t oldest_in_flight = ~uint64_t(0);
+  for (const auto& other : frames_) {
+    if (other->in_flight != 0) {
+      oldest_in_flight = std::min(oldest_in_flight, other->in_flight);
+    }
+  }
+  frame.in_flight = ++frame_;
+
+  // Memory slots are unbound from their page first, unless the page has
+  // been bound to another slot since.
+  containers::vector<VkSparseImageMemoryBind> binds(allocator_);
+  while (!retired_.empty() && retired_.front().frame < oldest_in_flight) {
+    const Retired& retired = retired_.front();
+    if (retired.slot == kNone) {
+      free_staging_.push_back(retired.staging);
+    } else {
+      if (page_bound_slot_[retired.page] == retired.slot) {
+        binds.push_back(PageBind(retired.page, kNone));
+        page_bound_slot_[retired.page] = kNone;
+      }
+      free_slots_.push_back(retired.slot);
+      --retired_slots_;
+    }
+    retired_.pop_front();
+  }
+
+  // Every coarser page under a requested page is requested as well, so
+  // that there is a chain of resident levels to clamp to, and so that
+  // coarse pages are evicted after the finer pages that cover them.
+  uint32_t* requested =
+      reinterpret_cast<uint32_t*>(frame.feedback->base_address());
+  for (uint32_t level = 0; level + 1 < tail_first_level_; ++level) {
+    const uint32_t pages_x = level_pages_x_[level];
+    for (uint32_t page = level_first_page_[level];
+         page < level_first_page_[level + 1]; ++page) {
+      if (requested[page] != 0) {
+        const uint32_t index = page - level_first_page_[level];
+        requested[level_first_page_[level + 1] +
+                  index / pages_x / 2 * level_pages_x_[level + 1] +
+                  index % pages_x / 2] = 1;
+      }
+    }
+  }
+
+  // The coarsest missing pages are loaded first, so that more of the
+  // texture sharpens at once.
+  containers::vector<uint32_t> missing(allocator_);
+  for (uint32_t level = tail_first_level_; level-- > 0;) {
+    for (uint32_t page = level_first_page_[level];
+         page < level_first_page_[level + 1]; ++page) {
+      if (requested[page] == 0) {
+        continue;
+      }
+      if (page_state_[page] == PageState::kResident) {
+        Unlink(page_slot_[page]);
+        LinkFirst(page_slot_[page]);
+      } else if (page_state_[page] == PageState::kNonResident &&
+                 page_bound_slot_[page] == kNone) {
+        // Pages that are still bound to an evicted slot are loaded again
+        // once they are unbound, so that the frames in flight never see
+        // them change.
+        missing.push_back(page);
+      }
+    }
+  }
+  memset(requested, 0, num_pages_ * sizeof(uint32_t));
+
+  if (!missing.empty() && !free_staging_.empty()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (uint32_t page : missing) {
+        if (free_staging_.empty()) {
+          break;
+        }
+        page_state_[page] = PageState::kLoading;
+        jobs_.push_back({page, free_staging_.back()});
+        free_staging_.pop_back();
+      }
+    }
+    job_queued_.notify_one();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (!done_.empty()) {
+      filled_.push_back(done_.front());
+      done_.pop_front();
+    }
+  }
+
+  // Make room for the filled pages by evicting the least recently used
+  // pages, unless they were requested by this frame's feedback, in which
+  // case the budget is too small for what is on screen.
+  const size_t wanted_slots =
+      std::min(filled_.size(), size_t(max_uploads_per_frame_));
+  while (free_slots_.size() + retired_slots_ < wanted_slots &&
+         lru_last_ != kNone && slot_last_used_[lru_last_] < frame_) {
+    Evict(lru_last_);
+  }
+
+  containers::vector<VkBufferImageCopy> copies(allocator_);
+  while (!filled_.empty() && !free_slots_.empty() &&
+         copies.size() < max_uploads_per_frame_) {
+    const PageJob job = filled_.front();
+    filled_.pop_front();
+    const uint32_t slot = free_slots_.back();
+    free_slots_.pop_back();
+
+    const VkSparseImageMemoryBind bind = PageBind(job.page, slot);
+    binds.push_back(bind);
+    page_bound_slot_[job.page] = slot;
+    slot_page_[slot] = job.page;
+    page_slot_[job.page] = slot;
+    page_state_[job.page] = PageState::kResident;
+    LinkFirst(slot);
+    ++resident_pages_;
+    page_table_dirty_ = true;
+
+    const size_t offset = job.staging * staging_page_size_;
+    staging_buffer_->flush(offset, staging_page_size_);
+    copies.push_back({
+        offset,  // bufferOffset
+        0,       // bufferRowLength
+        0,       // bufferImageHeight
+        {VK_IMAGE_ASPECT_COLOR_BIT, bind.subresource.mipLevel, 0,
+         1},          // imageSubresource
+        bind.offset,  // imageOffset
+        bind.extent,  // imageExtent
+    });
+    retired_.push_back({kNone, job.staging, job.page, frame_});
+  }
+
+  // The sparse binding queue may be the same as |queue|, so the binds are
+  // made here rather than on the paging thread, which would have to
+  // synchronize with every submit.
+  if (!binds.empty()) {
+    ::VkSemaphore bound = frame.bound;
+    VkSparseImageMemoryBindInfo image_bind_info{*image_, uint32_t(binds.size()),
+                                                binds.data()};
+    VkBindSparseInfo bind_info{
+        VK_STRUCTURE_TYPE_BIND_SPARSE_INFO,  // sType
+        nullptr,                             // pNext
+        0u,                                  // waitSemaphoreCount
+        nullptr,                             // pWaitSemaphores
+        0u,                                  // bufferBindCount
+        nullptr,                             // pBufferBinds
+        0u,                                  // imageOpaqueBindCount
+        nullptr,                             // pImageOpaqueBinds
+        1u,                                  // imageBindCount
+        &image_bind_info,                    // pImageBinds
+        copies.empty() ? 0u : 1u,            // signalSemaphoreCount
+        &bound                               // pSignalSemaphores
+    };
+    VkQueue& sparse_binding_queue = application_->sparse_binding_queue();
+    LOG_ASSERT(==, log_, VK_SUCCESS,
+               sparse_binding_queue->vkQueueBindSparse(
+                   sparse_binding_queue, 1u, &bind_info,
+                   ::VkFence(VK_NULL_HANDLE)));
+  }
+
+  if (!copies.empty()) {
+    VkCommandBuffer& command_buffer = frame.command_buffer;
+    application_->BeginCommandBuffer(&command_buffer);
+    command_buffer->vkCmdCopyBufferToImage(
+        command_buffer, *staging_buffer_, *image_, VK_IMAGE_LAYOUT_GENERAL,
+        uint32_t(copies.size()), copies.data());
+    const VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0,
+                                           mip_levels_, 0, 1};
+    VkImageMemoryBarrier barrier = {
+        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
+        nullptr,                                 // pNext
+        VK_ACCESS_TRANSFER_WRITE_BIT,            // srcAccessMask
+        VK_ACCESS_SHADER_READ_BIT,               // dstAccessMask
+        VK_IMAGE_LAYOUT_GENERAL,                 // oldLayout
+        VK_IMAGE_LAYOUT_GENERAL,                 // newLayout
+        VK_QUEUE_FAMILY_IGNORED,                 // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,                 // dstQueueFamilyIndex
+        *image_,                                 // image
+        range                                    // subresourceRange
+    };
+    command_buffer->vkCmdPipelineBarrier(
+        command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1,
+        &barrier);
+    LOG_ASSERT(==, log_, VK_SUCCESS,
+               application_->EndAndSubmitCommandBuffer(
+                   &command_buffer, queue, {frame.bound},
+                   {VK_PIPELINE_STAGE_TRANSFER_BIT}, {},
+                   ::VkFence(VK_NULL_HANDLE)));
+  }
+
+  if (page_table_dirty_) {
+    UpdatePageTable();
+    page_table_dirty_ = false;
+    ++page_table_version_;
+  }
+  if (frame.page_table_version != page_table_version_) {
+    memcpy(frame.page_table->base_address() + kPageTableHeaderSize,
+           min_level_.data(), min_level_.size() * sizeof(uint32_t));
+    frame.page_table_version = page_table_version_;
+  }
+}
+
+void VirtualTexture::RecordFeedbackBarrier(
+    VkCommandBuffer* command_buffer) const {
+  VkMemoryBarrier barrier = {
+      VK_STRUCTURE_TYPE_MEMORY_BARRIER,  // sType
+      nullptr,                           // pNext
+      VK_ACCESS_SHADER_WRITE_BIT,        // srcAccessMask
+      VK_ACCESS_HOST_READ_BIT            // dstAccessMask
+  };
+  (*command_buffer)
+      ->vkCmdPipelineBarrier(*command_buffer,
+                             VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                             VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0,
+                             nullptr, 0, nullptr);
+}
+
+VkDescriptorBufferInfo VirtualTexture::page_table_info(
+    size_t frame_index) const {
+  return {*frames_[frame_index]->page_table, 0, VK_WHOLE_SIZE};
+}
+
+VkDescriptorBufferInfo VirtualTexture::feedback_info(
+    size_t frame_index) const {
+  return {*frames_[frame_index]->feedback, 0, VK_WHOLE_SIZE};
+}
+
+void VirtualTexture::PageLoop() {
+  uint8_t* staging =
+      reinterpret_cast<uint8_t*>(staging_buffer_->base_address());
+  for (;;) {
+    PageJob job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      job_queued_.wait(lock, [this]() { return exiting_ || !jobs_.empty(); });
+      if (exiting_) {
+        return;
+      }
+      job = jobs_.front();
+      jobs_.pop_front();
+    }
+    uint32_t level;
+    uint32_t x;
+    uint32_t y;
+    GetPage(job.page, &level, &x, &y);
+    fill_page_(level, x * page_extent_.width, y * page_extent_.height,
+               page_extent_.width, page_extent_.height,
+               staging + job.staging * staging_page_size_);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      done_.push_back(job);
+    }
+  }
+}
+
+void VirtualTexture::GetPage(uint32_t page, uint32_t* level, uint32_t* x,
+                             uint32_t* y) const {
+  uint32_t page_level = 0;
+  while (page >= level_first_page_[page_level + 1]) {
+    ++page_level;
+  }
+  const uint32_t index = page - level_first_page_[page_level];
+  *level = page_level;
+  *x = index % level_pages_x_[page_level];
+  *y = index / level_pages_x_[page_level];
+}
+
+VkSparseImageMemoryBind VirtualTexture::PageBind(uint32_t page,
+                                                 uint32_t slot) const {
+  uint32_t level;
+  uint32_t x;
+  uint32_t y;
+  GetPage(page, &level, &x, &y);
+  // Binding no memory unbinds the page.
+  const ::VkDeviceMemory memory = slot == kNone
+                                      ? ::VkDeviceMemory(VK_NULL_HANDLE)
+                                      : ::VkDeviceMemory(*page_memory_);
+  return {
+      {VK_IMAGE_ASPECT_COLOR_BIT, level, 0},  // subresource
+      {int32_t(x * page_extent_.width), int32_t(y * page_extent_.height),
+       0},                                            // offset
+      page_extent_,                                   // extent
+      memory,                                         // memory
+      slot == kNone ? 0 : slot * page_memory_size_,  // memoryOffset
+      0,                                              // flags
+  };
+}
+
+void VirtualTexture::LinkFirst(uint32_t slot) {
+  lru_previous_[slot] = kNone;
+  lru_next_[slot] = lru_first_;
+  if (lru_first_ == kNone) {
+    lru_last_ = slot;
+  } else {
+    lru_previous_[lru_first_] = slot;
+  }
+  lru_first_ = slot;
+  slot_last_used_[slot] = frame_;
+}
+
+void VirtualTexture::Unlink(uint32_t slot) {
+  const uint32_t previous = lru_previous_[slot];
+  const uint32_t next = lru_next_[slot];
+  if (previous == kNone) {
+    lru_first_ = next;
+  } else {
+    lru_next_[previous] = next;
+  }
+  if (next == kNone) {
+    lru_last_ = previous;
+  } else {
+    lru_previous_[next] = previous;
+  }
+  lru_previous_[slot] = kNone;
+  lru_next_[slot] = kNone;
+}
+
+void VirtualTexture::Evict(uint32_t slot) {
+  // The page stays bound until the frames in flight are done with it, but
+  // the next page table already falls back to the coarser levels.
+  const uint32_t page = slot_page_[slot];
+  Unlink(slot);
+  page_state_[page] = PageState::kNonResident;
+  page_slot_[page] = kNone;
+  retired_.push_back({slot, kNone, page, frame_});
+  ++retired_slots_;
+  --resident_pages_;
+  page_table_dirty_ = true;
+}
+
+void VirtualTexture::UpdatePageTable() {
+  if (tail_first_level_ == 0) {
+    return;
+  }
+  // A level can only be sampled where it and every coarser level are
+  // resident, as linear filtering between levels reads both.
+  const uint32_t pages_x = level_pages_x_[0];
+  for (uint32_t i = 0; i < level_first_page_[1]; ++i) {
+    const uint32_t x = i % pages_x;
+    const uint32_t y = i / pages_x;
+    uint32_t min_level = tail_first_level_;
+    while (min_level > 0) {
+      const uint32_t level = min_level - 1;
+      const uint32_t page = level_first_page_[level] +
+                            (y >> level) * level_pages_x_[level] + (x >> level);
+      if (page_state_[page] != PageState::kResident) {
+        break;
+      }
+      min_level = level;
+    }
+    min_level_[i] = min_level;
+  }
+}
+
+}  // namespace vulkan
@@ -0,0 +1,249 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_HELPERS_VIRTUAL_TEXTURE_H_
+#define VULKAN_HELPERS_VIRTUAL_TEXTURE_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "support/containers/allocator.h"
+#include "support/containers/deque.h"
+#include "support/containers/unique_ptr.h"
+#include "support/containers/vector.h"
+#include "support/log/log.h"
+#include "vulkan_helpers/vulkan_application.h"
+
+namespace vulkan {
+
+// VirtualTexture is a sparse resident 2D image with a full mip chain, of
+// which only a fixed budget of pages is backed by memory at any time, so
+// textures much larger than the device memory can be sampled.
+//
+// Fragment shaders that sample the texture write the pages they would like
+// to read to a feedback buffer, and clamp the level of detail to the pages
+// that are resident with a page table. Both are storage buffers, one per
+// frame in flight:
+//
+//   layout(std430) readonly buffer page_table {
+//     // The width and height of a page in texels, the number of pages in a
+//     // row of level 0, and the first level of the mip tail.
+//     uvec4 info;
+//     // For every page of level 0, the finest level that is resident there,
+//     // along with every coarser level.
+//     uint min_level[];
+//   };
+//   layout(std430) buffer feedback {
+//     // Non-zero for every requested page of the levels before the mip tail,
+//     // level by level, and row by row in each level.
+//     uint requested[];
+//   };
+//
+// BeginFrame() reads back the feedback of the frame that last used the same
+// frame index, and hands the missing pages to a paging thread that fills
+// them with a PageFunction. The pages it has filled are then bound with
+// vkQueueBindSparse, and copied into the image. When the budget is used up,
+// the least recently requested pages are evicted, and their memory is
+// unbound and reused once no frame in flight can sample them anymore. The
+// mip tail is always resident, so there is always something to sample.
+//
+// The application has to be created with sparse binding, and the device
+// has to support sparseResidencyImage2D for the format.
+class VirtualTexture {
+ public:
+  // Fills the |width| x |height| texels of |level| that start at |x|, |y|,
+  // tightly packed into |texels|. Called on the paging thread, and while
+  // initializing the mip tail.
+  using PageFunction =
+      std::function<void(uint32_t level, uint32_t x, uint32_t y,
+                         uint32_t width, uint32_t height, uint8_t* texels)>;
+
+  static const uint32_t kDefaultMaxUploadsPerFrame = 16;
+
+  // Creates the image and the page pool, which holds |page_budget| pages.
+  // |frames_in_flight| is the number of frame indices BeginFrame() is called
+  // with. The image is |width| x |height| texels of |format|, which must not
+  // be block compressed, and both have to be powers of two.
+  VirtualTexture(VulkanApplication* application, VkFormat format,
+                 uint32_t width, uint32_t height, uint32_t page_budget,
+                 uint32_t frames_in_flight, PageFunction fill_page,
+                 uint32_t max_uploads_per_frame = kDefaultMaxUploadsPerFrame);
+  // Waits for the paging thread and for every bind.
+  ~VirtualTexture();
+
+  // Fills the mip tail, and records its upload and the transition of the
+  // image to VK_IMAGE_LAYOUT_GENERAL into |initialization_buffer|.
+  void InitializeData(VkCommandBuffer* initialization_buffer);
+  // Frees the staging memory of the mip tail, once |initialization_buffer|
+  // has finished.
+  void InitializationComplete();
+
+  // Reads the feedback for |frame_index|, pages in the requested pages that
+  // the paging thread has filled, and updates the page table for
+  // |frame_index|. The copies are submitted to |queue|, so they are done
+  // before anything that is submitted to |queue| afterwards. This is meant
+  // to be called once per frame, once the previous frame with the same
+  // index has finished and before the frame is submitted. Frame indices may
+  // come in any order, such as that of the acquired swapchain images.
+  void BeginFrame(VkQueue* queue, size_t frame_index);
+
+  // Records a barrier that makes the feedback written by fragment shaders
+  // visible to BeginFrame(). Record this after the last draw that samples
+  // the texture.
+  void RecordFeedbackBarrier(VkCommandBuffer* command_buffer) const;
+
+  ::VkImage image() const { return *image_; }
+  // Returns a view of every level, in VK_IMAGE_LAYOUT_GENERAL.
+  ::VkImageView view() const { return *image_view_; }
+  VkDescriptorBufferInfo page_table_info(size_t frame_index) const;
+  VkDescriptorBufferInfo feedback_info(size_t frame_index) const;
+
+  uint32_t width() const { return width_; }
+  uint32_t height() const { return height_; }
+  uint32_t mip_levels() const { return mip_levels_; }
+  // Returns the number of pages that are bound, out of the budget.
+  uint32_t resident_pages() const { return resident_pages_; }
+  uint32_t page_budget() const { return page_budget_; }
+
+ private:
+  static const uint32_t kNone = ~0u;
+
+  enum class PageState : uint8_t {
+    kNonResident,
+    // Queued for, or being filled by, the paging thread.
+    kLoading,
+    kResident,
+  };
+
+  // A page that is filled into a page-sized slot of the staging buffer.
+  struct PageJob {
+    uint32_t page;
+    uint32_t staging;
+  };
+
+  // A memory slot, or a staging slot if |slot| is kNone, that may still be
+  // used by |frame| and the frames before it. |page| is the page that the
+  // memory slot was bound to.
+  struct Retired {
+    uint32_t slot;
+    uint32_t staging;
+    uint32_t page;
+    uint64_t frame;
+  };
+
+  // The resources for one frame index.
+  struct Frame {
+    Frame(VkCommandBuffer&& command_buffer, VkSemaphore&& bound)
+        : command_buffer(std::move(command_buffer)), bound(std::move(bound)) {}
+    VkCommandBuffer command_buffer;
+    // Signaled by the binds, and waited on by the copies.
+    VkSemaphore bound;
+    containers::unique_ptr<VulkanApplication::Buffer> feedback;
+    containers::unique_ptr<VulkanApplication::Buffer> page_table;
+    uint64_t page_table_version = 0;
+    // The frame that uses this index, or 0 if it has finished.
+    uint64_t in_flight = 0;
+  };
+
+  // Runs on the paging thread.
+  void PageLoop();
+
+  void GetPage(uint32_t page, uint32_t* level, uint32_t* x,
+               uint32_t* y) const;
+  VkSparseImageMemoryBind PageBind(uint32_t page, uint32_t slot) const;
+  // Adds the memory slot to the front of the LRU list, or removes it.
+  void LinkFirst(uint32_t slot);
+  void Unlink(uint32_t slot);
+  void Evict(uint32_t slot);
+  void UpdatePageTable();
+
+  VulkanApplication* application_;
+  containers::Allocator* allocator_;
+  logging::Logger* log_;
+  const VkFormat format_;
+  const uint32_t width_;
+  const uint32_t height_;
+  const uint32_t mip_levels_;
+  const uint32_t page_budget_;
+  const uint32_t frames_in_flight_;
+  const uint32_t max_uploads_per_frame_;
+  const PageFunction fill_page_;
+  uint32_t texel_size_;
+
+  // The image and the memory its pages are bound from. The memory is
+  // declared first, so the image is destroyed before it.
+  containers::unique_ptr<VkDeviceMemory> page_memory_;
+  containers::unique_ptr<VulkanApplication::SparseImage> image_;
+  containers::unique_ptr<VkImageView> image_view_;
+  VkExtent3D page_extent_;
+  ::VkDeviceSize page_memory_size_;
+  uint32_t tail_first_level_;
+
+  // The pages of the levels before the mip tail, numbered like the feedback
+  // buffer.
+  containers::vector<uint32_t> level_first_page_;
+  containers::vector<uint32_t> level_pages_x_;
+  uint32_t num_pages_;
+  containers::vector<PageState> page_state_;
+  // The memory slot of every resident page, and the memory slot every page
+  // is actually bound to, which it stays bound to after being evicted until
+  // the frames in flight are done with it.
+  containers::vector<uint32_t> page_slot_;
+  containers::vector<uint32_t> page_bound_slot_;
+  // The page that every memory slot is bound to.
+  containers::vector<uint32_t> slot_page_;
+
+  // The memory slots in least recently used order, as a doubly linked list
+  // of the resident pages' slots, and the frame each was last requested in.
+  containers::vector<uint32_t> lru_previous_;
+  containers::vector<uint32_t> lru_next_;
+  containers::vector<uint64_t> slot_last_used_;
+  uint32_t lru_first_;
+  uint32_t lru_last_;
+  containers::vector<uint32_t> free_slots_;
+  containers::deque<Retired> retired_;
+  uint32_t retired_slots_;
+  uint32_t resident_pages_;
+
+  containers::unique_ptr<VulkanApplication::Buffer> staging_buffer_;
+  containers::unique_ptr<VulkanApplication::Buffer> tail_staging_buffer_;
+  size_t staging_page_size_;
+  containers::vector<uint32_t> free_staging_;
+  // Pages that the paging thread has filled, which are waiting for a free
+  // memory slot.
+  containers::deque<PageJob> filled_;
+
+  containers::vector<containers::unique_ptr<Frame>> frames_;
+  uint64_t frame_;
+  containers::vector<uint32_t> min_level_;
+  uint64_t page_table_version_;
+  bool page_table_dirty_;
+
+  // Guards everything below.
+  std::mutex mutex_;
+  std::condition_variable job_queued_;
+  containers::deque<PageJob> jobs_;
+  containers::deque<PageJob> done_;
+  bool exiting_;
+  std::thread thread_;
+};
+
+}  // namespace vulkan
+
+#endif  // VULKAN_HELPERS_VIRTUAL_TEXTURE_H_
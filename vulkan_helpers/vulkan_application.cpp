@@ -16,6 +16,7 @@
 #include "vulkan_helpers/vulkan_application.h"
 
 #include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <tuple>
 
@@ -47,13 +48,38 @@ VkDescriptorPool DescriptorSet::CreateDescriptorPool(
                                       pool_sizes.data(), 1, pNext);
 }
 
+VkDescriptorSet DescriptorSet::AllocateFromShared(
+    DescriptorAllocator* descriptor_allocator, VkDevice* device,
+    ::VkDescriptorSetLayout layout, ::VkDescriptorPool* pool) {
+  ::VkDescriptorSet set = descriptor_allocator->Allocate(layout, pool);
+  return VkDescriptorSet(set, *pool, device);
+}
+
 DescriptorSet::DescriptorSet(
     containers::Allocator* allocator, VkDevice* device,
     std::initializer_list<VkDescriptorSetLayoutBinding> bindings, void* pNext)
-    : pool_(CreateDescriptorPool(allocator, device, bindings, pNext)),
-      layout_(CreateDescriptorSetLayout(allocator, device, bindings)),
-      set_(AllocateDescriptorSet(device, pool_.get_raw_object(),
-                                 layout_.get_raw_object())) {}
+    : dedicated_pool_(CreateDescriptorPool(allocator, device, bindings, pNext)),
+      dedicated_layout_(CreateDescriptorSetLayout(allocator, device, bindings)),
+      descriptor_allocator_(nullptr),
+      pool_(dedicated_pool_),
+      layout_(dedicated_layout_),
+      set_(AllocateDescriptorSet(device, pool_, layout_)) {}
+
+DescriptorSet::DescriptorSet(
+    DescriptorAllocator* descriptor_allocator, VkDevice* device,
+    std::initializer_list<VkDescriptorSetLayoutBinding> bindings)
+    : dedicated_pool_(VK_NULL_HANDLE, nullptr, device),
+      dedicated_layout_(VK_NULL_HANDLE, nullptr, device),
+      descriptor_allocator_(descriptor_allocator),
+      pool_(VK_NULL_HANDLE),
+      layout_(descriptor_allocator->GetLayout(bindings)),
+      set_(AllocateFromShared(descriptor_allocator, device, layout_, &pool_)) {}
+
+DescriptorSet::~DescriptorSet() {
+  if (descriptor_allocator_ && set_ != VK_NULL_HANDLE) {
+    descriptor_allocator_->Free(set_.release(), layout_, pool_);
+  }
+}
 
 VulkanApplication::VulkanApplication(
     containers::Allocator* allocator, logging::Logger* log,
@@ -70,7 +96,7 @@ VulkanApplication::VulkanApplication(
       render_queue_index_(0u),
       present_queue_index_(0u),
       use_protected_memory_(options.use_protected_memory),
-      library_wrapper_(allocator_, log_),
+      library_wrapper_(allocator_, log_, entry_data_->null_driver()),
       instance_(CreateVerisonedInstanceForApplicaiton(
           allocator_, &library_wrapper_, entry_data_,
           options.vulkan_api_version, instance_extensions)),
@@ -96,6 +122,8 @@ VulkanApplication::VulkanApplication(
           options.min_swapchain_image_count)),
       command_pools_(allocator_),
       pipeline_cache_(CreateDefaultPipelineCache(&device_, entry_data)),
+      descriptor_allocator_(allocator_, &device_, 64,
+                            VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT),
       host_accessible_heap_(allocator_),
       coherent_heap_(allocator_),
       device_peer_memory_heaps_(allocator_),
@@ -105,45 +133,33 @@ VulkanApplication::VulkanApplication(
   }
 
   if (entry_data->output_frame_index() >= 1) {
-    PFN_vkSetSwapchainCallback set_callback =
-        reinterpret_cast<PFN_vkSetSwapchainCallback>(
-            device_.getProcAddrFunction()(device_, "vkSetSwapchainCallback"));
-
-    struct cb_data {
-      uint32_t output_frame;
-      const char* file_name;
-      logging::Logger* log;
-      const entry::EntryData* dat;
-      std::atomic<bool>& should_exit;
-      static void fn(void* obj, uint8_t* data, size_t size) {
-        cb_data* d = reinterpret_cast<cb_data*>(obj);
-        if (d->output_frame == 0) return;
-
-        if (size != d->dat->width() * d->dat->height() * 4) {
-          d->log->LogError("Invalid data size");
-          exit(-1);
-        }
-        if (--d->output_frame == 0) {
-          // Because we are in the callback swapchain, we know that the
-          // image size is 100x100, and the format is rgba
-          std::ofstream ppm;
-          ppm.open(d->file_name, std::ofstream::out | std::ofstream::binary);
-          ppm << "P6 " << d->dat->width() << " " << d->dat->height()
-              << " 255\n";
-
-          for (size_t i = 0; i < size; ++i) {
-            if (i % 4 == 3) continue;
-            ppm << char(*(data + i));
-          }
-          ppm.close();
-          d->should_exit.store(true);
-        }
-      }
-    };
-    auto cb = new cb_data{
-        static_cast<uint32_t>(entry_data->output_frame_index()),
-        entry_data->output_frame_file(), log_, entry_data_, should_exit_};
-    set_callback(swapchain_, &cb_data::fn, cb);
+    // Headless applications copy the frames out of the swapchain themselves
+    // in CaptureHeadlessFrame, otherwise the CallbackSwapchain layer hands
+    // them to CaptureSwapchainCallback as RGBA pixels.
+    const bool headless = entry_data->headless();
+    frame_capture_ = containers::make_unique<FrameCapture>(
+        allocator_, allocator_, log_, headless ? &device_ : nullptr,
+        render_queue_index_,
+        headless ? swapchain_.width() : entry_data->width(),
+        headless ? swapchain_.height() : entry_data->height(),
+        headless ? swapchain_.format() : VK_FORMAT_R8G8B8A8_UNORM,
+        static_cast<uint64_t>(entry_data->output_frame_index()),
+        entry_data->output_frame_count(), entry_data->output_frame_stride(),
+        GetCaptureFormat(log_, entry_data->output_format()),
+        entry_data->output_frame_file());
+    if (!headless) {
+      PFN_vkSetSwapchainCallback set_callback =
+          reinterpret_cast<PFN_vkSetSwapchainCallback>(
+              device_.getProcAddrFunction()(device_,
+                                            "vkSetSwapchainCallback"));
+      set_callback(swapchain_, &CaptureSwapchainCallback, this);
+    }
+  }
+
+  if (options.use_bindless_heap) {
+    bindless_heap_ = containers::make_unique<BindlessHeap>(
+        allocator_, allocator_, &device_, options.bindless_max_sampled_images,
+        options.bindless_max_storage_buffers, options.bindless_max_samplers);
   }
 
   vulkan::LoadContainer(log_, device_->vkGetSwapchainImagesKHR,
@@ -576,6 +592,95 @@ VulkanApplication::CreateAndBindSparseImage(
       img, containers::UniqueDeleter(allocator_, sizeof(SparseImage)));
 }
 
+containers::unique_ptr<VulkanApplication::SparseImage>
+VulkanApplication::CreateSparseResidentImage(
+    const VkImageCreateInfo* create_info) {
+  LOG_ASSERT(!=, log_,
+             create_info->flags & VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT, 0u);
+  LOG_ASSERT(==, log_, sparse_binding_queue_ != nullptr, true);
+  ::VkImage image;
+  LOG_ASSERT(==, log_,
+             device_->vkCreateImage(device_, create_info, nullptr, &image),
+             VK_SUCCESS);
+  VkMemoryRequirements requirements;
+  device_->vkGetImageMemoryRequirements(device_, image, &requirements);
+  uint32_t num_sparse_requirements = 0;
+  device_->vkGetImageSparseMemoryRequirements(
+      device_, image, &num_sparse_requirements, nullptr);
+  containers::vector<VkSparseImageMemoryRequirements> sparse_requirements(
+      allocator_);
+  sparse_requirements.resize(num_sparse_requirements);
+  device_->vkGetImageSparseMemoryRequirements(
+      device_, image, &num_sparse_requirements, sparse_requirements.data());
+
+  // Every aspect may have its own mip tail, which is either shared by all
+  // of the array layers or repeated for each of them. The metadata aspect
+  // has to be bound in any case.
+  containers::vector<AllocationToken*> tokens(allocator_);
+  containers::vector<VkSparseMemoryBind> binds(allocator_);
+  for (const auto& sparse_requirement : sparse_requirements) {
+    const bool metadata =
+        (sparse_requirement.formatProperties.aspectMask &
+         VK_IMAGE_ASPECT_METADATA_BIT) != 0;
+    if (sparse_requirement.imageMipTailSize == 0 ||
+        (sparse_requirement.imageMipTailFirstLod >= create_info->mipLevels &&
+         !metadata)) {
+      continue;
+    }
+    const uint32_t num_tails =
+        (sparse_requirement.formatProperties.flags &
+         VK_SPARSE_IMAGE_FORMAT_SINGLE_MIPTAIL_BIT) != 0
+            ? 1u
+            : create_info->arrayLayers;
+    for (uint32_t i = 0; i < num_tails; ++i) {
+      ::VkDeviceMemory memory;
+      ::VkDeviceSize offset;
+      AllocationToken* token = device_only_image_heap_->AllocateMemory(
+          sparse_requirement.imageMipTailSize, requirements.alignment, &memory,
+          &offset, nullptr);
+      tokens.push_back(token);
+      binds.emplace_back(VkSparseMemoryBind{
+          sparse_requirement.imageMipTailOffset +
+              i * sparse_requirement.imageMipTailStride,
+          sparse_requirement.imageMipTailSize, memory, offset,
+          metadata ? VkSparseMemoryBindFlags(VK_SPARSE_MEMORY_BIND_METADATA_BIT)
+                   : 0u});
+    }
+  }
+  if (!binds.empty()) {
+    VkSparseImageOpaqueMemoryBindInfo opaque_img_bind_info{
+        image, uint32_t(binds.size()), binds.data()};
+    VkBindSparseInfo bind_info{
+        VK_STRUCTURE_TYPE_BIND_SPARSE_INFO,  // sType
+        nullptr,                             // pNext
+        0u,                                  // waitSemaphoreCount
+        nullptr,                             // pWaitSemaphores
+        0u,                                  // bufferBindCount
+        nullptr,                             // pBufferBinds
+        1,                                   // imageOpaqueBindCount
+        &opaque_img_bind_info,               // pImageOpaqueBinds
+        0u,                                  // imageBindCount
+        nullptr,                             // pImageBinds
+        0u,                                  // signalSemaphoreCount
+        nullptr                              // pSignalSemaphores
+    };
+    LOG_ASSERT(==, log_, VK_SUCCESS,
+               sparse_binding_queue()->vkQueueBindSparse(
+                   sparse_binding_queue(), 1u, &bind_info,
+                   ::VkFence(VK_NULL_HANDLE)));
+    sparse_binding_queue()->vkQueueWaitIdle(sparse_binding_queue());
+  }
+
+  // We have to do it this way because Image is private and friended,
+  // so we cannot go through make_unique.
+  SparseImage* img = new (allocator_->malloc(sizeof(SparseImage)))
+      SparseImage(device_only_image_heap_.get(), std::move(tokens),
+                  VkImage(image, nullptr, &device_), create_info->format);
+
+  return containers::unique_ptr<SparseImage>(
+      img, containers::UniqueDeleter(allocator_, sizeof(SparseImage)));
+}
+
 containers::unique_ptr<VulkanApplication::Image>
 VulkanApplication::CreateAndBindMultiPlanarImage(
     const VkImageCreateInfo* create_info, const uint32_t* device_indices) {
@@ -1191,6 +1296,29 @@ bool VulkanApplication::DumpImageLayersData(
   return true;
 }
 
+::VkSemaphore VulkanApplication::CaptureHeadlessFrame(
+    uint32_t image_index, ::VkSemaphore wait_semaphore) {
+  if (!frame_capture_) {
+    return wait_semaphore;
+  }
+  ::VkSemaphore semaphore = frame_capture_->CaptureImage(
+      render_queue_, swapchain_images_[image_index],
+      VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, wait_semaphore);
+  if (frame_capture_->done()) {
+    should_exit_.store(true);
+  }
+  return semaphore;
+}
+
+void VulkanApplication::CaptureSwapchainCallback(void* application,
+                                                 uint8_t* data, size_t size) {
+  VulkanApplication* app = static_cast<VulkanApplication*>(application);
+  app->frame_capture_->CaptureHostData(data, size);
+  if (app->frame_capture_->done()) {
+    app->should_exit_.store(true);
+  }
+}
+
 // These linked-list nodes are ordered by offset into the heap.
 // the first node has a prev of nullptr, and the last node has a next of
 // nullptr.
@@ -1470,6 +1598,63 @@ void VulkanArena::FreeMemory(AllocationToken* token) {
       freeblocks_.insert(std::make_pair(token->allocationSize, token));
 }
 
+namespace {
+// FNV-1a over the bytes of |key|.
+size_t HashKey(const containers::string& key) {
+  uint64_t hash = 14695981039346656037ull;
+  for (char c : key) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+  }
+  return static_cast<size_t>(hash);
+}
+}  // anonymous namespace
+
+size_t PipelineLibraryCache::num_parts() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_parts_;
+}
+
+size_t PipelineLibraryCache::num_reused() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_reused_;
+}
+
+::VkPipeline PipelineLibraryCache::Find(const containers::string& key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = parts_.find(HashKey(key));
+  if (it == parts_.end()) {
+    return VK_NULL_HANDLE;
+  }
+  for (const auto& cached : it->second) {
+    if (cached.key == key) {
+      ++num_reused_;
+      return cached.part;
+    }
+  }
+  return VK_NULL_HANDLE;
+}
+
+::VkPipeline PipelineLibraryCache::Insert(const containers::string& key,
+                                          VkPipeline part) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const size_t hash = HashKey(key);
+  auto it = parts_.find(hash);
+  if (it == parts_.end()) {
+    it = parts_.emplace(hash, containers::vector<CachedPart>(allocator_))
+             .first;
+  }
+  for (const auto& cached : it->second) {
+    if (cached.key == key) {
+      ++num_reused_;
+      return cached.part;
+    }
+  }
+  ++num_parts_;
+  it->second.emplace_back(containers::string(key, allocator_),
+                          std::move(part));
+  return it->second.back().part;
+}
+
 VulkanGraphicsPipeline::VulkanGraphicsPipeline(containers::Allocator* allocator,
                                                PipelineLayout* layout,
                                                VulkanApplication* application,
@@ -1484,11 +1669,14 @@ VulkanGraphicsPipeline::VulkanGraphicsPipeline(containers::Allocator* allocator,
       vertex_binding_descriptions_(allocator),
       vertex_attribute_descriptions_(allocator),
       shader_modules_(allocator),
+      shader_code_(allocator),
       attachments_(allocator),
       layout_(*layout),
       pipeline_(VK_NULL_HANDLE, nullptr, &application->device()),
       contained_stages_(0),
-      pipeline_extensions_(nullptr) {
+      pipeline_extensions_(nullptr),
+      use_pipeline_library_(false),
+      library_cache_(nullptr) {
   MemoryClear(&vertex_input_state_);
   MemoryClear(&input_assembly_state_);
   MemoryClear(&tessellation_state_);
@@ -1597,6 +1785,10 @@ void VulkanGraphicsPipeline::AddShader(VkShaderStageFlagBits stage,
                  application_->device(), &create_info, nullptr, &module));
   shader_modules_.push_back(
       VkShaderModule(module, nullptr, &application_->device()));
+  shader_code_.emplace_back(
+      stage, containers::string(reinterpret_cast<const char*>(code),
+                                numCodeWords * 4,
+                                application_->GetAllocator()));
 
   stages_.push_back({
       VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,  // sType
@@ -1705,6 +1897,12 @@ void VulkanGraphicsPipeline::SetPipelineExtensions(
   pipeline_extensions_ = pipeline_extensions;
 }
 
+void VulkanGraphicsPipeline::EnablePipelineLibrary(
+    PipelineLibraryCache* cache) {
+  use_pipeline_library_ = true;
+  library_cache_ = cache;
+}
+
 void VulkanGraphicsPipeline::Commit() {
   vertex_input_state_.vertexBindingDescriptionCount =
       static_cast<uint32_t>(vertex_binding_descriptions_.size());
@@ -1754,6 +1952,10 @@ void VulkanGraphicsPipeline::Commit() {
       VK_NULL_HANDLE,                                   // basePipelineHandle
       0                                                 // basePipelineIndex
   };
+  if (use_pipeline_library_) {
+    CommitPipelineLibrary(create_info);
+    return;
+  }
   ::VkPipeline pipeline;
   LOG_ASSERT(==, application_->GetLogger(), VK_SUCCESS,
              application_->device()->vkCreateGraphicsPipelines(
@@ -1762,6 +1964,368 @@ void VulkanGraphicsPipeline::Commit() {
   pipeline_.initialize(pipeline);
 }
 
+::VkPipeline VulkanGraphicsPipeline::GetLibraryPart(
+    VkGraphicsPipelineCreateInfo create_info,
+    VkGraphicsPipelineLibraryFlagsEXT part, uint32_t stage_count,
+    const VkPipelineShaderStageCreateInfo* stages) {
+  create_info.pNext = nullptr;
+  create_info.stageCount = stage_count;
+  create_info.pStages = stage_count ? stages : nullptr;
+
+  // Only hand each part the state that it is responsible for.
+  switch (part) {
+    case VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT:
+      create_info.layout = VK_NULL_HANDLE;
+      create_info.renderPass = VK_NULL_HANDLE;
+      create_info.pViewportState = nullptr;
+      create_info.pRasterizationState = nullptr;
+      create_info.pTessellationState = nullptr;
+      create_info.pMultisampleState = nullptr;
+      create_info.pDepthStencilState = nullptr;
+      create_info.pColorBlendState = nullptr;
+      break;
+    case VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT:
+      create_info.pVertexInputState = nullptr;
+      create_info.pMultisampleState = nullptr;
+      create_info.pDepthStencilState = nullptr;
+      create_info.pColorBlendState = nullptr;
+      break;
+    case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT:
+      create_info.pVertexInputState = nullptr;
+      create_info.pInputAssemblyState = nullptr;
+      create_info.pViewportState = nullptr;
+      create_info.pRasterizationState = nullptr;
+      create_info.pTessellationState = nullptr;
+      create_info.pColorBlendState = nullptr;
+      break;
+    case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT:
+      create_info.layout = VK_NULL_HANDLE;
+      create_info.pVertexInputState = nullptr;
+      create_info.pInputAssemblyState = nullptr;
+      create_info.pViewportState = nullptr;
+      create_info.pRasterizationState = nullptr;
+      create_info.pTessellationState = nullptr;
+      create_info.pDepthStencilState = nullptr;
+      break;
+  }
+
+  containers::string key(application_->GetAllocator());
+  key.append(reinterpret_cast<const char*>(&part), sizeof(part));
+  const bool cacheable =
+      library_cache_ && AppendLibraryPartKey(create_info, &key);
+  if (cacheable) {
+    ::VkPipeline cached = library_cache_->Find(key);
+    if (cached != VK_NULL_HANDLE) {
+      return cached;
+    }
+  }
+
+  VkGraphicsPipelineLibraryCreateInfoEXT library_info{
+      VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT,  // sType
+      nullptr,                                                      // pNext
+      part                                                          // flags
+  };
+  create_info.pNext = &library_info;
+  create_info.flags |=
+      VK_PIPELINE_CREATE_LIBRARY_BIT_KHR |
+      VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+
+  ::VkPipeline pipeline;
+  LOG_ASSERT(==, application_->GetLogger(), VK_SUCCESS,
+             application_->device()->vkCreateGraphicsPipelines(
+                 application_->device(), application_->pipeline_cache(), 1,
+                 &create_info, nullptr, &pipeline));
+  if (cacheable) {
+    return library_cache_->Insert(
+        key, VkPipeline(pipeline, nullptr, &application_->device()));
+  }
+  library_->parts_.emplace_back(pipeline, nullptr, &application_->device());
+  return pipeline;
+}
+
+bool VulkanGraphicsPipeline::AppendLibraryPartKey(
+    const VkGraphicsPipelineCreateInfo& create_info,
+    containers::string* key) const {
+  // Appends the bytes of |value|, which must not contain padding.
+  auto append = [key](const void* value, size_t size) {
+    if (size != 0) {
+      key->append(reinterpret_cast<const char*>(value), size);
+    }
+  };
+  // Appends whether |state| is there, and returns true if it is there and
+  // has no extension structures.
+  auto append_state = [&append](const void* state, const void* next) {
+    const char present = state != nullptr;
+    append(&present, 1);
+    return state != nullptr && next == nullptr;
+  };
+
+  append(&create_info.flags, sizeof(create_info.flags));
+  append(&create_info.stageCount, sizeof(create_info.stageCount));
+  for (uint32_t i = 0; i < create_info.stageCount; ++i) {
+    const VkPipelineShaderStageCreateInfo& stage = create_info.pStages[i];
+    if (stage.pNext || stage.pSpecializationInfo) {
+      return false;
+    }
+    auto code = std::find_if(
+        shader_code_.begin(), shader_code_.end(),
+        [&stage](const ShaderCode& code) { return code.stage == stage.stage; });
+    if (code == shader_code_.end()) {
+      return false;
+    }
+    append(&stage.flags, sizeof(stage.flags));
+    append(&stage.stage, sizeof(stage.stage));
+    append(stage.pName, strlen(stage.pName) + 1);
+    const uint64_t code_size = code->code.size();
+    append(&code_size, sizeof(code_size));
+    key->append(code->code);
+  }
+
+  const VkPipelineVertexInputStateCreateInfo* vertex_input =
+      create_info.pVertexInputState;
+  if (append_state(vertex_input, vertex_input ? vertex_input->pNext
+                                              : nullptr)) {
+    append(&vertex_input->vertexBindingDescriptionCount, sizeof(uint32_t));
+    append(vertex_input->pVertexBindingDescriptions,
+           sizeof(VkVertexInputBindingDescription) *
+               vertex_input->vertexBindingDescriptionCount);
+    append(&vertex_input->vertexAttributeDescriptionCount, sizeof(uint32_t));
+    append(vertex_input->pVertexAttributeDescriptions,
+           sizeof(VkVertexInputAttributeDescription) *
+               vertex_input->vertexAttributeDescriptionCount);
+  } else if (vertex_input) {
+    return false;
+  }
+
+  const VkPipelineInputAssemblyStateCreateInfo* input_assembly =
+      create_info.pInputAssemblyState;
+  if (append_state(input_assembly,
+                   input_assembly ? input_assembly->pNext : nullptr)) {
+    append(&input_assembly->topology, sizeof(input_assembly->topology));
+    append(&input_assembly->primitiveRestartEnable, sizeof(VkBool32));
+  } else if (input_assembly) {
+    return false;
+  }
+
+  const VkPipelineTessellationStateCreateInfo* tessellation =
+      create_info.pTessellationState;
+  if (append_state(tessellation,
+                   tessellation ? tessellation->pNext : nullptr)) {
+    append(&tessellation->patchControlPoints, sizeof(uint32_t));
+  } else if (tessellation) {
+    return false;
+  }
+
+  const VkPipelineViewportStateCreateInfo* viewport =
+      create_info.pViewportState;
+  if (append_state(viewport, viewport ? viewport->pNext : nullptr)) {
+    append(&viewport->viewportCount, sizeof(uint32_t));
+    if (append_state(viewport->pViewports, nullptr)) {
+      append(viewport->pViewports,
+             sizeof(VkViewport) * viewport->viewportCount);
+    }
+    append(&viewport->scissorCount, sizeof(uint32_t));
+    if (append_state(viewport->pScissors, nullptr)) {
+      append(viewport->pScissors, sizeof(VkRect2D) * viewport->scissorCount);
+    }
+  } else if (viewport) {
+    return false;
+  }
+
+  const VkPipelineRasterizationStateCreateInfo* rasterization =
+      create_info.pRasterizationState;
+  if (append_state(rasterization,
+                   rasterization ? rasterization->pNext : nullptr)) {
+    append(&rasterization->depthClampEnable, sizeof(VkBool32));
+    append(&rasterization->rasterizerDiscardEnable, sizeof(VkBool32));
+    append(&rasterization->polygonMode, sizeof(VkPolygonMode));
+    append(&rasterization->cullMode, sizeof(VkCullModeFlags));
+    append(&rasterization->frontFace, sizeof(VkFrontFace));
+    append(&rasterization->depthBiasEnable, sizeof(VkBool32));
+    append(&rasterization->depthBiasConstantFactor, sizeof(float));
+    append(&rasterization->depthBiasClamp, sizeof(float));
+    append(&rasterization->depthBiasSlopeFactor, sizeof(float));
+    append(&rasterization->lineWidth, sizeof(float));
+  } else if (rasterization) {
+    return false;
+  }
+
+  const VkPipelineMultisampleStateCreateInfo* multisample =
+      create_info.pMultisampleState;
+  if (append_state(multisample, multisample ? multisample->pNext : nullptr)) {
+    append(&multisample->rasterizationSamples,
+           sizeof(VkSampleCountFlagBits));
+    append(&multisample->sampleShadingEnable, sizeof(VkBool32));
+    append(&multisample->minSampleShading, sizeof(float));
+    if (append_state(multisample->pSampleMask, nullptr)) {
+      append(multisample->pSampleMask,
+             sizeof(VkSampleMask) *
+                 ((multisample->rasterizationSamples + 31) / 32));
+    }
+    append(&multisample->alphaToCoverageEnable, sizeof(VkBool32));
+    append(&multisample->alphaToOneEnable, sizeof(VkBool32));
+  } else if (multisample) {
+    return false;
+  }
+
+  const VkPipelineDepthStencilStateCreateInfo* depth_stencil =
+      create_info.pDepthStencilState;
+  if (append_state(depth_stencil,
+                   depth_stencil ? depth_stencil->pNext : nullptr)) {
+    append(&depth_stencil->depthTestEnable, sizeof(VkBool32));
+    append(&depth_stencil->depthWriteEnable, sizeof(VkBool32));
+    append(&depth_stencil->depthCompareOp, sizeof(VkCompareOp));
+    append(&depth_stencil->depthBoundsTestEnable, sizeof(VkBool32));
+    append(&depth_stencil->stencilTestEnable, sizeof(VkBool32));
+    append(&depth_stencil->front, sizeof(VkStencilOpState));
+    append(&depth_stencil->back, sizeof(VkStencilOpState));
+    append(&depth_stencil->minDepthBounds, sizeof(float));
+    append(&depth_stencil->maxDepthBounds, sizeof(float));
+  } else if (depth_stencil) {
+    return false;
+  }
+
+  const VkPipelineColorBlendStateCreateInfo* color_blend =
+      create_info.pColorBlendState;
+  if (append_state(color_blend, color_blend ? color_blend->pNext : nullptr)) {
+    append(&color_blend->logicOpEnable, sizeof(VkBool32));
+    append(&color_blend->logicOp, sizeof(VkLogicOp));
+    append(&color_blend->attachmentCount, sizeof(uint32_t));
+    append(color_blend->pAttachments,
+           sizeof(VkPipelineColorBlendAttachmentState) *
+               color_blend->attachmentCount);
+    append(color_blend->blendConstants, sizeof(float) * 4);
+  } else if (color_blend) {
+    return false;
+  }
+
+  const VkPipelineDynamicStateCreateInfo* dynamic = create_info.pDynamicState;
+  if (append_state(dynamic, dynamic ? dynamic->pNext : nullptr)) {
+    append(&dynamic->dynamicStateCount, sizeof(uint32_t));
+    append(dynamic->pDynamicStates,
+           sizeof(VkDynamicState) * dynamic->dynamicStateCount);
+  } else if (dynamic) {
+    return false;
+  }
+
+  append(&create_info.layout, sizeof(create_info.layout));
+  append(&create_info.renderPass, sizeof(create_info.renderPass));
+  append(&create_info.subpass, sizeof(create_info.subpass));
+  return true;
+}
+
+void VulkanGraphicsPipeline::CommitPipelineLibrary(
+    const VkGraphicsPipelineCreateInfo& create_info) {
+  containers::Allocator* allocator = application_->GetAllocator();
+  VkDevice* device = &application_->device();
+  library_ = containers::make_unique<PipelineLibrary>(allocator, allocator,
+                                                      device);
+
+  // Move the fragment shader to the end so that the pre-rasterization
+  // stages can be handed to their part as one contiguous range.
+  auto fragment_stage = std::stable_partition(
+      stages_.begin(), stages_.end(),
+      [](const VkPipelineShaderStageCreateInfo& stage) {
+        return stage.stage != VK_SHADER_STAGE_FRAGMENT_BIT;
+      });
+  const uint32_t num_pre_rasterization_stages =
+      static_cast<uint32_t>(fragment_stage - stages_.begin());
+  const uint32_t num_fragment_stages =
+      static_cast<uint32_t>(stages_.end() - fragment_stage);
+
+  const VkGraphicsPipelineLibraryFlagsEXT kParts[] = {
+      VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT,
+      VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT,
+      VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT,
+      VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT};
+  containers::vector<::VkPipeline> raw_parts(allocator);
+  raw_parts.reserve(sizeof(kParts) / sizeof(kParts[0]));
+  for (auto part : kParts) {
+    uint32_t stage_count = 0;
+    const VkPipelineShaderStageCreateInfo* stages = nullptr;
+    if (part ==
+        VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT) {
+      stage_count = num_pre_rasterization_stages;
+      stages = stages_.data();
+    } else if (part == VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT) {
+      stage_count = num_fragment_stages;
+      stages = stages_.data() + num_pre_rasterization_stages;
+    }
+    raw_parts.push_back(
+        GetLibraryPart(create_info, part, stage_count, stages));
+  }
+
+  VkPipelineLibraryCreateInfoKHR link_info{
+      VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR,  // sType
+      pipeline_extensions_,                                // pNext
+      static_cast<uint32_t>(raw_parts.size()),             // libraryCount
+      raw_parts.data()                                     // pLibraries
+  };
+  VkGraphicsPipelineCreateInfo link_create_info{
+      VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,  // sType
+      &link_info,                                       // pNext
+      flags_,                                           // flags
+      0,                                                // stageCount
+      nullptr,                                          // pStage
+      nullptr,                                          // pVertexInputState
+      nullptr,                                          // pInputAssemblyState
+      nullptr,                                          // pTessellationState
+      nullptr,                                          // pViewportState
+      nullptr,                                          // pRasterizationState
+      nullptr,                                          // pMultisampleState
+      nullptr,                                          // pDepthStencilState
+      nullptr,                                          // pColorBlendState
+      nullptr,                                          // pDynamicState
+      layout_,                                          // layout
+      VK_NULL_HANDLE,                                   // renderPass
+      0,                                                // subpass
+      VK_NULL_HANDLE,                                   // basePipelineHandle
+      0                                                 // basePipelineIndex
+  };
+
+  // Fast-link first, this is what will be used until the optimized
+  // pipeline is ready.
+  ::VkPipeline pipeline;
+  LOG_ASSERT(==, application_->GetLogger(), VK_SUCCESS,
+             application_->device()->vkCreateGraphicsPipelines(
+                 application_->device(), application_->pipeline_cache(), 1,
+                 &link_create_info, nullptr, &pipeline));
+  pipeline_.initialize(pipeline);
+
+  // vkCreateGraphicsPipelines has been resolved above, so the background
+  // thread only ever reads the function table. The pipeline cache is
+  // internally synchronized.
+  PipelineLibrary* library = library_.get();
+  ::VkPipelineCache cache = application_->pipeline_cache();
+  link_info.pNext = nullptr;
+  link_create_info.flags |= VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT;
+  library->optimize_thread_ = std::thread(
+      [library, device, cache, link_info, link_create_info](
+          containers::vector<::VkPipeline> parts) mutable {
+        link_info.pLibraries = parts.data();
+        link_create_info.pNext = &link_info;
+        ::VkPipeline optimized;
+        LOG_ASSERT(==, device->GetLogger(), VK_SUCCESS,
+                   (*device)->vkCreateGraphicsPipelines(
+                       *device, cache, 1, &link_create_info, nullptr,
+                       &optimized));
+        library->optimized_pipeline_.initialize(optimized);
+        library->optimized_ready_.store(true, std::memory_order_release);
+      },
+      std::move(raw_parts));
+}
+
+bool VulkanGraphicsPipeline::IsOptimized() const {
+  return !library_ ||
+         library_->optimized_ready_.load(std::memory_order_acquire);
+}
+
+void VulkanGraphicsPipeline::WaitForOptimizedPipeline() {
+  if (library_ && library_->optimize_thread_.joinable()) {
+    library_->optimize_thread_.join();
+  }
+}
+
 VulkanComputePipeline::VulkanComputePipeline(
     containers::Allocator* allocator, PipelineLayout* layout,
     VulkanApplication* application,
@@ -17,14 +17,21 @@
 #define VULKAN_HELPERS_VULKAN_APPLICATION
 
 #include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <mutex>
+#include <thread>
 
 #include "support/containers/allocator.h"
 #include "support/containers/ordered_multimap.h"
+#include "support/containers/string.h"
 #include "support/containers/unordered_map.h"
 #include "support/containers/vector.h"
 #include "support/entry/entry.h"
 #include "support/log/log.h"
+#include "vulkan_helpers/bindless_heap.h"
+#include "vulkan_helpers/descriptor_allocator.h"
+#include "vulkan_helpers/frame_capture.h"
 #include "vulkan_helpers/helper_functions.h"
 #include "vulkan_wrapper/command_buffer_wrapper.h"
 #include "vulkan_wrapper/device_wrapper.h"
@@ -66,6 +73,11 @@ struct VulkanApplicationOptions {
   uint32_t min_swapchain_image_count = 0;
   void* device_next = nullptr;
 
+  bool use_bindless_heap = false;
+  uint32_t bindless_max_sampled_images = 0;
+  uint32_t bindless_max_storage_buffers = 0;
+  uint32_t bindless_max_samplers = 0;
+
   VulkanApplicationOptions& SetHostBufferSize(uint32_t size_in_bytes) {
     host_buffer_size = size_in_bytes;
     return *this;
@@ -145,6 +157,19 @@ struct VulkanApplicationOptions {
     device_next = pnext;
     return *this;
   }
+
+  // Creates a BindlessHeap with arrays of the given sizes. The descriptor
+  // indexing extension and features that it needs have to be enabled
+  // through the device extensions and SetDeviceExtensions().
+  VulkanApplicationOptions& EnableBindlessHeap(
+      uint32_t max_sampled_images = 4096, uint32_t max_storage_buffers = 4096,
+      uint32_t max_samplers = 64) {
+    use_bindless_heap = true;
+    bindless_max_sampled_images = max_sampled_images;
+    bindless_max_storage_buffers = max_storage_buffers;
+    bindless_max_samplers = max_samplers;
+    return *this;
+  }
 };
 
 // This class represents a location in GPU memory for storing data.
@@ -186,6 +211,56 @@ class VulkanArena {
 class VulkanApplication;
 class PipelineLayout;
 
+// PipelineLibraryCache holds the VK_EXT_graphics_pipeline_library parts that
+// VulkanGraphicsPipeline::Commit() creates for pipelines that use it. Parts
+// are looked up by all of the state they are created from, with shaders
+// compared by their SPIR-V, so pipelines that only differ in the state of
+// some parts share the others, and only create the parts that differ.
+//
+// Pipeline layouts and render passes are compared by handle, so the cache
+// must be destroyed before the layouts and render passes of the pipelines
+// that use it. It must outlive those pipelines.
+//
+// This is thread-safe.
+class PipelineLibraryCache {
+ public:
+  explicit PipelineLibraryCache(containers::Allocator* allocator)
+      : allocator_(allocator),
+        parts_(allocator),
+        num_parts_(0),
+        num_reused_(0) {}
+
+  // The number of parts that have been created, and the number of times that
+  // one of them was used instead of creating a new part.
+  size_t num_parts() const;
+  size_t num_reused() const;
+
+ private:
+  friend class VulkanGraphicsPipeline;
+
+  struct CachedPart {
+    CachedPart(containers::string&& key, VkPipeline&& part)
+        : key(std::move(key)), part(std::move(part)) {}
+    CachedPart(CachedPart&& other) = default;
+    containers::string key;
+    VkPipeline part;
+  };
+
+  // Returns the part that was created from |key|, or VK_NULL_HANDLE.
+  ::VkPipeline Find(const containers::string& key);
+  // Adds |part|, created from |key|, and returns it. If another thread has
+  // added a part for |key| in the meantime, |part| is destroyed and that one
+  // is returned instead.
+  ::VkPipeline Insert(const containers::string& key, VkPipeline part);
+
+  containers::Allocator* allocator_;
+  mutable std::mutex mutex_;
+  // Maps from the hash of the key to every part with that hash.
+  containers::unordered_map<size_t, containers::vector<CachedPart>> parts_;
+  size_t num_parts_;
+  size_t num_reused_;
+};
+
 // Customizable Graphics pipeline state.
 // Defaults to the following properties:
 //    Dynamic Viewport & Scissor
@@ -198,6 +273,7 @@ class PipelineLayout;
 //    Rasterization enabled
 //    Stencil test disabled
 //    Opaque Color blending
+//    Monolithic (non-library) pipeline creation
 
 class VulkanGraphicsPipeline {
  public:
@@ -216,10 +292,13 @@ class VulkanGraphicsPipeline {
         vertex_binding_descriptions_(allocator),
         vertex_attribute_descriptions_(allocator),
         shader_modules_(allocator),
+        shader_code_(allocator),
         attachments_(allocator),
         pipeline_(VK_NULL_HANDLE, nullptr, nullptr),
         contained_stages_(0),
-        pipeline_extensions_(nullptr) {}
+        pipeline_extensions_(nullptr),
+        use_pipeline_library_(false),
+        library_cache_(nullptr) {}
 
   VulkanGraphicsPipeline(VulkanGraphicsPipeline&& other) = default;
 
@@ -287,10 +366,85 @@ class VulkanGraphicsPipeline {
 
   VkPipelineCreateFlags& flags() { return flags_; }
 
+  // Makes Commit() build the pipeline out of VK_EXT_graphics_pipeline_library
+  // parts (vertex input, pre-rasterization shaders, fragment shader and
+  // fragment output) which are then fast-linked without link time
+  // optimization. A link time optimized pipeline is created from the same
+  // parts on a background thread, and replaces the fast-linked pipeline
+  // once it is ready. The device must have been created with
+  // VK_KHR_pipeline_library, VK_EXT_graphics_pipeline_library and the
+  // graphicsPipelineLibrary feature enabled.
+  // Parts are taken from, and added to, |cache| if it is not nullptr, so that
+  // they are shared with other pipelines. Otherwise they belong to this
+  // pipeline alone.
+  void EnablePipelineLibrary(PipelineLibraryCache* cache = nullptr);
+
   void Commit();
-  operator ::VkPipeline() const { return pipeline_; }
+
+  // Returns true if the pipeline returned by the ::VkPipeline conversion is
+  // the final, link time optimized one. This is always true for pipelines
+  // that are not built from pipeline libraries.
+  bool IsOptimized() const;
+
+  // Blocks until the background link time optimization, if any, has
+  // finished.
+  void WaitForOptimizedPipeline();
+
+  // Returns the optimized pipeline if it has been linked, otherwise the
+  // fast-linked one. Command buffers recorded with the fast-linked pipeline
+  // stay valid, it is kept alive for as long as this object.
+  operator ::VkPipeline() const {
+    if (library_ &&
+        library_->optimized_ready_.load(std::memory_order_acquire)) {
+      return library_->optimized_pipeline_;
+    }
+    return pipeline_;
+  }
 
  private:
+  // The SPIR-V of a shader stage, which library parts are cached by.
+  struct ShaderCode {
+    ShaderCode(VkShaderStageFlagBits stage, containers::string&& code)
+        : stage(stage), code(std::move(code)) {}
+    ShaderCode(ShaderCode&& other) = default;
+    VkShaderStageFlagBits stage;
+    containers::string code;
+  };
+
+  // The library parts that are not in a PipelineLibraryCache, and the state
+  // of the background optimized link of a pipeline created with
+  // EnablePipelineLibrary(). This lives on the heap so
+  // that the background thread is not affected if the
+  // VulkanGraphicsPipeline is moved.
+  struct PipelineLibrary {
+    PipelineLibrary(containers::Allocator* allocator, VkDevice* device)
+        : parts_(allocator),
+          optimized_pipeline_(VK_NULL_HANDLE, nullptr, device),
+          optimized_ready_(false) {}
+    ~PipelineLibrary() {
+      if (optimize_thread_.joinable()) {
+        optimize_thread_.join();
+      }
+    }
+    containers::vector<VkPipeline> parts_;
+    VkPipeline optimized_pipeline_;
+    std::atomic<bool> optimized_ready_;
+    std::thread optimize_thread_;
+  };
+
+  // Returns the library part of the pipeline selected by |part| for the
+  // given monolithic create_info, using only the given shader stages. It is
+  // taken from library_cache_ if it is there, and created otherwise.
+  ::VkPipeline GetLibraryPart(
+      VkGraphicsPipelineCreateInfo create_info,
+      VkGraphicsPipelineLibraryFlagsEXT part, uint32_t stage_count,
+      const VkPipelineShaderStageCreateInfo* stages);
+  void CommitPipelineLibrary(const VkGraphicsPipelineCreateInfo& create_info);
+  // Appends all of the state in |create_info| to |key|. Returns false if any
+  // of it cannot be compared, like extension structures.
+  bool AppendLibraryPartKey(const VkGraphicsPipelineCreateInfo& create_info,
+                            containers::string* key) const;
+
   ::VkRenderPass render_pass_;
   uint32_t subpass_;
   VulkanApplication* application_;
@@ -313,11 +467,15 @@ class VulkanGraphicsPipeline {
   containers::vector<VkVertexInputAttributeDescription>
       vertex_attribute_descriptions_;
   containers::vector<VkShaderModule> shader_modules_;
+  containers::vector<ShaderCode> shader_code_;
   containers::vector<VkPipelineColorBlendAttachmentState> attachments_;
   ::VkPipelineLayout layout_;
   VkPipeline pipeline_;
   uint32_t contained_stages_;
   const void* pipeline_extensions_;
+  bool use_pipeline_library_;
+  PipelineLibraryCache* library_cache_;
+  containers::unique_ptr<PipelineLibrary> library_;
 };
 
 // Customizable Compute pipeline state.
@@ -344,9 +502,14 @@ struct DescriptorSetLayoutBinding {
   DescriptorSetLayoutBinding(
       std::initializer_list<VkDescriptorSetLayoutBinding> bindings,
       VkDescriptorSetLayoutCreateFlags flags = 0)
-      : bindings_(bindings), flags_(flags) {}
+      : bindings_(bindings), flags_(flags), layout_(VK_NULL_HANDLE) {}
+  // Uses a layout that is owned elsewhere, such as the layout of a
+  // BindlessHeap, for this set.
+  DescriptorSetLayoutBinding(::VkDescriptorSetLayout layout)
+      : bindings_(), flags_(0), layout_(layout) {}
   std::initializer_list<VkDescriptorSetLayoutBinding> bindings_;
   VkDescriptorSetLayoutCreateFlags flags_;
+  ::VkDescriptorSetLayout layout_;
 };
 
 // PipelineLayout holds a VkPipelineLayout object as well as as set of
@@ -370,6 +533,10 @@ class PipelineLayout {
 
     descriptor_set_layouts_.reserve(layouts.size());
     for (auto binding_list : layouts) {
+      if (binding_list.layout_ != VK_NULL_HANDLE) {
+        raw_layouts.push_back(binding_list.layout_);
+        continue;
+      }
       descriptor_set_layouts_.emplace_back(CreateDescriptorSetLayout(
           allocator, device, binding_list.bindings_, binding_list.flags_));
       raw_layouts.push_back(descriptor_set_layouts_.back());
@@ -404,11 +571,16 @@ class PipelineLayout {
 // for allocating it.
 class DescriptorSet {
  public:
+  DescriptorSet(DescriptorSet&& other) = default;
+  // Sets from a DescriptorAllocator are freed through it, so that it can
+  // reuse their room.
+  ~DescriptorSet();
+
   operator ::VkDescriptorSet() const { return set_; }
 
   const ::VkDescriptorSet& raw_set() const { return set_.get_raw_object(); }
-  ::VkDescriptorPool pool() const { return pool_.get_raw_object(); }
-  ::VkDescriptorSetLayout layout() const { return layout_.get_raw_object(); }
+  ::VkDescriptorPool pool() const { return pool_; }
+  ::VkDescriptorSetLayout layout() const { return layout_; }
 
  private:
   friend class VulkanApplication;
@@ -418,17 +590,31 @@ class DescriptorSet {
       std::initializer_list<VkDescriptorSetLayoutBinding> bindings,
       void* pNext = nullptr);
 
+  static VkDescriptorSet AllocateFromShared(
+      DescriptorAllocator* descriptor_allocator, VkDevice* device,
+      ::VkDescriptorSetLayout layout, ::VkDescriptorPool* pool);
+
   // Creates a descriptor set with one descriptor according to the given
-  // |binding|.
+  // |binding|, in a pool and with a layout dedicated to this set. This is
+  // needed when the pool has to be created with extension structures.
   DescriptorSet(containers::Allocator* allocator, VkDevice* device,
                 std::initializer_list<VkDescriptorSetLayoutBinding> bindings,
                 void* pNext = nullptr);
 
-  // Pools is designed to amortize the cost of descriptor set allocation.
-  // But here we create a dedicated pool for each descriptor set. It suffers
-  // for performance, but is easy to write.
-  VkDescriptorPool pool_;
-  VkDescriptorSetLayout layout_;
+  // Creates a descriptor set with one descriptor according to the given
+  // |binding|, from the shared pools and cached layouts of
+  // |descriptor_allocator|.
+  DescriptorSet(DescriptorAllocator* descriptor_allocator, VkDevice* device,
+                std::initializer_list<VkDescriptorSetLayoutBinding> bindings);
+
+  // These only hold objects for sets that were created with a dedicated
+  // pool, shared pools and layouts belong to the DescriptorAllocator.
+  VkDescriptorPool dedicated_pool_;
+  VkDescriptorSetLayout dedicated_layout_;
+  // The allocator of sets that were not created with a dedicated pool.
+  DescriptorAllocator* descriptor_allocator_;
+  ::VkDescriptorPool pool_;
+  ::VkDescriptorSetLayout layout_;
   VkDescriptorSet set_;
 };
 
@@ -578,6 +764,9 @@ class VulkanApplication {
     LazyDeviceFunction<PFN_vkFlushMappedMemoryRanges>* flush_memory_range_;
     LazyDeviceFunction<PFN_vkInvalidateMappedMemoryRanges>*
         invalidate_memory_range_;
+    // The index of this buffer in the application's BindlessHeap, if it
+    // has been added to it.
+    BindlessIndex bindless_index_;
   };
 
   // On creation creates an instance, device, surface, swapchain, queues,
@@ -601,6 +790,13 @@ class VulkanApplication {
   containers::unique_ptr<SparseImage> CreateAndBindSparseImage(
       const VkImageCreateInfo* create_info, size_t slice_size,
       const uint32_t* device_indices = nullptr);
+  // Creates a sparse resident image from the given create_info, which must
+  // have VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT, and binds memory from the
+  // device-only image arena to its mip tail only. The rest of the image is
+  // left unbound, so that it can be bound page by page, as VirtualTexture
+  // does.
+  containers::unique_ptr<SparseImage> CreateSparseResidentImage(
+      const VkImageCreateInfo* create_info);
   // Creates a multi-planar image from the given create_info, and binds
   // memory from the device-only image arena. Memory is allocated for each
   // plane of the image if it is disjoint.
@@ -846,11 +1042,43 @@ class VulkanApplication {
   }
 
   // Allocates a descriptor set with one descriptor according to the given
-  // |binding|.
+  // |binding|. Sets are allocated from shared, growable pools and layouts
+  // are cached, unless |pNext| is given or one of the bindings is an inline
+  // uniform block, in which case the set gets its own pool.
   DescriptorSet AllocateDescriptorSet(
       std::initializer_list<VkDescriptorSetLayoutBinding> bindings,
       void* pNext = nullptr) {
-    return DescriptorSet(allocator_, &device_, bindings, pNext);
+    bool needs_dedicated_pool = pNext != nullptr;
+    for (const auto& binding : bindings) {
+      needs_dedicated_pool |=
+          binding.descriptorType == VK_DESCRIPTOR_TYPE_INLINE_UNIFORM_BLOCK_EXT;
+    }
+    if (needs_dedicated_pool) {
+      return DescriptorSet(allocator_, &device_, bindings, pNext);
+    }
+    return DescriptorSet(&descriptor_allocator_, &device_, bindings);
+  }
+
+  // Returns the DescriptorAllocator that backs AllocateDescriptorSet(). Its
+  // pools allow freeing individual sets, for transient sets that are reset
+  // every frame a separate DescriptorAllocator should be used instead.
+  DescriptorAllocator& descriptor_allocator() { return descriptor_allocator_; }
+
+  // Returns the BindlessHeap of this application, or nullptr if it was not
+  // enabled in the VulkanApplicationOptions.
+  BindlessHeap* bindless_heap() { return bindless_heap_.get(); }
+
+  // Returns the index of |buffer| in the storage buffer array of the
+  // BindlessHeap, adding the whole buffer to it the first time. The index is
+  // freed when the buffer is destroyed.
+  uint32_t GetBindlessIndex(Buffer* buffer) {
+    if (!buffer->bindless_index_.is_valid()) {
+      LOG_ASSERT(==, log_, true, bindless_heap_ != nullptr);
+      buffer->bindless_index_ = BindlessIndex(
+          bindless_heap_.get(), BindlessHeap::kStorageBufferBinding,
+          bindless_heap_->AddStorageBuffer(*buffer, 0, buffer->size()));
+    }
+    return buffer->bindless_index_.index();
   }
 
   VkSwapchainKHR& swapchain() { return swapchain_; }
@@ -954,6 +1182,17 @@ class VulkanApplication {
 
   bool should_exit() const { return should_exit_.load(); }
 
+  // In headless mode there is no CallbackSwapchain layer to write
+  // -output-frame, so this has to be called with the index of every
+  // swapchain image that is about to be presented, after the work that
+  // renders it has been submitted to the render queue, signaling
+  // |wait_semaphore|, and left it in VK_IMAGE_LAYOUT_PRESENT_SRC_KHR.
+  // Returns the semaphore that presenting the image has to wait for instead
+  // of |wait_semaphore|. should_exit() becomes true after the last frame
+  // that was asked for.
+  ::VkSemaphore CaptureHeadlessFrame(uint32_t image_index,
+                                     ::VkSemaphore wait_semaphore);
+
   static const VkAccessFlags kAllReadBits =
       VK_ACCESS_HOST_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT |
       VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
@@ -986,6 +1225,11 @@ class VulkanApplication {
   VkDevice SetupDevice(VkDevice device, bool create_async_compute_queue,
                        bool use_sparse_binding);
 
+  // Called by the CallbackSwapchain layer with the pixels of every presented
+  // frame.
+  static void CaptureSwapchainCallback(void* application, uint8_t* data,
+                                       size_t size);
+
   // Intended to be called by the constructor to create the device, since
   // VkDevice does not have a default constructor.
   VkDevice CreateDeviceGroup(
@@ -1026,6 +1270,8 @@ class VulkanApplication {
   VkSwapchainKHR swapchain_;
   containers::unordered_map<uint32_t, VkCommandPool> command_pools_;
   VkPipelineCache pipeline_cache_;
+  DescriptorAllocator descriptor_allocator_;
+  containers::unique_ptr<BindlessHeap> bindless_heap_;
   containers::vector<containers::unique_ptr<VulkanArena>> host_accessible_heap_;
   containers::vector<containers::unique_ptr<VulkanArena>> coherent_heap_;
   containers::unique_ptr<VulkanArena> device_only_image_heap_;
@@ -1033,6 +1279,8 @@ class VulkanApplication {
   containers::vector<containers::unique_ptr<VulkanArena>>
       device_peer_memory_heaps_;
   containers::vector<::VkImage> swapchain_images_;
+  // Writes -output-frame, if it was given.
+  containers::unique_ptr<FrameCapture> frame_capture_;
   std::atomic<bool> should_exit_;
 };
 
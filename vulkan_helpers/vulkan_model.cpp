@@ -0,0 +1,542 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vulkan_helpers/vulkan_model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace vulkan {
+namespace {
+// Returns |value| as a 16-bit normalized integer.
+int16_t ToSnorm16(float value) {
+  value = std::max(-1.0f, std::min(1.0f, value));
+  return static_cast<int16_t>(std::round(value * 32767.0f));
+}
+
+// Returns |value| as a half-precision float, rounded to the nearest even.
+uint16_t ToHalf(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+  const uint32_t exponent = (bits >> 23) & 0xFF;
+  uint32_t mantissa = bits & 0x7FFFFF;
+
+  if (exponent == 0xFF) {
+    // Infinity stays infinity, and NaN stays NaN.
+    return static_cast<uint16_t>(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+  }
+  const int32_t half_exponent = static_cast<int32_t>(exponent) - 127 + 15;
+  if (half_exponent >= 0x1F) {
+    return static_cast<uint16_t>(sign | 0x7C00);
+  }
+  if (half_exponent <= 0) {
+    // Denormal, or too small to be represented at all.
+    if (half_exponent < -10) {
+      return sign;
+    }
+    mantissa |= 0x800000;
+    const uint32_t shift = static_cast<uint32_t>(14 - half_exponent);
+    uint32_t half_mantissa = mantissa >> shift;
+    const uint32_t remainder = mantissa & ((1u << shift) - 1);
+    const uint32_t halfway = 1u << (shift - 1);
+    if (remainder > halfway || (remainder == halfway && (half_mantissa & 1))) {
+      ++half_mantissa;
+    }
+    return static_cast<uint16_t>(sign | half_mantissa);
+  }
+  uint32_t half = (static_cast<uint32_t>(half_exponent) << 10) |
+                  (mantissa >> 13);
+  const uint32_t remainder = mantissa & 0x1FFF;
+  // A carry out of the mantissa correctly increments the exponent, up to
+  // infinity.
+  if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+    ++half;
+  }
+  return static_cast<uint16_t>(sign | half);
+}
+
+// Writes |normal| octahedral-encoded to |out|. This maps the unit sphere onto
+// an octahedron, which is then unfolded into a square, so that two
+// components are enough.
+void ToOctahedral(const float* normal, int16_t* out) {
+  const float length =
+      std::abs(normal[0]) + std::abs(normal[1]) + std::abs(normal[2]);
+  float x = length > 0.0f ? normal[0] / length : 0.0f;
+  float y = length > 0.0f ? normal[1] / length : 0.0f;
+  if (length > 0.0f && normal[2] < 0.0f) {
+    // Fold the lower half of the octahedron over the upper one.
+    const float folded_x = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+    const float folded_y = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+    x = folded_x;
+    y = folded_y;
+  }
+  out[0] = ToSnorm16(x);
+  out[1] = ToSnorm16(y);
+}
+}  // anonymous namespace
+
+void VulkanModel::SetupLayout(const VulkanModelLayout& layout) {
+  if (lods_.empty()) {
+    lods_.push_back({0, static_cast<uint32_t>(num_indices_), 0.0f, 0});
+  }
+  for (const ModelLod& lod : lods_) {
+    LOG_ASSERT(==, logger_, true, IsValidModelLod(lod, num_indices_));
+  }
+
+  layout_ = layout;
+  convert_vertices_ = layout.interleaved || layout.quantized_positions ||
+                      layout.half_texture_coords || layout.octahedral_normals;
+  convert_indices_ = layout.small_indices && source_index_size_ == 4 &&
+                     num_vertices_ < 65536;
+
+  position_size_ = layout.quantized_positions ? sizeof(int16_t) * 4
+                                              : POSITION_SIZE;
+  texture_coord_size_ =
+      layout.half_texture_coords ? sizeof(uint16_t) * 2 : TEXCOORD_SIZE;
+  normal_size_ =
+      layout.octahedral_normals ? sizeof(int16_t) * 2 : NORMAL_SIZE;
+
+  if (!convert_vertices_) {
+    texture_coords_offset_ = source_texture_coords_offset_;
+    normals_offset_ = source_normals_offset_;
+    vertex_data_size_ = source_vertex_data_size_;
+  } else if (layout.interleaved) {
+    texture_coords_offset_ = position_size_;
+    normals_offset_ = position_size_ + texture_coord_size_;
+    vertex_data_size_ =
+        num_vertices_ * (position_size_ + texture_coord_size_ + normal_size_);
+  } else {
+    texture_coords_offset_ = num_vertices_ * position_size_;
+    normals_offset_ = num_vertices_ * (position_size_ + texture_coord_size_);
+    vertex_data_size_ =
+        num_vertices_ * (position_size_ + texture_coord_size_ + normal_size_);
+  }
+
+  const size_t index_size = convert_indices_ ? 2 : source_index_size_;
+  index_type_ = index_size == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+  // vkCmdUpdateBuffer only writes multiples of 4 bytes.
+  index_data_size_ = (num_indices_ * index_size + 3) & ~size_t(3);
+
+  for (size_t i = 0; i < 3; ++i) {
+    position_scale_[i] = 1.0f;
+    position_offset_[i] = 0.0f;
+  }
+  if (layout.quantized_positions && num_vertices_ > 0) {
+    float min[3] = {positions_[0], positions_[1], positions_[2]};
+    float max[3] = {positions_[0], positions_[1], positions_[2]};
+    for (size_t v = 1; v < num_vertices_; ++v) {
+      for (size_t i = 0; i < 3; ++i) {
+        min[i] = std::min(min[i], positions_[v * 3 + i]);
+        max[i] = std::max(max[i], positions_[v * 3 + i]);
+      }
+    }
+    for (size_t i = 0; i < 3; ++i) {
+      position_offset_[i] = (min[i] + max[i]) * 0.5f;
+      const float half_extent = (max[i] - min[i]) * 0.5f;
+      position_scale_[i] = half_extent > 0.0f ? half_extent : 1.0f;
+    }
+  }
+
+  meshlets_.clear();
+  if (layout.meshlets) {
+    BuildMeshlets();
+  }
+}
+
+uint32_t VulkanModel::SourceIndex(size_t i) const {
+  if (source_index_size_ == 2) {
+    return static_cast<const uint16_t*>(indices_)[i];
+  }
+  return static_cast<const uint32_t*>(indices_)[i];
+}
+
+void VulkanModel::BuildMeshlets() {
+  // Triangles are added to the current meshlet in order, until one would
+  // exceed its limits. used[v] is the meshlet that last used vertex v.
+  const uint32_t kUnused = ~0u;
+  containers::vector<uint32_t> used(num_vertices_, kUnused, allocator_);
+  containers::vector<uint32_t> vertices(allocator_);
+  containers::vector<uint32_t> indices(allocator_);
+  vertices.reserve(MESHLET_MAX_VERTICES);
+  indices.reserve(MESHLET_MAX_TRIANGLES * 3);
+  const size_t end = lods_[0].first_index + lods_[0].index_count;
+  size_t first_index = lods_[0].first_index;
+  for (size_t i = first_index; i < end; i += 3) {
+    const uint32_t triangle[3] = {SourceIndex(i), SourceIndex(i + 1),
+                                  SourceIndex(i + 2)};
+    uint32_t meshlet = static_cast<uint32_t>(meshlets_.size());
+    // A vertex repeated in a degenerate triangle counts twice, which only
+    // errs on the safe side.
+    size_t new_vertices = 0;
+    for (uint32_t v : triangle) {
+      new_vertices += used[v] == meshlet ? 0 : 1;
+    }
+    if (vertices.size() + new_vertices > MESHLET_MAX_VERTICES ||
+        indices.size() == MESHLET_MAX_TRIANGLES * 3) {
+      meshlets_.push_back(MeshletBounds(vertices, indices));
+      meshlets_.back().first_index = static_cast<uint32_t>(first_index);
+      first_index = i;
+      vertices.clear();
+      indices.clear();
+      ++meshlet;
+    }
+    for (uint32_t v : triangle) {
+      if (used[v] != meshlet) {
+        used[v] = meshlet;
+        vertices.push_back(v);
+      }
+      indices.push_back(v);
+    }
+  }
+  if (!indices.empty()) {
+    meshlets_.push_back(MeshletBounds(vertices, indices));
+    meshlets_.back().first_index = static_cast<uint32_t>(first_index);
+  }
+}
+
+Meshlet VulkanModel::MeshletBounds(
+    const containers::vector<uint32_t>& vertices,
+    const containers::vector<uint32_t>& indices) const {
+  Meshlet meshlet;
+  memset(&meshlet, 0, sizeof(meshlet));
+  meshlet.index_count = static_cast<uint32_t>(indices.size());
+  meshlet.vertex_count = static_cast<uint32_t>(vertices.size());
+
+  // The bounding sphere is centered on the bounding box.
+  float min[3], max[3];
+  for (size_t i = 0; i < 3; ++i) {
+    min[i] = max[i] = positions_[vertices[0] * 3 + i];
+  }
+  for (uint32_t v : vertices) {
+    for (size_t i = 0; i < 3; ++i) {
+      min[i] = std::min(min[i], positions_[v * 3 + i]);
+      max[i] = std::max(max[i], positions_[v * 3 + i]);
+    }
+  }
+  for (size_t i = 0; i < 3; ++i) {
+    meshlet.center[i] = (min[i] + max[i]) * 0.5f;
+  }
+  float radius_squared = 0.0f;
+  for (uint32_t v : vertices) {
+    float distance_squared = 0.0f;
+    for (size_t i = 0; i < 3; ++i) {
+      const float d = positions_[v * 3 + i] - meshlet.center[i];
+      distance_squared += d * d;
+    }
+    radius_squared = std::max(radius_squared, distance_squared);
+  }
+  meshlet.radius = std::sqrt(radius_squared);
+
+  // The cone axis is the average of the face normals, and its half angle is
+  // the largest angle between the axis and any of them. Counter-clockwise
+  // triangles are front-facing, as in the obj files the models come from.
+  containers::vector<float> normals(allocator_);
+  normals.reserve(indices.size());
+  float axis[3] = {0.0f, 0.0f, 0.0f};
+  for (size_t t = 0; t < indices.size(); t += 3) {
+    const float* p0 = &positions_[indices[t] * 3];
+    const float* p1 = &positions_[indices[t + 1] * 3];
+    const float* p2 = &positions_[indices[t + 2] * 3];
+    const float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+    const float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+    const float n[3] = {e1[1] * e2[2] - e1[2] * e2[1],
+                        e1[2] * e2[0] - e1[0] * e2[2],
+                        e1[0] * e2[1] - e1[1] * e2[0]};
+    const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (length == 0.0f) {
+      // Degenerate triangles are never rasterized.
+      continue;
+    }
+    for (size_t i = 0; i < 3; ++i) {
+      normals.push_back(n[i] / length);
+      axis[i] += n[i] / length;
+    }
+  }
+  const float axis_length =
+      std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+  meshlet.cone_cutoff = 1.0f;
+  if (axis_length > 0.0f) {
+    for (size_t i = 0; i < 3; ++i) {
+      meshlet.cone_axis[i] = axis[i] / axis_length;
+    }
+    float min_dot = 1.0f;
+    for (size_t n = 0; n < normals.size(); n += 3) {
+      min_dot = std::min(min_dot, normals[n] * meshlet.cone_axis[0] +
+                                      normals[n + 1] * meshlet.cone_axis[1] +
+                                      normals[n + 2] * meshlet.cone_axis[2]);
+    }
+    // A cone of 90 degrees or more always contains a front-facing normal.
+    if (min_dot > 0.0f) {
+      meshlet.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+    }
+  }
+  return meshlet;
+}
+
+size_t VulkanModel::SelectLod(float distance, float pixels_per_unit,
+                              float max_pixel_error) const {
+  size_t lod = 0;
+  while (lod + 1 < lods_.size() &&
+         lods_[lod + 1].error * pixels_per_unit <= max_pixel_error * distance) {
+    ++lod;
+  }
+  return lod;
+}
+
+void VulkanModel::WriteVertexData(uint8_t* data) const {
+  if (!convert_vertices_) {
+    memcpy(data, positions_, source_vertex_data_size_);
+    return;
+  }
+  const size_t stride =
+      layout_.interleaved ? position_size_ + texture_coord_size_ + normal_size_
+                          : 0;
+  for (size_t v = 0; v < num_vertices_; ++v) {
+    uint8_t* position = layout_.interleaved ? data + v * stride
+                                            : data + v * position_size_;
+    uint8_t* texture_coord =
+        layout_.interleaved
+            ? position + texture_coords_offset_
+            : data + texture_coords_offset_ + v * texture_coord_size_;
+    uint8_t* normal = layout_.interleaved
+                          ? position + normals_offset_
+                          : data + normals_offset_ + v * normal_size_;
+
+    if (layout_.quantized_positions) {
+      int16_t quantized[4];
+      for (size_t i = 0; i < 3; ++i) {
+        quantized[i] = ToSnorm16((positions_[v * 3 + i] - position_offset_[i]) /
+                                 position_scale_[i]);
+      }
+      quantized[3] = 32767;
+      memcpy(position, quantized, sizeof(quantized));
+    } else {
+      memcpy(position, &positions_[v * 3], POSITION_SIZE);
+    }
+
+    if (layout_.half_texture_coords) {
+      const uint16_t half[2] = {ToHalf(texture_coords_[v * 2]),
+                                ToHalf(texture_coords_[v * 2 + 1])};
+      memcpy(texture_coord, half, sizeof(half));
+    } else {
+      memcpy(texture_coord, &texture_coords_[v * 2], TEXCOORD_SIZE);
+    }
+
+    if (layout_.octahedral_normals) {
+      int16_t encoded[2];
+      ToOctahedral(&normals_[v * 3], encoded);
+      memcpy(normal, encoded, sizeof(encoded));
+    } else {
+      memcpy(normal, &normals_[v * 3], NORMAL_SIZE);
+    }
+  }
+}
+
+void VulkanModel::WriteIndexData(uint8_t* data) const {
+  memset(data, 0, index_data_size_);
+  if (!convert_indices_) {
+    memcpy(data, indices_, num_indices_ * source_index_size_);
+    return;
+  }
+  const uint32_t* indices = static_cast<const uint32_t*>(indices_);
+  for (size_t i = 0; i < num_indices_; ++i) {
+    const uint16_t index = static_cast<uint16_t>(indices[i]);
+    memcpy(data + i * sizeof(index), &index, sizeof(index));
+  }
+}
+
+void VulkanModel::InitializeData(vulkan::VulkanApplication* application,
+                                 vulkan::VkCommandBuffer* cmdBuffer) {
+  VkBufferCreateInfo create_info = {
+      VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
+      nullptr,                               // pNext
+      0,                                     // flags
+      vertex_data_size_,                     // size
+      VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,  // usage
+      VK_SHARING_MODE_EXCLUSIVE,
+      0,
+      nullptr};
+  vertexBuffer_ = application->CreateAndBindDeviceBuffer(&create_info);
+
+  create_info.usage =
+      VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+  create_info.size = index_data_size_;
+
+  indexBuffer_ = application->CreateAndBindDeviceBuffer(&create_info);
+
+  const size_t meshlet_data_size = meshlets_.size() * sizeof(Meshlet);
+  meshletBuffer_.reset();
+  if (!meshlets_.empty()) {
+    create_info.usage =
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    create_info.size = meshlet_data_size;
+    meshletBuffer_ = application->CreateAndBindDeviceBuffer(&create_info);
+  }
+
+  if (!file_) {
+    containers::vector<uint8_t> vertex_data(allocator_);
+    const void* vertices = positions_;
+    if (convert_vertices_) {
+      vertex_data.resize(vertex_data_size_);
+      WriteVertexData(vertex_data.data());
+      vertices = vertex_data.data();
+    }
+    application->FillSmallBuffer(vertexBuffer_.get(), vertices,
+                                 vertex_data_size_, 0, cmdBuffer,
+                                 VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+
+    containers::vector<uint8_t> index_data(allocator_);
+    const void* indices = indices_;
+    if (convert_indices_) {
+      index_data.resize(index_data_size_);
+      WriteIndexData(index_data.data());
+      indices = index_data.data();
+    }
+    application->FillSmallBuffer(indexBuffer_.get(), indices,
+                                 index_data_size_, 0, cmdBuffer,
+                                 VK_ACCESS_INDEX_READ_BIT);
+
+    if (meshletBuffer_) {
+      application->FillSmallBuffer(meshletBuffer_.get(), meshlets_.data(),
+                                   meshlet_data_size, 0, cmdBuffer,
+                                   VK_ACCESS_SHADER_READ_BIT);
+    }
+    return;
+  }
+
+  // The vertex data is followed by the index data, and then the meshlets, in
+  // the staging buffer.
+  stagingBuffer_ = application->CreateAndBindDefaultExclusiveHostBuffer(
+      vertex_data_size_ + index_data_size_ + meshlet_data_size,
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+  uint8_t* staging = reinterpret_cast<uint8_t*>(stagingBuffer_->base_address());
+  WriteVertexData(staging);
+  WriteIndexData(staging + vertex_data_size_);
+  memcpy(staging + vertex_data_size_ + index_data_size_, meshlets_.data(),
+         meshlet_data_size);
+  stagingBuffer_->flush();
+
+  VkBufferCopy vertex_copy = {0, 0, vertex_data_size_};
+  (*cmdBuffer)->vkCmdCopyBuffer(*cmdBuffer, *stagingBuffer_, *vertexBuffer_, 1,
+                                &vertex_copy);
+  VkBufferCopy index_copy = {vertex_data_size_, 0, index_data_size_};
+  (*cmdBuffer)->vkCmdCopyBuffer(*cmdBuffer, *stagingBuffer_, *indexBuffer_, 1,
+                                &index_copy);
+
+  VkBufferMemoryBarrier barriers[3] = {
+      {
+          VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+          nullptr,                                  // pNext
+          VK_ACCESS_TRANSFER_WRITE_BIT,             // srcAccessMask
+          VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,      // dstAccessMask
+          VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
+          VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
+          *vertexBuffer_,                           // buffer
+          0,                                        // offset
+          VK_WHOLE_SIZE                             // size
+      },
+      {
+          VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+          nullptr,                                  // pNext
+          VK_ACCESS_TRANSFER_WRITE_BIT,             // srcAccessMask
+          VK_ACCESS_INDEX_READ_BIT,                 // dstAccessMask
+          VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
+          VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
+          *indexBuffer_,                            // buffer
+          0,                                        // offset
+          VK_WHOLE_SIZE                             // size
+      },
+      {}};
+  uint32_t num_barriers = 2;
+  VkPipelineStageFlags dst_stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+  if (meshletBuffer_) {
+    VkBufferCopy meshlet_copy = {vertex_data_size_ + index_data_size_, 0,
+                                 meshlet_data_size};
+    (*cmdBuffer)->vkCmdCopyBuffer(*cmdBuffer, *stagingBuffer_, *meshletBuffer_,
+                                  1, &meshlet_copy);
+    barriers[num_barriers++] = {
+        VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
+        nullptr,                                  // pNext
+        VK_ACCESS_TRANSFER_WRITE_BIT,             // srcAccessMask
+        VK_ACCESS_SHADER_READ_BIT,                // dstAccessMask
+        VK_QUEUE_FAMILY_IGNORED,                  // srcQueueFamilyIndex
+        VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
+        *meshletBuffer_,                          // buffer
+        0,                                        // offset
+        VK_WHOLE_SIZE                             // size
+    };
+    dst_stages |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+  }
+  (*cmdBuffer)->vkCmdPipelineBarrier(*cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                     dst_stages, 0, 0, nullptr, num_barriers,
+                                     barriers, 0, nullptr);
+}
+
+void VulkanModel::GetAssemblyInfo(
+    containers::vector<VkVertexInputBindingDescription>* input_bindings,
+    containers::vector<VkVertexInputAttributeDescription>*
+        vertex_attribute_descriptions) {
+  if (layout_.interleaved) {
+    input_bindings->push_back({
+        0,                                                      // binding
+        static_cast<uint32_t>(normals_offset_ + normal_size_),  // stride
+        VK_VERTEX_INPUT_RATE_VERTEX                             // inputRate
+    });
+  } else {
+    const size_t strides[3] = {position_size_, texture_coord_size_,
+                               normal_size_};
+    for (uint32_t binding = 0; binding < 3; ++binding) {
+      input_bindings->push_back({
+          binding,                                   // binding
+          static_cast<uint32_t>(strides[binding]),  // stride
+          VK_VERTEX_INPUT_RATE_VERTEX                // inputRate
+      });
+    }
+  }
+
+  const VkFormat position_format = layout_.quantized_positions
+                                      ? VK_FORMAT_R16G16B16A16_SNORM
+                                      : VK_FORMAT_R32G32B32_SFLOAT;
+  const VkFormat texture_coord_format = layout_.half_texture_coords
+                                           ? VK_FORMAT_R16G16_SFLOAT
+                                           : VK_FORMAT_R32G32_SFLOAT;
+  const VkFormat normal_format = layout_.octahedral_normals
+                                     ? VK_FORMAT_R16G16_SNORM
+                                     : VK_FORMAT_R32G32B32_SFLOAT;
+  const bool interleaved = layout_.interleaved;
+  vertex_attribute_descriptions->push_back({
+      0,                // location
+      0,                // binding
+      position_format,  // format
+      0,                // offset
+  });
+  vertex_attribute_descriptions->push_back({
+      1,                                                       // location
+      interleaved ? 0u : 1u,                                   // binding
+      texture_coord_format,                                    // format
+      interleaved ? static_cast<uint32_t>(position_size_) : 0  // offset
+  });
+  vertex_attribute_descriptions->push_back({
+      2,                                                       // location
+      interleaved ? 0u : 2u,                                   // binding
+      normal_format,                                           // format
+      interleaved ? static_cast<uint32_t>(normals_offset_) : 0  // offset
+  });
+}
+
+}  // namespace vulkan
@@ -19,6 +19,8 @@
 #include "support/containers/allocator.h"
 #include "support/containers/vector.h"
 #include "support/log/log.h"
+#include "support/mapped_file/mapped_file.h"
+#include "vulkan_helpers/model_file.h"
 #include "vulkan_helpers/vulkan_application.h"
 
 #include <initializer_list>
@@ -30,26 +32,123 @@ const size_t NORMAL_SIZE = sizeof(float) * 3;
 
 const size_t INDEX_SIZE = sizeof(uint32_t);
 
+// The limits of a single meshlet. These are the values that mesh shading
+// hardware is usually designed around, which also keeps the bounds tight.
+const size_t MESHLET_MAX_VERTICES = 64;
+const size_t MESHLET_MAX_TRIANGLES = 124;
+
+// A cluster of consecutive triangles of a VulkanModel, and its bounds, as
+// stored in VulkanModel::MeshletBuffer(). This matches the std430 layout of
+// the Meshlet struct in models/meshlet.glsl.
+struct Meshlet {
+  // The bounding sphere, in model space.
+  float center[3];
+  float radius;
+  // The normal cone: the normals of all triangles are within the cone around
+  // cone_axis. cone_cutoff is the sine of its half angle, or 1 if the
+  // triangles face in too many directions for the meshlet to ever be
+  // back-facing as a whole.
+  float cone_axis[3];
+  float cone_cutoff;
+  // The triangles, as a range of the index buffer.
+  uint32_t first_index;
+  uint32_t index_count;
+  uint32_t vertex_count;
+  uint32_t reserved;
+};
+static_assert(sizeof(Meshlet) == 48, "Meshlet must match the std430 layout");
+
+// Describes how a VulkanModel stores its vertices and indices on the GPU.
+// The default is three separate streams of 32-bit floats, and 32-bit
+// indices. Enabling everything halves the size of a vertex, from 32 to 16
+// bytes.
+struct VulkanModelLayout {
+  bool interleaved = false;
+  bool quantized_positions = false;
+  bool half_texture_coords = false;
+  bool octahedral_normals = false;
+  bool small_indices = false;
+  bool meshlets = false;
+
+  // Stores the position, texture coordinate and normal of each vertex next
+  // to each other, in a single binding, rather than in three bindings.
+  VulkanModelLayout& EnableInterleaved() {
+    interleaved = true;
+    return *this;
+  }
+  // Stores positions as VK_FORMAT_R16G16B16A16_SNORM, relative to the
+  // bounding box of the model. The vertex shader sees positions in [-1, 1],
+  // which must be scaled by PositionScale() and then offset by
+  // PositionOffset(), usually as part of the model matrix.
+  VulkanModelLayout& EnableQuantizedPositions() {
+    quantized_positions = true;
+    return *this;
+  }
+  // Stores texture coordinates as VK_FORMAT_R16G16_SFLOAT.
+  VulkanModelLayout& EnableHalfTextureCoords() {
+    half_texture_coords = true;
+    return *this;
+  }
+  // Stores normals octahedral-encoded as VK_FORMAT_R16G16_SNORM. Vertex
+  // shaders must define MODEL_OCTAHEDRAL_NORMALS before including
+  // models/model_setup.glsl, which then decodes them in get_normal().
+  VulkanModelLayout& EnableOctahedralNormals() {
+    octahedral_normals = true;
+    return *this;
+  }
+  // Uses 16-bit indices if the model has fewer than 65536 vertices.
+  VulkanModelLayout& EnableSmallIndices() {
+    small_indices = true;
+    return *this;
+  }
+  // Enables all of the above.
+  VulkanModelLayout& EnableCompact() {
+    return EnableInterleaved()
+        .EnableQuantizedPositions()
+        .EnableHalfTextureCoords()
+        .EnableOctahedralNormals()
+        .EnableSmallIndices();
+  }
+  // Splits the triangles into meshlets of at most MESHLET_MAX_VERTICES
+  // vertices and MESHLET_MAX_TRIANGLES triangles, in index buffer order, and
+  // uploads their bounds to MeshletBuffer(), so that they can be culled on
+  // the GPU. Models written by convert_obj_to_c --optimize are already in an
+  // order that keeps meshlets compact.
+  VulkanModelLayout& EnableMeshlets() {
+    meshlets = true;
+    return *this;
+  }
+};
+
 struct VulkanModel {
  public:
   // A standard VulkanModel object. It is expected to be used with the
   // output from convert_obj_to_c.py. That is, positions, texture_coords
-  // and normals are expected to be sequential in memory.
+  // and normals are expected to be sequential in memory. If |num_lods| is
+  // not 0, |lods| are the levels of detail within the indices, otherwise all
+  // indices are a single one.
   VulkanModel(containers::Allocator* allocator, logging::Logger* logger,
               size_t num_vertices, const float* positions,
               const float* texture_coords, const float* normals,
-              size_t num_indices, const uint32_t* indices)
-      : allocator_(allocator),
-        logger_(logger),
-        positions_(positions),
+              size_t num_indices, const uint32_t* indices,
+              const VulkanModelLayout& layout = VulkanModelLayout(),
+              size_t num_lods = 0, const ModelLod* lods = nullptr)
+      : positions_(positions),
         texture_coords_(texture_coords),
         normals_(normals),
         indices_(indices),
+        source_index_size_(INDEX_SIZE),
+        source_vertex_data_size_(num_vertices * (POSITION_SIZE +
+                                                 TEXCOORD_SIZE + NORMAL_SIZE)),
+        source_texture_coords_offset_(num_vertices * POSITION_SIZE),
+        source_normals_offset_(num_vertices *
+                               (POSITION_SIZE + TEXCOORD_SIZE)),
         num_vertices_(num_vertices),
         num_indices_(num_indices),
-        vertex_data_size_(num_vertices *
-                          (POSITION_SIZE + TEXCOORD_SIZE + NORMAL_SIZE)),
-        index_data_size_(num_indices * INDEX_SIZE) {
+        allocator_(allocator),
+        logger_(logger),
+        lods_(lods, lods + num_lods, allocator),
+        meshlets_(allocator) {
     // Make sure that vertices, indices and normals are contiguous in memory
     // this simplifies everything. The standard model format guarantees this.
     LOG_ASSERT(==, logger, texture_coords,
@@ -60,167 +159,271 @@ struct VulkanModel {
                reinterpret_cast<const float*>(
                    reinterpret_cast<const uint8_t*>(texture_coords) +
                    num_vertices * TEXCOORD_SIZE));
+    SetupLayout(layout);
   }
 
   // Constructs a vulkan model from the output of the convert_obj_to_c.py
-  // script.
+  // script, including its levels of detail if it was converted with --lods.
   template <typename T>
   VulkanModel(containers::Allocator* allocator, logging::Logger* logger,
-              const T& t)
-      : VulkanModel(allocator, logger, t.num_vertices, t.positions, t.uv,
-                    t.normals, t.num_indices, t.indices) {}
+              const T& t, const VulkanModelLayout& layout = VulkanModelLayout())
+      : VulkanModel(allocator, logger, t, layout,
+                    ModelLods(allocator, t, 0)) {}
+
+  // Constructs a vulkan model from a binary model file, as written by
+  // convert_obj_to_c --binary. The file is mapped into memory, and stays
+  // mapped until this model is destroyed.
+  VulkanModel(containers::Allocator* allocator, logging::Logger* logger,
+              const char* path,
+              const VulkanModelLayout& layout = VulkanModelLayout())
+      : VulkanModel(allocator, logger, mapped_file::OpenFile(allocator, path),
+                    layout) {}
 
   // Creates the vertex and index buffers. Adds transfer commands to
   // CmdBuffer to populate the vertex and index buffers with data.
   // If this model has already been initialized, then this re-initializes it.
-  // TODO(awoloszyn):
-  // Currently all uploads are done with vkCmdUpdateBuffer. If many large models
-  // are created, then switch to a staging + data buffer.
+  // Models loaded from a file are written straight from the mapped file to a
+  // staging buffer from the host-visible buffer Arena, which must stay alive
+  // until cmdBuffer has completed, and so is only released by ReleaseData.
+  // Other models are uploaded with vkCmdUpdateBuffer.
   void InitializeData(vulkan::VulkanApplication* application,
-                      vulkan::VkCommandBuffer* cmdBuffer) {
-    VkBufferCreateInfo create_info = {
-        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
-        nullptr,                               // pNext
-        0,                                     // flags
-        vertex_data_size_,                     // size
-        VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,  // usage
-        VK_SHARING_MODE_EXCLUSIVE,
-        0,
-        nullptr};
-    vertexBuffer_ = application->CreateAndBindDeviceBuffer(&create_info);
-    application->FillSmallBuffer(
-        vertexBuffer_.get(), static_cast<const void*>(positions_),
-        vertex_data_size_, 0, cmdBuffer, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
-
-    create_info.usage =
-        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
-    create_info.size = index_data_size_;
-
-    indexBuffer_ = application->CreateAndBindDeviceBuffer(&create_info);
-
-    application->FillSmallBuffer(
-        indexBuffer_.get(), static_cast<const void*>(indices_),
-        index_data_size_, 0, cmdBuffer, VK_ACCESS_INDEX_READ_BIT);
-  }
+                      vulkan::VkCommandBuffer* cmdBuffer);
 
   // Releases all resources held by this model.
   void ReleaseData() {
     vertexBuffer_.release();
     indexBuffer_.release();
+    meshletBuffer_.reset();
+    stagingBuffer_.reset();
   }
 
   struct InputStateAssemblyInfo {};
 
   // Adds the vertex assembly state to the given vectors
   // for this model to be used in a pipeline.
-  // The attributes for the vertices are bound to sequential binding numbers:
+  // The attributes for the vertices are bound to sequential locations:
   //    layout(location = 0) in vec3 positions_;
   //    layout(location = 1) in vec2 texture_coords_;
   //    layout(location = 2) in vec3 normals_;
+  // Each is in its own binding, 0, 1 and 2, unless the layout is
+  // interleaved, in which case all are in binding 0. With octahedral
+  // normals the normals are a vec2, see models/model_setup.glsl.
   void GetAssemblyInfo(
       containers::vector<VkVertexInputBindingDescription>* input_bindings,
       containers::vector<VkVertexInputAttributeDescription>*
-          vertex_attribute_descriptions) {
-    input_bindings->push_back({
-        0,                           // binding
-        POSITION_SIZE,               // stride
-        VK_VERTEX_INPUT_RATE_VERTEX  // inputRate
-    });
-    input_bindings->push_back({
-        1,                           // binding
-        TEXCOORD_SIZE,               // stride
-        VK_VERTEX_INPUT_RATE_VERTEX  // inputRate
-    });
-    input_bindings->push_back({
-        2,                           // binding
-        NORMAL_SIZE,                 // stride
-        VK_VERTEX_INPUT_RATE_VERTEX  // inputRate
-    });
-
-    vertex_attribute_descriptions->push_back({
-        0,                           // location
-        0,                           // binding
-        VK_FORMAT_R32G32B32_SFLOAT,  // format
-        0,                           // offset
-    });
-    vertex_attribute_descriptions->push_back({
-        1,                        // location
-        1,                        // binding
-        VK_FORMAT_R32G32_SFLOAT,  // format
-        0,                        // offset
-    });
-    vertex_attribute_descriptions->push_back({
-        2,                           // location
-        2,                           // binding
-        VK_FORMAT_R32G32B32_SFLOAT,  // format
-        0,                           // offset
-    });
-  }
+          vertex_attribute_descriptions);
 
   // Inserts the commands required to draw this model into the given
   // command-buffer. This binds the vertex and index buffers, and issues
   // the draw call.
-  void Draw(vulkan::VkCommandBuffer* cmdBuffer) {
-    ::VkBuffer buffers[3] = {*vertexBuffer_, *vertexBuffer_, *vertexBuffer_};
-    ::VkDeviceSize offsets[3] = {
-        0, num_vertices_ * POSITION_SIZE,
-        num_vertices_ * (POSITION_SIZE + TEXCOORD_SIZE)};
-    (*cmdBuffer)->vkCmdBindVertexBuffers(*cmdBuffer, 0, 3, buffers, offsets);
-    (*cmdBuffer)
-        ->vkCmdBindIndexBuffer(*cmdBuffer, *indexBuffer_, 0,
-                               VK_INDEX_TYPE_UINT32);
-    (*cmdBuffer)
-        ->vkCmdDrawIndexed(*cmdBuffer, static_cast<uint32_t>(num_indices_), 1,
-                           0, 0, 0);
-  }
+  void Draw(vulkan::VkCommandBuffer* cmdBuffer) { DrawLod(cmdBuffer, 0, 1); }
 
   // Draws an instanced version of this model.
   void DrawInstanced(vulkan::VkCommandBuffer* cmdBuffer,
                      uint32_t instance_count) {
-    ::VkBuffer buffers[3] = {*vertexBuffer_, *vertexBuffer_, *vertexBuffer_};
-    ::VkDeviceSize offsets[3] = {
-        0, num_vertices_ * POSITION_SIZE,
-        num_vertices_ * (POSITION_SIZE + TEXCOORD_SIZE)};
-    (*cmdBuffer)->vkCmdBindVertexBuffers(*cmdBuffer, 0, 3, buffers, offsets);
-    (*cmdBuffer)
-        ->vkCmdBindIndexBuffer(*cmdBuffer, *indexBuffer_, 0,
-                               VK_INDEX_TYPE_UINT32);
-    (*cmdBuffer)
-        ->vkCmdDrawIndexed(*cmdBuffer, static_cast<uint32_t>(num_indices_),
-                           instance_count, 0, 0, 0);
+    DrawLod(cmdBuffer, 0, instance_count);
+  }
+
+  // Draws |instance_count| instances of level of detail |lod|.
+  void DrawLod(vulkan::VkCommandBuffer* cmdBuffer, size_t lod,
+               uint32_t instance_count) {
+    BindVertexAndIndexBuffers(cmdBuffer);
+    (*cmdBuffer)->vkCmdDrawIndexed(*cmdBuffer, lods_[lod].index_count,
+                                   instance_count, lods_[lod].first_index, 0,
+                                   0);
+  }
+
+  // Returns the coarsest level of detail whose error is at most
+  // |max_pixel_error| pixels on screen, when the model is |distance| away
+  // from the camera. |pixels_per_unit| is the size in pixels of one model
+  // unit at a distance of 1, which is the viewport height divided by
+  // 2 * tan(fov_y / 2) for a perspective projection, times the scale of the
+  // model matrix.
+  size_t SelectLod(float distance, float pixels_per_unit,
+                   float max_pixel_error = 1.0f) const;
+
+  // Draws the meshlets that a culling pass wrote to |draw_buffer| as
+  // VkDrawIndexedIndirectCommands, with their number in |count_buffer|.
+  // There can be up to NumMeshlets() commands. This needs
+  // VK_KHR_draw_indirect_count.
+  void DrawMeshletsIndirectCount(vulkan::VkCommandBuffer* cmdBuffer,
+                                 ::VkBuffer draw_buffer,
+                                 ::VkBuffer count_buffer) {
+    BindVertexAndIndexBuffers(cmdBuffer);
+    (*cmdBuffer)->vkCmdDrawIndexedIndirectCountKHR(
+        *cmdBuffer, draw_buffer, 0, count_buffer, 0,
+        static_cast<uint32_t>(meshlets_.size()),
+        static_cast<uint32_t>(sizeof(VkDrawIndexedIndirectCommand)));
   }
 
   void BindVertexAndIndexBuffers(vulkan::VkCommandBuffer* cmdBuffer) {
     ::VkBuffer buffers[3] = {*vertexBuffer_, *vertexBuffer_, *vertexBuffer_};
-    ::VkDeviceSize offsets[3] = {
-        0, num_vertices_ * POSITION_SIZE,
-        num_vertices_ * (POSITION_SIZE + TEXCOORD_SIZE)};
-    (*cmdBuffer)->vkCmdBindVertexBuffers(*cmdBuffer, 0, 3, buffers, offsets);
+    ::VkDeviceSize offsets[3] = {0, texture_coords_offset_, normals_offset_};
+    (*cmdBuffer)->vkCmdBindVertexBuffers(
+        *cmdBuffer, 0, layout_.interleaved ? 1 : 3, buffers, offsets);
     (*cmdBuffer)
-        ->vkCmdBindIndexBuffer(*cmdBuffer, *indexBuffer_, 0,
-                               VK_INDEX_TYPE_UINT32);
+        ->vkCmdBindIndexBuffer(*cmdBuffer, *indexBuffer_, 0, index_type_);
   }
 
-  size_t NumIndices() const { return num_indices_; }
+  // The number of indices of the full model, that Draw() draws.
+  size_t NumIndices() const { return lods_[0].index_count; }
   size_t NumVertices() const { return num_vertices_; }
   ::VkBuffer VertexBuffer() const { return *vertexBuffer_; }
   ::VkBuffer IndexBuffer() const { return *indexBuffer_; }
+  VkIndexType IndexType() const { return index_type_; }
+  const VulkanModelLayout& Layout() const { return layout_; }
+  // With quantized positions, the model space position of a vertex is
+  // position * PositionScale() + PositionOffset(). Otherwise these are
+  // (1, 1, 1) and (0, 0, 0).
+  const float* PositionScale() const { return position_scale_; }
+  const float* PositionOffset() const { return position_offset_; }
+  // The levels of detail, from the full model to the coarsest one. Each is
+  // a range of the index buffer. There is always at least one.
+  size_t NumLods() const { return lods_.size(); }
+  const ModelLod& Lod(size_t lod) const { return lods_[lod]; }
+  // The meshlets of the full model, if the layout enables them. Their bounds
+  // are in model space, before any quantization of the positions.
+  const containers::vector<Meshlet>& Meshlets() const { return meshlets_; }
+  size_t NumMeshlets() const { return meshlets_.size(); }
+  // A storage buffer holding Meshlets(), for culling on the GPU.
+  ::VkBuffer MeshletBuffer() const { return *meshletBuffer_; }
 
  private:
+  template <typename T>
+  VulkanModel(containers::Allocator* allocator, logging::Logger* logger,
+              const T& t, const VulkanModelLayout& layout,
+              const containers::vector<ModelLod>& lods)
+      : VulkanModel(allocator, logger, t.num_vertices, t.positions, t.uv,
+                    t.normals, t.num_indices, t.indices, layout, lods.size(),
+                    lods.data()) {}
+
+  // Returns the levels of detail of a model converted with --lods.
+  template <typename T>
+  static auto ModelLods(containers::Allocator* allocator, const T& t, int)
+      -> decltype(t.lods[0].error, containers::vector<ModelLod>(allocator)) {
+    containers::vector<ModelLod> lods(allocator);
+    for (size_t i = 0; i < t.num_lods; ++i) {
+      lods.push_back(
+          {t.lods[i].first_index, t.lods[i].index_count, t.lods[i].error, 0});
+    }
+    return lods;
+  }
+
+  // Other models are a single level of detail, which SetupLayout adds.
+  template <typename T>
+  static containers::vector<ModelLod> ModelLods(
+      containers::Allocator* allocator, const T&, ...) {
+    return containers::vector<ModelLod>(allocator);
+  }
+
+  VulkanModel(containers::Allocator* allocator, logging::Logger* logger,
+              containers::unique_ptr<mapped_file::MappedFile> file,
+              const VulkanModelLayout& layout)
+      : VulkanModel(allocator, logger, file.get(), ModelHeader(logger, file),
+                    layout) {
+    file_ = std::move(file);
+  }
+
+  VulkanModel(containers::Allocator* allocator, logging::Logger* logger,
+              const mapped_file::MappedFile* file,
+              const ModelFileHeader& header, const VulkanModelLayout& layout)
+      : positions_(reinterpret_cast<const float*>(file->data() +
+                                                  header.positions_offset)),
+        texture_coords_(reinterpret_cast<const float*>(
+            file->data() + header.texture_coords_offset)),
+        normals_(reinterpret_cast<const float*>(file->data() +
+                                                header.normals_offset)),
+        indices_(file->data() + header.indices_offset),
+        source_index_size_(header.index_size),
+        source_vertex_data_size_(static_cast<size_t>(
+            header.normals_offset + header.num_vertices * NORMAL_SIZE -
+            header.positions_offset)),
+        source_texture_coords_offset_(header.texture_coords_offset -
+                                      header.positions_offset),
+        source_normals_offset_(header.normals_offset -
+                               header.positions_offset),
+        num_vertices_(static_cast<size_t>(header.num_vertices)),
+        num_indices_(static_cast<size_t>(header.num_indices)),
+        allocator_(allocator),
+        logger_(logger),
+        lods_(reinterpret_cast<const ModelLod*>(file->data() +
+                                                header.lods_offset),
+              reinterpret_cast<const ModelLod*>(file->data() +
+                                                header.lods_offset) +
+                  header.num_lods,
+              allocator),
+        meshlets_(allocator) {
+    SetupLayout(layout);
+  }
+
+  // Returns the header of |file|, after checking that |file| is a valid
+  // model file.
+  static const ModelFileHeader& ModelHeader(
+      logging::Logger* logger,
+      const containers::unique_ptr<mapped_file::MappedFile>& file) {
+    LOG_ASSERT(!=, logger, file.get(),
+               static_cast<mapped_file::MappedFile*>(nullptr));
+    const ModelFileHeader& header =
+        *reinterpret_cast<const ModelFileHeader*>(file->data());
+    LOG_ASSERT(==, logger, true, IsValidModelFile(header, file->size()));
+    return header;
+  }
+
+  // Works out the sizes and offsets of the vertex and index data on the GPU
+  // for |layout|, and the bounding box for quantized positions. Checks the
+  // levels of detail.
+  void SetupLayout(const VulkanModelLayout& layout);
+  // Writes the vertex data, in the layout of the GPU, to |data|.
+  void WriteVertexData(uint8_t* data) const;
+  // Writes the index data, in the layout of the GPU, to |data|.
+  void WriteIndexData(uint8_t* data) const;
+  // Returns index |i| of the source data.
+  uint32_t SourceIndex(size_t i) const;
+  // Splits the source triangles into meshlets_.
+  void BuildMeshlets();
+  // Returns a meshlet with the bounds of the triangles in |indices|, which
+  // use |vertices|. Its first_index is left 0.
+  Meshlet MeshletBounds(const containers::vector<uint32_t>& vertices,
+                        const containers::vector<uint32_t>& indices) const;
+
+  // The source data, either compiled in, or in file_. The vertex data starts
+  // at positions_, and is source_vertex_data_size_ bytes long.
   const float* positions_;
   const float* texture_coords_;
   const float* normals_;
-  const uint32_t* indices_;
+  const void* indices_;
+  size_t source_index_size_;
+  size_t source_vertex_data_size_;
+  ::VkDeviceSize source_texture_coords_offset_;
+  ::VkDeviceSize source_normals_offset_;
   size_t num_vertices_;
   size_t num_indices_;
   containers::Allocator* allocator_;
   logging::Logger* logger_;
-  const size_t vertex_data_size_;
-  const size_t index_data_size_;
 
+  // The data on the GPU. If neither the vertices nor the indices have to be
+  // converted, it is a copy of the source data.
+  VulkanModelLayout layout_;
+  bool convert_vertices_;
+  bool convert_indices_;
+  size_t position_size_;
+  size_t texture_coord_size_;
+  size_t normal_size_;
+  ::VkDeviceSize texture_coords_offset_;
+  ::VkDeviceSize normals_offset_;
+  VkIndexType index_type_;
+  size_t vertex_data_size_;
+  size_t index_data_size_;
+  float position_scale_[3];
+  float position_offset_[3];
+  containers::vector<ModelLod> lods_;
+  containers::vector<Meshlet> meshlets_;
+
+  containers::unique_ptr<mapped_file::MappedFile> file_;
   containers::unique_ptr<vulkan::VulkanApplication::Buffer> vertexBuffer_;
   containers::unique_ptr<vulkan::VulkanApplication::Buffer> indexBuffer_;
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> meshletBuffer_;
+  containers::unique_ptr<vulkan::VulkanApplication::Buffer> stagingBuffer_;
 };
 
 }  // namespace vulkan
@@ -16,15 +16,17 @@
 #ifndef VULKAN_HELPERS_VULKAN_TEXTURE_H_
 #define VULKAN_HELPERS_VULKAN_TEXTURE_H_
 
+#include <algorithm>
 #include <initializer_list>
 
 #include "support/containers/allocator.h"
 #include "support/containers/vector.h"
 #include "support/log/log.h"
+#include "vulkan_helpers/bindless_heap.h"
+#include "vulkan_helpers/texture_compression.h"
 #include "vulkan_helpers/vulkan_application.h"
 
 namespace vulkan {
-// TODO(awoloszyn): Handle MIP chains.
 // TODO(awoloszyn): Handle Arrays.
 // TODO(awoloszyn): Handle cube-maps.
 struct VulkanTexture {
@@ -34,11 +36,15 @@ struct VulkanTexture {
   // and normals are expected to be sequential in memory. If a non-zero
   // |sparse_binding_block_size| is given, the texture image will be sparsely
   // bound with the given block size aligned to the image's memory alignment.
+  // |data| holds |data_mip_levels| tightly packed mip levels, from the
+  // largest to the smallest. If it only holds the first, the rest of the mip
+  // chain is generated on the GPU when the format allows it.
   VulkanTexture(containers::Allocator* allocator, logging::Logger* logger,
                 VkFormat format, size_t width, size_t height, const void* data,
                 size_t data_size, size_t sparse_binding_block_size = 0u,
                 size_t multiplanar_plane_count = 0u,
-                size_t downsampled_width = 0u, size_t downsampled_height = 0u)
+                size_t downsampled_width = 0u, size_t downsampled_height = 0u,
+                size_t data_mip_levels = 1u)
       : allocator_(allocator),
         logger_(logger),
         format_(format),
@@ -46,14 +52,17 @@ struct VulkanTexture {
         height_(height),
         data_(data),
         data_size_(data_size),
+        decompressed_data_(allocator),
         sparse_binding_block_size_(sparse_binding_block_size),
         multiplanar_plane_count_(multiplanar_plane_count),
         downsampled_width_(downsampled_width),
         downsampled_height_(downsampled_height),
+        data_mip_levels_(data_mip_levels),
+        mip_levels_(1),
         image_(nullptr) {}
 
   // Constructs a vulkan model from the output of the convert_img_to_c.py
-  // script.
+  // script, including the mip levels it wrote with --mipmaps.
   template <typename T>
   VulkanTexture(containers::Allocator* allocator, logging::Logger* logger,
                 const T& t, size_t sparse_binding_block_size = 0u,
@@ -62,7 +71,8 @@ struct VulkanTexture {
       : VulkanTexture(allocator, logger, t.format, t.width, t.height,
                       static_cast<const void*>(t.data), sizeof(t.data),
                       sparse_binding_block_size, multiplanar_plane_count,
-                      downsampled_width, downsampled_height) {}
+                      downsampled_width, downsampled_height,
+                      DataMipLevels(t, 0)) {}
 
   // Creates the image object.
   // Also creates a temporary buffer object for the upload data
@@ -71,22 +81,78 @@ struct VulkanTexture {
   // be safely deleted once the given command buffer has executed.
   // The image is transitioned into "VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL"
   // during the upload operation.
+  // The image gets a full mip chain unless it is sparse or multiplanar. The
+  // levels in the data are uploaded with a single copy, and the remaining
+  // ones are blitted from the previous level, if the format supports linear
+  // filtering of blits. Otherwise only the levels in the data are used.
   void InitializeData(vulkan::VulkanApplication* application,
                       vulkan::VkCommandBuffer* cmdBuffer,
                       VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT,
                       VkImageCreateFlags flags = 0, void* pNext = nullptr) {
+    if (CompressedBlockSize(format_) != 0 &&
+        !CanSampleFormat(application, format_)) {
+      Decompress();
+    }
+
+    const bool single_plane =
+        !IsFormatMultiplanar(format_) && multiplanar_plane_count_ <= 1;
+    mip_levels_ = 1;
+    if (sparse_binding_block_size_ == 0u && single_plane) {
+      mip_levels_ = static_cast<uint32_t>(data_mip_levels_);
+      if (CanBlitMipLevels(application)) {
+        mip_levels_ = FullMipChainLength();
+      }
+    }
+    LOG_ASSERT(<=, logger_, mip_levels_, FullMipChainLength());
+    const uint32_t uploaded_levels =
+        std::min(mip_levels_, static_cast<uint32_t>(data_mip_levels_));
+    if (mip_levels_ > uploaded_levels) {
+      usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
+
+    // In the upload buffer each level starts at a multiple of 4 bytes, as
+    // vkCmdCopyBufferToImage requires, and they are all copied at once.
+    // Compressed levels are whole blocks, so they also start on a block.
+    containers::vector<VkBufferImageCopy> level_copies(allocator_);
+    containers::vector<size_t> level_sizes(allocator_);
+    size_t upload_size = data_size_;
+    if (single_plane) {
+      upload_size = 0;
+      for (uint32_t level = 0; level < uploaded_levels; ++level) {
+        level_copies.push_back({
+            upload_size,                               // bufferOffset
+            0,                                         // bufferRowLength
+            0,                                         // bufferImageHeight
+            {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1},  // imageSubresource
+            {0, 0, 0},                                 // offset
+            {MipWidth(level), MipHeight(level), 1}     // extent
+        });
+        level_sizes.push_back(DataLevelSize(level));
+        upload_size = (upload_size + level_sizes.back() + 3) & ~size_t(3);
+      }
+    }
+
     VkBufferCreateInfo create_info = {
         VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
         nullptr,                               // pNext
         0,                                     // flags
-        data_size_,                            // size
+        upload_size,                           // size
         VK_BUFFER_USAGE_TRANSFER_SRC_BIT,      // usage
         VK_SHARING_MODE_EXCLUSIVE,
         0,
         nullptr};
     upload_buffer_ = application->CreateAndBindHostBuffer(&create_info);
-    void* copy_base = upload_buffer_->base_address();
-    memcpy(copy_base, data_, data_size_);
+    char* copy_base = upload_buffer_->base_address();
+    if (level_copies.empty()) {
+      memcpy(copy_base, data_, data_size_);
+    } else {
+      const char* level_data = static_cast<const char*>(data_);
+      for (size_t i = 0; i < level_copies.size(); ++i) {
+        memcpy(copy_base + level_copies[i].bufferOffset, level_data,
+               level_sizes[i]);
+        level_data += level_sizes[i];
+      }
+    }
     upload_buffer_->flush();
 
     VkImageCreateInfo image_create_info = {
@@ -97,7 +163,7 @@ struct VulkanTexture {
         format_,                              // format
         {static_cast<uint32_t>(width_), static_cast<uint32_t>(height_),
          1},                                      // Extent
-        1,                                        // mipLevels
+        mip_levels_,                              // mipLevels
         1,                                        // arrayLayers
         VK_SAMPLE_COUNT_1_BIT,                    // sampleCount
         VK_IMAGE_TILING_OPTIMAL,                  // tiling
@@ -159,7 +225,7 @@ struct VulkanTexture {
         format_,                                   // format
         {VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B,
          VK_COMPONENT_SWIZZLE_A},
-        {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
+        {VK_IMAGE_ASPECT_COLOR_BIT, 0, mip_levels_, 0, 1}};
 
     ::VkImageView raw_view;
     LOG_ASSERT(
@@ -169,6 +235,8 @@ struct VulkanTexture {
     image_view_ = containers::make_unique<vulkan::VkImageView>(
         allocator_,
         vulkan::VkImageView(raw_view, nullptr, &application->device()));
+    // The old view is gone, so its index in the bindless heap is too.
+    bindless_index_.Reset();
 
     VkImageMemoryBarrier barrier = {
         VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
@@ -180,7 +248,7 @@ struct VulkanTexture {
         VK_QUEUE_FAMILY_IGNORED,                 // srcQueueFamilyIndex
         VK_QUEUE_FAMILY_IGNORED,                 // dstQueueFamilyIndex
         image(),                                 // image
-        {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
+        {VK_IMAGE_ASPECT_COLOR_BIT, 0, mip_levels_, 0, 1}};
     VkBufferMemoryBarrier buffer_barrier = {
         VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // sType
         nullptr,                                  // pNext
@@ -190,7 +258,7 @@ struct VulkanTexture {
         VK_QUEUE_FAMILY_IGNORED,                  // dstQueueFamilyIndex
         *upload_buffer_,                          // buffer
         0,                                        // offset
-        data_size_,                               // size
+        upload_size,                              // size
     };
 
     (*cmdBuffer)
@@ -236,29 +304,85 @@ struct VulkanTexture {
               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
               static_cast<uint32_t>(multiplanar_plane_count_), copy_params);
     } else {
-      VkBufferImageCopy copy_params = {
-          0,                                     // bufferOffset
-          0,                                     // bufferRowLength
-          0,                                     // bufferImageHeight
-          {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},  // imageSubresource
-          {0, 0, 0},                             // offset
-          {static_cast<uint32_t>(width_), static_cast<uint32_t>(height_),
-           1}  // extent
-      };
+      (*cmdBuffer)
+          ->vkCmdCopyBufferToImage(
+              *cmdBuffer, *upload_buffer_, image(),
+              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+              static_cast<uint32_t>(level_copies.size()), level_copies.data());
+    }
 
+    // Each generated level is blitted from the one before it, which is moved
+    // to VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL first.
+    barrier.subresourceRange.levelCount = 1;
+    for (uint32_t level = uploaded_levels; level < mip_levels_; ++level) {
+      barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+      barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+      barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+      barrier.subresourceRange.baseMipLevel = level - 1;
+      (*cmdBuffer)
+          ->vkCmdPipelineBarrier(*cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                                 nullptr, 0, nullptr, 1, &barrier);
+
+      VkImageBlit blit = {
+          {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1},  // srcSubresource
+          {{0, 0, 0},
+           {static_cast<int32_t>(MipWidth(level - 1)),
+            static_cast<int32_t>(MipHeight(level - 1)), 1}},  // srcOffsets
+          {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1},  // dstSubresource
+          {{0, 0, 0},
+           {static_cast<int32_t>(MipWidth(level)),
+            static_cast<int32_t>(MipHeight(level)), 1}}  // dstOffsets
+      };
       (*cmdBuffer)
-          ->vkCmdCopyBufferToImage(*cmdBuffer, *upload_buffer_, image(),
-                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
-                                   &copy_params);
+          ->vkCmdBlitImage(*cmdBuffer, image(),
+                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image(),
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit,
+                           VK_FILTER_LINEAR);
+    }
+
+    // The uploaded levels that no blit read from, all the blit sources, and
+    // then the remaining levels, are made ready for sampling.
+    VkImageMemoryBarrier final_barriers[3] = {barrier, barrier, barrier};
+    uint32_t num_final_barriers = 0;
+    const uint32_t num_blit_sources = mip_levels_ - uploaded_levels;
+    if (num_blit_sources > 0 && uploaded_levels > 1) {
+      VkImageMemoryBarrier& uploaded_barrier =
+          final_barriers[num_final_barriers++];
+      uploaded_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      uploaded_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+      uploaded_barrier.subresourceRange.baseMipLevel = 0;
+      uploaded_barrier.subresourceRange.levelCount = uploaded_levels - 1;
+    }
+    if (num_blit_sources > 0) {
+      VkImageMemoryBarrier& source_barrier =
+          final_barriers[num_final_barriers++];
+      source_barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+      source_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+      source_barrier.subresourceRange.baseMipLevel = uploaded_levels - 1;
+      source_barrier.subresourceRange.levelCount = num_blit_sources;
+    }
+    VkImageMemoryBarrier& destination_barrier =
+        final_barriers[num_final_barriers++];
+    destination_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    destination_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    if (num_blit_sources > 0) {
+      destination_barrier.subresourceRange.baseMipLevel = mip_levels_ - 1;
+      destination_barrier.subresourceRange.levelCount = 1;
+    } else {
+      destination_barrier.subresourceRange.baseMipLevel = 0;
+      destination_barrier.subresourceRange.levelCount = mip_levels_;
+    }
+    for (uint32_t i = 0; i < num_final_barriers; ++i) {
+      final_barriers[i].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+      final_barriers[i].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
     }
-    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
     (*cmdBuffer)
         ->vkCmdPipelineBarrier(*cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
                                VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT, 0, 0,
-                               nullptr, 0, nullptr, 1, &barrier);
+                               nullptr, 0, nullptr, num_final_barriers,
+                               final_barriers);
   }
 
   // When the initialiation is complete, call this method, and the temporary
@@ -269,6 +393,22 @@ struct VulkanTexture {
     return image_ != nullptr ? ::VkImage(*image_) : ::VkImage(*sparse_image_);
   }
   ::VkImageView view() const { return *image_view_; }
+  // The number of mip levels of the image, valid after InitializeData.
+  uint32_t mip_levels() const { return mip_levels_; }
+
+  // Returns the index of the view of this texture in the sampled image
+  // array of |application|'s BindlessHeap, adding it the first time. The
+  // index is freed when this texture is destroyed.
+  uint32_t GetBindlessIndex(vulkan::VulkanApplication* application) {
+    if (!bindless_index_.is_valid()) {
+      BindlessHeap* heap = application->bindless_heap();
+      LOG_ASSERT(==, logger_, true, heap != nullptr);
+      bindless_index_ =
+          BindlessIndex(heap, BindlessHeap::kSampledImageBinding,
+                        heap->AddSampledImage(view()));
+    }
+    return bindless_index_.index();
+  }
 
   // Return true if format is multiplanar
   bool IsFormatMultiplanar(VkFormat format) {
@@ -315,22 +455,122 @@ struct VulkanTexture {
   }
 
  private:
+  // The mip_levels written by convert_img_to_c.py --mipmaps, or 1.
+  template <typename T>
+  static auto DataMipLevels(const T& t, int) -> decltype(size_t(t.mip_levels)) {
+    return t.mip_levels;
+  }
+  template <typename T>
+  static size_t DataMipLevels(const T&, ...) {
+    return 1u;
+  }
+
+  uint32_t MipWidth(uint32_t level) const {
+    return std::max(static_cast<uint32_t>(width_) >> level, 1u);
+  }
+  uint32_t MipHeight(uint32_t level) const {
+    return std::max(static_cast<uint32_t>(height_) >> level, 1u);
+  }
+
+  // Returns the size in bytes of |level| in the data. The levels are tightly
+  // packed, so for uncompressed formats the size of a texel follows from
+  // their total number of texels.
+  size_t DataLevelSize(uint32_t level) const {
+    if (CompressedBlockSize(format_) != 0) {
+      return CompressedImageSize(format_, MipWidth(level), MipHeight(level));
+    }
+    size_t num_texels = 0;
+    for (uint32_t i = 0; i < data_mip_levels_; ++i) {
+      num_texels += MipWidth(i) * MipHeight(i);
+    }
+    LOG_ASSERT(==, logger_, 0, data_size_ % num_texels);
+    return MipWidth(level) * MipHeight(level) * (data_size_ / num_texels);
+  }
+
+  // Replaces the block compressed data with its decoding, for devices that
+  // cannot sample format_.
+  void Decompress() {
+    const VkFormat format = DecompressedFormat(format_);
+    const size_t texel_size = format == VK_FORMAT_R8_UNORM ? 1 : 4;
+    size_t decompressed_size = 0;
+    for (uint32_t level = 0; level < data_mip_levels_; ++level) {
+      decompressed_size += MipWidth(level) * MipHeight(level) * texel_size;
+    }
+    decompressed_data_.resize(decompressed_size);
+
+    const uint8_t* blocks = static_cast<const uint8_t*>(data_);
+    uint8_t* texels = decompressed_data_.data();
+    for (uint32_t level = 0; level < data_mip_levels_; ++level) {
+      LOG_ASSERT(==, logger_, true,
+                 DecompressImage(format_, MipWidth(level), MipHeight(level),
+                                 blocks, texels));
+      blocks += DataLevelSize(level);
+      texels += MipWidth(level) * MipHeight(level) * texel_size;
+    }
+    logger_->LogInfo("Decompressed a texture that the device cannot sample");
+    format_ = format;
+    data_ = decompressed_data_.data();
+    data_size_ = decompressed_size;
+  }
+
+  // Returns true if images of |format| with optimal tiling can be sampled
+  // with linear filtering.
+  static bool CanSampleFormat(vulkan::VulkanApplication* application,
+                              VkFormat format) {
+    return HasOptimalTilingFeatures(
+        application, format,
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+            VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+  }
+
+  static bool HasOptimalTilingFeatures(vulkan::VulkanApplication* application,
+                                       VkFormat format,
+                                       VkFormatFeatureFlags required) {
+    VkFormatProperties properties = {};
+    application->instance()->vkGetPhysicalDeviceFormatProperties(
+        application->device().physical_device(), format, &properties);
+    return (properties.optimalTilingFeatures & required) == required;
+  }
+
+  // The number of levels down to 1x1.
+  uint32_t FullMipChainLength() const {
+    uint32_t levels = 1;
+    while (MipWidth(levels - 1) > 1 || MipHeight(levels - 1) > 1) {
+      ++levels;
+    }
+    return levels;
+  }
+
+  // Returns true if mip levels of format_ can be generated with linearly
+  // filtered blits.
+  bool CanBlitMipLevels(vulkan::VulkanApplication* application) const {
+    return HasOptimalTilingFeatures(
+        application, format_,
+        VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+            VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+  }
+
   VkFormat format_;
   size_t width_;
   size_t height_;
   const void* data_;
-  const size_t data_size_;
+  size_t data_size_;
+  // The decoding of compressed data, if the device cannot sample it.
+  containers::vector<uint8_t> decompressed_data_;
   containers::Allocator* allocator_;
   logging::Logger* logger_;
   size_t sparse_binding_block_size_;
   size_t multiplanar_plane_count_;
   size_t downsampled_width_;
   size_t downsampled_height_;
+  size_t data_mip_levels_;
+  uint32_t mip_levels_;
 
   containers::unique_ptr<vulkan::VulkanApplication::Buffer> upload_buffer_;
   containers::unique_ptr<vulkan::VulkanApplication::Image> image_;
   containers::unique_ptr<vulkan::VulkanApplication::SparseImage> sparse_image_;
   containers::unique_ptr<vulkan::VkImageView> image_view_;
+  BindlessIndex bindless_index_;
 };
 
 }  // namespace vulkan
@@ -0,0 +1,264 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vulkan_wrapper/call_tracer.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+#include <mutex>
+
+namespace vulkan {
+namespace {
+// Times per frame are kept in histograms with four buckets per power of two,
+// so percentiles are off by at most 12.5%. Times of less than 4 ticks have a
+// bucket each, and anything longer than 2^40 ticks ends up in the last one.
+const uint32_t kHistogramBuckets = 160;
+
+uint32_t HistogramBucket(uint64_t ticks) {
+  if (ticks < 4) {
+    return static_cast<uint32_t>(ticks);
+  }
+  uint32_t octave = 2;
+  while (octave < 63 && (ticks >> (octave + 1)) != 0) {
+    ++octave;
+  }
+  const uint32_t bucket = 4 + (octave - 2) * 4 +
+                          static_cast<uint32_t>((ticks >> (octave - 2)) & 3);
+  return std::min(bucket, kHistogramBuckets - 1);
+}
+
+// Returns the middle of the range of ticks that fall into |bucket|.
+double HistogramBucketTicks(uint32_t bucket) {
+  if (bucket < 4) {
+    return static_cast<double>(bucket);
+  }
+  const uint32_t octave = bucket / 4 + 1;
+  const uint64_t lower = static_cast<uint64_t>(4 + bucket % 4) << (octave - 2);
+  const uint64_t upper = static_cast<uint64_t>(5 + bucket % 4) << (octave - 2);
+  return (static_cast<double>(lower) + static_cast<double>(upper)) / 2.0;
+}
+
+// Returns the ticks that |percentile| percent of the |frames| frames in
+// |histogram| do not exceed. Frames missing from the histogram took no time.
+// As buckets are wide, the result is limited to the longest frame,
+// |max_ticks|.
+double HistogramPercentile(const uint32_t* histogram, uint64_t frames,
+                           uint64_t max_ticks, double percentile) {
+  const double max = static_cast<double>(max_ticks);
+  uint64_t counted = 0;
+  for (uint32_t i = 0; i < kHistogramBuckets; ++i) {
+    counted += histogram[i];
+  }
+  uint64_t frames_below = frames - counted;
+  for (uint32_t i = 0; i < kHistogramBuckets; ++i) {
+    frames_below += histogram[i];
+    if (static_cast<double>(frames_below) >=
+        percentile / 100.0 * static_cast<double>(frames)) {
+      return std::min(HistogramBucketTicks(i), max);
+    }
+  }
+  return max;
+}
+
+struct Entry {
+  const char* name;
+  std::atomic<uint64_t> calls;
+  std::atomic<uint64_t> ticks;
+  // The rest is only used by EndFrame() and LogReport().
+  // The counts when the first frame started.
+  uint64_t first_calls;
+  uint64_t first_ticks;
+  // The counts when the current frame started.
+  uint64_t frame_calls;
+  uint64_t frame_ticks;
+  uint64_t max_frame_ticks;
+  // The number of frames that spent a given time in the entry point.
+  uint32_t histogram[kHistogramBuckets];
+};
+
+// Static storage is zero-initialized before anything runs, so the entries
+// can be used from the constructors of other globals.
+Entry entries[CallTracer::kMaxEntryPoints];
+// Entries below this have their name set.
+std::atomic<uint32_t> entry_count;
+std::mutex register_mutex;
+
+bool frames_started = false;
+uint64_t frame_count = 0;
+uint64_t first_frame_begin = 0;
+uint64_t frame_begin = 0;
+uint64_t max_frame_ticks = 0;
+uint32_t frame_histogram[kHistogramBuckets];
+
+// A tick count and a steady_clock time taken together when tracing was
+// first enabled, to find out the length of a tick.
+bool calibrated = false;
+uint64_t calibration_ticks = 0;
+std::chrono::steady_clock::time_point calibration_time;
+
+double NanosecondsPerTick() {
+  const uint64_t ticks = CallTracer::Ticks() - calibration_ticks;
+  const double nanoseconds = static_cast<double>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - calibration_time)
+          .count());
+  return ticks == 0 ? 1.0 : nanoseconds / static_cast<double>(ticks);
+}
+}  // anonymous namespace
+
+std::atomic<bool> CallTracer::enabled_(false);
+
+void CallTracer::Enable(bool enabled) {
+  if (enabled && !calibrated) {
+    calibrated = true;
+    calibration_ticks = Ticks();
+    calibration_time = std::chrono::steady_clock::now();
+  }
+  enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+uint32_t CallTracer::Register(const char* name) {
+  std::lock_guard<std::mutex> lock(register_mutex);
+  const uint32_t count = entry_count.load(std::memory_order_relaxed);
+  for (uint32_t i = 0; i < count; ++i) {
+    if (entries[i].name == name || strcmp(entries[i].name, name) == 0) {
+      return i;
+    }
+  }
+  if (count == kMaxEntryPoints) {
+    return kMaxEntryPoints;
+  }
+  entries[count].name = name;
+  entry_count.store(count + 1, std::memory_order_release);
+  return count;
+}
+
+void CallTracer::Record(uint32_t index, uint64_t ticks) {
+  if (index >= kMaxEntryPoints) {
+    return;
+  }
+  entries[index].calls.fetch_add(1, std::memory_order_relaxed);
+  entries[index].ticks.fetch_add(ticks, std::memory_order_relaxed);
+}
+
+void CallTracer::EndFrame() {
+  const uint64_t now = Ticks();
+  const uint32_t count = entry_count.load(std::memory_order_acquire);
+  if (frames_started) {
+    max_frame_ticks = std::max(max_frame_ticks, now - frame_begin);
+    ++frame_histogram[HistogramBucket(now - frame_begin)];
+    ++frame_count;
+  } else {
+    frames_started = true;
+    first_frame_begin = now;
+  }
+  frame_begin = now;
+
+  for (uint32_t i = 0; i < count; ++i) {
+    Entry& entry = entries[i];
+    const uint64_t calls = entry.calls.load(std::memory_order_relaxed);
+    const uint64_t ticks = entry.ticks.load(std::memory_order_relaxed);
+    if (frame_count == 0) {
+      entry.first_calls = calls;
+      entry.first_ticks = ticks;
+    } else {
+      entry.max_frame_ticks =
+          std::max(entry.max_frame_ticks, ticks - entry.frame_ticks);
+      ++entry.histogram[HistogramBucket(ticks - entry.frame_ticks)];
+    }
+    entry.frame_calls = calls;
+    entry.frame_ticks = ticks;
+  }
+}
+
+void CallTracer::LogReport(logging::Logger* log) {
+  if (frame_count == 0) {
+    log->LogInfo("No frames of Vulkan calls have been traced");
+    return;
+  }
+  const uint32_t count = entry_count.load(std::memory_order_acquire);
+  const double microseconds_per_tick = NanosecondsPerTick() / 1000.0;
+  const double frames = static_cast<double>(frame_count);
+  const double frame_microseconds =
+      static_cast<double>(frame_begin - first_frame_begin) *
+      microseconds_per_tick / frames;
+
+  uint32_t order[kMaxEntryPoints];
+  uint64_t traced_ticks = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    order[i] = i;
+    traced_ticks += entries[i].frame_ticks - entries[i].first_ticks;
+  }
+  std::sort(order, order + count, [](uint32_t a, uint32_t b) {
+    return entries[a].frame_ticks - entries[a].first_ticks >
+           entries[b].frame_ticks - entries[b].first_ticks;
+  });
+
+  log->LogInfoF(
+      "Vulkan calls over %" PRIu64
+      " frames of %.3f ms on average and %.3f ms at most, %.1f%% of it "
+      "spent in Vulkan calls",
+      frame_count, frame_microseconds / 1000.0,
+      static_cast<double>(max_frame_ticks) * microseconds_per_tick / 1000.0,
+      static_cast<double>(traced_ticks) * microseconds_per_tick / frames /
+          frame_microseconds * 100.0);
+  const double milliseconds_per_tick = microseconds_per_tick / 1000.0;
+  log->LogInfoF(
+      "Frame time percentiles: 50th %.3f ms, 95th %.3f ms, 99th %.3f ms",
+      HistogramPercentile(frame_histogram, frame_count, max_frame_ticks, 50.0) *
+          milliseconds_per_tick,
+      HistogramPercentile(frame_histogram, frame_count, max_frame_ticks, 95.0) *
+          milliseconds_per_tick,
+      HistogramPercentile(frame_histogram, frame_count, max_frame_ticks, 99.0) *
+          milliseconds_per_tick);
+  // The percentiles are of the time per frame spent in each entry point.
+  log->LogInfoF("%-40s %12s %10s %10s %10s %10s %10s %7s", "Entry point",
+                "Calls/frame", "us/frame", "50th us", "95th us", "99th us",
+                "Max us", "Frame");
+  for (uint32_t i = 0; i < count; ++i) {
+    const Entry& entry = entries[order[i]];
+    const uint64_t calls = entry.frame_calls - entry.first_calls;
+    if (calls == 0) {
+      continue;
+    }
+    const double microseconds =
+        static_cast<double>(entry.frame_ticks - entry.first_ticks) *
+        microseconds_per_tick / frames;
+    const double share = microseconds / frame_microseconds * 100.0;
+    // One mark for every 2% of the frame.
+    char bar[51];
+    const size_t marks = std::min<size_t>(static_cast<size_t>(share / 2.0),
+                                          sizeof(bar) - 1);
+    memset(bar, '#', marks);
+    bar[marks] = '\0';
+    log->LogInfoF(
+        "%-40s %12.1f %10.2f %10.2f %10.2f %10.2f %10.2f %6.1f%% %s",
+        entry.name, static_cast<double>(calls) / frames, microseconds,
+        HistogramPercentile(entry.histogram, frame_count,
+                            entry.max_frame_ticks, 50.0) *
+            microseconds_per_tick,
+        HistogramPercentile(entry.histogram, frame_count,
+                            entry.max_frame_ticks, 95.0) *
+            microseconds_per_tick,
+        HistogramPercentile(entry.histogram, frame_count,
+                            entry.max_frame_ticks, 99.0) *
+            microseconds_per_tick,
+        static_cast<double>(entry.max_frame_ticks) * microseconds_per_tick,
+        share, bar);
+  }
+}
+
+}  // namespace vulkan
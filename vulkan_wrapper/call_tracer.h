@@ -0,0 +1,118 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_WRAPPER_CALL_TRACER_H_
+#define VULKAN_WRAPPER_CALL_TRACER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#if defined _MSC_VER && (defined _M_X64 || defined _M_IX86)
+#include <intrin.h>
+#elif defined __x86_64__ || defined __i386__
+#include <x86intrin.h>
+#endif
+
+#include "support/log/log.h"
+
+namespace vulkan {
+
+// CallTracer counts the calls to every Vulkan entry point that goes through
+// a LazyFunction, and the host time spent in them. It is off by default, and
+// then only costs LazyFunction a relaxed load.
+//
+// Calls are timed with the CPU cycle counter where there is one, and the
+// counts are shared by every function table, so all the vkCmdDraw calls of
+// all command buffers end up in the same entry. EndFrame() splits them into
+// frames and adds the time of each entry point in the frame to a histogram,
+// and LogReport() prints how much of a frame each entry point takes, on
+// average and at the 50th, 95th and 99th percentiles.
+//
+// All of this is static, as the tracer has to be reachable from every
+// LazyFunction. Scopes may be used from any thread, EndFrame() and
+// LogReport() from one thread at a time.
+class CallTracer {
+ public:
+  // The most entry points that can be traced, any others are ignored.
+  static const uint32_t kMaxEntryPoints = 512;
+  // The index of an entry point that has not been looked up yet.
+  static const uint32_t kUnregistered = UINT32_MAX;
+
+  // Times one call to the entry point named |name|. |*index| caches the
+  // index of the entry point, it is looked up if it is kUnregistered.
+  // |name| has to outlive the program.
+  class Scope {
+   public:
+    Scope(std::atomic<uint32_t>* index, const char* name);
+    ~Scope() { Record(index_, Ticks() - begin_); }
+
+   private:
+    uint32_t index_;
+    uint64_t begin_;
+  };
+
+  static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+  // Turns tracing on or off. Counts are kept while it is off.
+  static void Enable(bool enabled);
+
+  // Ends the current frame. Calls made before the first call to this are
+  // not part of any frame.
+  static void EndFrame();
+  // Logs the number of calls and the time per frame of every entry point,
+  // with its percentiles, most expensive first.
+  static void LogReport(logging::Logger* log);
+
+  // Returns the value of a cheap timer, in ticks of unspecified length.
+  static uint64_t Ticks() {
+#if defined _MSC_VER && (defined _M_X64 || defined _M_IX86)
+    return __rdtsc();
+#elif defined __x86_64__ || defined __i386__
+    return __rdtsc();
+#elif defined __aarch64__
+    uint64_t ticks;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+  }
+
+ private:
+  // Returns the index of the entry point named |name|, or kMaxEntryPoints
+  // if there is no room for it.
+  static uint32_t Register(const char* name);
+  static void Record(uint32_t index, uint64_t ticks);
+
+  static std::atomic<bool> enabled_;
+};
+
+inline CallTracer::Scope::Scope(std::atomic<uint32_t>* index,
+                                const char* name) {
+  index_ = index->load(std::memory_order_relaxed);
+  if (index_ == kUnregistered) {
+    // Every thread gets the same index, so it does not matter which store
+    // wins.
+    index_ = Register(name);
+    index->store(index_, std::memory_order_relaxed);
+  }
+  begin_ = Ticks();
+}
+
+}  // namespace vulkan
+
+#endif  // VULKAN_WRAPPER_CALL_TRACER_H_
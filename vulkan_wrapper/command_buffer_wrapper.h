@@ -85,8 +85,7 @@ class VkCommandBuffer {
   ::VkCommandPool pool_;
   ::VkDevice device_;
   logging::Logger* log_;
-  LazyFunction<PFN_vkFreeCommandBuffers, ::VkDevice, DeviceFunctions>*
-      destruction_function_;
+  LazyDeviceFunction<PFN_vkFreeCommandBuffers>* destruction_function_;
   CommandBufferFunctions* functions_;
   uint32_t device_mask_ = 0;
   uint32_t default_mask_ = 0;
@@ -55,13 +55,19 @@ class VkDescriptorSet {
 
   logging::Logger* GetLogger() { return log_; }
 
+  // Gives up ownership of the set, which is then not freed by this object.
+  ::VkDescriptorSet release() {
+    ::VkDescriptorSet set = descriptor_set_;
+    descriptor_set_ = VK_NULL_HANDLE;
+    return set;
+  }
+
  private:
   ::VkDescriptorSet descriptor_set_;
   ::VkDescriptorPool pool_;
   ::VkDevice device_;
   logging::Logger* log_;
-  LazyFunction<PFN_vkFreeDescriptorSets, ::VkDevice, DeviceFunctions>*
-      destruction_function_;
+  LazyDeviceFunction<PFN_vkFreeDescriptorSets>* destruction_function_;
 
  public:
   const ::VkDescriptorSet& get_raw_object() const { return descriptor_set_; }
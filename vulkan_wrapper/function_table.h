@@ -77,7 +77,8 @@ class InstanceFunctions {
         CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceDisplayProperties2KHR),
         CONSTRUCT_LAZY_FUNCTION(vkGetPhysicalDeviceDisplayPlaneProperties2KHR),
         CONSTRUCT_LAZY_FUNCTION(vkGetDisplayModeProperties2KHR),
-        CONSTRUCT_LAZY_FUNCTION(vkGetDisplayPlaneCapabilities2KHR)
+        CONSTRUCT_LAZY_FUNCTION(vkGetDisplayPlaneCapabilities2KHR),
+        CONSTRUCT_LAZY_FUNCTION(vkCreateHeadlessSurfaceEXT)
 #if defined __ANDROID__
         ,
         CONSTRUCT_LAZY_FUNCTION(vkCreateAndroidSurfaceKHR)
@@ -150,6 +151,7 @@ class InstanceFunctions {
   LAZY_FUNCTION(vkGetPhysicalDeviceDisplayPlaneProperties2KHR);
   LAZY_FUNCTION(vkGetDisplayModeProperties2KHR);
   LAZY_FUNCTION(vkGetDisplayPlaneCapabilities2KHR);
+  LAZY_FUNCTION(vkCreateHeadlessSurfaceEXT);
 #if defined __ANDROID__
   LAZY_FUNCTION(vkCreateAndroidSurfaceKHR);
 #elif defined __ggp__
@@ -167,8 +169,22 @@ class InstanceFunctions {
 };
 
 class DeviceFunctions;
+#if defined VULKAN_EAGER_DISPATCH
+// With VULKAN_EAGER_DISPATCH the device, command buffer and queue tables
+// hold plain function pointers, which are all resolved when the device is
+// created. They are called the same way, but calls skip the check for an
+// unresolved pointer, and the tables are a quarter of the size. Calls
+// through them are not seen by CallTracer.
+template <typename T>
+using LazyDeviceFunction = T;
+#define DEVICE_FUNCTION_INITIALIZER(function, device, functions) \
+  function(ResolveFunction<PFN_##function>(device, #function, functions))
+#else
 template <typename T>
 using LazyDeviceFunction = LazyFunction<T, ::VkDevice, DeviceFunctions>;
+#define DEVICE_FUNCTION_INITIALIZER(function, device, functions) \
+  function(device, #function, functions)
+#endif
 
 // CommandBufferFunctions stores a list of lazily resolved Vulkan Command
 // buffer functions. The instance of this class should be owned and the
@@ -177,95 +193,7 @@ using LazyDeviceFunction = LazyFunction<T, ::VkDevice, DeviceFunctions>;
 // through it.
 struct CommandBufferFunctions {
  public:
-  CommandBufferFunctions(::VkDevice device, DeviceFunctions* device_functions)
-      :
-#define CONSTRUCT_LAZY_FUNCTION(function) \
-  function(device, #function, device_functions)
-        CONSTRUCT_LAZY_FUNCTION(vkBeginCommandBuffer),
-        CONSTRUCT_LAZY_FUNCTION(vkEndCommandBuffer),
-        CONSTRUCT_LAZY_FUNCTION(vkResetCommandBuffer),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdPipelineBarrier),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdPipelineBarrier2KHR),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdCopyBufferToImage),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdCopyImageToBuffer),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBeginRenderPass),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdEndRenderPass),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdNextSubpass),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBeginConditionalRenderingEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdEndConditionalRenderingEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBeginTransformFeedbackEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdEndTransformFeedbackEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBindPipeline),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetLineWidth),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetBlendConstants),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetDepthBias),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetDepthBounds),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetScissor),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetStencilCompareMask),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetStencilReference),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetStencilWriteMask),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetViewport),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdCopyBuffer),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBindDescriptorSets),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBindVertexBuffers),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBindTransformFeedbackBuffersEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdClearColorImage),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdClearDepthStencilImage),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBindIndexBuffer),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdDraw),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdDrawIndexed),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdDrawIndirect),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdDrawIndexedIndirect),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdDispatch),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdDispatchIndirect),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBlitImage),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdPushConstants),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdExecuteCommands),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdResolveImage),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdCopyImage),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdClearAttachments),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdUpdateBuffer),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdFillBuffer),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdResetQueryPool),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBeginQuery),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdEndQuery),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdCopyQueryPoolResults),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdWriteTimestamp),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdWriteTimestamp2KHR),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetEvent),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdResetEvent),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdWaitEvents),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdWaitEvents2KHR),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetDeviceMask),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdDrawIndexedIndirectCountKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBeginDebugUtilsLabelEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdEndDebugUtilsLabelEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdInsertDebugUtilsLabelEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdPushDescriptorSetKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBindVertexBuffers2EXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetCullModeEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetDepthBoundsTestEnableEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetDepthBiasEnableEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetDepthCompareOpEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetDepthTestEnableEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetDepthWriteEnableEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetFrontFaceEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetLogicOpEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetPatchControlPointsEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetPrimitiveTopologyEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetPrimitiveRestartEnableEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetRasterizerDiscardEnableEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetScissorWithCountEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetStencilOpEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetStencilTestEnableEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdSetViewportWithCountEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBeginRenderingKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdEndRenderingKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdBeginRendering),
-        CONSTRUCT_LAZY_FUNCTION(vkCmdEndRendering)
-#undef CONSTRUCT_LAZY_FUNCTION
-  {
-  }
+  CommandBufferFunctions(::VkDevice device, DeviceFunctions* device_functions);
 
  public:
 #define LAZY_FUNCTION(function) LazyDeviceFunction<PFN_##function> function;
@@ -356,21 +284,7 @@ struct CommandBufferFunctions {
 
 struct QueueFunctions {
  public:
-  QueueFunctions(::VkDevice device, DeviceFunctions* device_functions)
-      :
-#define CONSTRUCT_LAZY_FUNCTION(function) \
-  function(device, #function, device_functions)
-        CONSTRUCT_LAZY_FUNCTION(vkQueueSubmit),
-        CONSTRUCT_LAZY_FUNCTION(vkQueueSubmit2KHR),
-        CONSTRUCT_LAZY_FUNCTION(vkQueueWaitIdle),
-        CONSTRUCT_LAZY_FUNCTION(vkQueuePresentKHR),
-        CONSTRUCT_LAZY_FUNCTION(vkQueueBindSparse),
-        CONSTRUCT_LAZY_FUNCTION(vkQueueBeginDebugUtilsLabelEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkQueueEndDebugUtilsLabelEXT),
-        CONSTRUCT_LAZY_FUNCTION(vkQueueInsertDebugUtilsLabelEXT)
-#undef CONSTRUCT_LAZY_FUNCTION
-  {
-  }
+  QueueFunctions(::VkDevice device, DeviceFunctions* device_functions);
 
  public:
 #define LAZY_FUNCTION(function) LazyDeviceFunction<PFN_##function> function;
@@ -404,7 +318,8 @@ class DeviceFunctions {
         vkGetDeviceProcAddr_(get_proc_addr_func),
         command_buffer_functions_(device, this),
         queue_functions_(device, this),
-#define CONSTRUCT_LAZY_FUNCTION(function) function(device, #function, this)
+#define CONSTRUCT_LAZY_FUNCTION(function) \
+  DEVICE_FUNCTION_INITIALIZER(function, device, this)
         CONSTRUCT_LAZY_FUNCTION(vkDestroyDevice),
         CONSTRUCT_LAZY_FUNCTION(vkCreateCommandPool),
         CONSTRUCT_LAZY_FUNCTION(vkTrimCommandPool),
@@ -662,6 +577,118 @@ class DeviceFunctions {
 #undef LAZY_FUNCTION
 };
 
+// These are defined here, as resolving functions needs DeviceFunctions to
+// be complete.
+inline CommandBufferFunctions::CommandBufferFunctions(
+    ::VkDevice device, DeviceFunctions* device_functions)
+    :
+#define CONSTRUCT_LAZY_FUNCTION(function) \
+  DEVICE_FUNCTION_INITIALIZER(function, device, device_functions)
+      CONSTRUCT_LAZY_FUNCTION(vkBeginCommandBuffer),
+      CONSTRUCT_LAZY_FUNCTION(vkEndCommandBuffer),
+      CONSTRUCT_LAZY_FUNCTION(vkResetCommandBuffer),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdPipelineBarrier),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdPipelineBarrier2KHR),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdCopyBufferToImage),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdCopyImageToBuffer),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdBeginRenderPass),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdEndRenderPass),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdNextSubpass),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdBeginConditionalRenderingEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdEndConditionalRenderingEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdBeginTransformFeedbackEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdEndTransformFeedbackEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdBindPipeline),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetLineWidth),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetBlendConstants),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetDepthBias),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetDepthBounds),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetScissor),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetStencilCompareMask),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetStencilReference),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetStencilWriteMask),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetViewport),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdCopyBuffer),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdBindDescriptorSets),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdBindVertexBuffers),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdBindTransformFeedbackBuffersEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdClearColorImage),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdClearDepthStencilImage),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdBindIndexBuffer),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdDraw),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdDrawIndexed),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdDrawIndirect),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdDrawIndexedIndirect),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdDispatch),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdDispatchIndirect),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdBlitImage),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdPushConstants),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdExecuteCommands),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdResolveImage),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdCopyImage),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdClearAttachments),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdUpdateBuffer),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdFillBuffer),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdResetQueryPool),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdBeginQuery),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdEndQuery),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdCopyQueryPoolResults),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdWriteTimestamp),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdWriteTimestamp2KHR),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetEvent),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdResetEvent),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdWaitEvents),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdWaitEvents2KHR),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetDeviceMask),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdDrawIndexedIndirectCountKHR),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdBeginDebugUtilsLabelEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdEndDebugUtilsLabelEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdInsertDebugUtilsLabelEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdPushDescriptorSetKHR),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdBindVertexBuffers2EXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetCullModeEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetDepthBoundsTestEnableEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetDepthBiasEnableEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetDepthCompareOpEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetDepthTestEnableEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetDepthWriteEnableEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetFrontFaceEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetLogicOpEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetPatchControlPointsEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetPrimitiveTopologyEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetPrimitiveRestartEnableEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetRasterizerDiscardEnableEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetScissorWithCountEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetStencilOpEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetStencilTestEnableEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdSetViewportWithCountEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdBeginRenderingKHR),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdEndRenderingKHR),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdBeginRendering),
+      CONSTRUCT_LAZY_FUNCTION(vkCmdEndRendering)
+#undef CONSTRUCT_LAZY_FUNCTION
+{
+}
+
+inline QueueFunctions::QueueFunctions(
+    ::VkDevice device, DeviceFunctions* device_functions)
+    :
+#define CONSTRUCT_LAZY_FUNCTION(function) \
+  DEVICE_FUNCTION_INITIALIZER(function, device, device_functions)
+      CONSTRUCT_LAZY_FUNCTION(vkQueueSubmit),
+      CONSTRUCT_LAZY_FUNCTION(vkQueueSubmit2KHR),
+      CONSTRUCT_LAZY_FUNCTION(vkQueueWaitIdle),
+      CONSTRUCT_LAZY_FUNCTION(vkQueuePresentKHR),
+      CONSTRUCT_LAZY_FUNCTION(vkQueueBindSparse),
+      CONSTRUCT_LAZY_FUNCTION(vkQueueBeginDebugUtilsLabelEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkQueueEndDebugUtilsLabelEXT),
+      CONSTRUCT_LAZY_FUNCTION(vkQueueInsertDebugUtilsLabelEXT)
+#undef CONSTRUCT_LAZY_FUNCTION
+{
+}
+
+#undef DEVICE_FUNCTION_INITIALIZER
+
 }  // namespace vulkan
 
 #endif  // VULKAN_WRAPPER_FUNCTION_TABLE_H_
@@ -16,6 +16,8 @@
 #ifndef VULKAN_WRAPPER_LAZY_FUNCTION_H_
 #define VULKAN_WRAPPER_LAZY_FUNCTION_H_
 
+#include "vulkan_wrapper/call_tracer.h"
+
 // This wraps a lazily initialized function pointer. It will be resolved
 // when it is first called.
 template <typename T, typename HANDLE, typename WRAPPER>
@@ -28,7 +30,8 @@ class LazyFunction {
 
   // When this functor is called, it will check if the function pointer
   // has been resolved. If not it will resolve it and then call the function.
-  // If it could not be resolved, the program will segfault.
+  // If it could not be resolved, the program will segfault. The call is
+  // timed if vulkan::CallTracer is enabled.
   template <typename... Args>
   typename std::result_of<T(Args...)>::type operator()(const Args&... args);
 
@@ -37,6 +40,8 @@ class LazyFunction {
   const char* function_name_;
   WRAPPER* wrapper_;
   T ptr_ = nullptr;
+  // The index of this entry point in vulkan::CallTracer.
+  std::atomic<uint32_t> trace_index_{vulkan::CallTracer::kUnregistered};
 };
 
 template <typename T, typename HANDLE, typename WRAPPER>
@@ -46,14 +51,32 @@ operator()(const Args&... args) {
   if (!ptr_) {
     ptr_ = reinterpret_cast<T>(wrapper_->getProcAddr(handle_, function_name_));
     if (ptr_) {
-      wrapper_->GetLogger()->LogInfo(function_name_, " for instance ", handle_,
-                                     " resolved");
+      wrapper_->GetLogger()->LogDebug(function_name_, " for instance ",
+                                      handle_, " resolved");
     } else {
       wrapper_->GetLogger()->LogError(function_name_, " for instance ", handle_,
                                       " could not be resolved, crashing now");
     }
   }
+  if (vulkan::CallTracer::enabled()) {
+    vulkan::CallTracer::Scope scope(&trace_index_, function_name_);
+    return ptr_(args...);
+  }
   return ptr_(args...);
 }
 
+// Resolves a function right away, for function tables that hold plain
+// function pointers. Returns nullptr if it could not be resolved, which is
+// expected for functions of extensions that are not enabled.
+template <typename T, typename HANDLE, typename WRAPPER>
+T ResolveFunction(HANDLE handle, const char* function_name,
+                  WRAPPER* wrapper) {
+  T ptr = reinterpret_cast<T>(wrapper->getProcAddr(handle, function_name));
+  if (!ptr) {
+    wrapper->GetLogger()->LogDebug(function_name, " for ", handle,
+                                   " could not be resolved");
+  }
+  return ptr;
+}
+
 #endif  //  VULKAN_WRAPPER_LAZY_FUNCTION_H_
\ No newline at end of file
@@ -15,11 +15,18 @@
 
 #include "vulkan_wrapper/library_wrapper.h"
 
+#include "vulkan_wrapper/null_driver.h"
+
 namespace vulkan {
 
 LibraryWrapper::LibraryWrapper(containers::Allocator* allocator,
-                               logging::Logger* logger)
+                               logging::Logger* logger, bool use_null_driver)
     : logger_(logger) {
+  if (use_null_driver) {
+    logger_->LogInfo("Using the null driver instead of the vulkan library");
+    vkGetInstanceProcAddr = &null_driver::GetInstanceProcAddr;
+    return;
+  }
   vulkan_lib_ = dynamic_loader::OpenLibrary(allocator, "vulkan");
   if (vulkan_lib_) {
     if (vulkan_lib_->is_valid()) {
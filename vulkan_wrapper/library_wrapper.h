@@ -33,8 +33,11 @@ using LazyLibraryFunction = LazyFunction<T, ::VkInstance, LibraryWrapper>;
 // for all global-scope functions.
 class LibraryWrapper {
  public:
-  LibraryWrapper(containers::Allocator* allocator, logging::Logger* logger);
-  bool is_valid() { return vulkan_lib_ && vulkan_lib_->is_valid(); }
+  // If use_null_driver is true, the vulkan library is not opened, and all
+  // functions are resolved from the null driver in null_driver.h instead.
+  LibraryWrapper(containers::Allocator* allocator, logging::Logger* logger,
+                 bool use_null_driver = false);
+  bool is_valid() { return vkGetInstanceProcAddr != nullptr; }
 
 #define LAZY_FUNCTION(function)                   \
   LazyLibraryFunction<PFN_##function> function = \
@@ -52,7 +55,7 @@ class LibraryWrapper {
   }
 
  private:
-  PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr;
+  PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr = nullptr;
 
   logging::Logger* logger_;
   containers::unique_ptr<dynamic_loader::DynamicLibrary> vulkan_lib_;
@@ -0,0 +1,1325 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vulkan_wrapper/null_driver.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_set>
+#include <vector>
+
+namespace vulkan {
+namespace null_driver {
+namespace {
+const uint32_t kQueueFamilyCount = 3;
+const uint32_t kMaxQueueCount = 4;
+const uint32_t kMemoryTypeCount = 4;
+const uint32_t kAllMemoryTypes = (1u << kMemoryTypeCount) - 1;
+const VkDeviceSize kMemoryAlignment = 256;
+// Images are sized as if every texel took as much memory as the largest
+// uncompressed formats.
+const VkDeviceSize kMaxTexelSize = 16;
+const char kPipelineCacheUUID[VK_UUID_SIZE + 1] = "NullDriverCache0";
+
+const VkMemoryPropertyFlags kMemoryTypeFlags[kMemoryTypeCount] = {
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+        VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
+
+const VkQueueFamilyProperties kQueueFamilies[kQueueFamilyCount] = {
+    {VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT |
+         VK_QUEUE_SPARSE_BINDING_BIT,
+     kMaxQueueCount, 64, {1, 1, 1}},
+    {VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT, 2, 64, {1, 1, 1}},
+    {VK_QUEUE_TRANSFER_BIT, 1, 64, {1, 1, 1}}};
+
+const VkExtensionProperties kInstanceExtensions[] = {
+    {VK_KHR_SURFACE_EXTENSION_NAME, VK_KHR_SURFACE_SPEC_VERSION},
+    {VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME,
+     VK_EXT_HEADLESS_SURFACE_SPEC_VERSION},
+    {VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME,
+     VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_SPEC_VERSION},
+#if defined __ANDROID__
+    {VK_KHR_ANDROID_SURFACE_EXTENSION_NAME,
+     VK_KHR_ANDROID_SURFACE_SPEC_VERSION},
+#elif defined __ggp__
+    {VK_GGP_STREAM_DESCRIPTOR_SURFACE_EXTENSION_NAME,
+     VK_GGP_STREAM_DESCRIPTOR_SURFACE_SPEC_VERSION},
+#elif defined __linux__
+    {VK_KHR_XCB_SURFACE_EXTENSION_NAME, VK_KHR_XCB_SURFACE_SPEC_VERSION},
+#elif defined _WIN32
+    {VK_KHR_WIN32_SURFACE_EXTENSION_NAME, VK_KHR_WIN32_SURFACE_SPEC_VERSION},
+#elif defined __APPLE__
+    {VK_MVK_MACOS_SURFACE_EXTENSION_NAME, VK_MVK_MACOS_SURFACE_SPEC_VERSION},
+#endif
+};
+
+const VkExtensionProperties kDeviceExtensions[] = {
+    {VK_KHR_SWAPCHAIN_EXTENSION_NAME, VK_KHR_SWAPCHAIN_SPEC_VERSION},
+    {VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME,
+     VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_SPEC_VERSION},
+    {VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME,
+     VK_KHR_DRAW_INDIRECT_COUNT_SPEC_VERSION},
+    {VK_EXT_HOST_QUERY_RESET_EXTENSION_NAME,
+     VK_EXT_HOST_QUERY_RESET_SPEC_VERSION},
+    {VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME,
+     VK_EXT_CALIBRATED_TIMESTAMPS_SPEC_VERSION}};
+
+// The device clock is the host's steady clock in nanoseconds, so it can be
+// calibrated against CLOCK_MONOTONIC where that is the steady clock.
+const VkTimeDomainEXT kTimeDomains[] = {
+    VK_TIME_DOMAIN_DEVICE_EXT,
+#if defined __linux__ || defined __ANDROID__
+    VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT,
+#endif
+};
+
+const VkSurfaceFormatKHR kSurfaceFormats[] = {
+    {VK_FORMAT_B8G8R8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR},
+    {VK_FORMAT_B8G8R8A8_SRGB, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR}};
+
+const VkPresentModeKHR kPresentModes[] = {VK_PRESENT_MODE_FIFO_KHR,
+                                          VK_PRESENT_MODE_MAILBOX_KHR,
+                                          VK_PRESENT_MODE_IMMEDIATE_KHR};
+
+// The objects behind the handles. Handles that need no state point at an
+// Object, so that every handle is unique.
+struct Object {
+  uint64_t unused;
+};
+
+struct Instance {
+  Object physical_device;
+};
+
+struct Queue {
+  uint32_t family_index;
+  uint32_t index;
+};
+
+struct Device {
+  Queue queues[kQueueFamilyCount][kMaxQueueCount];
+};
+
+struct Memory {
+  VkDeviceSize size;
+  // nullptr unless the memory is host visible.
+  void* data;
+};
+
+struct Buffer {
+  VkMemoryRequirements requirements;
+};
+
+struct Image {
+  VkExtent3D extent;
+  VkMemoryRequirements requirements;
+};
+
+struct Fence {
+  bool signaled;
+};
+
+struct Event {
+  VkResult status;
+};
+
+struct QueryPool {
+  uint32_t values_per_query;
+};
+
+struct Swapchain {
+  std::vector<Image> images;
+  std::vector<::VkImage> image_handles;
+  uint32_t next_image;
+};
+
+// Command pools and descriptor pools own the command buffers and descriptor
+// sets that are allocated from them.
+struct Pool {
+  std::unordered_set<Object*> children;
+};
+
+template <typename H, typename T>
+H ToHandle(T* object) {
+  return (H)(uintptr_t)object;
+}
+
+template <typename T, typename H>
+T* FromHandle(H handle) {
+  return (T*)(uintptr_t)handle;
+}
+
+VkDeviceSize AlignUp(VkDeviceSize size) {
+  return (size + kMemoryAlignment - 1) / kMemoryAlignment * kMemoryAlignment;
+}
+
+// Writes up to *|out_count| of the |count| |items| to |out| in the way every
+// vkEnumerate* and vkGet* function that returns an array does.
+template <typename T>
+VkResult Enumerate(const T* items, uint32_t count, uint32_t* out_count,
+                   T* out) {
+  if (!out) {
+    *out_count = count;
+    return VK_SUCCESS;
+  }
+  const uint32_t written = std::min(*out_count, count);
+  std::copy(items, items + written, out);
+  *out_count = written;
+  return written < count ? VK_INCOMPLETE : VK_SUCCESS;
+}
+
+bool IsSupported(const char* name, const VkExtensionProperties* extensions,
+                 size_t count) {
+  return std::find_if(extensions, extensions + count,
+                      [name](const VkExtensionProperties& extension) {
+                        return strcmp(name, extension.extensionName) == 0;
+                      }) != extensions + count;
+}
+
+// Implements any function by doing nothing, and returning VK_SUCCESS if it
+// returns a VkResult.
+template <typename T>
+struct NoOp;
+
+template <typename R, typename... Args>
+struct NoOp<R(VKAPI_PTR*)(Args...)> {
+  static VKAPI_ATTR R VKAPI_CALL Call(Args...) { return R(); }
+};
+
+// Implements the creation and destruction of objects of type T, which
+// default to objects without any state.
+template <typename T = Object, typename Parent, typename CreateInfo,
+          typename Handle>
+VKAPI_ATTR VkResult VKAPI_CALL CreateObject(Parent, const CreateInfo*,
+                                            const VkAllocationCallbacks*,
+                                            Handle* handle) {
+  *handle = ToHandle<Handle>(new T());
+  return VK_SUCCESS;
+}
+
+template <typename T = Object, typename Parent, typename Handle>
+VKAPI_ATTR void VKAPI_CALL DestroyObject(Parent, Handle handle,
+                                         const VkAllocationCallbacks*) {
+  delete FromHandle<T>(handle);
+}
+
+template <typename... Args>
+VKAPI_ATTR VkBool32 VKAPI_CALL PresentationSupport(Args...) {
+  return VK_TRUE;
+}
+
+// Instance and physical device functions.
+VKAPI_ATTR VkResult VKAPI_CALL
+EnumerateInstanceExtensionProperties(const char* layer, uint32_t* count,
+                                     VkExtensionProperties* properties) {
+  if (layer) {
+    return VK_ERROR_LAYER_NOT_PRESENT;
+  }
+  return Enumerate(kInstanceExtensions,
+                   sizeof(kInstanceExtensions) / sizeof(kInstanceExtensions[0]),
+                   count, properties);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+EnumerateInstanceLayerProperties(uint32_t* count, VkLayerProperties*) {
+  *count = 0;
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL EnumerateInstanceVersion(uint32_t* version) {
+  *version = VK_API_VERSION_1_1;
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+CreateInstance(const VkInstanceCreateInfo* create_info,
+               const VkAllocationCallbacks*, ::VkInstance* instance) {
+  // There are no layers, so the application would not get what it asked
+  // for, for example the CallbackSwapchain layer.
+  if (create_info->enabledLayerCount > 0) {
+    return VK_ERROR_LAYER_NOT_PRESENT;
+  }
+  for (uint32_t i = 0; i < create_info->enabledExtensionCount; ++i) {
+    if (!IsSupported(
+            create_info->ppEnabledExtensionNames[i], kInstanceExtensions,
+            sizeof(kInstanceExtensions) / sizeof(kInstanceExtensions[0]))) {
+      return VK_ERROR_EXTENSION_NOT_PRESENT;
+    }
+  }
+  *instance = ToHandle<::VkInstance>(new Instance());
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL DestroyInstance(::VkInstance instance,
+                                           const VkAllocationCallbacks*) {
+  delete FromHandle<Instance>(instance);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+EnumeratePhysicalDevices(::VkInstance instance, uint32_t* count,
+                         ::VkPhysicalDevice* physical_devices) {
+  const ::VkPhysicalDevice physical_device = ToHandle<::VkPhysicalDevice>(
+      &FromHandle<Instance>(instance)->physical_device);
+  return Enumerate(&physical_device, 1, count, physical_devices);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL EnumeratePhysicalDeviceGroups(
+    ::VkInstance instance, uint32_t* count,
+    VkPhysicalDeviceGroupProperties* groups) {
+  if (!groups) {
+    *count = 1;
+    return VK_SUCCESS;
+  }
+  if (*count == 0) {
+    return VK_INCOMPLETE;
+  }
+  *count = 1;
+  groups->physicalDeviceCount = 1;
+  groups->physicalDevices[0] = ToHandle<::VkPhysicalDevice>(
+      &FromHandle<Instance>(instance)->physical_device);
+  groups->subsetAllocation = VK_FALSE;
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceProperties(
+    ::VkPhysicalDevice, VkPhysicalDeviceProperties* properties) {
+  memset(properties, 0, sizeof(*properties));
+  properties->apiVersion = VK_API_VERSION_1_1;
+  properties->driverVersion = 1;
+  properties->deviceType = VK_PHYSICAL_DEVICE_TYPE_CPU;
+  strncpy(properties->deviceName, "Null Device",
+          VK_MAX_PHYSICAL_DEVICE_NAME_SIZE - 1);
+  memcpy(properties->pipelineCacheUUID, kPipelineCacheUUID, VK_UUID_SIZE);
+
+  VkPhysicalDeviceLimits& limits = properties->limits;
+  limits.maxImageDimension1D = 16384;
+  limits.maxImageDimension2D = 16384;
+  limits.maxImageDimension3D = 2048;
+  limits.maxImageDimensionCube = 16384;
+  limits.maxImageArrayLayers = 2048;
+  limits.maxTexelBufferElements = 1u << 27;
+  limits.maxUniformBufferRange = 65536;
+  limits.maxStorageBufferRange = 1u << 30;
+  limits.maxPushConstantsSize = 256;
+  limits.maxMemoryAllocationCount = 4096;
+  limits.maxSamplerAllocationCount = 4000;
+  limits.bufferImageGranularity = 1;
+  limits.sparseAddressSpaceSize = 1ull << 40;
+  limits.maxBoundDescriptorSets = 8;
+  limits.maxPerStageDescriptorSamplers = 1u << 20;
+  limits.maxPerStageDescriptorUniformBuffers = 1u << 20;
+  limits.maxPerStageDescriptorStorageBuffers = 1u << 20;
+  limits.maxPerStageDescriptorSampledImages = 1u << 20;
+  limits.maxPerStageDescriptorStorageImages = 1u << 20;
+  limits.maxPerStageDescriptorInputAttachments = 8;
+  limits.maxPerStageResources = 1u << 20;
+  limits.maxDescriptorSetSamplers = 1u << 20;
+  limits.maxDescriptorSetUniformBuffers = 1u << 20;
+  limits.maxDescriptorSetUniformBuffersDynamic = 16;
+  limits.maxDescriptorSetStorageBuffers = 1u << 20;
+  limits.maxDescriptorSetStorageBuffersDynamic = 16;
+  limits.maxDescriptorSetSampledImages = 1u << 20;
+  limits.maxDescriptorSetStorageImages = 1u << 20;
+  limits.maxDescriptorSetInputAttachments = 8;
+  limits.maxVertexInputAttributes = 32;
+  limits.maxVertexInputBindings = 32;
+  limits.maxVertexInputAttributeOffset = 2047;
+  limits.maxVertexInputBindingStride = 2048;
+  limits.maxVertexOutputComponents = 128;
+  limits.maxTessellationGenerationLevel = 64;
+  limits.maxTessellationPatchSize = 32;
+  limits.maxTessellationControlPerVertexInputComponents = 128;
+  limits.maxTessellationControlPerVertexOutputComponents = 128;
+  limits.maxTessellationControlPerPatchOutputComponents = 120;
+  limits.maxTessellationControlTotalOutputComponents = 4096;
+  limits.maxTessellationEvaluationInputComponents = 128;
+  limits.maxTessellationEvaluationOutputComponents = 128;
+  limits.maxGeometryShaderInvocations = 32;
+  limits.maxGeometryInputComponents = 128;
+  limits.maxGeometryOutputComponents = 128;
+  limits.maxGeometryOutputVertices = 256;
+  limits.maxGeometryTotalOutputComponents = 1024;
+  limits.maxFragmentInputComponents = 128;
+  limits.maxFragmentOutputAttachments = 8;
+  limits.maxFragmentDualSrcAttachments = 1;
+  limits.maxFragmentCombinedOutputResources = 1u << 20;
+  limits.maxComputeSharedMemorySize = 32768;
+  limits.maxComputeWorkGroupCount[0] = 65535;
+  limits.maxComputeWorkGroupCount[1] = 65535;
+  limits.maxComputeWorkGroupCount[2] = 65535;
+  limits.maxComputeWorkGroupInvocations = 1024;
+  limits.maxComputeWorkGroupSize[0] = 1024;
+  limits.maxComputeWorkGroupSize[1] = 1024;
+  limits.maxComputeWorkGroupSize[2] = 64;
+  limits.subPixelPrecisionBits = 8;
+  limits.subTexelPrecisionBits = 8;
+  limits.mipmapPrecisionBits = 8;
+  limits.maxDrawIndexedIndexValue = UINT32_MAX;
+  limits.maxDrawIndirectCount = UINT32_MAX;
+  limits.maxSamplerLodBias = 16.0f;
+  limits.maxSamplerAnisotropy = 16.0f;
+  limits.maxViewports = 16;
+  limits.maxViewportDimensions[0] = 16384;
+  limits.maxViewportDimensions[1] = 16384;
+  limits.viewportBoundsRange[0] = -32768.0f;
+  limits.viewportBoundsRange[1] = 32767.0f;
+  limits.viewportSubPixelBits = 8;
+  limits.minMemoryMapAlignment = 64;
+  limits.minTexelBufferOffsetAlignment = 16;
+  limits.minUniformBufferOffsetAlignment = 256;
+  limits.minStorageBufferOffsetAlignment = 16;
+  limits.minTexelOffset = -8;
+  limits.maxTexelOffset = 7;
+  limits.minTexelGatherOffset = -32;
+  limits.maxTexelGatherOffset = 31;
+  limits.minInterpolationOffset = -0.5f;
+  limits.maxInterpolationOffset = 0.4375f;
+  limits.subPixelInterpolationOffsetBits = 4;
+  limits.maxFramebufferWidth = 16384;
+  limits.maxFramebufferHeight = 16384;
+  limits.maxFramebufferLayers = 2048;
+  const VkSampleCountFlags sample_counts =
+      VK_SAMPLE_COUNT_1_BIT | VK_SAMPLE_COUNT_4_BIT;
+  limits.framebufferColorSampleCounts = sample_counts;
+  limits.framebufferDepthSampleCounts = sample_counts;
+  limits.framebufferStencilSampleCounts = sample_counts;
+  limits.framebufferNoAttachmentsSampleCounts = sample_counts;
+  limits.maxColorAttachments = 8;
+  limits.sampledImageColorSampleCounts = sample_counts;
+  limits.sampledImageIntegerSampleCounts = sample_counts;
+  limits.sampledImageDepthSampleCounts = sample_counts;
+  limits.sampledImageStencilSampleCounts = sample_counts;
+  limits.storageImageSampleCounts = VK_SAMPLE_COUNT_1_BIT;
+  limits.maxSampleMaskWords = 1;
+  limits.timestampComputeAndGraphics = VK_TRUE;
+  limits.timestampPeriod = 1.0f;
+  limits.maxClipDistances = 8;
+  limits.maxCullDistances = 8;
+  limits.maxCombinedClipAndCullDistances = 8;
+  limits.discreteQueuePriorities = 2;
+  limits.pointSizeRange[0] = 1.0f;
+  limits.pointSizeRange[1] = 64.0f;
+  limits.lineWidthRange[0] = 1.0f;
+  limits.lineWidthRange[1] = 8.0f;
+  limits.pointSizeGranularity = 1.0f;
+  limits.lineWidthGranularity = 1.0f;
+  limits.strictLines = VK_TRUE;
+  limits.standardSampleLocations = VK_TRUE;
+  limits.optimalBufferCopyOffsetAlignment = 1;
+  limits.optimalBufferCopyRowPitchAlignment = 1;
+  limits.nonCoherentAtomSize = 64;
+}
+
+VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceProperties2(
+    ::VkPhysicalDevice physical_device,
+    VkPhysicalDeviceProperties2* properties) {
+  GetPhysicalDeviceProperties(physical_device, &properties->properties);
+}
+
+VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceFeatures(
+    ::VkPhysicalDevice, VkPhysicalDeviceFeatures* features) {
+  // Every member is a VkBool32, and all of them are supported.
+  VkBool32* feature = reinterpret_cast<VkBool32*>(features);
+  std::fill(feature, feature + sizeof(*features) / sizeof(VkBool32), VK_TRUE);
+}
+
+VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceFeatures2(
+    ::VkPhysicalDevice physical_device, VkPhysicalDeviceFeatures2* features) {
+  GetPhysicalDeviceFeatures(physical_device, &features->features);
+}
+
+VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceMemoryProperties(
+    ::VkPhysicalDevice, VkPhysicalDeviceMemoryProperties* properties) {
+  memset(properties, 0, sizeof(*properties));
+  properties->memoryTypeCount = kMemoryTypeCount;
+  for (uint32_t i = 0; i < kMemoryTypeCount; ++i) {
+    properties->memoryTypes[i].propertyFlags = kMemoryTypeFlags[i];
+    properties->memoryTypes[i].heapIndex =
+        (kMemoryTypeFlags[i] & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) ? 0 : 1;
+  }
+  properties->memoryHeapCount = 2;
+  properties->memoryHeaps[0] = {4ull << 30, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT};
+  properties->memoryHeaps[1] = {8ull << 30, 0};
+}
+
+VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceMemoryProperties2(
+    ::VkPhysicalDevice physical_device,
+    VkPhysicalDeviceMemoryProperties2* properties) {
+  GetPhysicalDeviceMemoryProperties(physical_device,
+                                    &properties->memoryProperties);
+}
+
+VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceQueueFamilyProperties(
+    ::VkPhysicalDevice, uint32_t* count, VkQueueFamilyProperties* properties) {
+  Enumerate(kQueueFamilies, kQueueFamilyCount, count, properties);
+}
+
+VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceQueueFamilyProperties2(
+    ::VkPhysicalDevice, uint32_t* count,
+    VkQueueFamilyProperties2* properties) {
+  if (!properties) {
+    *count = kQueueFamilyCount;
+    return;
+  }
+  *count = std::min(*count, kQueueFamilyCount);
+  for (uint32_t i = 0; i < *count; ++i) {
+    properties[i].queueFamilyProperties = kQueueFamilies[i];
+  }
+}
+
+bool IsDepthFormat(VkFormat format) {
+  return format >= VK_FORMAT_D16_UNORM &&
+         format <= VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+
+VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceFormatProperties(
+    ::VkPhysicalDevice, VkFormat format, VkFormatProperties* properties) {
+  memset(properties, 0, sizeof(*properties));
+  if (format == VK_FORMAT_UNDEFINED) {
+    return;
+  }
+  const VkFormatFeatureFlags transfer =
+      VK_FORMAT_FEATURE_TRANSFER_SRC_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+  if (IsDepthFormat(format)) {
+    properties->optimalTilingFeatures =
+        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT |
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+        transfer;
+    return;
+  }
+  properties->linearTilingFeatures = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+                                     VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+                                     VK_FORMAT_FEATURE_BLIT_DST_BIT | transfer;
+  properties->optimalTilingFeatures =
+      VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+      VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT |
+      VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT |
+      VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BLEND_BIT |
+      VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+      VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | transfer;
+  properties->bufferFeatures = VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT |
+                               VK_FORMAT_FEATURE_UNIFORM_TEXEL_BUFFER_BIT |
+                               VK_FORMAT_FEATURE_STORAGE_TEXEL_BUFFER_BIT;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+GetPhysicalDeviceFormatProperties2(::VkPhysicalDevice physical_device,
+                                   VkFormat format,
+                                   VkFormatProperties2* properties) {
+  GetPhysicalDeviceFormatProperties(physical_device, format,
+                                    &properties->formatProperties);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL GetPhysicalDeviceImageFormatProperties(
+    ::VkPhysicalDevice, VkFormat format, VkImageType, VkImageTiling tiling,
+    VkImageUsageFlags, VkImageCreateFlags,
+    VkImageFormatProperties* properties) {
+  if (format == VK_FORMAT_UNDEFINED) {
+    return VK_ERROR_FORMAT_NOT_SUPPORTED;
+  }
+  properties->maxExtent = {16384, 16384, 2048};
+  properties->maxMipLevels = 15;
+  properties->maxArrayLayers = 2048;
+  properties->sampleCounts =
+      tiling == VK_IMAGE_TILING_OPTIMAL
+          ? VK_SAMPLE_COUNT_1_BIT | VK_SAMPLE_COUNT_4_BIT
+          : VK_SAMPLE_COUNT_1_BIT;
+  properties->maxResourceSize = 1ull << 40;
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL GetPhysicalDeviceImageFormatProperties2(
+    ::VkPhysicalDevice physical_device,
+    const VkPhysicalDeviceImageFormatInfo2* info,
+    VkImageFormatProperties2* properties) {
+  return GetPhysicalDeviceImageFormatProperties(
+      physical_device, info->format, info->type, info->tiling, info->usage,
+      info->flags, &properties->imageFormatProperties);
+}
+
+VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceSparseImageFormatProperties(
+    ::VkPhysicalDevice, VkFormat, VkImageType, VkSampleCountFlagBits,
+    VkImageUsageFlags, VkImageTiling, uint32_t* count,
+    VkSparseImageFormatProperties*) {
+  *count = 0;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL EnumerateDeviceExtensionProperties(
+    ::VkPhysicalDevice, const char* layer, uint32_t* count,
+    VkExtensionProperties* properties) {
+  if (layer) {
+    return VK_ERROR_LAYER_NOT_PRESENT;
+  }
+  return Enumerate(kDeviceExtensions,
+                   sizeof(kDeviceExtensions) / sizeof(kDeviceExtensions[0]),
+                   count, properties);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL EnumerateDeviceLayerProperties(
+    ::VkPhysicalDevice, uint32_t* count, VkLayerProperties*) {
+  *count = 0;
+  return VK_SUCCESS;
+}
+
+// Surface functions.
+VKAPI_ATTR VkResult VKAPI_CALL GetPhysicalDeviceSurfaceSupportKHR(
+    ::VkPhysicalDevice, uint32_t, ::VkSurfaceKHR, VkBool32* supported) {
+  *supported = VK_TRUE;
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL GetPhysicalDeviceSurfaceCapabilitiesKHR(
+    ::VkPhysicalDevice, ::VkSurfaceKHR,
+    VkSurfaceCapabilitiesKHR* capabilities) {
+  // The extent of the swapchain is up to the application, as it is for
+  // headless surfaces.
+  capabilities->minImageCount = 2;
+  capabilities->maxImageCount = 8;
+  capabilities->currentExtent = {0xFFFFFFFF, 0xFFFFFFFF};
+  capabilities->minImageExtent = {1, 1};
+  capabilities->maxImageExtent = {16384, 16384};
+  capabilities->maxImageArrayLayers = 1;
+  capabilities->supportedTransforms = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+  capabilities->currentTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+  capabilities->supportedCompositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+  capabilities->supportedUsageFlags =
+      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+      VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
+      VK_IMAGE_USAGE_STORAGE_BIT;
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL GetPhysicalDeviceSurfaceFormatsKHR(
+    ::VkPhysicalDevice, ::VkSurfaceKHR, uint32_t* count,
+    VkSurfaceFormatKHR* formats) {
+  return Enumerate(kSurfaceFormats,
+                   sizeof(kSurfaceFormats) / sizeof(kSurfaceFormats[0]), count,
+                   formats);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL GetPhysicalDeviceSurfacePresentModesKHR(
+    ::VkPhysicalDevice, ::VkSurfaceKHR, uint32_t* count,
+    VkPresentModeKHR* modes) {
+  return Enumerate(kPresentModes,
+                   sizeof(kPresentModes) / sizeof(kPresentModes[0]), count,
+                   modes);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL GetPhysicalDeviceCalibrateableTimeDomainsEXT(
+    ::VkPhysicalDevice, uint32_t* count, VkTimeDomainEXT* domains) {
+  return Enumerate(kTimeDomains,
+                   sizeof(kTimeDomains) / sizeof(kTimeDomains[0]), count,
+                   domains);
+}
+
+// Device functions.
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL GetDeviceProcAddr(::VkDevice,
+                                                           const char* name) {
+  return GetInstanceProcAddr(VK_NULL_HANDLE, name);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+CreateDevice(::VkPhysicalDevice, const VkDeviceCreateInfo* create_info,
+             const VkAllocationCallbacks*, ::VkDevice* device) {
+  for (uint32_t i = 0; i < create_info->enabledExtensionCount; ++i) {
+    if (!IsSupported(
+            create_info->ppEnabledExtensionNames[i], kDeviceExtensions,
+            sizeof(kDeviceExtensions) / sizeof(kDeviceExtensions[0]))) {
+      return VK_ERROR_EXTENSION_NOT_PRESENT;
+    }
+  }
+  Device* new_device = new Device();
+  for (uint32_t family = 0; family < kQueueFamilyCount; ++family) {
+    for (uint32_t index = 0; index < kMaxQueueCount; ++index) {
+      new_device->queues[family][index] = {family, index};
+    }
+  }
+  *device = ToHandle<::VkDevice>(new_device);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL DestroyDevice(::VkDevice device,
+                                         const VkAllocationCallbacks*) {
+  delete FromHandle<Device>(device);
+}
+
+VKAPI_ATTR void VKAPI_CALL GetDeviceQueue(::VkDevice device,
+                                          uint32_t family_index,
+                                          uint32_t index, ::VkQueue* queue) {
+  *queue = ToHandle<::VkQueue>(
+      &FromHandle<Device>(device)->queues[family_index][index]);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+AllocateMemory(::VkDevice, const VkMemoryAllocateInfo* allocate_info,
+               const VkAllocationCallbacks*, ::VkDeviceMemory* memory) {
+  if (allocate_info->memoryTypeIndex >= kMemoryTypeCount) {
+    return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+  }
+  Memory* new_memory = new Memory{allocate_info->allocationSize, nullptr};
+  if (kMemoryTypeFlags[allocate_info->memoryTypeIndex] &
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+    new_memory->data =
+        calloc(static_cast<size_t>(allocate_info->allocationSize), 1);
+    if (!new_memory->data) {
+      delete new_memory;
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+  }
+  *memory = ToHandle<::VkDeviceMemory>(new_memory);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL FreeMemory(::VkDevice, ::VkDeviceMemory memory,
+                                      const VkAllocationCallbacks*) {
+  Memory* old_memory = FromHandle<Memory>(memory);
+  if (old_memory) {
+    free(old_memory->data);
+    delete old_memory;
+  }
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL MapMemory(::VkDevice, ::VkDeviceMemory memory,
+                                         VkDeviceSize offset, VkDeviceSize,
+                                         VkMemoryMapFlags, void** data) {
+  Memory* mapped_memory = FromHandle<Memory>(memory);
+  if (!mapped_memory->data) {
+    return VK_ERROR_MEMORY_MAP_FAILED;
+  }
+  *data = static_cast<char*>(mapped_memory->data) + offset;
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+CreateBuffer(::VkDevice, const VkBufferCreateInfo* create_info,
+             const VkAllocationCallbacks*, ::VkBuffer* buffer) {
+  *buffer = ToHandle<::VkBuffer>(new Buffer{
+      {AlignUp(create_info->size), kMemoryAlignment, kAllMemoryTypes}});
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL GetBufferMemoryRequirements(
+    ::VkDevice, ::VkBuffer buffer, VkMemoryRequirements* requirements) {
+  *requirements = FromHandle<Buffer>(buffer)->requirements;
+}
+
+VKAPI_ATTR void VKAPI_CALL GetBufferMemoryRequirements2(
+    ::VkDevice device, const VkBufferMemoryRequirementsInfo2* info,
+    VkMemoryRequirements2* requirements) {
+  GetBufferMemoryRequirements(device, info->buffer,
+                              &requirements->memoryRequirements);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+CreateImage(::VkDevice, const VkImageCreateInfo* create_info,
+            const VkAllocationCallbacks*, ::VkImage* image) {
+  const VkExtent3D& extent = create_info->extent;
+  VkDeviceSize texels = 0;
+  for (uint32_t i = 0; i < create_info->mipLevels; ++i) {
+    texels += static_cast<VkDeviceSize>(std::max(extent.width >> i, 1u)) *
+              std::max(extent.height >> i, 1u) *
+              std::max(extent.depth >> i, 1u);
+  }
+  const VkDeviceSize size = texels * create_info->arrayLayers *
+                            create_info->samples * kMaxTexelSize;
+  *image = ToHandle<::VkImage>(
+      new Image{extent, {AlignUp(size), kMemoryAlignment, kAllMemoryTypes}});
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL GetImageMemoryRequirements(
+    ::VkDevice, ::VkImage image, VkMemoryRequirements* requirements) {
+  *requirements = FromHandle<Image>(image)->requirements;
+}
+
+VKAPI_ATTR void VKAPI_CALL GetImageMemoryRequirements2(
+    ::VkDevice device, const VkImageMemoryRequirementsInfo2* info,
+    VkMemoryRequirements2* requirements) {
+  GetImageMemoryRequirements(device, info->image,
+                             &requirements->memoryRequirements);
+}
+
+VKAPI_ATTR void VKAPI_CALL GetImageSparseMemoryRequirements(
+    ::VkDevice, ::VkImage, uint32_t* count,
+    VkSparseImageMemoryRequirements*) {
+  *count = 0;
+}
+
+VKAPI_ATTR void VKAPI_CALL GetImageSubresourceLayout(
+    ::VkDevice, ::VkImage image, const VkImageSubresource*,
+    VkSubresourceLayout* layout) {
+  const VkExtent3D& extent = FromHandle<Image>(image)->extent;
+  layout->offset = 0;
+  layout->rowPitch = extent.width * kMaxTexelSize;
+  layout->depthPitch = layout->rowPitch * extent.height;
+  layout->arrayPitch = layout->depthPitch * extent.depth;
+  layout->size = layout->arrayPitch;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+CreateFence(::VkDevice, const VkFenceCreateInfo* create_info,
+            const VkAllocationCallbacks*, ::VkFence* fence) {
+  *fence = ToHandle<::VkFence>(
+      new Fence{(create_info->flags & VK_FENCE_CREATE_SIGNALED_BIT) != 0});
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL ResetFences(::VkDevice, uint32_t count,
+                                           const ::VkFence* fences) {
+  for (uint32_t i = 0; i < count; ++i) {
+    FromHandle<Fence>(fences[i])->signaled = false;
+  }
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL GetFenceStatus(::VkDevice, ::VkFence fence) {
+  return FromHandle<Fence>(fence)->signaled ? VK_SUCCESS : VK_NOT_READY;
+}
+
+// Work completes as soon as it is submitted, so a fence that is not signaled
+// yet never will be, and waiting for it times out right away.
+VKAPI_ATTR VkResult VKAPI_CALL WaitForFences(::VkDevice, uint32_t count,
+                                             const ::VkFence* fences,
+                                             VkBool32 wait_all, uint64_t) {
+  uint32_t signaled = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    signaled += FromHandle<Fence>(fences[i])->signaled ? 1 : 0;
+  }
+  return (wait_all ? signaled == count : signaled > 0) ? VK_SUCCESS
+                                                       : VK_TIMEOUT;
+}
+
+void Signal(::VkFence fence) {
+  if (fence != VK_NULL_HANDLE) {
+    FromHandle<Fence>(fence)->signaled = true;
+  }
+}
+
+template <typename Info>
+VKAPI_ATTR VkResult VKAPI_CALL Submit(::VkQueue, uint32_t, const Info*,
+                                      ::VkFence fence) {
+  Signal(fence);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL CreateEvent(::VkDevice,
+                                           const VkEventCreateInfo*,
+                                           const VkAllocationCallbacks*,
+                                           ::VkEvent* event) {
+  *event = ToHandle<::VkEvent>(new Event{VK_EVENT_RESET});
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL GetEventStatus(::VkDevice, ::VkEvent event) {
+  return FromHandle<Event>(event)->status;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL SetEvent(::VkDevice, ::VkEvent event) {
+  FromHandle<Event>(event)->status = VK_EVENT_SET;
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL ResetEvent(::VkDevice, ::VkEvent event) {
+  FromHandle<Event>(event)->status = VK_EVENT_RESET;
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+CreateQueryPool(::VkDevice, const VkQueryPoolCreateInfo* create_info,
+                const VkAllocationCallbacks*, ::VkQueryPool* query_pool) {
+  uint32_t values_per_query = 1;
+  if (create_info->queryType == VK_QUERY_TYPE_PIPELINE_STATISTICS) {
+    values_per_query = 0;
+    for (VkQueryPipelineStatisticFlags statistics =
+             create_info->pipelineStatistics;
+         statistics; statistics &= statistics - 1) {
+      ++values_per_query;
+    }
+  }
+  *query_pool = ToHandle<::VkQueryPool>(new QueryPool{values_per_query});
+  return VK_SUCCESS;
+}
+
+// Every query has a result of 0, and is available.
+VKAPI_ATTR VkResult VKAPI_CALL GetQueryPoolResults(
+    ::VkDevice, ::VkQueryPool query_pool, uint32_t, uint32_t count,
+    size_t, void* data, VkDeviceSize stride, VkQueryResultFlags flags) {
+  const uint32_t values = FromHandle<QueryPool>(query_pool)->values_per_query;
+  const bool availability =
+      (flags & VK_QUERY_RESULT_WITH_AVAILABILITY_BIT) != 0;
+  for (uint32_t query = 0; query < count; ++query) {
+    char* result = static_cast<char*>(data) + query * stride;
+    for (uint32_t i = 0; i < values + (availability ? 1 : 0); ++i) {
+      const uint64_t value = i == values ? 1 : 0;
+      if (flags & VK_QUERY_RESULT_64_BIT) {
+        memcpy(result + i * sizeof(uint64_t), &value, sizeof(uint64_t));
+      } else {
+        const uint32_t value32 = static_cast<uint32_t>(value);
+        memcpy(result + i * sizeof(uint32_t), &value32, sizeof(uint32_t));
+      }
+    }
+  }
+  return VK_SUCCESS;
+}
+
+// Every time domain reads the same clock.
+VKAPI_ATTR VkResult VKAPI_CALL GetCalibratedTimestampsEXT(
+    ::VkDevice, uint32_t count, const VkCalibratedTimestampInfoEXT*,
+    uint64_t* timestamps, uint64_t* max_deviation) {
+  const uint64_t now = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+  std::fill(timestamps, timestamps + count, now);
+  *max_deviation = 1;
+  return VK_SUCCESS;
+}
+
+// Pipeline caches hold nothing but the header.
+VKAPI_ATTR VkResult VKAPI_CALL GetPipelineCacheData(::VkDevice,
+                                                    ::VkPipelineCache,
+                                                    size_t* size, void* data) {
+  const uint32_t header_size = 16 + VK_UUID_SIZE;
+  if (!data) {
+    *size = header_size;
+    return VK_SUCCESS;
+  }
+  if (*size < header_size) {
+    *size = 0;
+    return VK_INCOMPLETE;
+  }
+  const uint32_t header[4] = {header_size,
+                              VK_PIPELINE_CACHE_HEADER_VERSION_ONE, 0, 0};
+  memcpy(data, header, sizeof(header));
+  memcpy(static_cast<char*>(data) + sizeof(header), kPipelineCacheUUID,
+         VK_UUID_SIZE);
+  *size = header_size;
+  return VK_SUCCESS;
+}
+
+template <typename CreateInfo>
+VKAPI_ATTR VkResult VKAPI_CALL CreatePipelines(::VkDevice, ::VkPipelineCache,
+                                               uint32_t count,
+                                               const CreateInfo*,
+                                               const VkAllocationCallbacks*,
+                                               ::VkPipeline* pipelines) {
+  for (uint32_t i = 0; i < count; ++i) {
+    pipelines[i] = ToHandle<::VkPipeline>(new Object());
+  }
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL GetRenderAreaGranularity(::VkDevice,
+                                                    ::VkRenderPass,
+                                                    VkExtent2D* granularity) {
+  *granularity = {1, 1};
+}
+
+// Command pools and descriptor pools.
+template <typename Handle>
+void AllocateFromPool(Pool* pool, uint32_t count, Handle* handles) {
+  for (uint32_t i = 0; i < count; ++i) {
+    Object* child = new Object();
+    pool->children.insert(child);
+    handles[i] = ToHandle<Handle>(child);
+  }
+}
+
+template <typename Handle>
+void FreeToPool(Pool* pool, uint32_t count, const Handle* handles) {
+  for (uint32_t i = 0; i < count; ++i) {
+    Object* child = FromHandle<Object>(handles[i]);
+    if (child) {
+      pool->children.erase(child);
+      delete child;
+    }
+  }
+}
+
+void ResetPool(Pool* pool) {
+  for (Object* child : pool->children) {
+    delete child;
+  }
+  pool->children.clear();
+}
+
+template <typename Handle>
+VKAPI_ATTR void VKAPI_CALL DestroyPool(::VkDevice, Handle pool,
+                                       const VkAllocationCallbacks*) {
+  if (pool != VK_NULL_HANDLE) {
+    ResetPool(FromHandle<Pool>(pool));
+    delete FromHandle<Pool>(pool);
+  }
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+AllocateCommandBuffers(::VkDevice, const VkCommandBufferAllocateInfo* info,
+                       ::VkCommandBuffer* command_buffers) {
+  AllocateFromPool(FromHandle<Pool>(info->commandPool),
+                   info->commandBufferCount, command_buffers);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+FreeCommandBuffers(::VkDevice, ::VkCommandPool pool, uint32_t count,
+                   const ::VkCommandBuffer* command_buffers) {
+  FreeToPool(FromHandle<Pool>(pool), count, command_buffers);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+AllocateDescriptorSets(::VkDevice, const VkDescriptorSetAllocateInfo* info,
+                       ::VkDescriptorSet* sets) {
+  AllocateFromPool(FromHandle<Pool>(info->descriptorPool),
+                   info->descriptorSetCount, sets);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+FreeDescriptorSets(::VkDevice, ::VkDescriptorPool pool, uint32_t count,
+                   const ::VkDescriptorSet* sets) {
+  FreeToPool(FromHandle<Pool>(pool), count, sets);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL ResetDescriptorPool(::VkDevice,
+                                                   ::VkDescriptorPool pool,
+                                                   VkDescriptorPoolResetFlags) {
+  ResetPool(FromHandle<Pool>(pool));
+  return VK_SUCCESS;
+}
+
+// Swapchain functions.
+VKAPI_ATTR VkResult VKAPI_CALL
+CreateSwapchainKHR(::VkDevice, const VkSwapchainCreateInfoKHR* create_info,
+                   const VkAllocationCallbacks*, ::VkSwapchainKHR* swapchain) {
+  Swapchain* new_swapchain = new Swapchain();
+  const VkExtent3D extent = {create_info->imageExtent.width,
+                             create_info->imageExtent.height, 1};
+  const VkDeviceSize size = static_cast<VkDeviceSize>(extent.width) *
+                            extent.height * kMaxTexelSize;
+  new_swapchain->images.resize(
+      create_info->minImageCount,
+      Image{extent, {AlignUp(size), kMemoryAlignment, kAllMemoryTypes}});
+  for (Image& image : new_swapchain->images) {
+    new_swapchain->image_handles.push_back(ToHandle<::VkImage>(&image));
+  }
+  new_swapchain->next_image = 0;
+  *swapchain = ToHandle<::VkSwapchainKHR>(new_swapchain);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL GetSwapchainImagesKHR(
+    ::VkDevice, ::VkSwapchainKHR swapchain, uint32_t* count,
+    ::VkImage* images) {
+  const Swapchain* images_swapchain = FromHandle<Swapchain>(swapchain);
+  return Enumerate(images_swapchain->image_handles.data(),
+                   static_cast<uint32_t>(images_swapchain->images.size()),
+                   count, images);
+}
+
+// Images are handed out in order, and are available right away.
+VKAPI_ATTR VkResult VKAPI_CALL AcquireNextImageKHR(
+    ::VkDevice, ::VkSwapchainKHR swapchain, uint64_t, ::VkSemaphore,
+    ::VkFence fence, uint32_t* image_index) {
+  Swapchain* acquire_swapchain = FromHandle<Swapchain>(swapchain);
+  *image_index = acquire_swapchain->next_image;
+  acquire_swapchain->next_image =
+      (acquire_swapchain->next_image + 1) %
+      static_cast<uint32_t>(acquire_swapchain->images.size());
+  Signal(fence);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+QueuePresentKHR(::VkQueue, const VkPresentInfoKHR* present_info) {
+  if (present_info->pResults) {
+    std::fill(present_info->pResults,
+              present_info->pResults + present_info->swapchainCount,
+              VK_SUCCESS);
+  }
+  return VK_SUCCESS;
+}
+
+struct Function {
+  const char* name;
+  PFN_vkVoidFunction function;
+};
+
+// The casts make sure that every implementation has the right type.
+#define FUNCTION(name, implementation)       \
+  {                                          \
+    #name, reinterpret_cast<PFN_vkVoidFunction>( \
+               static_cast<PFN_##name>(implementation)) \
+  }
+#define NO_OP(name) FUNCTION(name, &NoOp<PFN_##name>::Call)
+
+const Function kFunctions[] = {
+    // Global functions.
+    FUNCTION(vkGetInstanceProcAddr, &GetInstanceProcAddr),
+    FUNCTION(vkEnumerateInstanceExtensionProperties,
+             &EnumerateInstanceExtensionProperties),
+    FUNCTION(vkEnumerateInstanceLayerProperties,
+             &EnumerateInstanceLayerProperties),
+    FUNCTION(vkEnumerateInstanceVersion, &EnumerateInstanceVersion),
+    FUNCTION(vkCreateInstance, &CreateInstance),
+
+    // Instance functions.
+    FUNCTION(vkDestroyInstance, &DestroyInstance),
+    FUNCTION(vkEnumeratePhysicalDevices, &EnumeratePhysicalDevices),
+    FUNCTION(vkEnumeratePhysicalDeviceGroups, &EnumeratePhysicalDeviceGroups),
+    FUNCTION(vkGetPhysicalDeviceProperties, &GetPhysicalDeviceProperties),
+    FUNCTION(vkGetPhysicalDeviceProperties2, &GetPhysicalDeviceProperties2),
+    FUNCTION(vkGetPhysicalDeviceProperties2KHR, &GetPhysicalDeviceProperties2),
+    FUNCTION(vkGetPhysicalDeviceFeatures, &GetPhysicalDeviceFeatures),
+    FUNCTION(vkGetPhysicalDeviceFeatures2, &GetPhysicalDeviceFeatures2),
+    FUNCTION(vkGetPhysicalDeviceFeatures2KHR, &GetPhysicalDeviceFeatures2),
+    FUNCTION(vkGetPhysicalDeviceMemoryProperties,
+             &GetPhysicalDeviceMemoryProperties),
+    FUNCTION(vkGetPhysicalDeviceMemoryProperties2,
+             &GetPhysicalDeviceMemoryProperties2),
+    FUNCTION(vkGetPhysicalDeviceMemoryProperties2KHR,
+             &GetPhysicalDeviceMemoryProperties2),
+    FUNCTION(vkGetPhysicalDeviceQueueFamilyProperties,
+             &GetPhysicalDeviceQueueFamilyProperties),
+    FUNCTION(vkGetPhysicalDeviceQueueFamilyProperties2,
+             &GetPhysicalDeviceQueueFamilyProperties2),
+    FUNCTION(vkGetPhysicalDeviceQueueFamilyProperties2KHR,
+             &GetPhysicalDeviceQueueFamilyProperties2),
+    FUNCTION(vkGetPhysicalDeviceFormatProperties,
+             &GetPhysicalDeviceFormatProperties),
+    FUNCTION(vkGetPhysicalDeviceFormatProperties2,
+             &GetPhysicalDeviceFormatProperties2),
+    FUNCTION(vkGetPhysicalDeviceFormatProperties2KHR,
+             &GetPhysicalDeviceFormatProperties2),
+    FUNCTION(vkGetPhysicalDeviceImageFormatProperties,
+             &GetPhysicalDeviceImageFormatProperties),
+    FUNCTION(vkGetPhysicalDeviceImageFormatProperties2,
+             &GetPhysicalDeviceImageFormatProperties2),
+    FUNCTION(vkGetPhysicalDeviceImageFormatProperties2KHR,
+             &GetPhysicalDeviceImageFormatProperties2),
+    FUNCTION(vkGetPhysicalDeviceSparseImageFormatProperties,
+             &GetPhysicalDeviceSparseImageFormatProperties),
+    FUNCTION(vkEnumerateDeviceExtensionProperties,
+             &EnumerateDeviceExtensionProperties),
+    FUNCTION(vkEnumerateDeviceLayerProperties,
+             &EnumerateDeviceLayerProperties),
+    FUNCTION(vkCreateDevice, &CreateDevice),
+    FUNCTION(vkGetPhysicalDeviceCalibrateableTimeDomainsEXT,
+             &GetPhysicalDeviceCalibrateableTimeDomainsEXT),
+
+    // Surface functions.
+    FUNCTION(vkDestroySurfaceKHR, &DestroyObject),
+    FUNCTION(vkCreateHeadlessSurfaceEXT, &CreateObject),
+    FUNCTION(vkGetPhysicalDeviceSurfaceSupportKHR,
+             &GetPhysicalDeviceSurfaceSupportKHR),
+    FUNCTION(vkGetPhysicalDeviceSurfaceCapabilitiesKHR,
+             &GetPhysicalDeviceSurfaceCapabilitiesKHR),
+    FUNCTION(vkGetPhysicalDeviceSurfaceFormatsKHR,
+             &GetPhysicalDeviceSurfaceFormatsKHR),
+    FUNCTION(vkGetPhysicalDeviceSurfacePresentModesKHR,
+             &GetPhysicalDeviceSurfacePresentModesKHR),
+#if defined __ANDROID__
+    FUNCTION(vkCreateAndroidSurfaceKHR, &CreateObject),
+#elif defined __ggp__
+    FUNCTION(vkCreateStreamDescriptorSurfaceGGP, &CreateObject),
+#elif defined __linux__
+    FUNCTION(vkCreateXcbSurfaceKHR, &CreateObject),
+    FUNCTION(vkGetPhysicalDeviceXcbPresentationSupportKHR,
+             &PresentationSupport),
+#elif defined _WIN32
+    FUNCTION(vkCreateWin32SurfaceKHR, &CreateObject),
+    FUNCTION(vkGetPhysicalDeviceWin32PresentationSupportKHR,
+             &PresentationSupport),
+#elif defined __APPLE__
+    FUNCTION(vkCreateMacOSSurfaceMVK, &CreateObject),
+#endif
+
+    // Device functions.
+    FUNCTION(vkGetDeviceProcAddr, &GetDeviceProcAddr),
+    FUNCTION(vkDestroyDevice, &DestroyDevice),
+    FUNCTION(vkGetDeviceQueue, &GetDeviceQueue),
+    NO_OP(vkDeviceWaitIdle),
+    FUNCTION(vkAllocateMemory, &AllocateMemory),
+    FUNCTION(vkFreeMemory, &FreeMemory),
+    FUNCTION(vkMapMemory, &MapMemory),
+    NO_OP(vkUnmapMemory),
+    NO_OP(vkFlushMappedMemoryRanges),
+    NO_OP(vkInvalidateMappedMemoryRanges),
+    FUNCTION(vkCreateBuffer, &CreateBuffer),
+    FUNCTION(vkDestroyBuffer, &DestroyObject<Buffer>),
+    FUNCTION(vkGetBufferMemoryRequirements, &GetBufferMemoryRequirements),
+    FUNCTION(vkGetBufferMemoryRequirements2, &GetBufferMemoryRequirements2),
+    NO_OP(vkBindBufferMemory),
+    NO_OP(vkBindBufferMemory2),
+    FUNCTION(vkCreateBufferView, &CreateObject),
+    FUNCTION(vkDestroyBufferView, &DestroyObject),
+    FUNCTION(vkCreateImage, &CreateImage),
+    FUNCTION(vkDestroyImage, &DestroyObject<Image>),
+    FUNCTION(vkGetImageMemoryRequirements, &GetImageMemoryRequirements),
+    FUNCTION(vkGetImageMemoryRequirements2, &GetImageMemoryRequirements2),
+    FUNCTION(vkGetImageSparseMemoryRequirements,
+             &GetImageSparseMemoryRequirements),
+    FUNCTION(vkGetImageSubresourceLayout, &GetImageSubresourceLayout),
+    NO_OP(vkBindImageMemory),
+    NO_OP(vkBindImageMemory2),
+    FUNCTION(vkCreateImageView, &CreateObject),
+    FUNCTION(vkDestroyImageView, &DestroyObject),
+    FUNCTION(vkCreateSampler, &CreateObject),
+    FUNCTION(vkDestroySampler, &DestroyObject),
+    FUNCTION(vkCreateSamplerYcbcrConversion, &CreateObject),
+    FUNCTION(vkDestroySamplerYcbcrConversion, &DestroyObject),
+    FUNCTION(vkCreateFence, &CreateFence),
+    FUNCTION(vkDestroyFence, &DestroyObject<Fence>),
+    FUNCTION(vkResetFences, &ResetFences),
+    FUNCTION(vkGetFenceStatus, &GetFenceStatus),
+    FUNCTION(vkWaitForFences, &WaitForFences),
+    FUNCTION(vkCreateSemaphore, &CreateObject),
+    FUNCTION(vkDestroySemaphore, &DestroyObject),
+    FUNCTION(vkCreateEvent, &CreateEvent),
+    FUNCTION(vkDestroyEvent, &DestroyObject<Event>),
+    FUNCTION(vkGetEventStatus, &GetEventStatus),
+    FUNCTION(vkSetEvent, &SetEvent),
+    FUNCTION(vkResetEvent, &ResetEvent),
+    FUNCTION(vkCreateQueryPool, &CreateQueryPool),
+    FUNCTION(vkDestroyQueryPool, &DestroyObject<QueryPool>),
+    FUNCTION(vkGetQueryPoolResults, &GetQueryPoolResults),
+    NO_OP(vkResetQueryPoolEXT),
+    FUNCTION(vkGetCalibratedTimestampsEXT, &GetCalibratedTimestampsEXT),
+    FUNCTION(vkCreateShaderModule, &CreateObject),
+    FUNCTION(vkDestroyShaderModule, &DestroyObject),
+    FUNCTION(vkCreatePipelineCache, &CreateObject),
+    FUNCTION(vkDestroyPipelineCache, &DestroyObject),
+    FUNCTION(vkGetPipelineCacheData, &GetPipelineCacheData),
+    NO_OP(vkMergePipelineCaches),
+    FUNCTION(vkCreatePipelineLayout, &CreateObject),
+    FUNCTION(vkDestroyPipelineLayout, &DestroyObject),
+    FUNCTION(vkCreateGraphicsPipelines, &CreatePipelines),
+    FUNCTION(vkCreateComputePipelines, &CreatePipelines),
+    FUNCTION(vkDestroyPipeline, &DestroyObject),
+    FUNCTION(vkCreateRenderPass, &CreateObject),
+    FUNCTION(vkDestroyRenderPass, &DestroyObject),
+    FUNCTION(vkGetRenderAreaGranularity, &GetRenderAreaGranularity),
+    FUNCTION(vkCreateFramebuffer, &CreateObject),
+    FUNCTION(vkDestroyFramebuffer, &DestroyObject),
+    FUNCTION(vkCreateDescriptorSetLayout, &CreateObject),
+    FUNCTION(vkDestroyDescriptorSetLayout, &DestroyObject),
+    FUNCTION(vkCreateDescriptorUpdateTemplate, &CreateObject),
+    FUNCTION(vkCreateDescriptorUpdateTemplateKHR, &CreateObject),
+    FUNCTION(vkDestroyDescriptorUpdateTemplate, &DestroyObject),
+    FUNCTION(vkDestroyDescriptorUpdateTemplateKHR, &DestroyObject),
+    FUNCTION(vkCreateDescriptorPool, &CreateObject<Pool>),
+    FUNCTION(vkDestroyDescriptorPool, &DestroyPool),
+    FUNCTION(vkResetDescriptorPool, &ResetDescriptorPool),
+    FUNCTION(vkAllocateDescriptorSets, &AllocateDescriptorSets),
+    FUNCTION(vkFreeDescriptorSets, &FreeDescriptorSets),
+    NO_OP(vkUpdateDescriptorSets),
+    NO_OP(vkUpdateDescriptorSetWithTemplate),
+    NO_OP(vkUpdateDescriptorSetWithTemplateKHR),
+    FUNCTION(vkCreateCommandPool, &CreateObject<Pool>),
+    FUNCTION(vkDestroyCommandPool, &DestroyPool),
+    NO_OP(vkResetCommandPool),
+    NO_OP(vkTrimCommandPool),
+    FUNCTION(vkAllocateCommandBuffers, &AllocateCommandBuffers),
+    FUNCTION(vkFreeCommandBuffers, &FreeCommandBuffers),
+
+    // Swapchain functions.
+    FUNCTION(vkCreateSwapchainKHR, &CreateSwapchainKHR),
+    FUNCTION(vkDestroySwapchainKHR, &DestroyObject<Swapchain>),
+    FUNCTION(vkGetSwapchainImagesKHR, &GetSwapchainImagesKHR),
+    FUNCTION(vkAcquireNextImageKHR, &AcquireNextImageKHR),
+
+    // Queue functions.
+    FUNCTION(vkQueueSubmit, &Submit),
+    FUNCTION(vkQueueBindSparse, &Submit),
+    NO_OP(vkQueueWaitIdle),
+    FUNCTION(vkQueuePresentKHR, &QueuePresentKHR),
+
+    // Command buffer functions.
+    NO_OP(vkBeginCommandBuffer),
+    NO_OP(vkEndCommandBuffer),
+    NO_OP(vkResetCommandBuffer),
+    NO_OP(vkCmdBindPipeline),
+    NO_OP(vkCmdSetViewport),
+    NO_OP(vkCmdSetScissor),
+    NO_OP(vkCmdSetLineWidth),
+    NO_OP(vkCmdSetDepthBias),
+    NO_OP(vkCmdSetBlendConstants),
+    NO_OP(vkCmdSetDepthBounds),
+    NO_OP(vkCmdSetStencilCompareMask),
+    NO_OP(vkCmdSetStencilWriteMask),
+    NO_OP(vkCmdSetStencilReference),
+    NO_OP(vkCmdSetDeviceMask),
+    NO_OP(vkCmdBindDescriptorSets),
+    NO_OP(vkCmdBindIndexBuffer),
+    NO_OP(vkCmdBindVertexBuffers),
+    NO_OP(vkCmdDraw),
+    NO_OP(vkCmdDrawIndexed),
+    NO_OP(vkCmdDrawIndirect),
+    NO_OP(vkCmdDrawIndexedIndirect),
+    NO_OP(vkCmdDrawIndirectCountKHR),
+    NO_OP(vkCmdDrawIndexedIndirectCountKHR),
+    NO_OP(vkCmdDispatch),
+    NO_OP(vkCmdDispatchBase),
+    NO_OP(vkCmdDispatchIndirect),
+    NO_OP(vkCmdCopyBuffer),
+    NO_OP(vkCmdCopyImage),
+    NO_OP(vkCmdBlitImage),
+    NO_OP(vkCmdCopyBufferToImage),
+    NO_OP(vkCmdCopyImageToBuffer),
+    NO_OP(vkCmdUpdateBuffer),
+    NO_OP(vkCmdFillBuffer),
+    NO_OP(vkCmdClearColorImage),
+    NO_OP(vkCmdClearDepthStencilImage),
+    NO_OP(vkCmdClearAttachments),
+    NO_OP(vkCmdResolveImage),
+    NO_OP(vkCmdSetEvent),
+    NO_OP(vkCmdResetEvent),
+    NO_OP(vkCmdWaitEvents),
+    NO_OP(vkCmdPipelineBarrier),
+    NO_OP(vkCmdBeginQuery),
+    NO_OP(vkCmdEndQuery),
+    NO_OP(vkCmdResetQueryPool),
+    NO_OP(vkCmdWriteTimestamp),
+    NO_OP(vkCmdCopyQueryPoolResults),
+    NO_OP(vkCmdPushConstants),
+    NO_OP(vkCmdBeginRenderPass),
+    NO_OP(vkCmdNextSubpass),
+    NO_OP(vkCmdEndRenderPass),
+    NO_OP(vkCmdExecuteCommands),
+};
+
+#undef NO_OP
+#undef FUNCTION
+}  // anonymous namespace
+
+PFN_vkVoidFunction VKAPI_CALL GetInstanceProcAddr(::VkInstance,
+                                                  const char* name) {
+  for (const Function& function : kFunctions) {
+    if (strcmp(function.name, name) == 0) {
+      return function.function;
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace null_driver
+}  // namespace vulkan
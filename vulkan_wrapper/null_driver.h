@@ -0,0 +1,52 @@
+/* Copyright 2022 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VULKAN_WRAPPER_NULL_DRIVER_H_
+#define VULKAN_WRAPPER_NULL_DRIVER_H_
+
+#include "vulkan_helpers/vulkan_header_wrapper.h"
+
+namespace vulkan {
+namespace null_driver {
+
+// The null driver is a Vulkan implementation that does no work at all. It
+// exposes one physical device with fake memory types, heaps and queue
+// families, the surface and swapchain extensions, and every entry point that
+// VulkanApplication and the samples use.
+//
+// Everything it does is trivial and deterministic:
+//  - Submitted work completes right away, so fences are signaled by
+//    vkQueueSubmit and vkAcquireNextImageKHR, and waits never block.
+//  - Host visible memory is backed by zeroed host memory, device local
+//    memory is not backed at all.
+//  - Queries return 0, commands are not recorded, and shaders and pipelines
+//    are not looked at.
+//
+// This makes it possible to run VulkanApplication without a GPU, and to
+// measure the CPU cost of the framework and the samples without the cost of
+// a real driver, see -null-driver in support/entry/README.md.
+//
+// Returns the null driver's implementation of |name|, or nullptr if it does
+// not implement it. |instance| is ignored, as there is only one
+// implementation of every function. The returned functions may be used from
+// any thread, but objects must be externally synchronized as the Vulkan
+// specification requires.
+PFN_vkVoidFunction VKAPI_CALL GetInstanceProcAddr(::VkInstance instance,
+                                                  const char* name);
+
+}  // namespace null_driver
+}  // namespace vulkan
+
+#endif  // VULKAN_WRAPPER_NULL_DRIVER_H_